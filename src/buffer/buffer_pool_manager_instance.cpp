@@ -12,6 +12,10 @@
 
 #include "buffer/buffer_pool_manager_instance.h"
 
+#include <algorithm>
+#include <cstring>
+#include <unordered_set>
+
 #include "common/macros.h"
 
 #include "common/logger.h"
@@ -58,10 +62,119 @@ bool BufferPoolManagerInstance::FlushPgImp(page_id_t page_id) {
   }
   auto frame_id = page_table_[page_id];
   pages_[frame_id].is_dirty_ = false;
-  disk_manager_->WritePage(page_id, pages_[frame_id].GetData());
+  WritePageToDisk(&pages_[frame_id]);
   return true;
 }
 
+std::vector<DirtyPageEntry> BufferPoolManagerInstance::GetDirtyPageTable() {
+  std::scoped_lock<std::mutex> lock(latch_);
+  std::vector<DirtyPageEntry> dirty_pages;
+  for (size_t i = 0; i < pool_size_; ++i) {
+    Page *page = &pages_[i];
+    // A pinned page may be changed at any time, but it only becomes dirty once it is unpinned.
+    bool may_be_dirty = page->is_dirty_ || page->pin_count_ > 0;
+    if (page->page_id_ != INVALID_PAGE_ID && page->rec_lsn_ != INVALID_LSN && may_be_dirty) {
+      dirty_pages.push_back(DirtyPageEntry{page->page_id_, page->rec_lsn_});
+    }
+  }
+  return dirty_pages;
+}
+
+std::vector<page_id_t> BufferPoolManagerInstance::GetResidentPages() {
+  std::scoped_lock<std::mutex> lock(latch_);
+  std::vector<page_id_t> page_ids;
+  std::vector<bool> listed(pool_size_, false);
+  page_ids.reserve(page_table_.size());
+  for (size_t i = 0; i < pool_size_; ++i) {
+    if (pages_[i].page_id_ != INVALID_PAGE_ID && pages_[i].pin_count_ > 0) {
+      page_ids.push_back(pages_[i].page_id_);
+      listed[i] = true;
+    }
+  }
+  for (frame_id_t frame_id : replacer_->GetFramesByHotness()) {
+    if (pages_[frame_id].page_id_ != INVALID_PAGE_ID && !listed[frame_id]) {
+      page_ids.push_back(pages_[frame_id].page_id_);
+      listed[frame_id] = true;
+    }
+  }
+  return page_ids;
+}
+
+size_t BufferPoolManagerInstance::Prefetch(const std::vector<page_id_t> &page_ids) {
+  std::vector<page_id_t> sorted;
+  sorted.reserve(page_ids.size());
+  for (page_id_t page_id : page_ids) {
+    if (page_id != INVALID_PAGE_ID) {
+      ValidatePageId(page_id);
+      sorted.push_back(page_id);
+    }
+  }
+  std::sort(sorted.begin(), sorted.end());
+  sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+  std::vector<char> buffer(PREFETCH_BATCH_PAGES * PAGE_SIZE);
+  std::unordered_set<page_id_t> loaded;
+  size_t resident = 0;
+  size_t i = 0;
+  while (i < sorted.size()) {
+    // The latch is dropped between reads, so fetches don't wait for the whole prefetch.
+    std::scoped_lock<std::mutex> lock(latch_);
+    while (i < sorted.size() && page_table_.count(sorted[i]) != 0) {
+      ++resident;
+      ++i;
+    }
+    if (i == sorted.size()) {
+      break;
+    }
+    // Read the run of consecutive pages that starts here, as far as there are free frames for it.
+    size_t run = 0;
+    while (i + run < sorted.size() && run < static_cast<size_t>(PREFETCH_BATCH_PAGES) && run < free_list_.size() &&
+           sorted[i + run] == sorted[i] + static_cast<page_id_t>(run * num_instances_) &&
+           page_table_.count(sorted[i + run]) == 0) {
+      ++run;
+    }
+    if (run == 0) {
+      // Prefetching never evicts a page, it stops once the free frames are used up.
+      break;
+    }
+    if (num_instances_ == 1) {
+      disk_manager_->ReadPages(sorted[i], static_cast<int>(run), buffer.data());
+    } else {
+      // The pages of one instance are strided on disk, so they are read one by one.
+      for (size_t j = 0; j < run; ++j) {
+        disk_manager_->ReadPage(sorted[i + j], buffer.data() + j * PAGE_SIZE);
+      }
+    }
+    for (size_t j = 0; j < run; ++j) {
+      frame_id_t frame_id = free_list_.front();
+      free_list_.pop_front();
+      Page *page = &pages_[frame_id];
+      page_table_[sorted[i + j]] = frame_id;
+      page->page_id_ = sorted[i + j];
+      page->pin_count_ = 0;
+      page->is_dirty_ = false;
+      page->rec_lsn_ = INVALID_LSN;
+      memcpy(page->GetData(), buffer.data() + j * PAGE_SIZE, PAGE_SIZE);
+      replacer_->Unpin(frame_id);
+      loaded.insert(sorted[i + j]);
+    }
+    resident += run;
+    i += run;
+  }
+
+  // The pages went into the replacer in page id order. Touch them again coldest first, so that the hottest are the
+  // last to be evicted.
+  std::scoped_lock<std::mutex> lock(latch_);
+  for (auto it = page_ids.rbegin(); it != page_ids.rend(); ++it) {
+    auto entry = page_table_.find(*it);
+    if (loaded.count(*it) != 0 && entry != page_table_.end() && pages_[entry->second].pin_count_ == 0) {
+      replacer_->Pin(entry->second);
+      replacer_->Unpin(entry->second);
+    }
+  }
+  return resident;
+}
+
 void BufferPoolManagerInstance::FlushAllPgsImp() {
   // You can do it!
   // std::lock_guard<std::mutex> lock(latch_);
@@ -98,7 +211,7 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
     }
     if (pages_[frame_id].IsDirty()) {
       pages_[frame_id].is_dirty_ = false;
-      disk_manager_->WritePage(pages_[frame_id].GetPageId(), pages_[frame_id].GetData());
+      WritePageToDisk(&pages_[frame_id]);
     }
   }
   // 3.   Update P's metadata, zero out memory and add P to the page table.
@@ -107,8 +220,9 @@ Page *BufferPoolManagerInstance::NewPgImp(page_id_t *page_id) {
   page_table_[*page_id] = frame_id;
   Page *new_page = &pages_[frame_id];
   new_page->page_id_ = *page_id;
-  new_page->pin_count_ = 1;
+  new_page->pin_count_ = 0;
   new_page->is_dirty_ = false;
+  PinPage(new_page);
   new_page->ResetMemory();
   disk_manager_->WritePage(new_page->GetPageId(), new_page->GetData());
   // 4.   Set the page ID output parameter. Return a pointer to P.
@@ -126,8 +240,9 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   if (page_table_.count(page_id) != 0U) {
     auto frame_id = page_table_[page_id];
     Page *the_page = &pages_[frame_id];
-    the_page->pin_count_++;
+    PinPage(the_page);
     replacer_->Pin(frame_id);
+    num_hits_++;
     return the_page;
   }
   // 1.2    If P does not exist, find a replacement page (R) from either the free list or the replacer.
@@ -150,17 +265,19 @@ Page *BufferPoolManagerInstance::FetchPgImp(page_id_t page_id) {
   Page *the_page = &pages_[frame_id];
   if (the_page->IsDirty()) {
     the_page->is_dirty_ = false;
-    disk_manager_->WritePage(the_page->GetPageId(), the_page->GetData());
+    WritePageToDisk(the_page);
   }
   // 3.     Delete R from the page table and insert P.
   page_table_.erase(the_page->GetPageId());
   page_table_[page_id] = frame_id;
   // 4.     Update P's metadata, read in the page content from disk, and then return a pointer to P.
   the_page->page_id_ = page_id;
-  the_page->pin_count_ = 1;
+  the_page->pin_count_ = 0;
+  PinPage(the_page);
   the_page->ResetMemory();
   replacer_->Pin(frame_id);
   disk_manager_->ReadPage(page_id, the_page->GetData());
+  num_misses_++;
   return the_page;
 }
 
@@ -187,6 +304,7 @@ bool BufferPoolManagerInstance::DeletePgImp(page_id_t page_id) {
   the_page->pin_count_ = 0;
   free_list_.push_back(frame_id);
   the_page->is_dirty_ = false;
+  the_page->rec_lsn_ = INVALID_LSN;
   // disk_manager_->WritePage(the_page->GetPageId(), the_page->GetData());
   DeallocatePage(page_id);
   return true;
@@ -231,4 +349,25 @@ void BufferPoolManagerInstance::ValidatePageId(const page_id_t page_id) const {
   assert(page_id % num_instances_ == instance_index_);  // allocated pages mod back to this BPI
 }
 
+void BufferPoolManagerInstance::WritePageToDisk(Page *page) {
+  if (enable_logging && log_manager_ != nullptr) {
+    // Changes still logged privately have no LSN yet, and the page LSN only covers them once they are published.
+    log_manager_->PublishPageLog(page);
+    if (page->GetLSN() > log_manager_->GetPersistentLSN()) {
+      log_manager_->Flush(page->GetLSN());
+    }
+  }
+  disk_manager_->WritePage(page->GetPageId(), page->GetData());
+  // A pinned page may have been changed by a record that is not on disk yet, so it keeps its recovery LSN.
+  if (page->pin_count_ == 0) {
+    page->rec_lsn_ = INVALID_LSN;
+  }
+}
+
+void BufferPoolManagerInstance::PinPage(Page *page) {
+  if (page->pin_count_++ == 0 && !page->is_dirty_) {
+    page->rec_lsn_ = log_manager_ == nullptr ? INVALID_LSN : log_manager_->GetNextLSN();
+  }
+}
+
 }  // namespace bustub
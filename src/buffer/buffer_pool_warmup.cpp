@@ -0,0 +1,72 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_warmup.cpp
+//
+// Identification: src/buffer/buffer_pool_warmup.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "buffer/buffer_pool_warmup.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "common/logger.h"
+
+namespace bustub {
+
+void BufferPoolWarmup::SaveResidentPages() { disk_manager_->WriteWarmupList(buffer_pool_manager_->GetResidentPages()); }
+
+bool BufferPoolWarmup::Start() {
+  if (worker_.joinable()) {
+    return true;
+  }
+  std::vector<page_id_t> page_ids;
+  if (!disk_manager_->ReadWarmupList(&page_ids)) {
+    done_ = true;
+    return false;
+  }
+  stop_ = false;
+  done_ = false;
+  worker_ = std::thread([this, page_ids = std::move(page_ids)]() mutable { RunWarmup(std::move(page_ids)); });
+  return true;
+}
+
+void BufferPoolWarmup::Stop() {
+  stop_ = true;
+  Wait();
+}
+
+void BufferPoolWarmup::Wait() {
+  if (worker_.joinable()) {
+    worker_.join();
+  }
+}
+
+void BufferPoolWarmup::RunWarmup(std::vector<page_id_t> page_ids) {
+  auto start = std::chrono::steady_clock::now();
+  // There is no point in prefetching more pages than fit into the buffer pool.
+  page_ids.resize(std::min(page_ids.size(), buffer_pool_manager_->GetPoolSize()));
+  for (size_t begin = 0; begin < page_ids.size() && !stop_; begin += chunk_size_) {
+    size_t end = std::min(begin + chunk_size_, page_ids.size());
+    std::vector<page_id_t> chunk(page_ids.begin() + begin, page_ids.begin() + end);
+    size_t resident = buffer_pool_manager_->Prefetch(chunk);
+    num_prefetched_ += resident;
+    warmup_ns_ = (std::chrono::steady_clock::now() - start).count();
+    if (resident < chunk.size()) {
+      // The buffer pool is full, the queries have taken the rest of it.
+      break;
+    }
+  }
+  warmup_ns_ = (std::chrono::steady_clock::now() - start).count();
+  LOG_DEBUG("warm-up prefetched %zu pages in %ld ms", num_prefetched_.load(),
+            static_cast<int64_t>(warmup_ns_ / 1000000));
+  done_ = true;
+}
+
+}  // namespace bustub
@@ -63,6 +63,12 @@ void LRUReplacer::Unpin(frame_id_t frame_id) {
   to_pos_[frame_id] = lru_cache_.begin();
 }
 
+std::vector<frame_id_t> LRUReplacer::GetFramesByHotness() {
+  std::scoped_lock<std::mutex> lock(the_mutex_);
+  // The most recently unpinned frame is at the front.
+  return std::vector<frame_id_t>(lru_cache_.begin(), lru_cache_.end());
+}
+
 size_t LRUReplacer::Size() {
   // size_t lru_size = lru_cache_.size();
   return to_pos_.size();
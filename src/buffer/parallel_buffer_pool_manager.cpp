@@ -41,6 +41,68 @@ size_t ParallelBufferPoolManager::GetPoolSize() {
   return parallel_buffer_pool_sizes_;
 }
 
+std::vector<DirtyPageEntry> ParallelBufferPoolManager::GetDirtyPageTable() {
+  std::vector<DirtyPageEntry> dirty_pages;
+  for (size_t i = 0; i < num_instance_; ++i) {
+    auto instance_pages = buffer_pool_[i]->GetDirtyPageTable();
+    dirty_pages.insert(dirty_pages.end(), instance_pages.begin(), instance_pages.end());
+  }
+  return dirty_pages;
+}
+
+std::vector<page_id_t> ParallelBufferPoolManager::GetResidentPages() {
+  std::vector<std::vector<page_id_t>> instance_pages(num_instance_);
+  size_t total = 0;
+  for (size_t i = 0; i < num_instance_; ++i) {
+    instance_pages[i] = buffer_pool_[i]->GetResidentPages();
+    total += instance_pages[i].size();
+  }
+  // The instances are not ranked against each other, so the n-th hottest page of every instance comes before the
+  // (n+1)-th of any.
+  std::vector<page_id_t> page_ids;
+  page_ids.reserve(total);
+  for (size_t rank = 0; page_ids.size() < total; ++rank) {
+    for (size_t i = 0; i < num_instance_; ++i) {
+      if (rank < instance_pages[i].size()) {
+        page_ids.push_back(instance_pages[i][rank]);
+      }
+    }
+  }
+  return page_ids;
+}
+
+size_t ParallelBufferPoolManager::Prefetch(const std::vector<page_id_t> &page_ids) {
+  std::vector<std::vector<page_id_t>> instance_pages(num_instance_);
+  for (page_id_t page_id : page_ids) {
+    if (page_id != INVALID_PAGE_ID) {
+      instance_pages[page_id % num_instance_].push_back(page_id);
+    }
+  }
+  size_t resident = 0;
+  for (size_t i = 0; i < num_instance_; ++i) {
+    if (!instance_pages[i].empty()) {
+      resident += buffer_pool_[i]->Prefetch(instance_pages[i]);
+    }
+  }
+  return resident;
+}
+
+uint64_t ParallelBufferPoolManager::GetNumHits() {
+  uint64_t hits = 0;
+  for (size_t i = 0; i < num_instance_; ++i) {
+    hits += buffer_pool_[i]->GetNumHits();
+  }
+  return hits;
+}
+
+uint64_t ParallelBufferPoolManager::GetNumMisses() {
+  uint64_t misses = 0;
+  for (size_t i = 0; i < num_instance_; ++i) {
+    misses += buffer_pool_[i]->GetNumMisses();
+  }
+  return misses;
+}
+
 BufferPoolManager *ParallelBufferPoolManager::GetBufferPoolManager(page_id_t page_id) {
   // Get BufferPoolManager responsible for handling given page id. You can use this method in your other methods.
   return buffer_pool_[page_id % num_instance_];
@@ -18,6 +18,10 @@ std::atomic<bool> enable_logging(false);
 
 std::chrono::duration<int64_t> log_timeout = std::chrono::seconds(1);
 
+std::atomic<bool> enable_page_compression(false);
+
+std::atomic<int64_t> log_segment_size(0);
+
 std::chrono::milliseconds cycle_detection_interval = std::chrono::milliseconds(50);
 
 }  // namespace bustub
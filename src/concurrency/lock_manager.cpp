@@ -12,6 +12,12 @@
 
 #include "concurrency/lock_manager.h"
 
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -19,63 +25,97 @@
 
 namespace bustub {
 
+namespace {
+
+/** Every thread waits for at most one lock at a time, so one condition variable per thread serves all its waits. */
+thread_local std::condition_variable waiter_cv;
+
+constexpr size_t NUM_TABLE_LOCK_MODES = 5;
+
+/** Which table lock modes two transactions may hold at the same time, indexed by TableLockMode. */
+constexpr bool TABLE_LOCK_COMPATIBLE[NUM_TABLE_LOCK_MODES][NUM_TABLE_LOCK_MODES] = {
+    {true, true, true, true, false},      // INTENTION_SHARED
+    {true, true, false, false, false},    // INTENTION_EXCLUSIVE
+    {true, false, true, false, false},    // SHARED
+    {true, false, false, false, false},   // SHARED_INTENTION_EXCLUSIVE
+    {false, false, false, false, false},  // EXCLUSIVE
+};
+
+/** The weakest table lock mode that covers both of two modes. */
+constexpr TableLockMode TABLE_LOCK_JOIN[NUM_TABLE_LOCK_MODES][NUM_TABLE_LOCK_MODES] = {
+    {TableLockMode::INTENTION_SHARED, TableLockMode::INTENTION_EXCLUSIVE, TableLockMode::SHARED,
+     TableLockMode::SHARED_INTENTION_EXCLUSIVE, TableLockMode::EXCLUSIVE},
+    {TableLockMode::INTENTION_EXCLUSIVE, TableLockMode::INTENTION_EXCLUSIVE, TableLockMode::SHARED_INTENTION_EXCLUSIVE,
+     TableLockMode::SHARED_INTENTION_EXCLUSIVE, TableLockMode::EXCLUSIVE},
+    {TableLockMode::SHARED, TableLockMode::SHARED_INTENTION_EXCLUSIVE, TableLockMode::SHARED,
+     TableLockMode::SHARED_INTENTION_EXCLUSIVE, TableLockMode::EXCLUSIVE},
+    {TableLockMode::SHARED_INTENTION_EXCLUSIVE, TableLockMode::SHARED_INTENTION_EXCLUSIVE,
+     TableLockMode::SHARED_INTENTION_EXCLUSIVE, TableLockMode::SHARED_INTENTION_EXCLUSIVE, TableLockMode::EXCLUSIVE},
+    {TableLockMode::EXCLUSIVE, TableLockMode::EXCLUSIVE, TableLockMode::EXCLUSIVE, TableLockMode::EXCLUSIVE,
+     TableLockMode::EXCLUSIVE},
+};
+
+bool AreCompatible(TableLockMode a, TableLockMode b) {
+  return TABLE_LOCK_COMPATIBLE[static_cast<size_t>(a)][static_cast<size_t>(b)];
+}
+
+TableLockMode Join(TableLockMode a, TableLockMode b) {
+  return TABLE_LOCK_JOIN[static_cast<size_t>(a)][static_cast<size_t>(b)];
+}
+
+/**
+ * Under deadlock detection, call visit for every request a waiting request waits for: the conflicting requests of
+ * other transactions that are granted or queued ahead of it.
+ */
+template <typename Request, typename Conflicts, typename Visit>
+void VisitBlockers(const std::list<Request> &rq, const Request &waiter, Conflicts conflicts, Visit visit) {
+  bool ahead = true;
+  for (const auto &other : rq) {
+    if (&other == &waiter) {
+      ahead = false;
+    } else if (other.txn_id_ != waiter.txn_id_ && (ahead || other.granted_) && conflicts(waiter, other)) {
+      visit(other);
+    }
+  }
+}
+
+/** @return true if a waiting request waits for no other request, under deadlock detection */
+template <typename Request, typename Conflicts>
+bool HasNoBlockers(const std::list<Request> &rq, const Request &waiter, Conflicts conflicts) {
+  bool blocked = false;
+  VisitBlockers(rq, waiter, conflicts, [&blocked](const auto &) { blocked = true; });
+  return !blocked;
+}
+
+}  // namespace
+
+LockManager::LockManager(size_t escalation_threshold, DeadlockPolicy policy)
+    : escalation_threshold_(escalation_threshold), policy_(policy) {
+  if (policy_ == DeadlockPolicy::DETECTION) {
+    enable_cycle_detection_ = true;
+    cycle_detection_thread_ = std::thread([this] { RunCycleDetection(); });
+  }
+}
+
+LockManager::~LockManager() {
+  if (cycle_detection_thread_.joinable()) {
+    {
+      std::scoped_lock latch(detection_latch_);
+      enable_cycle_detection_ = false;
+    }
+    detection_cv_.notify_one();
+    cycle_detection_thread_.join();
+  }
+}
+
 bool LockManager::LockShared(Transaction *txn, const RID &rid) {
-  LockRequest txn_request(txn->GetTransactionId(), LockMode::SHARED);
   if (txn->IsSharedLocked(rid)) {
     return true;
   }
   if (!CanLock(txn, LockMode::SHARED)) {
     return false;
   }
-  std::unique_lock<std::mutex> ulock(latch_);
-  auto &rid_lock_rq = lock_table_[rid];
-  auto &rq = lock_table_[rid].request_queue_;
-  rq.push_back(txn_request);
-  auto check = [&]() -> bool {
-    bool flag = true;
-    if (rq.size() == 1) {
-      return true;
-    }
-    for (auto ite = rq.begin(); ite != rq.end();) {
-      if (ite->lock_mode_ == LockMode::EXCLUSIVE) {
-        if (ite->txn_id_ > txn->GetTransactionId()) {
-          Transaction *young_txn = TransactionManager::GetTransaction(ite->txn_id_);
-          young_txn->SetState(TransactionState::ABORTED);
-          ite = rq.erase(ite);
-          rid_lock_rq.cv_.notify_all();
-        } else if (ite->txn_id_ < txn->GetTransactionId()) {
-          flag = false;
-          ++ite;
-        } else {
-          ++ite;
-        }
-      } else {
-        ++ite;
-      }
-    }
-    return txn->GetState() != TransactionState::ABORTED && flag;
-  };
-  while (!check() && txn->GetState() != TransactionState::ABORTED) {
-    lock_table_[rid].cv_.wait(ulock);
-  }
-  if (txn->GetState() == TransactionState::ABORTED) {
-    for (auto ite = rq.begin(); ite != rq.end();) {
-      if (ite->txn_id_ == txn->GetTransactionId()) {
-        ite = rq.erase(ite);
-      } else {
-        ++ite;
-      }
-    }
-    return false;
-  }
-  for (auto &ite : rid_lock_rq.request_queue_) {
-    if (ite.txn_id_ == txn->GetTransactionId()) {
-      ite.granted_ = true;
-    }
-  }
-  txn->SetState(TransactionState::GROWING);
-  txn->GetSharedLockSet()->emplace(rid);
-  return true;
+  return AcquireLock(txn, rid, LockMode::SHARED);
 }
 
 bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
@@ -85,56 +125,27 @@ bool LockManager::LockExclusive(Transaction *txn, const RID &rid) {
   if (!CanLock(txn, LockMode::EXCLUSIVE)) {
     return false;
   }
-  std::unique_lock<std::mutex> ulock(latch_);
-  LockRequest txn_request(txn->GetTransactionId(), LockMode::EXCLUSIVE);
-  auto &rq = lock_table_[rid].request_queue_;
-  auto &rid_lock_rq = lock_table_[rid];
-  rq.push_back(txn_request);
-  auto check = [&]() -> bool {
-    bool flag = true;
-    if (rq.size() == 1) {
-      return true;
-    }
-    for (auto ite = rq.begin(); ite != rq.end();) {
-      if (ite->txn_id_ < txn->GetTransactionId()) {
-        flag = false;
-        ++ite;
-      } else if (ite->txn_id_ > txn->GetTransactionId()) {
-        Transaction *young_txn = TransactionManager::GetTransaction(ite->txn_id_);
-        young_txn->SetState(TransactionState::ABORTED);
-        ite = rq.erase(ite);
-        rid_lock_rq.cv_.notify_all();
-      } else {
-        ++ite;
-      }
-    }
-    return txn->GetState() != TransactionState::ABORTED && flag;
-  };
-  while (!check() && txn->GetState() != TransactionState::ABORTED) {
-    lock_table_[rid].cv_.wait(ulock);
+  return AcquireLock(txn, rid, LockMode::EXCLUSIVE);
+}
+
+bool LockManager::LockExclusive(Transaction *txn, table_oid_t oid, const RID &rid) {
+  if (IsTableLocked(txn, oid, TableLockMode::EXCLUSIVE) || txn->IsExclusiveLocked(rid)) {
+    return true;
   }
-  if (txn->GetState() == TransactionState::ABORTED) {
-    for (auto ite = rq.begin(); ite != rq.end();) {
-      if (ite->txn_id_ == txn->GetTransactionId()) {
-        ite = rq.erase(ite);
-      } else {
-        ++ite;
-      }
-    }
+  if (!LockExclusive(txn, rid)) {
     return false;
   }
-  for (auto &ite : rq) {
-    if (ite.txn_id_ == txn->GetTransactionId()) {
-      ite.granted_ = true;
-    }
+  auto &row_locks = (*txn->GetTableRowLocks())[oid];
+  row_locks.emplace_back(rid);
+  if (escalation_threshold_ != 0 && row_locks.size() > escalation_threshold_) {
+    return EscalateRowLocks(txn, oid);
   }
-  txn->SetState(TransactionState::GROWING);
-  txn->GetExclusiveLockSet()->emplace(rid);
   return true;
 }
 
 bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
-  std::unique_lock<std::mutex> ulock(latch_);
+  auto &rid_lock_rq = GetRequestQueue(rid);
+  std::unique_lock<std::mutex> ulock(rid_lock_rq.request_mutex_);
   if (txn->GetState() != TransactionState::GROWING) {
     TransactionAbortException e(txn->GetTransactionId(), AbortReason::UPGRADE_CONFLICT);
     throw e;
@@ -143,15 +154,7 @@ bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
   if (txn->IsExclusiveLocked(rid) || !txn->IsSharedLocked(rid)) {
     return true;
   }
-  auto &rid_lock_rq = lock_table_[rid];
-  auto &rq = rid_lock_rq.request_queue_;
-  for (auto ite = rq.begin(); ite != rq.end();) {
-    if (ite->txn_id_ == txn->GetTransactionId()) {
-      ite = rq.erase(ite);
-    } else {
-      ++ite;
-    }
-  }
+  RemoveRequests(&rid_lock_rq, txn->GetTransactionId());
   txn->GetSharedLockSet()->erase(rid);
   ulock.unlock();
   bool ans = LockExclusive(txn, rid);
@@ -159,19 +162,12 @@ bool LockManager::LockUpgrade(Transaction *txn, const RID &rid) {
 }
 
 bool LockManager::Unlock(Transaction *txn, const RID &rid) {
-  std::unique_lock<std::mutex> ulock(latch_);
-  auto &rq = lock_table_[rid].request_queue_;
+  auto &rid_lock_rq = GetRequestQueue(rid);
+  std::unique_lock<std::mutex> ulock(rid_lock_rq.request_mutex_);
   if (txn->GetState() == TransactionState::ABORTED || txn->GetState() == TransactionState::COMMITTED) {
-    for (auto ite = rq.begin(); ite != rq.end();) {
-      if (ite->txn_id_ == txn->GetTransactionId()) {
-        ite = rq.erase(ite);
-      } else {
-        ++ite;
-      }
-    }
+    RemoveRequests(&rid_lock_rq, txn->GetTransactionId());
     txn->GetExclusiveLockSet()->erase(rid);
     txn->GetSharedLockSet()->erase(rid);
-    lock_table_[rid].cv_.notify_all();
     return txn->GetState() == TransactionState::COMMITTED;
   }
   if (txn->GetState() == TransactionState::GROWING || txn->GetState() == TransactionState::SHRINKING) {
@@ -184,23 +180,527 @@ bool LockManager::Unlock(Transaction *txn, const RID &rid) {
         txn->SetState(TransactionState::SHRINKING);
       }
     } else {
-      lock_table_[rid].cv_.notify_all();
       return false;
     }
-    for (auto ite = rq.begin(); ite != rq.end();) {
-      if (ite->txn_id_ == txn->GetTransactionId()) {
-        ite = rq.erase(ite);
-      } else {
-        ++ite;
+    RemoveRequests(&rid_lock_rq, txn->GetTransactionId());
+    return true;
+  }
+  return false;
+}
+
+bool LockManager::AcquireLock(Transaction *txn, const RID &rid, LockMode mode) {
+  auto &rid_lock_rq = GetRequestQueue(rid);
+  std::unique_lock<std::mutex> ulock(rid_lock_rq.request_mutex_);
+  if (policy_ == DeadlockPolicy::WOUND_WAIT) {
+    WoundYoungerRequests(&rid_lock_rq, txn->GetTransactionId(), mode);
+  }
+  auto &request = rid_lock_rq.request_queue_.emplace_back(txn->GetTransactionId(), mode);
+  request.cv_ = &waiter_cv;
+  // Checked once, so that a request is profiled either completely or not at all.
+  bool profiling = profiling_;
+  if (profiling) {
+    ProfileRequest(&rid_lock_rq.contention_, &row_queue_lengths_, rid_lock_rq.request_queue_.size());
+  }
+  GrantRequests(&rid_lock_rq);
+  bool waits = profiling && !request.granted_ && txn->GetState() != TransactionState::ABORTED;
+  std::chrono::steady_clock::time_point wait_start;
+  if (waits) {
+    wait_start = std::chrono::steady_clock::now();
+  }
+  // A wound erases the request after aborting the transaction, so the request is only looked at while it is alive.
+  while (txn->GetState() != TransactionState::ABORTED && !request.granted_) {
+    waiter_cv.wait(ulock);
+  }
+  if (waits) {
+    ProfileWait(&rid_lock_rq.contention_, wait_start);
+  }
+  if (txn->GetState() == TransactionState::ABORTED) {
+    if (profiling) {
+      rid_lock_rq.contention_.aborts_++;
+    }
+    // The request is still queued if the transaction was wounded on another queue.
+    RemoveRequests(&rid_lock_rq, txn->GetTransactionId());
+    return false;
+  }
+  // The state stays as it is: a transaction wounded on another queue in the meantime has to stay aborted.
+  if (mode == LockMode::SHARED) {
+    txn->GetSharedLockSet()->emplace(rid);
+  } else {
+    txn->GetExclusiveLockSet()->emplace(rid);
+  }
+  return true;
+}
+
+void LockManager::WoundYoungerRequests(LockRequestQueue *queue, txn_id_t txn_id, LockMode mode) {
+  auto &rq = queue->request_queue_;
+  for (auto ite = rq.begin(); ite != rq.end();) {
+    if (ite->txn_id_ > txn_id && (mode == LockMode::EXCLUSIVE || ite->lock_mode_ == LockMode::EXCLUSIVE)) {
+      Transaction *young_txn = TransactionManager::GetTransaction(ite->txn_id_);
+      young_txn->SetState(TransactionState::ABORTED);
+      if (profiling_) {
+        queue->contention_.wounds_++;
+      }
+      if (!ite->granted_) {
+        ite->cv_->notify_one();
       }
+      ite = rq.erase(ite);
+    } else {
+      ++ite;
     }
-    lock_table_[rid].cv_.notify_all();
+  }
+}
+
+void LockManager::GrantRequests(LockRequestQueue *queue) {
+  if (policy_ == DeadlockPolicy::DETECTION) {
+    auto conflicts = [](const LockRequest &a, const LockRequest &b) {
+      return a.lock_mode_ == LockMode::EXCLUSIVE || b.lock_mode_ == LockMode::EXCLUSIVE;
+    };
+    for (auto &request : queue->request_queue_) {
+      if (!request.granted_ && HasNoBlockers(queue->request_queue_, request, conflicts)) {
+        request.granted_ = true;
+        request.cv_->notify_one();
+      }
+    }
+    return;
+  }
+  txn_id_t oldest = std::numeric_limits<txn_id_t>::max();
+  txn_id_t oldest_exclusive = std::numeric_limits<txn_id_t>::max();
+  for (const auto &request : queue->request_queue_) {
+    oldest = std::min(oldest, request.txn_id_);
+    if (request.lock_mode_ == LockMode::EXCLUSIVE) {
+      oldest_exclusive = std::min(oldest_exclusive, request.txn_id_);
+    }
+  }
+  for (auto &request : queue->request_queue_) {
+    if (request.granted_) {
+      continue;
+    }
+    // The other requests of the same transaction never hold it up.
+    bool grantable = request.lock_mode_ == LockMode::SHARED ? oldest_exclusive >= request.txn_id_
+                                                            : oldest >= request.txn_id_;
+    if (grantable) {
+      request.granted_ = true;
+      request.cv_->notify_one();
+    }
+  }
+}
+
+void LockManager::RemoveRequests(LockRequestQueue *queue, txn_id_t txn_id) {
+  auto &rq = queue->request_queue_;
+  for (auto ite = rq.begin(); ite != rq.end();) {
+    if (ite->txn_id_ == txn_id) {
+      ite = rq.erase(ite);
+    } else {
+      ++ite;
+    }
+  }
+  GrantRequests(queue);
+}
+
+LockManager::LockRequestQueue &LockManager::GetRequestQueue(const RID &rid) {
+  // The RID hash is the identity on page id and slot, so mix it before taking the shard from its top bits.
+  uint64_t hash = std::hash<RID>()(rid);
+  hash = (hash ^ (hash >> 32)) * 0x9E3779B97F4A7C15ULL;
+  auto &shard = shards_[hash >> (64 - LOCK_SHARD_BITS)];
+  std::scoped_lock<std::mutex> lock(shard.latch_);
+  return shard.lock_table_[rid];
+}
+
+bool LockManager::LockTable(Transaction *txn, table_oid_t oid, TableLockMode mode) {
+  auto table_lock_set = txn->GetTableLockSet();
+  auto held = table_lock_set->find(oid);
+  if (held != table_lock_set->end() && Join(held->second, mode) == held->second) {
     return true;
   }
-  lock_table_[rid].cv_.notify_all();
+  if (!CanLockTable(txn, mode)) {
+    return false;
+  }
+  TableLockMode target = held == table_lock_set->end() ? mode : Join(held->second, mode);
+  txn_id_t txn_id = txn->GetTransactionId();
+  std::unique_lock<std::mutex> ulock(table_latch_);
+  auto &queue = table_lock_table_[oid];
+  if (policy_ == DeadlockPolicy::WOUND_WAIT) {
+    WoundYoungerTableRequests(&queue, txn_id, target);
+  }
+  auto &rq = queue.request_queue_;
+  auto request = std::find_if(rq.begin(), rq.end(), [txn_id](const auto &r) { return r.txn_id_ == txn_id; });
+  if (request == rq.end()) {
+    request = rq.emplace(rq.end(), txn_id, target);
+  } else {
+    // An upgrade: the transaction keeps its place in the queue, and waits like a new request.
+    request->lock_mode_ = target;
+    request->granted_ = false;
+  }
+  request->cv_ = &waiter_cv;
+  bool profiling = profiling_;
+  if (profiling) {
+    ProfileRequest(&queue.contention_, &table_queue_lengths_, rq.size());
+  }
+  GrantTableRequests(&queue);
+  bool waits = profiling && !request->granted_ && txn->GetState() != TransactionState::ABORTED;
+  std::chrono::steady_clock::time_point wait_start;
+  if (waits) {
+    wait_start = std::chrono::steady_clock::now();
+  }
+  while (txn->GetState() != TransactionState::ABORTED && !request->granted_) {
+    waiter_cv.wait(ulock);
+  }
+  if (waits) {
+    ProfileWait(&queue.contention_, wait_start);
+  }
+  if (txn->GetState() == TransactionState::ABORTED) {
+    if (profiling) {
+      queue.contention_.aborts_++;
+    }
+    rq.remove_if([txn_id](const auto &r) { return r.txn_id_ == txn_id; });
+    GrantTableRequests(&queue);
+    return false;
+  }
+  (*table_lock_set)[oid] = target;
+  return true;
+}
+
+bool LockManager::UnlockTable(Transaction *txn, table_oid_t oid) {
+  auto table_lock_set = txn->GetTableLockSet();
+  auto held = table_lock_set->find(oid);
+  if (held == table_lock_set->end()) {
+    return false;
+  }
+  if (txn->GetState() == TransactionState::GROWING) {
+    // Like for rows, releasing a lock others could not read under ends the growing phase, and so does releasing any
+    // lock under REPEATABLE_READ.
+    if (held->second == TableLockMode::INTENTION_EXCLUSIVE ||
+        held->second == TableLockMode::SHARED_INTENTION_EXCLUSIVE || held->second == TableLockMode::EXCLUSIVE ||
+        txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ) {
+      txn->SetState(TransactionState::SHRINKING);
+    }
+  }
+  table_lock_set->erase(held);
+  txn_id_t txn_id = txn->GetTransactionId();
+  std::scoped_lock<std::mutex> latch(table_latch_);
+  auto &queue = table_lock_table_[oid];
+  queue.request_queue_.remove_if([txn_id](const auto &r) { return r.txn_id_ == txn_id; });
+  GrantTableRequests(&queue);
+  return true;
+}
+
+bool LockManager::EscalateRowLocks(Transaction *txn, table_oid_t oid) {
+  if (!LockTable(txn, oid, TableLockMode::EXCLUSIVE)) {
+    return false;
+  }
+  // The transaction stays in its growing phase: the rows stay locked, just by the table lock now.
+  auto table_row_locks = txn->GetTableRowLocks();
+  auto &row_locks = (*table_row_locks)[oid];
+  for (const auto &rid : row_locks) {
+    auto &rid_lock_rq = GetRequestQueue(rid);
+    std::scoped_lock<std::mutex> latch(rid_lock_rq.request_mutex_);
+    RemoveRequests(&rid_lock_rq, txn->GetTransactionId());
+    txn->GetExclusiveLockSet()->erase(rid);
+    txn->GetSharedLockSet()->erase(rid);
+  }
+  num_escalations_++;
+  num_escalated_row_locks_ += row_locks.size();
+  table_row_locks->erase(oid);
+  return true;
+}
+
+bool LockManager::IsTableLocked(Transaction *txn, table_oid_t oid, TableLockMode mode) {
+  auto table_lock_set = txn->GetTableLockSet();
+  auto held = table_lock_set->find(oid);
+  return held != table_lock_set->end() && Join(held->second, mode) == held->second;
+}
+
+void LockManager::WoundYoungerTableRequests(TableLockRequestQueue *queue, txn_id_t txn_id, TableLockMode mode) {
+  auto &rq = queue->request_queue_;
+  for (auto ite = rq.begin(); ite != rq.end();) {
+    if (ite->txn_id_ > txn_id && !AreCompatible(mode, ite->lock_mode_)) {
+      TransactionManager::GetTransaction(ite->txn_id_)->SetState(TransactionState::ABORTED);
+      if (profiling_) {
+        queue->contention_.wounds_++;
+      }
+      if (!ite->granted_) {
+        ite->cv_->notify_one();
+      }
+      ite = rq.erase(ite);
+    } else {
+      ++ite;
+    }
+  }
+}
+
+void LockManager::GrantTableRequests(TableLockRequestQueue *queue) {
+  if (policy_ == DeadlockPolicy::DETECTION) {
+    auto conflicts = [](const TableLockRequest &a, const TableLockRequest &b) {
+      return !AreCompatible(a.lock_mode_, b.lock_mode_);
+    };
+    for (auto &request : queue->request_queue_) {
+      if (!request.granted_ && HasNoBlockers(queue->request_queue_, request, conflicts)) {
+        request.granted_ = true;
+        request.cv_->notify_one();
+      }
+    }
+    return;
+  }
+  std::array<txn_id_t, NUM_TABLE_LOCK_MODES> oldest;
+  oldest.fill(std::numeric_limits<txn_id_t>::max());
+  for (const auto &request : queue->request_queue_) {
+    auto &oldest_in_mode = oldest[static_cast<size_t>(request.lock_mode_)];
+    oldest_in_mode = std::min(oldest_in_mode, request.txn_id_);
+  }
+  for (auto &request : queue->request_queue_) {
+    if (request.granted_) {
+      continue;
+    }
+    bool grantable = true;
+    for (size_t mode = 0; mode < NUM_TABLE_LOCK_MODES; mode++) {
+      if (!AreCompatible(request.lock_mode_, static_cast<TableLockMode>(mode)) && oldest[mode] < request.txn_id_) {
+        grantable = false;
+        break;
+      }
+    }
+    if (grantable) {
+      request.granted_ = true;
+      request.cv_->notify_one();
+    }
+  }
+}
+
+std::vector<HotLock> LockManager::GetHottestLocks(size_t n) {
+  std::vector<HotLock> locks;
+  auto contended = [](const LockContention &contention) {
+    return contention.waits_ != 0 || contention.wounds_ != 0 || contention.aborts_ != 0;
+  };
+  for (auto &shard : shards_) {
+    std::scoped_lock<std::mutex> shard_latch(shard.latch_);
+    for (auto &[rid, queue] : shard.lock_table_) {
+      std::scoped_lock<std::mutex> queue_latch(queue.request_mutex_);
+      if (contended(queue.contention_)) {
+        locks.push_back(HotLock{false, rid, 0, queue.contention_});
+      }
+    }
+  }
+  {
+    std::scoped_lock<std::mutex> table_latch(table_latch_);
+    for (const auto &[oid, queue] : table_lock_table_) {
+      if (contended(queue.contention_)) {
+        locks.push_back(HotLock{true, RID(), oid, queue.contention_});
+      }
+    }
+  }
+  auto hotter = [](const HotLock &a, const HotLock &b) {
+    const auto &x = a.contention_;
+    const auto &y = b.contention_;
+    return std::tie(x.wait_ns_, x.waits_, x.aborts_, x.wounds_) > std::tie(y.wait_ns_, y.waits_, y.aborts_, y.wounds_);
+  };
+  n = std::min(n, locks.size());
+  std::partial_sort(locks.begin(), locks.begin() + n, locks.end(), hotter);
+  locks.resize(n);
+  return locks;
+}
+
+std::string LockManager::GetContentionReport(size_t n) {
+  std::ostringstream os;
+  os << "row queue lengths: " << row_queue_lengths_.ToString() << "\n";
+  os << "table queue lengths: " << table_queue_lengths_.ToString();
+  for (const auto &lock : GetHottestLocks(n)) {
+    os << "\n" << lock.ToString();
+  }
+  return os.str();
+}
+
+void LockManager::ResetProfile() {
+  for (auto &shard : shards_) {
+    std::scoped_lock<std::mutex> shard_latch(shard.latch_);
+    for (auto &[rid, queue] : shard.lock_table_) {
+      std::scoped_lock<std::mutex> queue_latch(queue.request_mutex_);
+      queue.contention_ = LockContention();
+    }
+  }
+  {
+    std::scoped_lock<std::mutex> table_latch(table_latch_);
+    for (auto &[oid, queue] : table_lock_table_) {
+      queue.contention_ = LockContention();
+    }
+  }
+  row_queue_lengths_.Reset();
+  table_queue_lengths_.Reset();
+}
+
+void LockManager::ProfileRequest(LockContention *contention, QueueLengthHistogram *lengths, size_t queue_length) {
+  contention->requests_++;
+  contention->max_queue_length_ = std::max(contention->max_queue_length_, queue_length);
+  lengths->Record(queue_length);
+}
+
+void LockManager::ProfileWait(LockContention *contention, std::chrono::steady_clock::time_point wait_start) {
+  contention->waits_++;
+  contention->wait_ns_ +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - wait_start).count();
+}
+
+void LockManager::AddEdge(txn_id_t t1, txn_id_t t2) {
+  std::scoped_lock latch(waits_for_latch_);
+  waits_for_[t1].insert(t2);
+}
+
+void LockManager::RemoveEdge(txn_id_t t1, txn_id_t t2) {
+  std::scoped_lock latch(waits_for_latch_);
+  auto it = waits_for_.find(t1);
+  if (it != waits_for_.end()) {
+    it->second.erase(t2);
+    if (it->second.empty()) {
+      waits_for_.erase(it);
+    }
+  }
+}
+
+bool LockManager::HasCycle(txn_id_t *txn_id) {
+  std::scoped_lock latch(waits_for_latch_);
+  // Depth-first search, where the transactions on the current path are on the stack. The transactions all of whose
+  // paths were searched already are done, and can't be part of a cycle not found yet.
+  std::set<txn_id_t> done;
+  std::vector<txn_id_t> path;
+  std::set<txn_id_t> on_path;
+  std::function<bool(txn_id_t)> search = [&](txn_id_t txn) {
+    path.push_back(txn);
+    on_path.insert(txn);
+    auto edges = waits_for_.find(txn);
+    if (edges != waits_for_.end()) {
+      for (txn_id_t next : edges->second) {
+        if (on_path.count(next) != 0) {
+          // The cycle is the part of the path from next on.
+          *txn_id = *std::max_element(std::find(path.begin(), path.end(), next), path.end());
+          return true;
+        }
+        if (done.count(next) == 0 && search(next)) {
+          return true;
+        }
+      }
+    }
+    path.pop_back();
+    on_path.erase(txn);
+    done.insert(txn);
+    return false;
+  };
+  for (const auto &[txn, edges] : waits_for_) {
+    if (done.count(txn) == 0 && search(txn)) {
+      return true;
+    }
+  }
   return false;
 }
 
+std::vector<std::pair<txn_id_t, txn_id_t>> LockManager::GetEdgeList() {
+  std::scoped_lock latch(waits_for_latch_);
+  std::vector<std::pair<txn_id_t, txn_id_t>> edges;
+  for (const auto &[t1, targets] : waits_for_) {
+    for (txn_id_t t2 : targets) {
+      edges.emplace_back(t1, t2);
+    }
+  }
+  return edges;
+}
+
+void LockManager::RunCycleDetection() {
+  std::unique_lock<std::mutex> lock(detection_latch_);
+  while (!detection_cv_.wait_for(lock, cycle_detection_interval, [this] { return !enable_cycle_detection_; })) {
+    BuildWaitsForGraph();
+    txn_id_t victim = INVALID_TXN_ID;
+    while (HasCycle(&victim)) {
+      AbortWaiter(victim);
+      // The victim stops waiting, which breaks every cycle through it.
+      std::scoped_lock latch(waits_for_latch_);
+      waits_for_.erase(victim);
+      for (auto &[txn, targets] : waits_for_) {
+        targets.erase(victim);
+      }
+    }
+  }
+}
+
+void LockManager::BuildWaitsForGraph() {
+  {
+    std::scoped_lock latch(waits_for_latch_);
+    waits_for_.clear();
+  }
+  waiting_for_row_.clear();
+  waiting_for_table_.clear();
+  // The queues are looked at one after another, not all at once. An edge may be gone by the time a cycle through it
+  // is found, but AbortWaiter only aborts a transaction that still waits.
+  auto row_conflicts = [](const LockRequest &a, const LockRequest &b) {
+    return a.lock_mode_ == LockMode::EXCLUSIVE || b.lock_mode_ == LockMode::EXCLUSIVE;
+  };
+  for (auto &shard : shards_) {
+    std::scoped_lock<std::mutex> shard_latch(shard.latch_);
+    for (auto &[rid, queue] : shard.lock_table_) {
+      std::scoped_lock<std::mutex> queue_latch(queue.request_mutex_);
+      for (const auto &request : queue.request_queue_) {
+        if (request.granted_) {
+          continue;
+        }
+        VisitBlockers(queue.request_queue_, request, row_conflicts,
+                      [&](const LockRequest &blocker) { AddEdge(request.txn_id_, blocker.txn_id_); });
+        waiting_for_row_[request.txn_id_] = &queue;
+      }
+    }
+  }
+  auto table_conflicts = [](const TableLockRequest &a, const TableLockRequest &b) {
+    return !AreCompatible(a.lock_mode_, b.lock_mode_);
+  };
+  std::scoped_lock<std::mutex> table_latch(table_latch_);
+  for (auto &[oid, queue] : table_lock_table_) {
+    for (const auto &request : queue.request_queue_) {
+      if (request.granted_) {
+        continue;
+      }
+      VisitBlockers(queue.request_queue_, request, table_conflicts,
+                    [&](const TableLockRequest &blocker) { AddEdge(request.txn_id_, blocker.txn_id_); });
+      waiting_for_table_[request.txn_id_] = oid;
+    }
+  }
+}
+
+void LockManager::AbortWaiter(txn_id_t txn_id) {
+  auto abort_if_waiting = [this, txn_id](auto &rq) {
+    for (auto &request : rq) {
+      if (request.txn_id_ == txn_id && !request.granted_) {
+        TransactionManager::GetTransaction(txn_id)->SetState(TransactionState::ABORTED);
+        request.cv_->notify_one();
+        num_deadlocks_++;
+        return;
+      }
+    }
+  };
+  auto row = waiting_for_row_.find(txn_id);
+  if (row != waiting_for_row_.end()) {
+    std::scoped_lock<std::mutex> latch(row->second->request_mutex_);
+    abort_if_waiting(row->second->request_queue_);
+    return;
+  }
+  auto table = waiting_for_table_.find(txn_id);
+  if (table != waiting_for_table_.end()) {
+    std::scoped_lock<std::mutex> latch(table_latch_);
+    abort_if_waiting(table_lock_table_[table->second].request_queue_);
+  }
+}
+
+bool LockManager::CanLockTable(Transaction *txn, TableLockMode mode) {
+  if (txn->GetState() == TransactionState::ABORTED) {
+    return false;
+  }
+  // READ_UNCOMMITTED never takes shared locks, so it doesn't announce any either.
+  if (txn->GetIsolationLevel() == IsolationLevel::READ_UNCOMMITTED && mode != TableLockMode::INTENTION_EXCLUSIVE &&
+      mode != TableLockMode::EXCLUSIVE) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  if (txn->GetState() == TransactionState::SHRINKING) {
+    txn->SetState(TransactionState::ABORTED);
+    return false;
+  }
+  return true;
+}
+
 bool LockManager::CanLock(Transaction *txn, LockMode mode) {
   if (txn->GetState() == TransactionState::ABORTED) {
     return false;
@@ -0,0 +1,69 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_stats.cpp
+//
+// Identification: src/concurrency/lock_stats.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "concurrency/lock_stats.h"
+
+#include <sstream>
+
+namespace bustub {
+
+std::string HotLock::ToString() const {
+  std::ostringstream os;
+  if (is_table_) {
+    os << "table " << oid_;
+  } else {
+    os << "row (" << rid_.GetPageId() << ", " << rid_.GetSlotNum() << ")";
+  }
+  os << ": " << contention_.requests_ << " requests, " << contention_.waits_ << " waits, "
+     << static_cast<double>(contention_.wait_ns_) / 1000000 << " ms waited, " << contention_.wounds_ << " wounds, "
+     << contention_.aborts_ << " aborts, queue up to " << contention_.max_queue_length_;
+  return os.str();
+}
+
+void QueueLengthHistogram::Record(size_t length) {
+  size_t bucket = 0;
+  while (length > 1 && bucket < NUM_BUCKETS - 1) {
+    length >>= 1;
+    bucket++;
+  }
+  buckets_[bucket]++;
+}
+
+uint64_t QueueLengthHistogram::GetCount() const {
+  uint64_t count = 0;
+  for (const auto &bucket : buckets_) {
+    count += bucket.load();
+  }
+  return count;
+}
+
+void QueueLengthHistogram::Reset() {
+  for (auto &bucket : buckets_) {
+    bucket = 0;
+  }
+}
+
+std::string QueueLengthHistogram::ToString() const {
+  std::ostringstream os;
+  bool first = true;
+  for (size_t i = 0; i < NUM_BUCKETS; i++) {
+    uint64_t count = buckets_[i].load();
+    if (count == 0) {
+      continue;
+    }
+    os << (first ? "" : ", ") << GetBucketBound(i) << "+: " << count;
+    first = false;
+  }
+  return first ? "none" : os.str();
+}
+
+}  // namespace bustub
@@ -12,6 +12,8 @@
 
 #include "concurrency/transaction_manager.h"
 
+#include <algorithm>
+#include <functional>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -20,62 +22,90 @@
 
 namespace bustub {
 
-std::unordered_map<txn_id_t, Transaction *> TransactionManager::txn_map = {};
-std::shared_mutex TransactionManager::txn_map_mutex = {};
+std::array<TransactionManager::TxnMapShard, 1 << TransactionManager::TXN_SHARD_BITS>
+    TransactionManager::txn_map_shards = {};
 
 Transaction *TransactionManager::Begin(Transaction *txn, IsolationLevel isolation_level) {
-  // Acquire the global transaction latch in shared mode.
-  global_txn_latch_.RLock();
-
   if (txn == nullptr) {
     txn = new Transaction(next_txn_id_++, isolation_level);
   }
-  txn_map_mutex.lock();
-  txn_map[txn->GetTransactionId()] = txn;
-  txn_map_mutex.unlock();
+  StartRunning(txn);
+  RegisterTransaction(txn);
+
+  if (txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION) {
+    std::scoped_lock latch(snapshot_latch_);
+    txn->SetReadTimestamp(last_commit_ts_);
+    active_read_ts_.insert(txn->GetReadTimestamp());
+  }
+
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::BEGIN);
+    std::scoped_lock latch(active_txns_latch_);
+    lsn_t lsn = log_manager_->AppendLogRecord(&log_record);
+    txn->SetPrevLSN(lsn);
+    active_txns_[txn] = lsn;
+  }
   return txn;
 }
 
-void TransactionManager::Commit(Transaction *txn) {
+bool TransactionManager::Commit(Transaction *txn, Durability durability, std::chrono::milliseconds max_delay) {
+  bool is_optimistic = txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC;
+  if (is_optimistic && !ValidateOptimistic(txn)) {
+    Abort(txn);
+    return false;
+  }
+
   txn->SetState(TransactionState::COMMITTED);
 
-  // Perform all deletes before we commit.
-  auto write_set = txn->GetWriteSet();
-  while (!write_set->empty()) {
-    auto &item = write_set->back();
-    auto table = item.table_;
-    if (item.wtype_ == WType::DELETE) {
-      // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
+  bool is_snapshot = txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION;
+  // Before the deletes are applied, which frees their slots for other inserts.
+  if (is_snapshot) {
+    CommitVersions(txn);
+  } else if (is_optimistic && !WriteOptimistic(txn)) {
+    Abort(txn);
+    return false;
+  }
+
+  // Perform all deletes before we commit. Note that this also releases the locks when holding the page latch.
+  FinishTableWrites(txn, true);
+
+  if (enable_logging && log_manager_ != nullptr) {
+    // The transaction is durable once its COMMIT record is; the flush thread writes it together with the COMMIT
+    // records of every other transaction waiting at this point.
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::COMMIT);
+    log_manager_->AppendTxnLogRecord(&log_record, txn, nullptr);
+    lsn_t lsn = log_manager_->PublishTxnLog(txn);
+    RemoveActiveTxn(txn);
+    if (durability == Durability::SYNC) {
+      log_manager_->Flush(lsn);
+    } else {
+      log_manager_->FlushWithin(lsn, std::min<std::chrono::milliseconds>(max_delay, log_timeout));
     }
-    write_set->pop_back();
   }
-  write_set->clear();
 
   // Release all the locks.
   ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
+  if (is_snapshot) {
+    EndSnapshot(txn);
+  }
+  // Nothing looks the transaction up by its id any more, it holds no locks.
+  DeregisterTransaction(txn);
+  FinishRunning(txn);
+  return true;
 }
 
 void TransactionManager::Abort(Transaction *txn) {
   txn->SetState(TransactionState::ABORTED);
-  // Rollback before releasing the lock.
-  auto table_write_set = txn->GetWriteSet();
-  while (!table_write_set->empty()) {
-    auto &item = table_write_set->back();
-    auto table = item.table_;
-    if (item.wtype_ == WType::DELETE) {
-      table->RollbackDelete(item.rid_, txn);
-    } else if (item.wtype_ == WType::INSERT) {
-      // Note that this also releases the lock when holding the page latch.
-      table->ApplyDelete(item.rid_, txn);
-    } else if (item.wtype_ == WType::UPDATE) {
-      table->UpdateTuple(item.tuple_, item.rid_, txn);
+  bool is_snapshot = txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION;
+  bool is_optimistic = txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC;
+  VersionedTuples written_tuples;
+  if (is_snapshot || is_optimistic) {
+    for (const auto &item : *txn->GetWriteSet()) {
+      written_tuples.emplace_back(item.table_, item.rid_);
     }
-    table_write_set->pop_back();
   }
-  table_write_set->clear();
+  // Rollback before releasing the lock.
+  FinishTableWrites(txn, false);
   // Rollback index updates
   auto index_write_set = txn->GetIndexWriteSet();
   while (!index_write_set->empty()) {
@@ -99,17 +129,240 @@ void TransactionManager::Abort(Transaction *txn) {
     }
     index_write_set->pop_back();
   }
-  table_write_set->clear();
   index_write_set->clear();
+  // Only now that the tuples are back as they were may other snapshots read them from the pages again.
+  if (is_snapshot) {
+    AbortVersions(txn, written_tuples);
+  }
+  if (is_optimistic) {
+    // The rolled back inserts count as changes, a reader of them must fail validation.
+    for (const auto &[table, rid] : written_tuples) {
+      table->UnlockStamp(rid, txn, true);
+    }
+    for (const auto &[rid, item] : *txn->GetPendingWriteSet()) {
+      item.table_->UnlockStamp(rid, txn, false);
+    }
+    txn->GetPendingWriteSet()->clear();
+    txn->GetReadSet()->clear();
+  }
+
+  if (enable_logging && log_manager_ != nullptr) {
+    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ABORT);
+    log_manager_->AppendTxnLogRecord(&log_record, txn, nullptr);
+    log_manager_->PublishTxnLog(txn);
+    RemoveActiveTxn(txn);
+  }
 
   // Release all the locks.
   ReleaseLocks(txn);
-  // Release the global transaction latch.
-  global_txn_latch_.RUnlock();
+  if (is_snapshot) {
+    EndSnapshot(txn);
+  }
+  // Nothing looks the transaction up by its id any more, it holds no locks.
+  DeregisterTransaction(txn);
+  FinishRunning(txn);
+}
+
+Transaction *TransactionManager::GetTransaction(txn_id_t txn_id) {
+  auto &shard = txn_map_shards[GetTxnShard(txn_id)];
+  std::shared_lock latch(shard.latch_);
+  auto it = shard.txn_map_.find(txn_id);
+  assert(it != shard.txn_map_.end());
+  return it == shard.txn_map_.end() ? nullptr : it->second;
+}
+
+void TransactionManager::RegisterTransaction(Transaction *txn) {
+  auto &shard = txn_map_shards[GetTxnShard(txn->GetTransactionId())];
+  std::scoped_lock latch(shard.latch_);
+  shard.txn_map_[txn->GetTransactionId()] = txn;
+}
+
+void TransactionManager::DeregisterTransaction(Transaction *txn) {
+  auto &shard = txn_map_shards[GetTxnShard(txn->GetTransactionId())];
+  std::scoped_lock latch(shard.latch_);
+  auto it = shard.txn_map_.find(txn->GetTransactionId());
+  if (it != shard.txn_map_.end() && it->second == txn) {
+    shard.txn_map_.erase(it);
+  }
+}
+
+void TransactionManager::StartRunning(Transaction *txn) {
+  auto &count = running_txns_[GetTxnShard(txn->GetTransactionId())].count_;
+  while (true) {
+    count++;
+    if (!txns_blocked_) {
+      return;
+    }
+    // Back off while the checkpoint runs, it may be waiting for this count already.
+    count--;
+    std::unique_lock latch(block_latch_);
+    block_cv_.notify_all();
+    block_cv_.wait(latch, [this] { return !txns_blocked_; });
+  }
+}
+
+void TransactionManager::FinishRunning(Transaction *txn) {
+  running_txns_[GetTxnShard(txn->GetTransactionId())].count_--;
+  if (txns_blocked_) {
+    // Notify under the latch, so the checkpoint can't miss it between checking the counts and waiting.
+    std::scoped_lock latch(block_latch_);
+    block_cv_.notify_all();
+  }
+}
+
+bool TransactionManager::NoneRunning() const {
+  return std::all_of(running_txns_.begin(), running_txns_.end(),
+                     [](const RunningTxnCount &running) { return running.count_ == 0; });
+}
+
+void TransactionManager::BlockAllTransactions() {
+  std::unique_lock latch(block_latch_);
+  // One checkpoint at a time.
+  block_cv_.wait(latch, [this] { return !txns_blocked_; });
+  txns_blocked_ = true;
+  block_cv_.wait(latch, [this] { return NoneRunning(); });
+}
+
+void TransactionManager::ResumeTransactions() {
+  {
+    std::scoped_lock latch(block_latch_);
+    txns_blocked_ = false;
+  }
+  block_cv_.notify_all();
+}
+
+lsn_t TransactionManager::AppendLogRecordWithActiveTxns(LogRecord *log_record,
+                                                        std::vector<ActiveTxnEntry> *active_txns) {
+  std::scoped_lock latch(active_txns_latch_);
+  lsn_t lsn = log_manager_->AppendLogRecord(log_record);
+  active_txns->clear();
+  active_txns->reserve(active_txns_.size());
+  for (const auto &[txn, first_lsn] : active_txns_) {
+    active_txns->push_back(ActiveTxnEntry{txn->GetTransactionId(), first_lsn, txn->GetPrevLSN()});
+  }
+  return lsn;
+}
+
+void TransactionManager::CommitVersions(Transaction *txn) {
+  auto write_set = txn->GetWriteSet();
+  if (write_set->empty()) {
+    return;
+  }
+  VersionedTuples tuples;
+  tuples.reserve(write_set->size());
+  for (const auto &item : *write_set) {
+    tuples.emplace_back(item.table_, item.rid_);
+  }
+  std::scoped_lock latch(commit_latch_);
+  timestamp_t commit_ts = last_commit_ts_ + 1;
+  for (const auto &[table, rid] : tuples) {
+    table->CommitVersion(rid, txn, commit_ts);
+  }
+  txn->SetCommitTimestamp(commit_ts);
+  // Publish the timestamp only now, so that a snapshot that includes it sees every write of the transaction.
+  last_commit_ts_ = commit_ts;
+  gc_queue_.emplace_back(commit_ts, std::move(tuples));
 }
 
-void TransactionManager::BlockAllTransactions() { global_txn_latch_.WLock(); }
+void TransactionManager::AbortVersions(Transaction *txn, const VersionedTuples &tuples) {
+  for (const auto &[table, rid] : tuples) {
+    table->AbortVersion(rid, txn);
+  }
+  // The chains may hold older versions that were kept for a snapshot before, collect them again.
+  std::scoped_lock latch(commit_latch_);
+  gc_queue_.emplace_back(last_commit_ts_, tuples);
+}
 
-void TransactionManager::ResumeTransactions() { global_txn_latch_.WUnlock(); }
+void TransactionManager::EndSnapshot(Transaction *txn) {
+  {
+    std::scoped_lock latch(snapshot_latch_);
+    auto it = active_read_ts_.find(txn->GetReadTimestamp());
+    if (it != active_read_ts_.end()) {
+      active_read_ts_.erase(it);
+    }
+  }
+  timestamp_t watermark = GetWatermark();
+  std::scoped_lock latch(commit_latch_);
+  while (!gc_queue_.empty() && gc_queue_.front().first <= watermark) {
+    for (const auto &[table, rid] : gc_queue_.front().second) {
+      table->CollectVersions(rid, watermark);
+    }
+    gc_queue_.pop_front();
+  }
+}
+
+bool TransactionManager::ValidateOptimistic(Transaction *txn) {
+  // Another transaction holding a stamp fails the validation rather than being waited for, so there are no deadlocks.
+  for (const auto &[rid, item] : *txn->GetPendingWriteSet()) {
+    if (!item.table_->LockStamp(rid, txn)) {
+      return false;
+    }
+  }
+  for (const auto &item : *txn->GetReadSet()) {
+    if (!item.table_->ValidateStamp(item.rid_, txn, item.stamp_)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TransactionManager::WriteOptimistic(Transaction *txn) {
+  // The transaction is committing, so the table heap writes right away and adds to the write set as usual.
+  auto pending_write_set = txn->GetPendingWriteSet();
+  for (auto it = pending_write_set->begin(); it != pending_write_set->end();) {
+    const auto &[rid, item] = *it;
+    bool written = item.wtype_ == WType::DELETE ? item.table_->MarkDelete(rid, txn)
+                                                : item.table_->UpdateTuple(item.tuple_, rid, txn);
+    // A write fails if the tuple no longer fits its page, or its row lock fails. The stamps stay locked, so that
+    // nobody reads the writes done so far before Abort rolls them back.
+    if (!written || txn->GetState() == TransactionState::ABORTED) {
+      return false;
+    }
+    it = pending_write_set->erase(it);
+  }
+  for (const auto &item : *txn->GetWriteSet()) {
+    item.table_->UnlockStamp(item.rid_, txn, true);
+  }
+  txn->GetReadSet()->clear();
+  return true;
+}
+
+timestamp_t TransactionManager::GetWatermark() {
+  std::scoped_lock latch(snapshot_latch_);
+  return active_read_ts_.empty() ? last_commit_ts_.load() : *active_read_ts_.begin();
+}
+
+void TransactionManager::FinishTableWrites(Transaction *txn, bool is_commit) {
+  auto write_set = txn->GetWriteSet();
+  // Newest first, the order to undo the writes to a tuple in.
+  std::vector<const TableWriteRecord *> records;
+  records.reserve(write_set->size());
+  for (auto it = write_set->rbegin(); it != write_set->rend(); ++it) {
+    if (!is_commit || it->wtype_ == WType::DELETE) {
+      records.push_back(&*it);
+    }
+  }
+  // The writes to different pages don't depend on each other, those to one page stay in order.
+  std::stable_sort(records.begin(), records.end(), [](const TableWriteRecord *a, const TableWriteRecord *b) {
+    if (a->table_ != b->table_) {
+      return std::less<TableHeap *>()(a->table_, b->table_);
+    }
+    return a->rid_.GetPageId() < b->rid_.GetPageId();
+  });
+  for (auto first = records.cbegin(); first != records.cend();) {
+    TableHeap *table = (*first)->table_;
+    auto last = std::find_if(first, records.cend(), [table](const TableWriteRecord *r) { return r->table_ != table; });
+    table->FinishWrites(first, last, txn, is_commit);
+    first = last;
+  }
+  write_set->clear();
+}
+
+void TransactionManager::RemoveActiveTxn(Transaction *txn) {
+  // The finishing record is already appended, so a checkpoint that still sees the transaction only costs recovery a
+  // little more reading.
+  std::scoped_lock latch(active_txns_latch_);
+  active_txns_.erase(txn);
+}
 
 }  // namespace bustub
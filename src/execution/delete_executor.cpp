@@ -23,6 +23,12 @@ DeleteExecutor::DeleteExecutor(ExecutorContext *exec_ctx, const DeletePlanNode *
 void DeleteExecutor::Init() {
   table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->TableOid());
   index_info_set_ = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
+  Transaction *txn = exec_ctx_->GetTransaction();
+  // Snapshot and optimistic transactions take no locks, the table heap detects their conflicts.
+  if (!txn->IsLockFree() &&
+      !exec_ctx_->GetLockManager()->LockTable(txn, plan_->TableOid(), TableLockMode::INTENTION_EXCLUSIVE)) {
+    exec_ctx_->GetTransactionManager()->Abort(txn);
+  }
   if (child_executor_) {
     child_executor_->Init();
   }
@@ -36,16 +42,15 @@ bool DeleteExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   Transaction *txn = GetExecutorContext()->GetTransaction();
   TransactionManager *txn_mgr = exec_ctx_->GetTransactionManager();
   LockManager *lgr = exec_ctx_->GetLockManager();
+  bool lock_free = txn->IsLockFree();
   while (child_executor_->Next(&tmp_tuple, &tmp_rid)) {
     if (txn->IsSharedLocked(tmp_rid)) {
       if (!lgr->LockUpgrade(txn, tmp_rid)) {
         txn_mgr->Abort(txn);
       }
     }
-    if (!txn->IsExclusiveLocked(tmp_rid)) {
-      if (!lgr->LockExclusive(txn, tmp_rid)) {
-        txn_mgr->Abort(txn);
-      }
+    if (!lock_free && !lgr->LockExclusive(txn, plan_->TableOid(), tmp_rid)) {
+      txn_mgr->Abort(txn);
     }
     if (!table_heap->MarkDelete(tmp_rid, txn)) {
       return false;
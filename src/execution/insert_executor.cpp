@@ -23,6 +23,12 @@ InsertExecutor::InsertExecutor(ExecutorContext *exec_ctx, const InsertPlanNode *
 void InsertExecutor::Init() {
   table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->TableOid());
   indexs_info_ = exec_ctx_->GetCatalog()->GetTableIndexes(table_info_->name_);
+  Transaction *txn = exec_ctx_->GetTransaction();
+  // Snapshot and optimistic transactions take no locks, the table heap detects their conflicts.
+  if (!txn->IsLockFree() &&
+      !exec_ctx_->GetLockManager()->LockTable(txn, plan_->TableOid(), TableLockMode::INTENTION_EXCLUSIVE)) {
+    exec_ctx_->GetTransactionManager()->Abort(txn);
+  }
   if (child_executor_) {
     child_executor_->Init();
   }
@@ -34,6 +40,7 @@ bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   LockManager *lgr = exec_ctx_->GetLockManager();
   auto schema = table_info_->schema_;
   auto table_heap = table_info_->table_.get();
+  bool lock_free = txn->IsLockFree();
   if (plan_->IsRawInsert()) {
     auto raw_values = plan_->RawValues();
     for (uint32_t i = 0; i < raw_values.size(); ++i) {
@@ -43,7 +50,7 @@ bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
       if (!table_heap->InsertTuple(tmp_tuple, &tmp_rid, exec_ctx_->GetTransaction())) {
         return false;
       }
-      if (!lgr->LockExclusive(txn, tmp_rid)) {
+      if (!lock_free && !lgr->LockExclusive(txn, plan_->TableOid(), tmp_rid)) {
         txn_mgr->Abort(txn);
       }
       for (auto &index_info : indexs_info_) {
@@ -64,7 +71,7 @@ bool InsertExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
     if (!table_heap->InsertTuple(tmp_tuple, &tmp_rid, exec_ctx_->GetTransaction())) {
       return false;
     }
-    if (!lgr->LockExclusive(txn, tmp_rid)) {
+    if (!lock_free && !lgr->LockExclusive(txn, plan_->TableOid(), tmp_rid)) {
       txn_mgr->Abort(txn);
       return false;
     }
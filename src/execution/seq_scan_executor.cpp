@@ -21,6 +21,18 @@ SeqScanExecutor::SeqScanExecutor(ExecutorContext *exec_ctx, const SeqScanPlanNod
 
 void SeqScanExecutor::Init() {
   table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->GetTableOid());
+  Transaction *txn = exec_ctx_->GetTransaction();
+  // REPEATABLE_READ keeps every row it reads locked until the end anyway, so it locks the whole table instead.
+  // READ_COMMITTED still locks row by row, to let go of each row right after reading it. READ_UNCOMMITTED takes no
+  // locks, and neither do snapshot and optimistic transactions.
+  if (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ ||
+      txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
+    auto mode = txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ ? TableLockMode::SHARED
+                                                                            : TableLockMode::INTENTION_SHARED;
+    if (!exec_ctx_->GetLockManager()->LockTable(txn, plan_->GetTableOid(), mode)) {
+      exec_ctx_->GetTransactionManager()->Abort(txn);
+    }
+  }
   table_iter_ = table_info_->table_->Begin(GetExecutorContext()->GetTransaction());
 }
 
@@ -34,10 +46,13 @@ bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
   Tuple tmp_tuple;
   RID tmp_rid;
   const auto out_put_schema = plan_->OutputSchema();
+  bool lock_rows = (txn->GetIsolationLevel() == IsolationLevel::REPEATABLE_READ ||
+                    txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) &&
+                   !LockManager::IsTableLocked(txn, plan_->GetTableOid(), TableLockMode::SHARED);
   while (table_iter_ != the_end) {
     tmp_tuple = *table_iter_++;
     tmp_rid = tmp_tuple.GetRid();
-    if (!lgr->LockShared(txn, tmp_rid)) {
+    if (lock_rows && !lgr->LockShared(txn, tmp_rid)) {
       txn_mgr->Abort(txn);
     }
     if (predicate == nullptr || predicate->Evaluate(&tmp_tuple, &table_schema).GetAs<bool>()) {
@@ -51,7 +66,7 @@ bool SeqScanExecutor::Next(Tuple *tuple, RID *rid) {
       Tuple new_tuple(tmp_value, out_put_schema);
       *tuple = new_tuple;
       *rid = tmp_rid;
-      if (txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
+      if (lock_rows && txn->GetIsolationLevel() == IsolationLevel::READ_COMMITTED) {
         if (!lgr->Unlock(txn, tmp_rid)) {
           txn_mgr->Abort(txn);
           return false;
@@ -21,6 +21,12 @@ UpdateExecutor::UpdateExecutor(ExecutorContext *exec_ctx, const UpdatePlanNode *
 
 void UpdateExecutor::Init() {
   table_info_ = exec_ctx_->GetCatalog()->GetTable(plan_->TableOid());
+  Transaction *txn = exec_ctx_->GetTransaction();
+  // Snapshot and optimistic transactions take no locks, the table heap detects their conflicts.
+  if (!txn->IsLockFree() &&
+      !exec_ctx_->GetLockManager()->LockTable(txn, plan_->TableOid(), TableLockMode::INTENTION_EXCLUSIVE)) {
+    exec_ctx_->GetTransactionManager()->Abort(txn);
+  }
   if (child_executor_) {
     child_executor_->Init();
   }
@@ -35,16 +41,15 @@ bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
   Tuple tmp_tuple;
   RID tmp_rid;
   Schema schema = table_info_->schema_;
+  bool lock_free = txn->IsLockFree();
   while (child_executor_->Next(&tmp_tuple, &tmp_rid)) {
     if (txn->IsSharedLocked(tmp_rid)) {
       if (!lgr->LockUpgrade(txn, tmp_rid)) {
         txn_mgr->Abort(txn);
       }
     }
-    if (!txn->IsExclusiveLocked(tmp_rid)) {
-      if (!lgr->LockExclusive(txn, tmp_rid)) {
-        txn_mgr->Abort(txn);
-      }
+    if (!lock_free && !lgr->LockExclusive(txn, plan_->TableOid(), tmp_rid)) {
+      txn_mgr->Abort(txn);
     }
     if (!table_heap->GetTuple(tmp_rid, &tmp_tuple, exec_ctx_->GetTransaction())) {
       return false;
@@ -62,6 +67,9 @@ bool UpdateExecutor::Next([[maybe_unused]] Tuple *tuple, RID *rid) {
         new_iwr.old_tuple_ = tmp_tuple;
         txn->AppendTableWriteRecord(new_iwr);
       }
+    } else if (txn->GetState() == TransactionState::ABORTED) {
+      // Another transaction updated the tuple first.
+      return false;
     }
   }
   return false;
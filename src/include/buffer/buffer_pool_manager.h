@@ -15,6 +15,7 @@
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <vector>
 
 #include "buffer/lru_replacer.h"
 #include "recovery/log_manager.h"
@@ -87,6 +88,32 @@ class BufferPoolManager {
   /** @return size of the buffer pool */
   virtual size_t GetPoolSize() = 0;
 
+  /**
+   * Collect the dirty page table for a checkpoint: every page that may hold changes not yet on disk, with the LSN
+   * from which redo has to consider it. Pages are not latched, so the table is only accurate up to pages being
+   * dirtied concurrently, whose changes are newer than any checkpoint that starts before the call.
+   * @return the dirty page table
+   */
+  virtual std::vector<DirtyPageEntry> GetDirtyPageTable() = 0;
+
+  /** @return the pages in the buffer pool, hottest first: the pinned pages, then the others by replacer order */
+  virtual std::vector<page_id_t> GetResidentPages() = 0;
+
+  /**
+   * Read pages into free frames before they are fetched, without evicting anything. Runs of consecutive pages are
+   * read with one request each, in page id order, and the prefetched pages are ranked by the order they were given.
+   * @param page_ids the pages to prefetch, hottest first
+   * @return the number of the given pages that are resident afterwards, short of all of them once the buffer pool
+   * runs out of free frames
+   */
+  virtual size_t Prefetch(const std::vector<page_id_t> &page_ids) = 0;
+
+  /** @return the number of fetches that found their page in the buffer pool */
+  virtual uint64_t GetNumHits() = 0;
+
+  /** @return the number of fetches that had to read their page from disk */
+  virtual uint64_t GetNumMisses() = 0;
+
  protected:
   /**
    * Grading function. Do not modify!
@@ -12,9 +12,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <list>
 #include <mutex>  // NOLINT
 #include <unordered_map>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "buffer/lru_replacer.h"
@@ -58,6 +60,25 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** @return pointer to all the pages in the buffer pool */
   Page *GetPages() { return pages_; }
 
+  /** @return the pages that are dirty or pinned, with their recovery LSN */
+  std::vector<DirtyPageEntry> GetDirtyPageTable() override;
+
+  /** @return the pages in the buffer pool, hottest first: the pinned pages, then the others by replacer order */
+  std::vector<page_id_t> GetResidentPages() override;
+
+  /**
+   * Read pages into free frames before they are fetched, without evicting anything.
+   * @param page_ids the pages to prefetch, hottest first, all of this instance
+   * @return the number of the given pages that are resident afterwards
+   */
+  size_t Prefetch(const std::vector<page_id_t> &page_ids) override;
+
+  /** @return the number of fetches that found their page in the buffer pool */
+  uint64_t GetNumHits() override { return num_hits_; }
+
+  /** @return the number of fetches that had to read their page from disk */
+  uint64_t GetNumMisses() override { return num_misses_; }
+
  protected:
   /**
    * Fetch the requested page from the buffer pool.
@@ -121,6 +142,23 @@ class BufferPoolManagerInstance : public BufferPoolManager {
    */
   void ValidatePageId(page_id_t page_id) const;
 
+  /**
+   * Write a page to disk, first forcing the log up to the page LSN so that no change reaches the disk before the log
+   * records describing it (the WAL rule).
+   * @param page the page to write
+   */
+  void WritePageToDisk(Page *page);
+
+  /**
+   * Pin a frame for a page, starting its recovery LSN if the page is clean: no change made before this point can be
+   * missing from the disk.
+   * @param page the page to pin
+   */
+  void PinPage(Page *page);
+
+  /** The most pages Prefetch reads with one request. */
+  static constexpr int PREFETCH_BATCH_PAGES = 16;
+
   /** Number of pages in the buffer pool. */
   const size_t pool_size_;
   /** How many instances are in the parallel BPM (if present, otherwise just 1 BPI) */
@@ -135,13 +173,16 @@ class BufferPoolManagerInstance : public BufferPoolManager {
   /** Pointer to the disk manager. */
   DiskManager *disk_manager_ __attribute__((__unused__));
   /** Pointer to the log manager. */
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
   /** Page table for keeping track of buffer pool pages. */
   std::unordered_map<page_id_t, frame_id_t> page_table_;
   /** Replacer to find unpinned pages for replacement. */
   Replacer *replacer_;
   /** List of free pages. */
   std::list<frame_id_t> free_list_;
+  /** Fetches that found their page resident, and fetches that read it from disk. */
+  std::atomic<uint64_t> num_hits_{0};
+  std::atomic<uint64_t> num_misses_{0};
   /** This latch protects shared data structures. We recommend updating this comment to describe what it protects. */
   std::mutex latch_;
 };
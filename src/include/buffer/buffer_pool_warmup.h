@@ -0,0 +1,88 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_warmup.h
+//
+// Identification: src/include/buffer/buffer_pool_warmup.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * BufferPoolWarmup brings the buffer pool back to the pages it held before a restart.
+ *
+ * SaveResidentPages persists the resident pages, hottest first, as the warm-up list of the disk manager; the
+ * checkpoint manager calls it with every checkpoint, and it should be called on a clean shutdown. After the restart,
+ * Start prefetches the list in the background while queries already run: it goes through the list hottest first in
+ * chunks, and each chunk is read in page id order with one request per run of consecutive pages. Prefetching only
+ * fills free frames, so it never evicts a page the queries fetched in the meantime, and it stops once the buffer pool
+ * is full.
+ */
+class BufferPoolWarmup {
+ public:
+  /**
+   * Creates a new warm-up.
+   * @param buffer_pool_manager the buffer pool to warm up
+   * @param disk_manager the disk manager that keeps the warm-up list
+   * @param chunk_size how many pages of the list are prefetched at once
+   */
+  BufferPoolWarmup(BufferPoolManager *buffer_pool_manager, DiskManager *disk_manager, size_t chunk_size = 256)
+      : buffer_pool_manager_(buffer_pool_manager), disk_manager_(disk_manager), chunk_size_(chunk_size) {}
+
+  /** Stops prefetching. */
+  ~BufferPoolWarmup() { Stop(); }
+
+  /** Persist the pages that are resident now as the warm-up list. */
+  void SaveResidentPages();
+
+  /**
+   * Start prefetching the warm-up list in the background.
+   * @return false if there is no warm-up list
+   */
+  bool Start();
+
+  /** Stop prefetching, leaving the pages prefetched so far in the buffer pool. */
+  void Stop();
+
+  /** Wait until prefetching is done. */
+  void Wait();
+
+  /** @return true once the whole list was prefetched, the buffer pool ran full, or prefetching was stopped */
+  bool IsDone() const { return done_; }
+
+  /** @return the number of pages of the list that were resident once the warm-up went through them */
+  size_t GetNumPrefetched() const { return num_prefetched_; }
+
+  /** @return how long prefetching took, or has taken so far */
+  std::chrono::nanoseconds GetWarmupTime() const { return std::chrono::nanoseconds(warmup_ns_.load()); }
+
+ private:
+  /** Prefetch the list chunk by chunk until it ends, the buffer pool runs full, or the warm-up is stopped. */
+  void RunWarmup(std::vector<page_id_t> page_ids);
+
+  BufferPoolManager *buffer_pool_manager_;
+  DiskManager *disk_manager_;
+  const size_t chunk_size_;
+
+  std::thread worker_;
+  std::atomic<bool> stop_{false};
+  std::atomic<bool> done_{false};
+  std::atomic<size_t> num_prefetched_{0};
+  std::atomic<int64_t> warmup_ns_{0};
+};
+
+}  // namespace bustub
@@ -48,6 +48,8 @@ class LRUReplacer : public Replacer {
 
   size_t Size() override;
 
+  std::vector<frame_id_t> GetFramesByHotness() override;
+
  private:
   std::unordered_map<frame_id_t, std::list<frame_id_t>::iterator> to_pos_;
   std::list<frame_id_t> lru_cache_;
@@ -41,6 +41,25 @@ class ParallelBufferPoolManager : public BufferPoolManager {
   /** @return size of the buffer pool */
   size_t GetPoolSize() override;
 
+  /** @return the dirty page tables of all the instances */
+  std::vector<DirtyPageEntry> GetDirtyPageTable() override;
+
+  /** @return the resident pages of all the instances, interleaving their hotness orders */
+  std::vector<page_id_t> GetResidentPages() override;
+
+  /**
+   * Prefetch pages into the instances responsible for them.
+   * @param page_ids the pages to prefetch, hottest first
+   * @return the number of the given pages that are resident afterwards
+   */
+  size_t Prefetch(const std::vector<page_id_t> &page_ids) override;
+
+  /** @return the number of fetches that found their page in the buffer pool, over all instances */
+  uint64_t GetNumHits() override;
+
+  /** @return the number of fetches that had to read their page from disk, over all instances */
+  uint64_t GetNumMisses() override;
+
  protected:
   /**
    * @param page_id id of page
@@ -12,6 +12,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "common/config.h"
 
 namespace bustub {
@@ -45,6 +47,9 @@ class Replacer {
 
   /** @return the number of elements in the replacer that can be victimized */
   virtual size_t Size() = 0;
+
+  /** @return the frames that can be victimized, hottest first, i.e. the last victim first; empty if not tracked */
+  virtual std::vector<frame_id_t> GetFramesByHotness() { return {}; }
 };
 
 }  // namespace bustub
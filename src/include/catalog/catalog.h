@@ -131,6 +131,7 @@ class Catalog {
 
     // Fetch the table OID for the new table
     const auto table_oid = next_table_oid_.fetch_add(1);
+    table->SetTableOid(table_oid);
 
     // Construct the table information
     auto meta = std::make_unique<TableInfo>(schema, table_name, std::move(table), table_oid);
@@ -17,6 +17,7 @@
 #include "concurrency/lock_manager.h"
 #include "recovery/checkpoint_manager.h"
 #include "recovery/log_manager.h"
+#include "storage/disk/compressed_disk_manager.h"
 #include "storage/disk/disk_manager.h"
 
 namespace bustub {
@@ -27,7 +28,11 @@ class BustubInstance {
     enable_logging = false;
 
     // storage related
-    disk_manager_ = new DiskManager(db_file_name);
+    if (enable_page_compression) {
+      disk_manager_ = new CompressedDiskManager(db_file_name);
+    } else {
+      disk_manager_ = new DiskManager(db_file_name);
+    }
 
     // log related
     log_manager_ = new LogManager(disk_manager_);
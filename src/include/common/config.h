@@ -27,14 +27,22 @@ extern std::atomic<bool> enable_logging;
 /** If ENABLE_LOGGING is true, the log should be flushed to disk every LOG_TIMEOUT. */
 extern std::chrono::duration<int64_t> log_timeout;
 
+/** True if pages should be stored compressed on disk. Read when a BustubInstance is created. */
+extern std::atomic<bool> enable_page_compression;
+
+/** The size of a log segment file in bytes, 0 to keep the log in a single file. Read when a DiskManager is created. */
+extern std::atomic<int64_t> log_segment_size;
+
 static constexpr int INVALID_PAGE_ID = -1;                                    // invalid page id
 static constexpr int INVALID_TXN_ID = -1;                                     // invalid transaction id
 static constexpr int INVALID_LSN = -1;                                        // invalid log sequence number
 static constexpr int HEADER_PAGE_ID = 0;                                      // the header page id
 static constexpr int PAGE_SIZE = 4096;                                        // size of a data page in byte
 static constexpr int BUFFER_POOL_SIZE = 10;                                   // size of buffer pool
-static constexpr int LOG_BUFFER_SIZE = ((BUFFER_POOL_SIZE + 1) * PAGE_SIZE);  // size of a log buffer in byte
+static constexpr int LOG_BUFFER_SIZE = 32 * PAGE_SIZE;                        // default size of a log buffer in byte
+static constexpr int NUM_LOG_BUFFERS = 2;                                     // default number of log buffers
 static constexpr int BUCKET_SIZE = 50;                                        // size of extendible hash bucket
+static constexpr int LOCK_ESCALATION_THRESHOLD = 5000;  // exclusive row locks on a table before it is locked instead
 
 using frame_id_t = int32_t;    // frame id type
 using page_id_t = int32_t;     // page id type
@@ -42,5 +50,6 @@ using txn_id_t = int32_t;      // transaction id type
 using lsn_t = int32_t;         // log sequence number type
 using slot_offset_t = size_t;  // slot offset type
 using oid_t = uint16_t;
+using timestamp_t = int64_t;   // commit timestamp type
 
 }  // namespace bustub
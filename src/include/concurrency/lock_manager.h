@@ -13,24 +13,61 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>              // NOLINT
 #include <condition_variable>  // NOLINT
 #include <list>
+#include <map>
 #include <memory>
 #include <mutex>  // NOLINT
+#include <set>
+#include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "common/config.h"
 #include "common/rid.h"
+#include "concurrency/lock_stats.h"
 #include "concurrency/transaction.h"
 
 namespace bustub {
 
 class TransactionManager;
 
+/** How the lock manager keeps transactions from waiting for each other forever. */
+enum class DeadlockPolicy {
+  /** Prevention: an older transaction aborts the younger ones that hold or wait for a lock it conflicts with. */
+  WOUND_WAIT,
+  /**
+   * Detection: transactions wait for conflicting locks in the order they asked for them, and a background thread
+   * aborts the youngest transaction of every cycle in the waits-for graph, every cycle_detection_interval.
+   */
+  DETECTION
+};
+
 /**
  * LockManager handles transactions asking for locks on records.
+ *
+ * The lock table is split into shards by RID hash, each with its own latch that only guards the lookup of a request
+ * queue. Every queue has its own latch, which the requests on it are granted and waited for under, so locking
+ * unrelated rows does not serialize on a single latch. Whoever changes a queue decides which requests it grants and
+ * wakes up just their threads, so a release doesn't send every waiter to rescan the queue.
+ *
+ * Transactions also lock whole tables, in the modes of TableLockMode. A transaction that locks a table in a mode which
+ * covers the rows it reads or writes needs no row locks at all, so a full scan takes one lock instead of one per row.
+ * Otherwise it takes an intention lock on the table before locking rows in it. Table locks follow the same wound-wait
+ * policy as row locks. Once a transaction holds more exclusive row locks on a table than the escalation threshold, they
+ * are escalated: the transaction locks the whole table exclusively instead and releases the row locks.
+ *
+ * Wound-wait aborts a younger transaction whenever an older one conflicts with it, whether the two would deadlock or
+ * not. With deadlock detection, only the transactions that end up in a waits-for cycle are aborted, at the price of
+ * letting a deadlock stand until the detector runs next.
+ *
+ * While profiling is on, every queue also keeps a LockContention record of the requests for its lock, which it updates
+ * under its own latch. Profiling is off by default, when a request only checks the flag.
  */
 class LockManager {
   enum class LockMode { SHARED, EXCLUSIVE };
@@ -42,25 +79,50 @@ class LockManager {
     txn_id_t txn_id_;
     LockMode lock_mode_;
     bool granted_;
+    /** The condition variable the requesting thread waits on until the request is granted. */
+    std::condition_variable *cv_{nullptr};
   };
 
   class LockRequestQueue {
    public:
     std::list<LockRequest> request_queue_;
-    // for notifying blocked transactions on this rid
-    std::condition_variable cv_;
     // txn_id of an upgrading transaction (if any)
     txn_id_t upgrading_ = INVALID_TXN_ID;
     std::mutex request_mutex_;
+    /** Guarded by request_mutex_. */
+    LockContention contention_;
+  };
+
+  class TableLockRequest {
+   public:
+    TableLockRequest(txn_id_t txn_id, TableLockMode lock_mode) : txn_id_(txn_id), lock_mode_(lock_mode) {}
+
+    txn_id_t txn_id_;
+    /** The mode the request is for. A transaction has at most one request per table, upgraded in place. */
+    TableLockMode lock_mode_;
+    bool granted_{false};
+    std::condition_variable *cv_{nullptr};
+  };
+
+  class TableLockRequestQueue {
+   public:
+    std::list<TableLockRequest> request_queue_;
+    /** Guarded by table_latch_. */
+    LockContention contention_;
   };
 
  public:
   /**
-   * Creates a new lock manager configured for the deadlock prevention policy.
+   * Creates a new lock manager, which starts the cycle detection thread under DeadlockPolicy::DETECTION.
+   * @param escalation_threshold how many exclusive row locks a transaction may hold on a table before they are
+   * escalated to a table lock, 0 to never escalate
+   * @param policy how to deal with deadlocks
    */
-  LockManager() = default;
+  explicit LockManager(size_t escalation_threshold = LOCK_ESCALATION_THRESHOLD,
+                       DeadlockPolicy policy = DeadlockPolicy::WOUND_WAIT);
 
-  ~LockManager() = default;
+  /** Stops the cycle detection thread, if any. */
+  ~LockManager();
 
   /*
    * [LOCK_NOTE]: For all locking functions, we:
@@ -87,6 +149,17 @@ class LockManager {
    */
   bool LockExclusive(Transaction *txn, const RID &rid);
 
+  /**
+   * Acquire an exclusive lock on a row of a table, unless the transaction already locked the whole table exclusively.
+   * Counts the lock towards escalation, and escalates when the transaction holds too many on the table.
+   * See [LOCK_NOTE] in header file.
+   * @param txn the transaction requesting the exclusive lock
+   * @param oid the table the row belongs to, which the transaction holds an intention lock on
+   * @param rid the RID to be locked in exclusive mode
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockExclusive(Transaction *txn, table_oid_t oid, const RID &rid);
+
   /**
    * Upgrade a lock from a shared lock to an exclusive lock.
    * @param txn the transaction requesting the lock upgrade
@@ -107,11 +180,218 @@ class LockManager {
 
   bool CanLock(Transaction *txn, LockMode mode);
 
+  /**
+   * Acquire a lock on a table. If the transaction already holds a lock on the table, the lock is upgraded to the
+   * weakest mode that covers both the held and the requested mode, e.g. SHARED_INTENTION_EXCLUSIVE for
+   * INTENTION_EXCLUSIVE and SHARED. See [LOCK_NOTE] in header file.
+   * @param txn the transaction requesting the lock
+   * @param oid the table to be locked
+   * @param mode the lock mode
+   * @return true if the lock is granted, false otherwise
+   */
+  bool LockTable(Transaction *txn, table_oid_t oid, TableLockMode mode);
+
+  /**
+   * Release the lock the transaction holds on a table.
+   * @param txn the transaction releasing the lock
+   * @param oid the table that is locked by the transaction
+   * @return true if the unlock is successful, false otherwise
+   */
+  bool UnlockTable(Transaction *txn, table_oid_t oid);
+
+  /**
+   * @param txn the transaction
+   * @param oid the table
+   * @param mode the lock mode
+   * @return true if the lock the transaction holds on the table covers the mode, e.g. a SHARED lock on the table
+   * covers INTENTION_SHARED, and covers SHARED locks on all of its rows
+   */
+  static bool IsTableLocked(Transaction *txn, table_oid_t oid, TableLockMode mode);
+
+  /** @return the number of times row locks were escalated to a table lock */
+  uint64_t GetNumEscalations() const { return num_escalations_; }
+
+  /** @return the number of row locks released by escalations, whose requests and lock set entries were freed */
+  uint64_t GetNumEscalatedRowLocks() const { return num_escalated_row_locks_; }
+
+  /*** Graph API, used by deadlock detection. The detection thread rebuilds the graph from the waiting requests. ***/
+
+  /**
+   * Adds an edge from t1 -> t2, i.e. t1 waits for t2.
+   * @param t1 the waiting transaction
+   * @param t2 the transaction waited for
+   */
+  void AddEdge(txn_id_t t1, txn_id_t t2);
+
+  /**
+   * Removes an edge from t1 -> t2.
+   * @param t1 the waiting transaction
+   * @param t2 the transaction waited for
+   */
+  void RemoveEdge(txn_id_t t1, txn_id_t t2);
+
+  /**
+   * Checks if the graph has a cycle. The search starts from the oldest transaction and follows the edges to older
+   * transactions first, so the same graph always yields the same cycle.
+   * @param[out] txn_id if the graph has a cycle, the youngest transaction in it
+   * @return true if the graph has a cycle
+   */
+  bool HasCycle(txn_id_t *txn_id);
+
+  /** @return all the edges in the graph, for testing */
+  std::vector<std::pair<txn_id_t, txn_id_t>> GetEdgeList();
+
+  /** Runs cycle detection in the background until the lock manager is destroyed. */
+  void RunCycleDetection();
+
+  /** @return the number of transactions aborted to break a deadlock */
+  uint64_t GetNumDeadlocks() const { return num_deadlocks_; }
+
+  /*** Contention profiling. ***/
+
+  /** Start or stop recording the contention on every lock. Stopping keeps what was recorded so far. */
+  void SetProfiling(bool enabled) { profiling_ = enabled; }
+
+  /** @return true if the contention on every lock is recorded */
+  bool IsProfiling() const { return profiling_; }
+
+  /**
+   * @param n how many locks to return at most
+   * @return the locks of rows and tables that requests waited for longest in total, longest first. Only locks that
+   * were waited for, or whose requests wounded or were aborted, are in it.
+   */
+  std::vector<HotLock> GetHottestLocks(size_t n);
+
+  /** @return the lengths of the row lock request queues when requests joined them */
+  const QueueLengthHistogram &GetRowQueueLengths() const { return row_queue_lengths_; }
+
+  /** @return the lengths of the table lock request queues when requests joined them */
+  const QueueLengthHistogram &GetTableQueueLengths() const { return table_queue_lengths_; }
+
+  /**
+   * @param n how many of the hottest locks to list
+   * @return a human-readable, multi-line report of the queue lengths and the hottest locks
+   */
+  std::string GetContentionReport(size_t n);
+
+  /** Clear everything profiling recorded. */
+  void ResetProfile();
+
  private:
-  std::mutex latch_;
+  /** log2 of the number of lock table shards. */
+  static constexpr size_t LOCK_SHARD_BITS = 6;
+
+  /** A part of the lock table, on its own cache line so that the latches of neighbouring shards don't share one. */
+  struct alignas(64) LockTableShard {
+    std::mutex latch_;
+    std::unordered_map<RID, LockRequestQueue> lock_table_;
+  };
+
+  /**
+   * Look up the request queue of a RID, creating it on first use. Queues are never removed from the lock table, so
+   * the queue stays valid after the shard latch is released.
+   * @param rid the RID
+   * @return the request queue of the RID
+   */
+  LockRequestQueue &GetRequestQueue(const RID &rid);
+
+  /**
+   * Queue a lock request and wait until it is granted or the transaction is aborted.
+   * @param txn the transaction requesting the lock
+   * @param rid the RID to be locked
+   * @param mode the lock mode
+   * @return true if the lock is granted, false otherwise
+   */
+  bool AcquireLock(Transaction *txn, const RID &rid, LockMode mode);
+
+  /**
+   * Wound-wait: abort the younger transactions whose requests conflict with a new request, and drop their requests.
+   * Waiting for the older transactions instead is left to GrantRequests.
+   * @param queue the request queue, whose latch the caller holds
+   * @param txn_id the transaction making the new request
+   * @param mode the lock mode of the new request
+   */
+  void WoundYoungerRequests(LockRequestQueue *queue, txn_id_t txn_id, LockMode mode);
+
+  /**
+   * Grant every waiting request that no older conflicting request is queued ahead of, and wake up only the threads
+   * waiting for those. Wounds keep the conflicting requests of a queue ordered oldest first, so locks are handed over
+   * in FIFO order. Under deadlock detection, a request is granted once no conflicting request of another transaction
+   * is granted or queued ahead of it.
+   * @param queue the request queue, whose latch the caller holds
+   */
+  void GrantRequests(LockRequestQueue *queue);
+
+  /**
+   * Drop the requests of a transaction and grant the requests that were waiting for them.
+   * @param queue the request queue, whose latch the caller holds
+   * @param txn_id the transaction
+   */
+  void RemoveRequests(LockRequestQueue *queue, txn_id_t txn_id);
+
+  /**
+   * Lock a table exclusively in place of the exclusive row locks the transaction holds on it, and release those.
+   * @param txn the transaction
+   * @param oid the table
+   * @return false if the transaction was aborted while waiting for the table
+   */
+  bool EscalateRowLocks(Transaction *txn, table_oid_t oid);
+
+  /** Like CanLock, for a table lock. */
+  bool CanLockTable(Transaction *txn, TableLockMode mode);
+
+  /** Wound-wait on a table: like WoundYoungerRequests, the caller holds table_latch_. */
+  void WoundYoungerTableRequests(TableLockRequestQueue *queue, txn_id_t txn_id, TableLockMode mode);
+
+  /** Grant the table lock requests no older incompatible request is queued ahead of, the caller holds table_latch_. */
+  void GrantTableRequests(TableLockRequestQueue *queue);
+
+  /** Rebuild the waits-for graph from the requests that wait, remembering which queue each waits in. */
+  void BuildWaitsForGraph();
+
+  /** Abort a transaction the graph found waiting, and wake it up, if it still waits in the same queue. */
+  void AbortWaiter(txn_id_t txn_id);
+
+  /**
+   * Record a request that joined a queue, the caller holds the latch of the queue and checked that profiling is on.
+   * @param contention the record of the queue
+   * @param lengths the histogram of the kind of queue
+   * @param queue_length the length of the queue, the request included
+   */
+  static void ProfileRequest(LockContention *contention, QueueLengthHistogram *lengths, size_t queue_length);
+
+  /** Record that a request waited from wait_start until now, the caller holds the latch of the queue. */
+  static void ProfileWait(LockContention *contention, std::chrono::steady_clock::time_point wait_start);
 
   /** Lock table for lock requests. */
-  std::unordered_map<RID, LockRequestQueue> lock_table_;
+  std::array<LockTableShard, 1 << LOCK_SHARD_BITS> shards_;
+
+  /** Guards the table lock requests. There are few tables and a transaction locks each once, so one latch does. */
+  std::mutex table_latch_;
+  std::unordered_map<table_oid_t, TableLockRequestQueue> table_lock_table_;
+
+  const size_t escalation_threshold_;
+  std::atomic<uint64_t> num_escalations_{0};
+  std::atomic<uint64_t> num_escalated_row_locks_{0};
+
+  const DeadlockPolicy policy_;
+  /** The waits-for graph, ordered so that cycles are searched for deterministically. */
+  std::mutex waits_for_latch_;
+  std::map<txn_id_t, std::set<txn_id_t>> waits_for_;
+  /** Where the transactions in the graph wait: the queue of a row, or a table. Only the detection thread uses them. */
+  std::unordered_map<txn_id_t, LockRequestQueue *> waiting_for_row_;
+  std::unordered_map<txn_id_t, table_oid_t> waiting_for_table_;
+
+  std::thread cycle_detection_thread_;
+  /** Wakes up the detection thread to stop it. */
+  std::mutex detection_latch_;
+  std::condition_variable detection_cv_;
+  bool enable_cycle_detection_{false};
+  std::atomic<uint64_t> num_deadlocks_{0};
+
+  std::atomic<bool> profiling_{false};
+  QueueLengthHistogram row_queue_lengths_;
+  QueueLengthHistogram table_queue_lengths_;
 };
 
 }  // namespace bustub
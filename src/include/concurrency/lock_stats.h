@@ -0,0 +1,86 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// lock_stats.h
+//
+// Identification: src/include/concurrency/lock_stats.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "common/config.h"
+#include "common/rid.h"
+#include "concurrency/transaction.h"
+
+namespace bustub {
+
+/** How contended the lock of one row or table was while the lock manager profiled. */
+struct LockContention {
+  /** Lock requests, counting the upgrade of a table lock as a new request. */
+  uint64_t requests_{0};
+  /** Requests that were not granted right away. */
+  uint64_t waits_{0};
+  /** The time the waiting requests waited, whether they were granted in the end or not. */
+  uint64_t wait_ns_{0};
+  /** Requests of younger transactions that requests for the lock wounded. */
+  uint64_t wounds_{0};
+  /** Requests that failed because their transaction was aborted, by a wound or as a deadlock victim. */
+  uint64_t aborts_{0};
+  /** The most requests the queue of the lock held at once. */
+  size_t max_queue_length_{0};
+};
+
+/** An entry of a contention report: the lock of a table if is_table_ is set, of a row otherwise. */
+struct HotLock {
+  bool is_table_;
+  RID rid_;
+  table_oid_t oid_;
+  LockContention contention_;
+
+  /** @return a one-line summary */
+  std::string ToString() const;
+};
+
+/**
+ * QueueLengthHistogram counts the lengths lock request queues had when a request joined them, the request included,
+ * in power-of-two buckets: bucket i holds lengths in [2^i, 2^(i+1)), so bucket 0 counts the uncontended requests.
+ * Recording is lock-free, requests on different queues record concurrently.
+ */
+class QueueLengthHistogram {
+ public:
+  static constexpr size_t NUM_BUCKETS = 16;
+
+  /**
+   * Record one sample.
+   * @param length the queue length, at least 1
+   */
+  void Record(size_t length);
+
+  /** @return the number of recorded samples */
+  uint64_t GetCount() const;
+
+  /** @return the number of samples in the given bucket */
+  uint64_t GetBucketCount(size_t bucket) const { return buckets_[bucket].load(); }
+
+  /** @return the smallest length the given bucket holds */
+  static size_t GetBucketBound(size_t bucket) { return static_cast<size_t>(1) << bucket; }
+
+  void Reset();
+
+  /** @return the non-empty buckets on one line */
+  std::string ToString() const;
+
+ private:
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+};
+
+}  // namespace bustub
@@ -17,7 +17,9 @@
 #include <memory>
 #include <string>
 #include <thread>  // NOLINT
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "common/config.h"
 #include "common/logger.h"
@@ -45,8 +47,32 @@ enum class TransactionState { GROWING, SHRINKING, COMMITTED, ABORTED };
 
 /**
  * Transaction isolation level.
+ *
+ * The first three isolate transactions by two-phase locking. SNAPSHOT_ISOLATION takes no locks: the transaction reads
+ * the database as of its beginning from the tuple versions a TableHeap keeps, and is aborted when it writes a tuple
+ * that another transaction wrote since (first updater wins). Only snapshot transactions keep versions, so they are not
+ * isolated from locking transactions writing the same tables.
+ *
+ * OPTIMISTIC takes no locks either. The transaction keeps its updates and deletes to itself, and remembers the version
+ * stamp of every tuple it reads. At commit it validates that none of them changed since, and only then writes; if one
+ * did, the commit aborts the transaction instead. This makes its reads and writes of existing tuples serializable,
+ * but does not guard against phantoms. Like snapshot transactions, optimistic ones are only isolated from each other.
+ */
+enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED, SNAPSHOT_ISOLATION, OPTIMISTIC };
+
+/**
+ * When a commit returns relative to its COMMIT record reaching the disk.
+ * SYNC waits for the record to be durable. ASYNC returns as soon as it is appended, and the log manager makes it
+ * durable within a bounded delay; a crash in that window loses the transaction, but recovery still sees a consistent
+ * prefix of the history, since the log is written in order.
  */
-enum class IsolationLevel { READ_UNCOMMITTED, REPEATABLE_READ, READ_COMMITTED };
+enum class Durability { SYNC, ASYNC };
+
+/**
+ * Lock modes on a whole table. The intention modes announce row locks of the same kind taken inside the table, and
+ * SHARED_INTENTION_EXCLUSIVE is a shared lock on the table combined with exclusive locks on some of its rows.
+ */
+enum class TableLockMode { INTENTION_SHARED, INTENTION_EXCLUSIVE, SHARED, SHARED_INTENTION_EXCLUSIVE, EXCLUSIVE };
 
 /**
  * Type of write operation.
@@ -55,8 +81,11 @@ enum class WType { INSERT = 0, DELETE, UPDATE };
 
 class TableHeap;
 class Catalog;
+class PrivateLogBuffer;
 using table_oid_t = uint32_t;
 using index_oid_t = uint32_t;
+/** The oid of a table heap that is not in a catalog. */
+static constexpr table_oid_t INVALID_TABLE_OID = UINT32_MAX;
 
 /**
  * WriteRecord tracks information related to a write.
@@ -74,6 +103,26 @@ class TableWriteRecord {
   TableHeap *table_;
 };
 
+/** The version stamp of a tuple, which OPTIMISTIC transactions validate their reads against. */
+struct TupleStamp {
+  /** Counts the commits that changed the tuple. */
+  uint64_t version_{0};
+  /** The optimistic transaction about to write the tuple, or that inserted it and has not finished yet, if any. */
+  txn_id_t writer_{INVALID_TXN_ID};
+};
+
+/**
+ * ReadRecord tracks a tuple an optimistic transaction read, with the stamp the tuple had.
+ */
+class TableReadRecord {
+ public:
+  TableReadRecord(RID rid, TupleStamp stamp, TableHeap *table) : rid_(rid), stamp_(stamp), table_(table) {}
+
+  RID rid_;
+  TupleStamp stamp_;
+  TableHeap *table_;
+};
+
 /**
  * WriteRecord tracks information related to a write.
  */
@@ -155,10 +204,14 @@ class Transaction {
         txn_id_(txn_id),
         prev_lsn_(INVALID_LSN),
         shared_lock_set_{new std::unordered_set<RID>},
-        exclusive_lock_set_{new std::unordered_set<RID>} {
+        exclusive_lock_set_{new std::unordered_set<RID>},
+        table_lock_set_{new std::unordered_map<table_oid_t, TableLockMode>},
+        table_row_locks_{new std::unordered_map<table_oid_t, std::vector<RID>>} {
     // Initialize the sets that will be tracked.
     table_write_set_ = std::make_shared<std::deque<TableWriteRecord>>();
     index_write_set_ = std::make_shared<std::deque<IndexWriteRecord>>();
+    table_read_set_ = std::make_shared<std::vector<TableReadRecord>>();
+    pending_write_set_ = std::make_shared<std::unordered_map<RID, TableWriteRecord>>();
     page_set_ = std::make_shared<std::deque<bustub::Page *>>();
     deleted_page_set_ = std::make_shared<std::unordered_set<page_id_t>>();
   }
@@ -176,12 +229,23 @@ class Transaction {
   /** @return the isolation level of this transaction */
   inline IsolationLevel GetIsolationLevel() const { return isolation_level_; }
 
+  /** @return true if the transaction takes no locks, because the table heaps detect its conflicts */
+  inline bool IsLockFree() const {
+    return isolation_level_ == IsolationLevel::SNAPSHOT_ISOLATION || isolation_level_ == IsolationLevel::OPTIMISTIC;
+  }
+
   /** @return the list of table write records of this transaction */
   inline std::shared_ptr<std::deque<TableWriteRecord>> GetWriteSet() { return table_write_set_; }
 
   /** @return the list of index write records of this transaction */
   inline std::shared_ptr<std::deque<IndexWriteRecord>> GetIndexWriteSet() { return index_write_set_; }
 
+  /** @return the tuples an optimistic transaction read, to validate at commit */
+  inline std::shared_ptr<std::vector<TableReadRecord>> GetReadSet() { return table_read_set_; }
+
+  /** @return the updates and deletes an optimistic transaction has not written yet, by tuple */
+  inline std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> GetPendingWriteSet() { return pending_write_set_; }
+
   /** @return the page set */
   inline std::shared_ptr<std::deque<Page *>> GetPageSet() { return page_set_; }
 
@@ -228,6 +292,14 @@ class Transaction {
   /** @return true if rid is exclusively locked by this transaction */
   bool IsExclusiveLocked(const RID &rid) { return exclusive_lock_set_->find(rid) != exclusive_lock_set_->end(); }
 
+  /** @return the tables locked by this transaction, with the mode of each lock */
+  inline std::shared_ptr<std::unordered_map<table_oid_t, TableLockMode>> GetTableLockSet() { return table_lock_set_; }
+
+  /** @return the exclusive row locks this transaction took through LockManager::LockExclusive, by table */
+  inline std::shared_ptr<std::unordered_map<table_oid_t, std::vector<RID>>> GetTableRowLocks() {
+    return table_row_locks_;
+  }
+
   /** @return the current state of the transaction */
   inline TransactionState GetState() { return state_; }
 
@@ -246,6 +318,33 @@ class Transaction {
    */
   inline void SetPrevLSN(lsn_t prev_lsn) { prev_lsn_ = prev_lsn; }
 
+  /** @return the buffer holding the log records of the transaction that are not published yet, if any */
+  inline PrivateLogBuffer *GetPrivateLog() { return private_log_; }
+
+  /**
+   * Set the private log buffer of the transaction, managed by the LogManager.
+   * @param private_log the buffer, or nullptr once it is given back
+   */
+  inline void SetPrivateLog(PrivateLogBuffer *private_log) { private_log_ = private_log; }
+
+  /** @return the commit timestamp of the snapshot a SNAPSHOT_ISOLATION transaction reads */
+  inline timestamp_t GetReadTimestamp() const { return read_ts_; }
+
+  /**
+   * Set the read timestamp of the transaction, managed by the TransactionManager.
+   * @param read_ts the commit timestamp of the last transaction the snapshot includes
+   */
+  inline void SetReadTimestamp(timestamp_t read_ts) { read_ts_ = read_ts; }
+
+  /** @return the commit timestamp of the transaction, valid once a SNAPSHOT_ISOLATION transaction that wrote commits */
+  inline timestamp_t GetCommitTimestamp() const { return commit_ts_; }
+
+  /**
+   * Set the commit timestamp of the transaction, managed by the TransactionManager.
+   * @param commit_ts the commit timestamp
+   */
+  inline void SetCommitTimestamp(timestamp_t commit_ts) { commit_ts_ = commit_ts; }
+
  private:
   /** The current transaction state. */
   TransactionState state_;
@@ -260,8 +359,16 @@ class Transaction {
   std::shared_ptr<std::deque<TableWriteRecord>> table_write_set_;
   /** The undo set of indexes. */
   std::shared_ptr<std::deque<IndexWriteRecord>> index_write_set_;
-  /** The LSN of the last record written by the transaction. */
-  lsn_t prev_lsn_;
+  /** Optimistic concurrency control: the tuples read, and the updates and deletes to write at commit. */
+  std::shared_ptr<std::vector<TableReadRecord>> table_read_set_;
+  std::shared_ptr<std::unordered_map<RID, TableWriteRecord>> pending_write_set_;
+  /** The LSN of the last record written by the transaction, also read by checkpoints. */
+  std::atomic<lsn_t> prev_lsn_;
+  /** The private log buffer of the transaction. */
+  PrivateLogBuffer *private_log_{nullptr};
+  /** Snapshot isolation: the snapshot the transaction reads, and the timestamp its writes become visible at. */
+  timestamp_t read_ts_{0};
+  timestamp_t commit_ts_{0};
 
   /** Concurrent index: the pages that were latched during index operation. */
   std::shared_ptr<std::deque<Page *>> page_set_;
@@ -272,6 +379,10 @@ class Transaction {
   std::shared_ptr<std::unordered_set<RID>> shared_lock_set_;
   /** LockManager: the set of exclusive-locked tuples held by this transaction. */
   std::shared_ptr<std::unordered_set<RID>> exclusive_lock_set_;
+  /** LockManager: the tables locked by this transaction. */
+  std::shared_ptr<std::unordered_map<table_oid_t, TableLockMode>> table_lock_set_;
+  /** LockManager: the exclusive row locks held by this transaction, by table, counted for lock escalation. */
+  std::shared_ptr<std::unordered_map<table_oid_t, std::vector<RID>>> table_row_locks_;
 };
 
 }  // namespace bustub
@@ -12,10 +12,18 @@
 
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>  // NOLINT
+#include <set>
 #include <shared_mutex>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
 #include "concurrency/lock_manager.h"
@@ -24,6 +32,7 @@
 
 namespace bustub {
 class LockManager;
+class TableHeap;
 
 /**
  * TransactionManager keeps track of all the transactions running in the system.
@@ -46,8 +55,13 @@ class TransactionManager {
   /**
    * Commits a transaction.
    * @param txn the transaction to commit
+   * @param durability whether to wait for the COMMIT record to be durable
+   * @param max_delay for an asynchronous commit, how long the COMMIT record may stay in memory, at most log_timeout
+   * @return false if the transaction was aborted instead, which only happens to an OPTIMISTIC transaction that fails
+   * validation
    */
-  void Commit(Transaction *txn);
+  bool Commit(Transaction *txn, Durability durability = Durability::SYNC,
+              std::chrono::milliseconds max_delay = log_timeout);
 
   /**
    * Aborts a transaction
@@ -56,26 +70,11 @@ class TransactionManager {
   void Abort(Transaction *txn);
 
   /**
-   * Global list of running transactions
-   */
-
-  /** The transaction map is a global list of all the running transactions in the system. */
-  static std::unordered_map<txn_id_t, Transaction *> txn_map;
-  static std::shared_mutex txn_map_mutex;
-
-  /**
-   * Locates and returns the transaction with the given transaction ID.
+   * Locates and returns a running transaction, i.e. one that began and did not finish committing or aborting yet.
    * @param txn_id the id of the transaction to be found, it must exist!
    * @return the transaction with the given transaction id
    */
-  static Transaction *GetTransaction(txn_id_t txn_id) {
-    TransactionManager::txn_map_mutex.lock_shared();
-    assert(TransactionManager::txn_map.find(txn_id) != TransactionManager::txn_map.end());
-    auto *res = TransactionManager::txn_map[txn_id];
-    assert(res != nullptr);
-    TransactionManager::txn_map_mutex.unlock_shared();
-    return res;
-  }
+  static Transaction *GetTransaction(txn_id_t txn_id);
 
   /** Prevents all transactions from performing operations, used for checkpointing. */
   void BlockAllTransactions();
@@ -83,7 +82,105 @@ class TransactionManager {
   /** Resumes all transactions, used for checkpointing. */
   void ResumeTransactions();
 
+  /**
+   * Append a log record together with a snapshot of the active transaction table, used for fuzzy checkpointing.
+   * Every transaction whose BEGIN record precedes the appended record and whose COMMIT or ABORT record does not is
+   * in the snapshot; transactions that are just finishing may be in it as well.
+   * @param log_record the record to append
+   * @param[out] active_txns the transactions that were active when the record was appended
+   * @return the LSN of the appended record
+   */
+  lsn_t AppendLogRecordWithActiveTxns(LogRecord *log_record, std::vector<ActiveTxnEntry> *active_txns);
+
+  /**
+   * Continue the transaction ids after the ones in a recovered log, before any transaction begins.
+   * @param next_txn_id the id of the next transaction
+   */
+  void SetNextTxnId(txn_id_t next_txn_id) { next_txn_id_ = next_txn_id; }
+
+  /** @return the commit timestamp of the last SNAPSHOT_ISOLATION transaction that committed writes */
+  timestamp_t GetLastCommitTimestamp() const { return last_commit_ts_; }
+
  private:
+  /** log2 of the number of shards of the transaction registry, and of the running transaction counts. */
+  static constexpr size_t TXN_SHARD_BITS = 6;
+
+  /** A part of the registry of running transactions, on its own cache line like the lock table shards. */
+  struct alignas(64) TxnMapShard {
+    std::shared_mutex latch_;
+    std::unordered_map<txn_id_t, Transaction *> txn_map_;
+  };
+
+  /** The number of running transactions whose id falls into a shard. */
+  struct alignas(64) RunningTxnCount {
+    std::atomic<int64_t> count_{0};
+  };
+
+  /** @return the shard of a transaction, the ids are consecutive so their low bits spread them evenly */
+  static size_t GetTxnShard(txn_id_t txn_id) { return static_cast<size_t>(txn_id) & ((1 << TXN_SHARD_BITS) - 1); }
+
+  /** Add a transaction to the registry, replacing one with the same id from another transaction manager. */
+  static void RegisterTransaction(Transaction *txn);
+
+  /** Remove a finished transaction from the registry. It leaves the entry of another transaction with its id alone. */
+  static void DeregisterTransaction(Transaction *txn);
+
+  /** Count a transaction as running, waiting while a checkpoint blocks all transactions. */
+  void StartRunning(Transaction *txn);
+
+  /** Count a transaction as finished, and wake up a checkpoint waiting for it. */
+  void FinishRunning(Transaction *txn);
+
+  /** @return true if no transaction is running, the caller must hold block_latch_ */
+  bool NoneRunning() const;
+
+  /** The running transactions of all transaction managers, by id. */
+  static std::array<TxnMapShard, 1 << TXN_SHARD_BITS> txn_map_shards;
+
+  /** The tuples a snapshot transaction wrote, to commit, drop or garbage collect their versions. */
+  using VersionedTuples = std::vector<std::pair<TableHeap *, RID>>;
+
+  /**
+   * Commit the versions a snapshot transaction wrote under the next commit timestamp. A snapshot taken from then on
+   * sees all of them.
+   */
+  void CommitVersions(Transaction *txn);
+
+  /** Drop the versions of an aborted snapshot transaction, whose writes are rolled back already. */
+  void AbortVersions(Transaction *txn, const VersionedTuples &tuples);
+
+  /** End the snapshot of a finished snapshot transaction, and collect the versions no running snapshot needs. */
+  void EndSnapshot(Transaction *txn);
+
+  /** @return the oldest read timestamp any running or future snapshot transaction can have */
+  timestamp_t GetWatermark();
+
+  /**
+   * Validate an optimistic transaction: lock the stamps of the tuples it is going to write, then check the stamps of
+   * the tuples it read. Once it passed, the transaction serializes here, and no tuple it read can change until it has
+   * written.
+   * @return false if a tuple it read changed, or another transaction holds a tuple it reads or writes
+   */
+  bool ValidateOptimistic(Transaction *txn);
+
+  /**
+   * Write the pending updates and deletes of a validated optimistic transaction, and unlock all of its stamps.
+   * @return false if a write failed, which leaves the stamps locked and the transaction to be aborted
+   */
+  bool WriteOptimistic(Transaction *txn);
+
+  /**
+   * Finish the table writes of a committed or aborted transaction with TableHeap::FinishWrites, sorted by table and
+   * page so that each page is fetched and latched once. On commit only the deletes are left to apply.
+   * @param txn the transaction
+   * @param is_commit true to commit the writes, false to roll them back. It is not taken from the state of the
+   * transaction, which a wound may set to ABORTED while the transaction commits.
+   */
+  void FinishTableWrites(Transaction *txn, bool is_commit);
+
+  /** Forget a transaction that wrote its COMMIT or ABORT record. */
+  void RemoveActiveTxn(Transaction *txn);
+
   /**
    * Releases all the locks held by the given transaction.
    * @param txn the transaction whose locks should be released
@@ -99,14 +196,46 @@ class TransactionManager {
     for (auto locked_rid : lock_set) {
       lock_manager_->Unlock(txn, locked_rid);
     }
+    std::vector<table_oid_t> table_lock_set;
+    for (const auto &item : *txn->GetTableLockSet()) {
+      table_lock_set.emplace_back(item.first);
+    }
+    for (auto oid : table_lock_set) {
+      lock_manager_->UnlockTable(txn, oid);
+    }
+    txn->GetTableRowLocks()->clear();
   }
 
   std::atomic<txn_id_t> next_txn_id_{0};
   LockManager *lock_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
+  LogManager *log_manager_;
 
-  /** The global transaction latch is used for checkpointing. */
-  ReaderWriterLatch global_txn_latch_;
+  /**
+   * The running transactions, counted in shards by id so that Begin and Commit don't all write one cache line. A
+   * transaction is counted in the same shard when it finishes on another thread, e.g. when aborted by a checker.
+   */
+  std::array<RunningTxnCount, 1 << TXN_SHARD_BITS> running_txns_;
+  /** Set while a checkpoint blocks all transactions. Begin counts a transaction before it checks the flag, and the
+   * checkpoint sets it before it checks the counts, so one of the two always sees the other. */
+  std::atomic<bool> txns_blocked_{false};
+  /** Lets a checkpoint wait for the running transactions to finish, and Begin for the checkpoint. */
+  std::mutex block_latch_;
+  std::condition_variable block_cv_;
+
+  /** Orders BEGIN records against checkpoints, and protects active_txns_. */
+  std::mutex active_txns_latch_;
+  /** The transactions that wrote a BEGIN record but not yet a COMMIT or ABORT record, with their BEGIN LSN. */
+  std::unordered_map<Transaction *, lsn_t> active_txns_;
+
+  /** Hands out commit timestamps in order, and protects gc_queue_. */
+  std::mutex commit_latch_;
+  std::atomic<timestamp_t> last_commit_ts_{0};
+  /** The tuples whose versions to collect once no snapshot older than the timestamp runs, oldest first. */
+  std::deque<std::pair<timestamp_t, VersionedTuples>> gc_queue_;
+  /** Protects active_read_ts_, so that no version is collected while a new snapshot that needs it is taken. */
+  std::mutex snapshot_latch_;
+  /** The read timestamps of the running snapshot transactions. */
+  std::multiset<timestamp_t> active_read_ts_;
 };
 
 }  // namespace bustub
@@ -12,14 +12,25 @@
 
 #pragma once
 
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/buffer_pool_warmup.h"
 #include "concurrency/transaction_manager.h"
 #include "recovery/log_manager.h"
 
 namespace bustub {
 
 /**
- * CheckpointManager creates consistent checkpoints by blocking all other transactions temporarily.
+ * CheckpointManager creates checkpoints that bound how much of the log recovery has to read.
+ *
+ * BeginCheckpoint/EndCheckpoint create consistent checkpoints by blocking all other transactions temporarily and
+ * flushing the whole buffer pool. FuzzyCheckpoint creates ARIES-style checkpoints instead, which neither block
+ * transactions nor write pages: a CHECKPOINT_BEGIN record is appended together with a snapshot of the active
+ * transaction table, and a CHECKPOINT_END record carries that table and the dirty page table of the buffer pool.
+ * Either way, once the checkpoint is durable the master record is updated to point at it, and the log before the
+ * point recovery starts reading from is truncated. With a warm-up attached, every checkpoint also saves the resident
+ * pages as its warm-up list.
  */
 class CheckpointManager {
  public:
@@ -34,10 +45,30 @@ class CheckpointManager {
   void BeginCheckpoint();
   void EndCheckpoint();
 
+  /**
+   * Take a fuzzy checkpoint while transactions keep running.
+   * @return the LSN of the CHECKPOINT_BEGIN record
+   */
+  lsn_t FuzzyCheckpoint();
+
+  /** @param warmup the warm-up whose list every checkpoint saves, nullptr to save none */
+  void SetBufferPoolWarmup(BufferPoolWarmup *warmup) { warmup_ = warmup; }
+
  private:
-  TransactionManager *transaction_manager_ __attribute__((__unused__));
-  LogManager *log_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /**
+   * Append the CHECKPOINT_END records, as many as the tables need to fit into a log buffer, make them durable, point
+   * the master record at the checkpoint and truncate the log recovery no longer needs.
+   * @param begin_lsn the LSN of the CHECKPOINT_BEGIN record
+   * @param active_txns the active transaction table as of begin_lsn
+   * @param dirty_pages the pages that may hold changes older than begin_lsn that are not on disk
+   */
+  void CompleteCheckpoint(lsn_t begin_lsn, std::vector<ActiveTxnEntry> active_txns,
+                          std::vector<DirtyPageEntry> dirty_pages);
+
+  TransactionManager *transaction_manager_;
+  LogManager *log_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  BufferPoolWarmup *warmup_{nullptr};
 };
 
 }  // namespace bustub
@@ -13,62 +13,333 @@
 #pragma once
 
 #include <algorithm>
+#include <chrono>              // NOLINT
 #include <condition_variable>  // NOLINT
 #include <future>              // NOLINT
-#include <mutex>               // NOLINT
+#include <map>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
+#include <vector>
 
 #include "recovery/log_record.h"
 #include "storage/disk/disk_manager.h"
 
 namespace bustub {
 
+class LogShipper;
+class Page;
+class Transaction;
+
+/**
+ * PrivateLogBuffer collects the log records of one transaction, so that they reach the log in a single reservation.
+ * The records are serialized without their LSN and previous LSN, which are only filled in once they are published.
+ * Until then the pages they changed point at the buffer, and whoever wants to write such a page, or to log another
+ * change to it, publishes the buffer first.
+ */
+class PrivateLogBuffer {
+ public:
+  explicit PrivateLogBuffer(size_t capacity) : data_(std::make_unique<char[]>(capacity)), capacity_(capacity) {}
+
+ private:
+  friend class LogManager;
+
+  /** Serializes appending against publishing, which other threads may do. */
+  std::mutex latch_;
+  std::unique_ptr<char[]> data_;
+  const size_t capacity_;
+  int size_{0};
+  int num_records_{0};
+  /** The pages changed by the buffered records, with the index of the record that changed them. */
+  std::vector<std::pair<Page *, int>> pages_;
+  /** The transaction the buffer belongs to, whose previous LSN is advanced when it is published. */
+  Transaction *txn_{nullptr};
+};
+
 /**
  * LogManager maintains a separate thread that is awakened whenever the log buffer is full or whenever a timeout
  * happens. When the thread is awakened, the log buffer's content is written into the disk log file.
+ *
+ * The log buffers form a ring: records are appended to the active buffer, log_buffer_, and once it is full it is
+ * sealed and the next buffer of the ring becomes active, while the flush thread writes the full buffers in order.
+ * Both the size of a buffer and the number of buffers are chosen at construction, so that bursts of writes can be
+ * absorbed without waiting for the disk. A committing transaction does not write the log itself: it waits until the
+ * persistent LSN passes its COMMIT record. Every transaction that commits while a write is in progress lands in a
+ * later buffer, so one durable write covers all of them (group commit).
+ *
+ * Appending takes no latch. A thread reserves its LSN and its byte range in log_buffer_ with a single CAS on
+ * reserve_state_, serializes the record into the range concurrently with other appenders, and then publishes it by
+ * adding its size to completed_bytes_. To rotate, the buffer is sealed so that no more space can be reserved, and the
+ * rotating thread waits until the completed bytes cover the sealed prefix. An appender that finds the log buffer full
+ * rotates it itself as long as a buffer is free, so the flush thread only ever writes.
+ *
+ * An asynchronous commit does not wait for its COMMIT record; it only sets a deadline with FlushWithin, and the flush
+ * thread, which otherwise writes at least every log_timeout, writes the log buffer by the earliest such deadline.
+ *
+ * With private buffers enabled, the records a transaction logs through AppendTxnLogRecord are collected in its
+ * PrivateLogBuffer and published at commit or abort, or whenever the buffer fills, with one reservation.
+ *
+ * With a LogShipper attached, every log buffer is also handed to the shipper once it is durable, for a hot standby.
  */
 class LogManager {
  public:
-  explicit LogManager(DiskManager *disk_manager)
-      : next_lsn_(0), persistent_lsn_(INVALID_LSN), disk_manager_(disk_manager) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-    flush_buffer_ = new char[LOG_BUFFER_SIZE];
-  }
+  /**
+   * Creates a new log manager.
+   * @param disk_manager the disk manager the log is written to
+   * @param buffer_size the size of each log buffer in bytes, which is also the largest log record
+   * @param num_buffers the number of log buffers in the ring, at least 2
+   */
+  explicit LogManager(DiskManager *disk_manager, size_t buffer_size = LOG_BUFFER_SIZE,
+                      size_t num_buffers = NUM_LOG_BUFFERS);
 
-  ~LogManager() {
-    delete[] log_buffer_;
-    delete[] flush_buffer_;
-    log_buffer_ = nullptr;
-    flush_buffer_ = nullptr;
-  }
+  ~LogManager();
 
   void RunFlushThread();
   void StopFlushThread();
 
   lsn_t AppendLogRecord(LogRecord *log_record);
 
-  inline lsn_t GetNextLSN() { return next_lsn_; }
+  /**
+   * Log a change of a transaction, privately if private buffers are enabled. Either way the record is published
+   * before the page can be written back, and the page LSN and the previous LSN of the transaction cover it once it is.
+   * The caller must hold the write latch of the page.
+   * @param log_record the record, whose LSN is only set if it is appended directly
+   * @param txn the transaction that made the change
+   * @param page the page that was changed, or nullptr
+   */
+  void AppendTxnLogRecord(LogRecord *log_record, Transaction *txn, Page *page);
+
+  /**
+   * Publish the private log buffer of a finishing transaction and give it back.
+   * @param txn the transaction
+   * @return the LSN of the last record of the transaction
+   */
+  lsn_t PublishTxnLog(Transaction *txn);
+
+  /**
+   * Publish the records that changed a page and are still in a private buffer, before the page is written back.
+   * @param page the page
+   */
+  void PublishPageLog(Page *page);
+
+  /**
+   * Choose the size of the private log buffers, at most the log buffer size, or disable them with 0, the default.
+   * Only takes effect for transactions that have no private buffer yet.
+   */
+  void SetPrivateBufferSize(size_t size);
+  size_t GetPrivateBufferSize() const { return private_buffer_size_; }
+
+  /**
+   * Block until every log record up to and including the given LSN is durable.
+   * @param lsn the LSN that has to become persistent
+   */
+  void Flush(lsn_t lsn);
+
+  /**
+   * Make sure that every log record up to and including the given LSN becomes durable within a delay, without waiting
+   * for it.
+   * @param lsn the LSN that has to become persistent
+   * @param max_delay the time the flush thread may take
+   */
+  void FlushWithin(lsn_t lsn, std::chrono::milliseconds max_delay);
+
+  inline lsn_t GetNextLSN() { return StateLSN(reserve_state_); }
+
+  /**
+   * Continue the LSNs after the ones in a recovered log, before logging starts, so that the records appended from now
+   * on are newer than the recovered pages.
+   * @param next_lsn the LSN of the next record, one past the highest in the log
+   */
+  void SetNextLSN(lsn_t next_lsn);
+
   inline lsn_t GetPersistentLSN() { return persistent_lsn_; }
   inline void SetPersistentLSN(lsn_t lsn) { persistent_lsn_ = lsn; }
   inline char *GetLogBuffer() { return log_buffer_; }
 
+  /** @return the number of durable log writes */
+  uint64_t GetNumFlushes() const { return num_flushes_; }
+
+  /** @return the number of COMMIT records made durable */
+  uint64_t GetNumCommits() const { return num_commits_; }
+
+  /** @return the average number of commits made durable by one log write */
+  double GetCommitsPerFlush() const {
+    return num_flushes_ == 0 ? 0 : static_cast<double>(num_commits_) / num_flushes_;
+  }
+
+  /** @return the time from appending a COMMIT record until it was durable */
+  const LatencyHistogram &GetCommitLatency() const { return commit_latency_; }
+
+  /** @return the number of appends that found the log buffer full */
+  uint64_t GetNumAppendStalls() const { return num_append_stalls_; }
+
+  /** @return the total time appends spent rotating the log buffers or waiting for a free one */
+  std::chrono::nanoseconds GetAppendStallTime() const { return std::chrono::nanoseconds(append_stall_ns_.load()); }
+
+  /** @return the size of each log buffer in bytes */
+  size_t GetBufferSize() const { return buffer_size_; }
+
+  /** @return the number of log buffers */
+  size_t GetNumBuffers() const { return buffers_.size(); }
+
+  /**
+   * Choose how tuple updates are logged: as UPDATE_DELTA records holding the changed bytes, the default, or as
+   * UPDATE records holding both images in full. Recovery understands both.
+   */
+  void SetUpdateDeltas(bool enabled) { update_deltas_ = enabled; }
+  bool UsesUpdateDeltas() const { return update_deltas_; }
+
+  /**
+   * Find where to start reading the log to reach a record. Only the start of each buffer is indexed, so the offset
+   * can precede the record by up to a buffer.
+   * @param lsn the LSN of an appended record
+   * @return the offset in the log of the buffer holding the record
+   */
+  int64_t GetLogOffset(lsn_t lsn);
+
+  /**
+   * Durably replace the master record, which points recovery at the last checkpoint.
+   * @param master_record the new master record, whose checkpoint must already be durable in the log
+   */
+  void WriteMasterRecord(const MasterRecord &master_record);
+
+  /**
+   * Let the disk manager discard the log before an offset, which no recovery will read again.
+   * @param offset the offset of the oldest log byte recovery may still need
+   */
+  void TruncateLog(int64_t offset);
+
+  /**
+   * Stream the log written from now on to a standby, or stop streaming it with nullptr.
+   * @param log_shipper the shipper, which must outlive the log manager or be detached first
+   */
+  void SetLogShipper(LogShipper *log_shipper);
+
+  /**
+   * Serialize a log record.
+   * @param log_record the record, whose size and LSN must already be set
+   * @param[out] dst the output buffer, at least log_record->GetSize() bytes long
+   */
+  static void SerializeLogRecord(LogRecord *log_record, char *dst);
+
  private:
-  // TODO(students): you may add your own member variables
+  /** Set in reserve_state_ while log_buffer_ is being drained. */
+  static constexpr uint64_t SEALED = 1ULL << 31;
+
+  /** One buffer of the ring, and what it holds once it is full. */
+  struct LogBuffer {
+    std::unique_ptr<char[]> data_;
+    /** Append times, in steady clock nanoseconds, of the COMMIT records in the buffer. */
+    std::unique_ptr<int64_t[]> commit_times_;
+    int size_{0};
+    lsn_t last_lsn_{INVALID_LSN};
+    int num_commits_{0};
+  };
 
-  /** The atomic counter which records the next log sequence number. */
-  std::atomic<lsn_t> next_lsn_;
+  /** reserve_state_ packs the next LSN into the upper 32 bits, and the SEALED bit and used bytes into the lower. */
+  static uint64_t PackState(lsn_t next_lsn, int offset) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(next_lsn)) << 32) | static_cast<uint32_t>(offset);
+  }
+  static lsn_t StateLSN(uint64_t state) { return static_cast<lsn_t>(state >> 32); }
+  static int StateOffset(uint64_t state) { return static_cast<int>(state & (SEALED - 1)); }
+
+  /**
+   * Reserve the LSNs and the byte range of records in log_buffer_.
+   * @param size the total size of the records
+   * @param num_records the number of records
+   * @return the reserve state the reservation was made in, holding the first LSN and the offset
+   */
+  uint64_t Reserve(int size, int num_records);
+
+  /**
+   * Make room for a record in the log buffer, rotating the buffers or waiting for the flush thread.
+   * @param size the size of the record
+   */
+  void WaitForSpace(int size);
+
+  /** Publish the records of a private buffer to the log buffer. */
+  void PublishPrivateLog(PrivateLogBuffer *buffer);
+
+  /** Publish the records of a private buffer whose latch the caller holds. */
+  void PublishLocked(PrivateLogBuffer *buffer);
+
+  /**
+   * Seal log_buffer_, drain the in-flight appends, queue it for writing and activate the next buffer of the ring,
+   * which must be free. The caller must hold latch_.
+   */
+  void RotateBuffers();
+
+  /**
+   * Write out the oldest full buffer, rotating log_buffer_ first if no buffer is full. If another thread is already
+   * writing, wait for it instead. The caller must hold latch_ through lock, which is released during the write.
+   */
+  void FlushInline(std::unique_lock<std::mutex> *lock);
+
+  /** The next LSN and the used bytes of log_buffer_, see PackState. */
+  std::atomic<uint64_t> reserve_state_;
+  /** Bytes of log_buffer_ whose records have been fully serialized. */
+  std::atomic<int> completed_bytes_{0};
   /** The log records before and including the persistent lsn have been written to disk. */
   std::atomic<lsn_t> persistent_lsn_;
 
+  const size_t buffer_size_;
+  /** A COMMIT record is at least a header long, which bounds the number of them in one buffer. */
+  const size_t max_commits_per_buffer_;
+  std::vector<LogBuffer> buffers_;
+  /** The data of the active buffer, buffers_[active_], read by appenders without latch_. */
   char *log_buffer_;
-  char *flush_buffer_;
+  int64_t *log_commit_times_;
+  std::atomic<int> log_num_commits_{0};
 
+  /** Serializes rotations and protects the flush state below it. Appenders only take it when log_buffer_ is full. */
   std::mutex latch_;
 
-  std::thread *flush_thread_ __attribute__((__unused__));
+  std::thread *flush_thread_{nullptr};
+  bool stop_flush_thread_{false};
+  /** Set when someone is waiting for the log to be written. */
+  bool flush_requested_{false};
+  /** The active buffer, and the full buffers waiting to be written, which precede it in the ring. */
+  size_t active_{0};
+  size_t num_full_{0};
+  /** Set while the oldest full buffer is being written. */
+  bool writing_{false};
+  /** The earliest deadline set by FlushWithin, and the largest LSN it has to cover. */
+  std::chrono::steady_clock::time_point flush_deadline_{std::chrono::steady_clock::time_point::max()};
+  lsn_t deadline_lsn_{INVALID_LSN};
+  /** The first LSN and log offset of the active buffer, and of every buffer before it. */
+  lsn_t active_first_lsn_{0};
+  int64_t active_offset_;
+  std::map<lsn_t, int64_t> lsn_offsets_;
+  /** The offset up to which the log is durable. */
+  int64_t flushed_offset_;
+  LogShipper *log_shipper_{nullptr};
 
+  /** Wakes up the flush thread. */
   std::condition_variable cv_;
+  /** Wakes up appenders waiting for a free buffer. */
+  std::condition_variable append_cv_;
+  /** Wakes up threads waiting for the persistent LSN to advance. */
+  std::condition_variable flushed_cv_;
+
+  std::atomic<bool> update_deltas_{true};
+
+  std::atomic<size_t> private_buffer_size_{0};
+  /**
+   * Owns every private buffer, and keeps the ones not lent to a transaction. Buffers are only freed with the log
+   * manager, so a page that still points at a buffer given back can at worst publish a later transaction early.
+   */
+  std::mutex private_buffers_latch_;
+  std::vector<std::unique_ptr<PrivateLogBuffer>> private_buffers_;
+  std::vector<PrivateLogBuffer *> free_private_buffers_;
+
+  std::atomic<uint64_t> num_flushes_{0};
+  std::atomic<uint64_t> num_commits_{0};
+  LatencyHistogram commit_latency_;
+  std::atomic<uint64_t> num_append_stalls_{0};
+  std::atomic<uint64_t> append_stall_ns_{0};
 
-  DiskManager *disk_manager_ __attribute__((__unused__));
+  DiskManager *disk_manager_;
 };
 
 }  // namespace bustub
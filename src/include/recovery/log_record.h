@@ -14,8 +14,11 @@
 
 #include <cassert>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "common/config.h"
+#include "recovery/tuple_delta.h"
 #include "storage/table/tuple.h"
 
 namespace bustub {
@@ -32,6 +35,44 @@ enum class LogRecordType {
   ABORT,
   /** Creating a new page in the table heap. */
   NEWPAGE,
+  /** Start of a fuzzy checkpoint. */
+  CHECKPOINT_BEGIN,
+  /**
+   * End of a checkpoint, carrying the active transaction table and the dirty page table. Tables too large for one
+   * record are split across several, the last of which is flagged.
+   */
+  CHECKPOINT_END,
+  /** An update that only logs the changed bytes of the tuple. */
+  UPDATE_DELTA,
+};
+
+/** An entry of the active transaction table recorded by a checkpoint. */
+struct ActiveTxnEntry {
+  txn_id_t txn_id_;
+  /** The BEGIN record of the transaction. */
+  lsn_t first_lsn_;
+  /** The last record the transaction wrote before the checkpoint began. */
+  lsn_t last_lsn_;
+};
+
+/** An entry of the dirty page table recorded by a checkpoint. */
+struct DirtyPageEntry {
+  page_id_t page_id_;
+  /** The first record that may have dirtied the page since it was last written back. */
+  lsn_t rec_lsn_;
+};
+
+/**
+ * The master record lives outside the log and points recovery at the last complete checkpoint.
+ * Analysis starts at the CHECKPOINT_BEGIN record, redo and undo may have to look further back, up to scan_lsn_.
+ */
+struct MasterRecord {
+  lsn_t checkpoint_lsn_;
+  /** The smallest LSN recovery has to read. */
+  lsn_t scan_lsn_;
+  /** Offsets in the log to start reading at to find the two records above. */
+  int64_t checkpoint_offset_;
+  int64_t scan_offset_;
 };
 
 /**
@@ -53,14 +94,23 @@ enum class LogRecordType {
  *-----------------------------------------------------------------------------------
  * | HEADER | tuple_rid | tuple_size | old_tuple_data | tuple_size | new_tuple_data |
  *-----------------------------------------------------------------------------------
+ * For update delta type log record (see tuple_delta.h)
+ *-------------------------------
+ * | HEADER | tuple_rid | delta |
+ *-------------------------------
  * For new page type log record
- *--------------------------
- * | HEADER | prev_page_id |
- *--------------------------
+ *-------------------------------------
+ * | HEADER | prev_page_id | page_id |
+ *-------------------------------------
+ * For checkpoint end type log record (checkpoint begin type has no body)
+ *----------------------------------------------------------------------------------------------
+ * | HEADER | begin_lsn | is_last | num_txns | ActiveTxnEntry[] | num_pages | DirtyPageEntry[] |
+ *----------------------------------------------------------------------------------------------
  */
 class LogRecord {
   friend class LogManager;
   friend class LogRecovery;
+  friend class LogStandby;
 
  public:
   LogRecord() = default;
@@ -98,6 +148,16 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(RID) + old_tuple.GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t);
   }
 
+  // constructor for UPDATE_DELTA type
+  LogRecord(txn_id_t txn_id, lsn_t prev_lsn, const RID &update_rid, TupleDelta delta)
+      : txn_id_(txn_id),
+        prev_lsn_(prev_lsn),
+        log_record_type_(LogRecordType::UPDATE_DELTA),
+        update_rid_(update_rid),
+        delta_(std::move(delta)) {
+    size_ = HEADER_SIZE + sizeof(RID) + delta_.GetSerializedSize();
+  }
+
   // constructor for NEWPAGE type
   LogRecord(txn_id_t txn_id, lsn_t prev_lsn, LogRecordType log_record_type, page_id_t prev_page_id, page_id_t page_id)
       : size_(HEADER_SIZE),
@@ -110,6 +170,23 @@ class LogRecord {
     size_ = HEADER_SIZE + sizeof(page_id_t) * 2;
   }
 
+  // constructor for CHECKPOINT_END type, is_last is false for all but the last record of a split checkpoint
+  LogRecord(lsn_t begin_lsn, std::vector<ActiveTxnEntry> active_txns, std::vector<DirtyPageEntry> dirty_pages,
+            bool is_last = true)
+      : log_record_type_(LogRecordType::CHECKPOINT_END),
+        checkpoint_begin_lsn_(begin_lsn),
+        checkpoint_is_last_(is_last),
+        active_txns_(std::move(active_txns)),
+        dirty_pages_(std::move(dirty_pages)) {
+    size_ = static_cast<int32_t>(CheckpointEndSize(active_txns_.size(), dirty_pages_.size()));
+  }
+
+  /** @return the size of a CHECKPOINT_END record carrying the given number of table entries */
+  static size_t CheckpointEndSize(size_t num_txns, size_t num_pages) {
+    return HEADER_SIZE + sizeof(lsn_t) + 3 * sizeof(int32_t) + num_txns * sizeof(ActiveTxnEntry) +
+           num_pages * sizeof(DirtyPageEntry);
+  }
+
   ~LogRecord() = default;
 
   inline Tuple &GetDeleteTuple() { return delete_tuple_; }
@@ -126,8 +203,18 @@ class LogRecord {
 
   inline RID &GetUpdateRID() { return update_rid_; }
 
+  inline TupleDelta &GetUpdateDelta() { return delta_; }
+
   inline page_id_t GetNewPageRecord() { return prev_page_id_; }
 
+  inline lsn_t GetCheckpointBeginLSN() { return checkpoint_begin_lsn_; }
+
+  inline bool IsLastCheckpointEnd() { return checkpoint_is_last_; }
+
+  inline std::vector<ActiveTxnEntry> &GetActiveTxns() { return active_txns_; }
+
+  inline std::vector<DirtyPageEntry> &GetDirtyPages() { return dirty_pages_; }
+
   inline int32_t GetSize() { return size_; }
 
   inline lsn_t GetLSN() { return lsn_; }
@@ -172,10 +259,17 @@ class LogRecord {
   RID update_rid_;
   Tuple old_tuple_;
   Tuple new_tuple_;
+  TupleDelta delta_;
 
   // case4: for new page operation
   page_id_t prev_page_id_{INVALID_PAGE_ID};
   page_id_t page_id_{INVALID_PAGE_ID};
+
+  // case5: for checkpoint end
+  lsn_t checkpoint_begin_lsn_{INVALID_LSN};
+  bool checkpoint_is_last_{true};
+  std::vector<ActiveTxnEntry> active_txns_;
+  std::vector<DirtyPageEntry> dirty_pages_;
   static const int HEADER_SIZE = 20;
 };  // namespace bustub
 
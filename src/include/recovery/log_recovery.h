@@ -13,24 +13,53 @@
 #pragma once
 
 #include <algorithm>
-#include <mutex>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
 #include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
 #include "recovery/log_record.h"
+#include "storage/page/table_page.h"
 
 namespace bustub {
 
 /**
  * Read log file from disk, redo and undo.
+ *
+ * Redo scans the log once, sequentially, and hands every record to the worker that owns its page: pages are
+ * partitioned by id across the workers, and each worker applies the records of its pages in LSN order. A record is
+ * only replayed if it is newer than the page LSN, so pages that were written back before the crash are skipped.
+ * Meanwhile the scan tracks the transactions that never committed or aborted. Undo then rolls back these losers,
+ * reading their records newest first and handing them to the workers by page the same way. Each page is thus rolled
+ * back in the reverse order its space was taken, which leaves room for every old tuple unless a transaction that
+ * committed took the space since. A record that cannot be replayed or rolled back makes Redo or Undo throw.
+ *
+ * If the master record points at a complete checkpoint, the scan starts at the oldest record the checkpoint still
+ * needs instead of the start of the log. Before the checkpoint, only the transactions in its active transaction table
+ * are tracked, and only the pages in its dirty page table are replayed, from their recovery LSN on.
+ *
+ * Recovery must run before logging is enabled, since the table page operations it replays would otherwise be logged.
+ * Restart then hands over to normal processing.
  */
 class LogRecovery {
  public:
-  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
-      : disk_manager_(disk_manager), buffer_pool_manager_(buffer_pool_manager), offset_(0) {
-    log_buffer_ = new char[LOG_BUFFER_SIZE];
-  }
+  /**
+   * Creates a new log recovery.
+   * @param disk_manager the disk manager the log is read from
+   * @param buffer_pool_manager the buffer pool the pages are recovered into
+   * @param num_workers the number of threads replaying the log, at most half the buffer pool since each of them pins
+   * a page at a time
+   */
+  LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager,
+              size_t num_workers = std::thread::hardware_concurrency());
 
   ~LogRecovery() {
     delete[] log_buffer_;
@@ -39,19 +68,187 @@ class LogRecovery {
 
   void Redo();
   void Undo();
-  bool DeserializeLogRecord(const char *data, LogRecord *log_record);
+
+  /**
+   * Prepare normal processing after Redo and Undo, before logging is enabled. The LSNs and transaction ids continue
+   * after the highest ones in the log, so that new records are replayed onto pages that carry older LSNs and the next
+   * recovery does not mistake new transactions for old ones. Every loser Undo rolled back gets an ABORT record, so
+   * that the next recovery does not roll it back again, over what later transactions wrote. The rolled back pages are
+   * written back before the ABORT records, since nothing else in the log tells how to roll them back.
+   * @param log_manager the log manager of the restarted system
+   * @param txn_manager the transaction manager of the restarted system
+   */
+  void Restart(LogManager *log_manager, TransactionManager *txn_manager);
+
+  /**
+   * Deserialize a log record.
+   * @param data the serialized log record
+   * @param size the number of bytes available at data
+   * @param[out] log_record the deserialized log record
+   * @return true if a complete log record was deserialized, false if data ends within the record or holds no record
+   */
+  bool DeserializeLogRecord(const char *data, int size, LogRecord *log_record);
+
+  /**
+   * Redo a single log record on the calling thread, unless the pages it touches are already newer. This is how a
+   * standby applies the log it is streamed.
+   * @param log_record the record
+   */
+  void ReplayLogRecord(LogRecord *log_record);
+
+  /** @return the number of threads replaying the log */
+  size_t GetNumWorkers() const { return num_workers_; }
+
+  /** @return the offset in the log the last redo started reading at, 0 unless it started from a checkpoint */
+  int64_t GetScanStartOffset() const { return scan_offset_; }
+
+  /** @return the highest LSN redo read, INVALID_LSN for an empty log */
+  lsn_t GetMaxLSN() const { return max_lsn_; }
+
+  /** @return the highest transaction id redo read, INVALID_TXN_ID for an empty log */
+  txn_id_t GetMaxTxnId() const { return max_txn_id_; }
 
  private:
-  DiskManager *disk_manager_ __attribute__((__unused__));
-  BufferPoolManager *buffer_pool_manager_ __attribute__((__unused__));
+  /** Records handed to a worker at once, to keep the queue synchronization off the per-record path. */
+  static constexpr size_t BATCH_SIZE = 256;
+  /** Batches a worker may fall behind the scan before the scan waits for it. */
+  static constexpr size_t MAX_QUEUED_BATCHES = 16;
+
+  using RecordBatch = std::vector<std::unique_ptr<LogRecord>>;
+
+  /** The batches of log records waiting for one redo or undo worker. */
+  struct RecordQueue {
+    std::mutex latch_;
+    /** Signals both a new batch to the worker and free room to the scan. */
+    std::condition_variable cv_;
+    std::deque<RecordBatch> batches_;
+    bool done_{false};
+    /** The first exception of the worker, after which it only drains the queue. Read once the worker is joined. */
+    std::exception_ptr error_;
+  };
+
+  /** The workers of a redo or undo pass, and the batches being filled for them. */
+  struct WorkerPool {
+    explicit WorkerPool(size_t num_workers) : queues_(num_workers), batches_(num_workers) {}
+
+    std::vector<RecordQueue> queues_;
+    std::vector<std::thread> threads_;
+    std::vector<RecordBatch> batches_;
+  };
+
+  /** Where a log record of an active transaction is, and the previous record of the same transaction. */
+  struct LogLocation {
+    int64_t offset_;
+    lsn_t prev_lsn_;
+  };
+
+  size_t PartitionOf(page_id_t page_id) const { return static_cast<size_t>(page_id) % num_workers_; }
+
+  /** @return the tuple a log record of a tuple operation is about */
+  static const RID &GetRID(const LogRecord &log_record) {
+    switch (log_record.log_record_type_) {
+      case LogRecordType::INSERT:
+        return log_record.insert_rid_;
+      case LogRecordType::UPDATE:
+      case LogRecordType::UPDATE_DELTA:
+        return log_record.update_rid_;
+      default:
+        return log_record.delete_rid_;
+    }
+  }
+
+  /**
+   * Load the checkpoint the master record points at, if it is complete in the log.
+   * @return true if redo can start from the checkpoint, false if it has to read the whole log
+   */
+  bool LoadCheckpoint();
+
+  /** Read the log from the start or the checkpoint on, handing the records to replay to the workers. */
+  void ScanLog(WorkerPool *pool);
+
+  /** @return true if a record of the scan may be missing from a page, judging by the checkpoint */
+  bool NeedsRedo(page_id_t page_id, lsn_t lsn) const {
+    if (lsn >= checkpoint_lsn_) {
+      return true;
+    }
+    auto it = dirty_pages_.find(page_id);
+    return it != dirty_pages_.end() && lsn >= it->second;
+  }
+
+  /**
+   * Start a worker per partition.
+   * @param undo true to roll back the records handed to the workers, false to replay them
+   */
+  void StartWorkers(WorkerPool *pool, bool undo);
+
+  /** Hand a log record to the worker of a partition. */
+  void Dispatch(WorkerPool *pool, size_t partition, std::unique_ptr<LogRecord> log_record);
+
+  /**
+   * Hand over the last batches, wait for the workers, and rethrow the first exception of the scan or of a worker.
+   * @param error the exception the scan stopped with, if any
+   */
+  void FinishWorkers(WorkerPool *pool, std::exception_ptr error);
+
+  /** Queue a batch for a worker, waiting while the worker is too far behind. */
+  void PushBatch(RecordQueue *queue, RecordBatch *batch);
+
+  /** Replay or roll back the batches of a queue until it is done. */
+  void RunWorker(RecordQueue *queue, size_t partition, bool undo);
+
+  /** Replay one log record on the pages of the given partition that it touches. */
+  void RedoLogRecord(LogRecord *log_record, size_t partition);
+
+  /** Roll back the change of a tuple operation record of a loser on its page. */
+  void UndoLogRecord(const LogRecord &log_record);
+
+  /**
+   * Rewrite a tuple of a page by applying an update delta to its current image.
+   * @param redo true to apply the delta forwards, false to roll it back
+   * @return false if the delta does not match the tuple, or the page has no room for the new image
+   */
+  bool ApplyUpdateDelta(TablePage *page, const RID &rid, const TupleDelta &delta, bool redo);
+
+  /**
+   * Read the log into the log buffer, starting at an offset, and grow the buffer first if the record there is larger.
+   * @return false at the end of the log
+   */
+  bool ReadLogBuffer(int64_t offset);
+
+  /** Read the log record at an offset of the log. */
+  void ReadLogRecord(int64_t offset, LogRecord *log_record);
+
+  /** Fetch and write-latch a table page, throwing if the buffer pool has no free frame. */
+  TablePage *FetchTablePage(page_id_t page_id);
+
+  /** Write-unlatch and unpin a page fetched by FetchTablePage. */
+  void ReleaseTablePage(TablePage *page, bool is_dirty);
+
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  size_t num_workers_;
 
   /** Maintain active transactions and its corresponding latest lsn. */
   std::unordered_map<txn_id_t, lsn_t> active_txn_;
-  /** Mapping the log sequence number to log file offset for undos. */
-  std::unordered_map<lsn_t, int> lsn_mapping_;
+  /** Mapping the log sequence number to log file offset for undos, kept for the active transactions only. */
+  std::unordered_map<lsn_t, LogLocation> lsn_mapping_;
+  /** The losers undo rolled back and their latest LSN, which Restart logs an ABORT record for. */
+  std::unordered_map<txn_id_t, lsn_t> undone_txns_;
+  /** The highest LSN and transaction id in the log, which Restart continues after. */
+  lsn_t max_lsn_{INVALID_LSN};
+  txn_id_t max_txn_id_{INVALID_TXN_ID};
 
-  int offset_ __attribute__((__unused__));
+  /** The checkpoint redo starts from, see LoadCheckpoint; INVALID_LSN for none. */
+  lsn_t checkpoint_lsn_{INVALID_LSN};
+  lsn_t scan_lsn_{INVALID_LSN};
+  int64_t scan_offset_{0};
+  /** The active transaction table and the dirty page table of the checkpoint. */
+  std::unordered_set<txn_id_t> checkpoint_txns_;
+  std::unordered_map<page_id_t, lsn_t> dirty_pages_;
+
+  int64_t offset_;
+  /** The buffer redo reads the log into, LOG_BUFFER_SIZE bytes unless a larger record was found. */
   char *log_buffer_;
+  int log_buffer_size_{LOG_BUFFER_SIZE};
 };
-
 }  // namespace bustub
@@ -0,0 +1,120 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_shipper.h
+//
+// Identification: src/include/recovery/log_shipper.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <deque>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "common/config.h"
+
+namespace bustub {
+
+/** Header of every chunk of log sent to a standby, followed by size_ bytes of whole log records. */
+struct ShippedLogHeader {
+  /** Offset of the chunk in the log of the primary. */
+  int64_t offset_;
+  /** Time the chunk became durable on the primary, in steady clock nanoseconds. */
+  int64_t flush_time_;
+  int32_t size_;
+  /** LSN of the last record in the chunk. */
+  lsn_t last_lsn_;
+};
+
+/**
+ * LogShipper streams the log of a primary to a hot standby (see LogStandby) over a local socket or pipe.
+ *
+ * The log manager hands every log buffer to Ship right after writing it, so only durable records are shipped, always
+ * in log order and in chunks of whole records. Ship only copies the buffer into a queue; a sender thread writes the
+ * queue to the connection, so a slow standby never holds up the log. If the standby falls more than max_queued_bytes
+ * behind, or the connection breaks, the shipper disconnects it and drops everything queued. The standby then has to
+ * be rebuilt from a copy of the primary.
+ */
+class LogShipper {
+ public:
+  /** How long the shipper waits, when it is destroyed, for a standby that stopped taking the rest of the queue. */
+  static constexpr std::chrono::milliseconds STOP_TIMEOUT{1000};
+
+  /**
+   * Creates a new log shipper and starts its sender thread.
+   * @param fd the connection to the standby, a stream socket or the write end of a pipe, closed by the shipper
+   * @param max_queued_bytes how much shipped log may wait for the standby before it is disconnected
+   */
+  explicit LogShipper(int fd, size_t max_queued_bytes = 64 * 1024 * 1024);
+
+  /**
+   * Stops the sender thread after it has sent everything queued, and closes the connection. A standby that takes
+   * nothing for STOP_TIMEOUT is disconnected instead, so that it can't keep the primary from shutting down.
+   */
+  ~LogShipper();
+
+  /**
+   * Queue a chunk of durable log for the standby.
+   * @param data the log records
+   * @param size the size of the records in bytes
+   * @param offset the offset of the records in the log
+   * @param last_lsn the LSN of the last record
+   */
+  void Ship(const char *data, int size, int64_t offset, lsn_t last_lsn);
+
+  /** @return false once the standby was disconnected */
+  bool IsConnected() const { return connected_; }
+
+  /** @return the LSN of the last record sent to the standby */
+  lsn_t GetShippedLSN() const { return shipped_lsn_; }
+
+  /** @return the number of log bytes sent to the standby */
+  uint64_t GetShippedBytes() const { return shipped_bytes_; }
+
+ private:
+  /** Send the queued chunks until the shipper is destroyed or disconnected. */
+  void RunSender();
+
+  /**
+   * Write all of a chunk to the connection, waiting for it to take more whenever it is full.
+   * @return false if the connection broke, or the sender was woken up to stop
+   */
+  bool SendAll(const char *data, size_t size);
+
+  /** Drop the queue and wake up the sender if it is waiting for the connection, the caller must hold latch_. */
+  void Disconnect();
+
+  /** Wake up the sender if it waits for the connection to take more. */
+  void WakeSender();
+
+  /** Non-blocking, so that the sender can wait for the connection and the wake-up pipe at once. */
+  int fd_;
+  /** Written to wake up the sender, read by it. Unlike shutdown, this works for a pipe as well. */
+  int wake_fds_[2];
+  const size_t max_queued_bytes_;
+
+  /** Protects the queue. */
+  std::mutex latch_;
+  std::condition_variable cv_;
+  /** Chunks waiting to be sent, each a ShippedLogHeader followed by the records. */
+  std::deque<std::vector<char>> queue_;
+  size_t queued_bytes_{0};
+  /** Set under latch_, read by the sender without it while it waits for the connection. */
+  std::atomic<bool> stop_{false};
+  std::thread sender_;
+
+  std::atomic<bool> connected_{true};
+  std::atomic<lsn_t> shipped_lsn_{INVALID_LSN};
+  std::atomic<uint64_t> shipped_bytes_{0};
+};
+
+}  // namespace bustub
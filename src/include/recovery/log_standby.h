@@ -0,0 +1,165 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_standby.h
+//
+// Identification: src/include/recovery/log_standby.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <functional>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "buffer/buffer_pool_manager.h"
+#include "common/rwlatch.h"
+#include "recovery/log_recovery.h"
+#include "recovery/log_shipper.h"
+#include "storage/disk/disk_stats.h"
+#include "storage/page/table_page.h"
+
+namespace bustub {
+
+/**
+ * LogStandby is a hot standby that applies the log streamed by a LogShipper and serves read-only queries.
+ *
+ * The standby has to start from the same database as the primary had when the shipper was attached, e.g. both empty.
+ * An applier thread appends every chunk it receives to the log of its own disk manager, and redoes its records in log
+ * order with LogRecovery::ReplayLogRecord. The pages therefore also hold the changes of transactions that have not
+ * committed yet. Before such a transaction first changes a tuple, the standby keeps the image the tuple had, and reads
+ * return that image until the transaction commits or aborts. Strict 2PL on the primary guarantees at most one such
+ * image per tuple. A chunk is applied under an exclusive latch that reads share, so every read sees the database as
+ * of one LSN, the applied LSN, with exactly the transactions committed up to it.
+ *
+ * The standby replays the log without logging it again, so it must run in its own process, where logging is off.
+ */
+class LogStandby {
+ public:
+  /**
+   * Creates a new standby.
+   * @param fd the connection to the shipper of the primary, a stream socket or the read end of a pipe, closed by the
+   * standby
+   * @param disk_manager the disk manager of the standby, which keeps a copy of the shipped log
+   * @param buffer_pool_manager the buffer pool of the standby
+   */
+  LogStandby(int fd, DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager);
+
+  /** Stops applying the log and closes the connection. */
+  ~LogStandby();
+
+  /** Start applying the log streamed by the primary. */
+  void Start();
+
+  /** Stop applying the log, disconnecting from the primary. */
+  void Stop();
+
+  /**
+   * Wait until the standby has applied a record, or was disconnected.
+   * @param lsn the LSN of the record
+   * @param timeout how long to wait at most
+   * @return true if the record was applied
+   */
+  bool WaitForLSN(lsn_t lsn, std::chrono::milliseconds timeout);
+
+  /** @return the LSN of the last record applied, which reads are consistent with */
+  lsn_t GetAppliedLSN() const { return applied_lsn_; }
+
+  /** @return false once the primary disconnected or the stream broke */
+  bool IsConnected() const { return connected_; }
+
+  /**
+   * Read a tuple as of the applied LSN.
+   * @param rid the tuple
+   * @param[out] tuple the tuple, if it exists
+   * @param[out] read_lsn the LSN the read is consistent with, optional
+   * @return true if the tuple exists at that LSN
+   */
+  bool GetTuple(const RID &rid, Tuple *tuple, lsn_t *read_lsn = nullptr);
+
+  /**
+   * Scan a table as of the applied LSN, which does not advance during the scan.
+   * @param first_page_id the first page of the table
+   * @param visitor called for every tuple, which must not call back into the standby
+   * @return the LSN the scan is consistent with
+   */
+  lsn_t ScanTable(page_id_t first_page_id, const std::function<void(const RID &, const Tuple &)> &visitor);
+
+  /** @return the time from a chunk becoming durable on the primary until the standby applied it */
+  const LatencyHistogram &GetApplyLag() const { return apply_lag_; }
+
+  /** @return the number of log bytes applied */
+  uint64_t GetAppliedBytes() const { return applied_bytes_; }
+
+  /** @return the number of log records applied */
+  uint64_t GetAppliedRecords() const { return applied_records_; }
+
+ private:
+  /** The image a tuple had before an uncommitted transaction changed it. */
+  struct BeforeImage {
+    txn_id_t txn_id_;
+    /** False if the tuple did not exist, e.g. because the transaction inserted it. */
+    bool exists_;
+    Tuple tuple_;
+  };
+
+  /** Receive and apply chunks until the connection ends or Stop is called. */
+  void RunApplier();
+
+  /** Read exactly size bytes, @return false if the connection ended or Stop was called first. */
+  bool ReceiveAll(char *data, size_t size);
+
+  /** Apply the records of one chunk, the caller must hold read_latch_ exclusively. */
+  void ApplyChunk(const char *data, int size);
+
+  /** Keep the current image of a tuple before a transaction changes it for the first time. */
+  void SaveBeforeImage(txn_id_t txn_id, const RID &rid);
+
+  /** Read a tuple from a latched page, as of the applied LSN. The caller must hold read_latch_. */
+  bool ReadTuple(TablePage *page, const RID &rid, Tuple *tuple);
+
+  /** Fetch a table page, throwing if the buffer pool has no free frame. */
+  TablePage *FetchTablePage(page_id_t page_id);
+
+  int fd_;
+  /** Stop writes to the second and the applier polls the first along with fd_, which may not be a socket. */
+  int wake_fds_[2];
+  DiskManager *disk_manager_;
+  BufferPoolManager *buffer_pool_manager_;
+  LogRecovery log_recovery_;
+
+  std::thread applier_;
+  /** The chunk received last and the one before, which DiskManager::WriteLog wants to alternate. */
+  std::vector<char> chunks_[2];
+  size_t active_chunk_{0};
+  /** The log offset the next chunk has to start at, -1 before the first chunk. */
+  int64_t next_offset_{-1};
+
+  /** Held exclusively while a chunk is applied, and shared by reads. It lets the applier in first, so a steady stream
+   * of reads can't starve it. */
+  ReaderWriterLatch read_latch_;
+  std::unordered_map<RID, BeforeImage> before_images_;
+  /** The tuples each uncommitted transaction changed. */
+  std::unordered_map<txn_id_t, std::vector<RID>> txn_tuples_;
+
+  std::atomic<lsn_t> applied_lsn_{INVALID_LSN};
+  std::atomic<bool> connected_{true};
+  /** Wakes up the threads in WaitForLSN. */
+  std::mutex applied_latch_;
+  std::condition_variable applied_cv_;
+
+  LatencyHistogram apply_lag_;
+  std::atomic<uint64_t> applied_bytes_{0};
+  std::atomic<uint64_t> applied_records_{0};
+};
+
+}  // namespace bustub
@@ -0,0 +1,101 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// tuple_delta.h
+//
+// Identification: src/include/recovery/tuple_delta.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "storage/table/tuple.h"
+
+namespace bustub {
+
+/**
+ * TupleDelta is the body of an UPDATE_DELTA log record: the byte ranges in which the new image of a tuple differs
+ * from the old one, with both the old and the new bytes of each range, so that it can be applied in either direction.
+ *
+ * Serialized format (all fields 16 bits, since a tuple never exceeds a page):
+ *--------------------------------------------------------------------------------------------------------
+ * | old_size | new_size | num_ranges | (offset, old_length, new_length)[] | old_bytes[] | new_bytes[] |
+ *--------------------------------------------------------------------------------------------------------
+ * Offsets are in the old image; each range replaces old_length bytes there by new_length bytes.
+ */
+class TupleDelta {
+ public:
+  TupleDelta() = default;
+
+  /**
+   * Computes the delta between two images of a tuple. If both have the same size, unchanged bytes split the delta
+   * into ranges wherever a gap is worth a range of its own; otherwise the delta is a single range between the longest
+   * common prefix and suffix.
+   * @param old_tuple the image before the update
+   * @param new_tuple the image after the update
+   */
+  TupleDelta(const Tuple &old_tuple, const Tuple &new_tuple);
+
+  /** @return the size of the serialized delta in bytes */
+  uint32_t GetSerializedSize() const {
+    return 3 * sizeof(uint16_t) + ranges_.size() * sizeof(Range) + old_bytes_.size() + new_bytes_.size();
+  }
+
+  /** @return the number of changed byte ranges */
+  size_t GetNumRanges() const { return ranges_.size(); }
+
+  void SerializeTo(char *storage) const;
+
+  /**
+   * Deserializes a delta.
+   * @param storage the serialized delta
+   * @param size the number of bytes available at storage
+   * @return false if the delta does not fit into size or is inconsistent
+   */
+  bool DeserializeFrom(const char *storage, uint32_t size);
+
+  /**
+   * Applies the delta forwards.
+   * @param old_tuple the image before the update
+   * @param[out] new_tuple the image after the update
+   * @return false if old_tuple is not the image the delta was computed from
+   */
+  bool Redo(const Tuple &old_tuple, Tuple *new_tuple) const;
+
+  /**
+   * Applies the delta backwards.
+   * @param new_tuple the image after the update
+   * @param[out] old_tuple the image before the update
+   * @return false if new_tuple is not the image the delta leads to
+   */
+  bool Undo(const Tuple &new_tuple, Tuple *old_tuple) const;
+
+ private:
+  struct Range {
+    uint16_t offset_;
+    uint16_t old_length_;
+    uint16_t new_length_;
+  };
+  static_assert(sizeof(Range) == 3 * sizeof(uint16_t));
+
+  /**
+   * Rebuilds one image from the other.
+   * @param forward true to build the new image from the old one
+   */
+  bool Apply(const Tuple &src, Tuple *dst, bool forward) const;
+
+  uint16_t old_size_{0};
+  uint16_t new_size_{0};
+  std::vector<Range> ranges_;
+  /** The bytes of all ranges, back to back. */
+  std::vector<char> old_bytes_;
+  std::vector<char> new_bytes_;
+};
+
+}  // namespace bustub
@@ -0,0 +1,140 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compressed_disk_manager.h
+//
+// Identification: src/include/storage/disk/compressed_disk_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>  // NOLINT
+#include <string>
+#include <vector>
+
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * CompressedDiskManager stores every page compressed with PageCodec.
+ *
+ * Compressed pages no longer have a fixed position, so the database is split into two files:
+ *  - the data file (the database file itself), made of extents of whole SECTOR_SIZE sectors, and
+ *  - the page-mapping file (".map"), an array of MapEntry indexed by page id.
+ *
+ * A page is rewritten in place while its compressed image fits into its extent; otherwise it moves to a larger
+ * extent, and the old extent is kept on a free list for reuse. Pages that do not compress below PAGE_SIZE are stored
+ * raw. A page that moves is written and synced before its mapping entry is, and the old extent is only freed once the
+ * entry is synced, so a crash during a move leaves either image reachable. A rewrite in place is not protected against
+ * torn writes, just like a page of the plain DiskManager.
+ */
+class CompressedDiskManager : public DiskManager {
+ public:
+  /** Allocation unit of the data file in bytes. */
+  static constexpr size_t SECTOR_SIZE = 256;
+
+  /** Page-mapping entry describing where the compressed image of a page lives. */
+  struct MapEntry {
+    /** First sector of the extent. */
+    uint32_t sector_;
+    /** Size of the stored image in bytes, 0 if the page was never written, PAGE_SIZE if it is stored raw. */
+    uint16_t length_;
+    /** Size of the extent in sectors. */
+    uint16_t capacity_;
+  };
+
+  /** I/O volume and CPU cost of the compression layer. */
+  struct CompressionStats {
+    /** Bytes handed to WritePage, i.e. pages written * PAGE_SIZE. */
+    uint64_t logical_bytes_written_;
+    /** Bytes of page images written to the data file, without the padding of their extents to whole sectors. */
+    uint64_t physical_bytes_written_;
+    /** Bytes handed back by ReadPage, i.e. pages read * PAGE_SIZE. */
+    uint64_t logical_bytes_read_;
+    /** Bytes actually read from the data file. */
+    uint64_t physical_bytes_read_;
+    /** Time spent compressing pages. */
+    uint64_t compress_ns_;
+    /** Time spent decompressing pages. */
+    uint64_t decompress_ns_;
+  };
+
+  /**
+   * Creates a new compressed disk manager.
+   * @param db_file the database file, which holds the compressed extents
+   */
+  explicit CompressedDiskManager(const std::string &db_file);
+
+  ~CompressedDiskManager() override;
+
+  /**
+   * Shut down the disk manager and close all the file resources.
+   */
+  void ShutDown() override;
+
+  /** @return a snapshot of the compression statistics */
+  CompressionStats GetCompressionStats() const;
+
+  /** @return the number of sectors allocated in the data file */
+  size_t GetAllocatedSectors();
+
+ protected:
+  /**
+   * Compress a page and write it to the data file.
+   * @param page_id id of the page
+   * @param page_data raw page data
+   */
+  void WritePgImp(page_id_t page_id, const char *page_data) override;
+
+  /**
+   * Read a page from the data file and decompress it.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer
+   */
+  void ReadPgImp(page_id_t page_id, char *page_data) override;
+
+  /**
+   * Read consecutive pages, whose images are not contiguous, one by one.
+   * @param first_page_id id of the first page
+   * @param num_pages the number of pages
+   * @param[out] page_data output buffer
+   */
+  void ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data) override;
+
+ private:
+  /**
+   * Find an extent for an image of the given number of sectors, reusing a free extent if possible.
+   * The caller must hold latch_.
+   */
+  uint32_t AllocateExtent(uint16_t sectors);
+
+  std::string map_name_;
+  /** Positional I/O descriptors of the data file and the page-mapping file. */
+  int data_fd_;
+  int map_fd_;
+
+  /** Protects page_map_, free_extents_ and next_sector_. */
+  std::mutex latch_;
+  /** In-memory copy of the page-mapping file. */
+  std::vector<MapEntry> page_map_;
+  /** Free extents by size in sectors. */
+  std::multimap<uint16_t, uint32_t> free_extents_;
+  /** The first sector past the end of the data file. */
+  uint32_t next_sector_{0};
+
+  std::atomic<uint64_t> logical_bytes_written_{0};
+  std::atomic<uint64_t> physical_bytes_written_{0};
+  std::atomic<uint64_t> logical_bytes_read_{0};
+  std::atomic<uint64_t> physical_bytes_read_{0};
+  std::atomic<uint64_t> compress_ns_{0};
+  std::atomic<uint64_t> decompress_ns_{0};
+};
+
+}  // namespace bustub
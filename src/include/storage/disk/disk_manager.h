@@ -13,33 +13,48 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
 #include <fstream>
 #include <future>  // NOLINT
-#include <mutex>   // NOLINT
+#include <map>
+#include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
 #include "common/config.h"
+#include "storage/disk/disk_stats.h"
 
 namespace bustub {
 
 /**
  * DiskManager takes care of the allocation and deallocation of pages within a database. It performs the reading and
  * writing of pages to and from disk, providing a logical file layer within the context of a database management system.
+ *
+ * The log is either a single ever-growing file, or, if log_segment_size is set when the disk manager is created, a
+ * sequence of segment files "<log>.<n>", where segment n holds the log bytes [n * size, (n + 1) * size). Log offsets
+ * stay global, so a segmented log is read and written exactly like a single file, but TruncateLog can drop the
+ * segments a checkpoint has made obsolete. Dropped segments are kept as spares, up to MAX_SPARE_LOG_SEGMENTS, and
+ * recycled for new segments.
  */
 class DiskManager {
  public:
+  /** The number of truncated log segments kept for reuse. */
+  static constexpr size_t MAX_SPARE_LOG_SEGMENTS = 2;
+
   /**
    * Creates a new disk manager that writes to the specified database file.
    * @param db_file the file name of the database file to write to
    */
   explicit DiskManager(const std::string &db_file);
 
-  ~DiskManager() = default;
+  virtual ~DiskManager();
 
   /**
    * Shut down the disk manager and close all the file resources.
    */
-  void ShutDown();
+  virtual void ShutDown();
 
   /**
    * Write a page to the database file.
@@ -55,6 +70,14 @@ class DiskManager {
    */
   void ReadPage(page_id_t page_id, char *page_data);
 
+  /**
+   * Read a run of consecutive pages with a single request.
+   * @param first_page_id id of the first page
+   * @param num_pages the number of pages
+   * @param[out] page_data output buffer of num_pages * PAGE_SIZE bytes
+   */
+  void ReadPages(page_id_t first_page_id, int num_pages, char *page_data);
+
   /**
    * Flush the entire log buffer into disk.
    * @param log_data raw log data
@@ -69,7 +92,64 @@ class DiskManager {
    * @param offset offset of the log entry in the file
    * @return true if the read was successful, false otherwise
    */
-  bool ReadLog(char *log_data, int size, int offset);
+  bool ReadLog(char *log_data, int size, int64_t offset);
+
+  /** @return the size of the log in bytes, i.e. the offset the next log write starts at */
+  virtual int64_t GetLogSize();
+
+  /** @return the offset of the oldest log byte that was not truncated */
+  virtual int64_t GetLogStart();
+
+  /**
+   * Discard the log before an offset, once recovery can no longer need it. Only whole segments are dropped, and never
+   * the last one, so more of the log may be kept than asked; a log kept in a single file is never truncated.
+   * @param offset the offset of the oldest log byte to keep
+   */
+  virtual void TruncateLog(int64_t offset);
+
+  /** @return the number of log segment files, 0 if the log is a single file */
+  size_t GetNumLogSegments();
+
+  /**
+   * Durably replace the master record, a small record kept outside the log that tells recovery where the last
+   * checkpoint is.
+   * @param data raw master record
+   * @param size size of the master record
+   */
+  virtual void WriteMasterRecord(const char *data, int size);
+
+  /**
+   * Read the master record.
+   * @param[out] data output buffer
+   * @param size size of the master record
+   * @return true if the read was successful, false if no master record was written yet
+   */
+  virtual bool ReadMasterRecord(char *data, int size);
+
+  /**
+   * Durably replace the warm-up list, the pages a buffer pool held, to be prefetched after a restart.
+   * @param page_ids the pages, hottest first
+   */
+  virtual void WriteWarmupList(const std::vector<page_id_t> &page_ids);
+
+  /**
+   * Read the warm-up list.
+   * @param[out] page_ids the pages, hottest first
+   * @return true if the read was successful, false if no warm-up list was written yet
+   */
+  virtual bool ReadWarmupList(std::vector<page_id_t> *page_ids);
+
+  /** @return the I/O statistics of this disk manager */
+  DiskStats &GetStats() { return stats_; }
+
+  /**
+   * Start logging the I/O statistics periodically.
+   * @param interval the time between two dumps
+   */
+  void StartStatsDump(std::chrono::milliseconds interval);
+
+  /** Stop logging the I/O statistics. */
+  void StopStatsDump();
 
   /** @return the number of disk flushes */
   int GetNumFlushes() const;
@@ -89,20 +169,103 @@ class DiskManager {
   /** Checks if the non-blocking flush future was set. */
   inline bool HasFlushLogFuture() { return flush_log_f_ != nullptr; }
 
+ protected:
+  /**
+   * Creates a disk manager that is not backed by any file, for subclasses that keep pages and log elsewhere.
+   */
+  DiskManager() = default;
+
+  /**
+   * Write a page to the database file, the actual implementation of WritePage().
+   * @param page_id id of the page
+   * @param page_data raw page data
+   */
+  virtual void WritePgImp(page_id_t page_id, const char *page_data);
+
+  /**
+   * Read a page from the database file, the actual implementation of ReadPage().
+   * @param page_id id of the page
+   * @param[out] page_data output buffer
+   */
+  virtual void ReadPgImp(page_id_t page_id, char *page_data);
+
+  /**
+   * Read consecutive pages from the database file, the actual implementation of ReadPages(). Subclasses that store
+   * pages elsewhere must override it along with ReadPgImp.
+   * @param first_page_id id of the first page
+   * @param num_pages the number of pages
+   * @param[out] page_data output buffer
+   */
+  virtual void ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data);
+
+  /**
+   * Flush the entire log buffer into disk, the actual implementation of WriteLog().
+   * @param log_data raw log data
+   * @param size size of log entry
+   */
+  virtual void WriteLogImp(char *log_data, int size);
+
+  /**
+   * Read a log entry from the log file, the actual implementation of ReadLog().
+   * @param[out] log_data output buffer
+   * @param size size of the log entry
+   * @param offset offset of the log entry in the file
+   * @return true if the read was successful, false otherwise
+   */
+  virtual bool ReadLogImp(char *log_data, int size, int64_t offset);
+
+  static int64_t GetFileSize(const std::string &file_name);
+
+  std::atomic<int> num_writes_{0};
+  int num_flushes_{0};
+
  private:
-  int GetFileSize(const std::string &file_name);
+  /** Find the segments of the log and where it ends. */
+  void OpenLogSegments();
+
+  /** Create segment, from a spare if there is one, and preallocate it. The caller must hold log_segment_latch_. */
+  int CreateLogSegment(int64_t segment);
+
+  /** Append to the segmented log and sync it. */
+  void WriteLogSegments(const char *log_data, int size);
+
+  /** Read from the segmented log, across segment boundaries. */
+  bool ReadLogSegments(char *log_data, int size, int64_t offset);
+
+  std::string SegmentName(int64_t segment) const { return log_name_ + "." + std::to_string(segment); }
+
   // stream to write log file
   std::fstream log_io_;
   std::string log_name_;
+  std::string master_name_;
+  std::string warmup_name_;
+  // descriptor of the log file used to sync it
+  int log_fd_{-1};
+  /** The size of a log segment, 0 if the log is a single file. */
+  int64_t log_segment_size_{0};
+  /** Protects the segmented log state below. */
+  std::mutex log_segment_latch_;
+  /** Descriptors of the log segments by segment number. */
+  std::map<int64_t, int> log_segments_;
+  /** Truncated segment files waiting to be reused. */
+  std::vector<std::string> spare_log_segments_;
+  int64_t log_start_{0};
+  int64_t log_end_{0};
   // stream to write db file
   std::fstream db_io_;
   std::string file_name_;
-  int num_flushes_;
-  int num_writes_;
-  bool flush_log_;
-  std::future<void> *flush_log_f_;
+  bool flush_log_{false};
+  std::future<void> *flush_log_f_{nullptr};
   // With multiple buffer pool instances, need to protect file access
   std::mutex db_io_latch_;
+
+  DiskStats stats_;
+  /** Background thread that logs stats_ every stats_dump_interval_, and what it waits on. */
+  std::thread stats_dump_thread_;
+  std::chrono::milliseconds stats_dump_interval_{0};
+  bool stats_dump_enabled_{false};
+  std::mutex stats_dump_latch_;
+  std::condition_variable stats_dump_cv_;
 };
 
 }  // namespace bustub
@@ -0,0 +1,115 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_stats.h
+//
+// Identification: src/include/storage/disk/disk_stats.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace bustub {
+
+/** The kinds of requests a disk manager serves. */
+enum class DiskOp { PAGE_READ = 0, PAGE_WRITE, LOG_READ, LOG_WRITE };
+
+/**
+ * LatencyHistogram counts samples in power-of-two buckets of microseconds: bucket 0 holds samples below 1us and
+ * bucket i holds samples in [2^(i-1), 2^i) us. Recording is lock-free, so it can sit on the I/O path.
+ */
+class LatencyHistogram {
+ public:
+  static constexpr size_t NUM_BUCKETS = 32;
+
+  /**
+   * Record one sample.
+   * @param latency_ns the latency in nanoseconds
+   */
+  void Record(uint64_t latency_ns);
+
+  /** @return the number of recorded samples */
+  uint64_t GetCount() const;
+
+  /** @return the number of samples in the given bucket */
+  uint64_t GetBucketCount(size_t bucket) const { return buckets_[bucket].load(); }
+
+  /** @return the exclusive upper bound of the given bucket in microseconds */
+  static uint64_t GetBucketBound(size_t bucket) { return 1ULL << bucket; }
+
+  /**
+   * @param percentile a value in (0, 100]
+   * @return the upper bound in microseconds of the bucket holding the given percentile, 0 if there are no samples
+   */
+  uint64_t GetPercentile(double percentile) const;
+
+  /** @return the average latency in microseconds */
+  double GetMean() const;
+
+  void Reset();
+
+ private:
+  std::array<std::atomic<uint64_t>, NUM_BUCKETS> buckets_{};
+  std::atomic<uint64_t> total_ns_{0};
+};
+
+/**
+ * DiskStats accumulates per-operation counts, bytes, latencies and access patterns of a disk manager.
+ *
+ * A page request is sequential if it targets the page after the previous request of the same kind, and a log request
+ * is sequential if it starts where the previous one ended. Everything else counts as random, which on a spinning disk
+ * or a throttled cloud volume usually means an extra seek.
+ */
+class DiskStats {
+ public:
+  /**
+   * Record a completed request.
+   * @param op the kind of request
+   * @param position the page id for page requests, the byte offset for log requests
+   * @param bytes the size of the request
+   * @param latency_ns the time the request took
+   */
+  void Record(DiskOp op, int64_t position, size_t bytes, uint64_t latency_ns);
+
+  /** @return the number of requests of the given kind */
+  uint64_t GetCount(DiskOp op) const { return Get(op).count_.load(); }
+
+  /** @return the number of bytes moved by requests of the given kind */
+  uint64_t GetBytes(DiskOp op) const { return Get(op).bytes_.load(); }
+
+  /** @return the number of sequential requests of the given kind */
+  uint64_t GetSequentialCount(DiskOp op) const { return Get(op).sequential_.load(); }
+
+  /** @return the latency histogram of the given kind of request */
+  const LatencyHistogram &GetLatency(DiskOp op) const { return Get(op).latency_; }
+
+  /** Clear all the statistics. */
+  void Reset();
+
+  /** @return a human-readable, multi-line summary */
+  std::string ToString() const;
+
+ private:
+  struct OpStats {
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> sequential_{0};
+    /** The position at which the next request would be sequential. */
+    std::atomic<int64_t> next_position_{-1};
+    LatencyHistogram latency_;
+  };
+
+  const OpStats &Get(DiskOp op) const { return ops_[static_cast<size_t>(op)]; }
+
+  std::array<OpStats, 4> ops_;
+};
+
+}  // namespace bustub
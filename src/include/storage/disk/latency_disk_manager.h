@@ -0,0 +1,175 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// latency_disk_manager.h
+//
+// Identification: src/include/storage/disk/latency_disk_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <mutex>   // NOLINT
+#include <vector>
+
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * I/O characteristics of an emulated device.
+ */
+struct DiskProfile {
+  /** Time from the end of the transfer of a page read until it completes. */
+  std::chrono::microseconds read_latency_{0};
+  /** Time from the end of the transfer of a page write until it completes. */
+  std::chrono::microseconds write_latency_{0};
+  /** Time from the end of the transfer of a log flush until it is durable. */
+  std::chrono::microseconds log_latency_{0};
+  /** Transfer rate of the device in bytes per second, 0 for unlimited. */
+  uint64_t bandwidth_{0};
+
+  /** @return a profile resembling a spinning disk: seek-dominated, ~150MB/s */
+  static DiskProfile Hdd() {
+    return DiskProfile{std::chrono::microseconds(5000), std::chrono::microseconds(5000), std::chrono::microseconds(5000),
+                       150ULL << 20};
+  }
+
+  /** @return a profile resembling a SATA flash drive: ~100us per access, ~500MB/s */
+  static DiskProfile Ssd() {
+    return DiskProfile{std::chrono::microseconds(100), std::chrono::microseconds(50), std::chrono::microseconds(200),
+                       500ULL << 20};
+  }
+};
+
+/**
+ * LatencyDiskManager wraps another disk manager and delays every request as if it were served by a device with the
+ * given DiskProfile.
+ *
+ * Transfers are serialized on a single device timeline, so the bandwidth limit holds no matter how many threads issue
+ * requests, while the access latencies of concurrent requests overlap as they would on a device with a deep queue.
+ * Pairing it with MemoryDiskManager makes benchmark results independent of the machine's own storage.
+ */
+class LatencyDiskManager : public DiskManager {
+ public:
+  /**
+   * Creates a new latency-injecting disk manager.
+   * @param disk_manager the disk manager that actually stores the data, not owned
+   * @param profile the characteristics of the emulated device
+   */
+  LatencyDiskManager(DiskManager *disk_manager, const DiskProfile &profile);
+
+  ~LatencyDiskManager() override = default;
+
+  /**
+   * Shut down the underlying disk manager.
+   */
+  void ShutDown() override;
+
+  /** @return the log size of the underlying disk manager */
+  int64_t GetLogSize() override;
+
+  /** @return the log start of the underlying disk manager */
+  int64_t GetLogStart() override;
+
+  /**
+   * Truncate the log of the underlying disk manager, which only touches file metadata and is not charged.
+   * @param offset the offset of the oldest log byte to keep
+   */
+  void TruncateLog(int64_t offset) override;
+
+  /**
+   * Write the master record through the underlying disk manager, then wait for it to be durable like a log flush.
+   * @param data raw master record
+   * @param size size of the master record
+   */
+  void WriteMasterRecord(const char *data, int size) override;
+
+  /**
+   * Read the master record through the underlying disk manager, charged like a page read.
+   * @param[out] data output buffer
+   * @param size size of the master record
+   * @return true if the read was successful, false if no master record was written yet
+   */
+  bool ReadMasterRecord(char *data, int size) override;
+
+  /**
+   * Write the warm-up list through the underlying disk manager, then wait for it to be durable like a log flush.
+   * @param page_ids the pages, hottest first
+   */
+  void WriteWarmupList(const std::vector<page_id_t> &page_ids) override;
+
+  /**
+   * Read the warm-up list through the underlying disk manager, charged like a page read.
+   * @param[out] page_ids the pages, hottest first
+   * @return true if the read was successful, false if no warm-up list was written yet
+   */
+  bool ReadWarmupList(std::vector<page_id_t> *page_ids) override;
+
+  /** @return the total time requests spent waiting on the emulated device */
+  std::chrono::nanoseconds GetInjectedDelay() const { return std::chrono::nanoseconds(injected_ns_.load()); }
+
+ protected:
+  /**
+   * Write a page through the underlying disk manager, then wait for the emulated write to complete.
+   * @param page_id id of the page
+   * @param page_data raw page data
+   */
+  void WritePgImp(page_id_t page_id, const char *page_data) override;
+
+  /**
+   * Wait for the emulated read to complete, then read the page through the underlying disk manager.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer
+   */
+  void ReadPgImp(page_id_t page_id, char *page_data) override;
+
+  /**
+   * Wait for one emulated read of all the pages to complete, then read them through the underlying disk manager.
+   * @param first_page_id id of the first page
+   * @param num_pages the number of pages
+   * @param[out] page_data output buffer
+   */
+  void ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data) override;
+
+  /**
+   * Flush the log buffer through the underlying disk manager, then wait for the emulated flush to complete.
+   * @param log_data raw log data
+   * @param size size of log entry
+   */
+  void WriteLogImp(char *log_data, int size) override;
+
+  /**
+   * Read a log entry through the underlying disk manager, charged like a page read.
+   * @param[out] log_data output buffer
+   * @param size size of the log entry
+   * @param offset offset of the log entry in the file
+   * @return true if the read was successful, false otherwise
+   */
+  bool ReadLogImp(char *log_data, int size, int64_t offset) override;
+
+ private:
+  /**
+   * Reserve the device for a transfer of the given size and sleep until the request completes.
+   * @param bytes size of the transfer
+   * @param latency access latency of the request
+   */
+  void Delay(size_t bytes, std::chrono::microseconds latency);
+
+  DiskManager *disk_manager_;
+  DiskProfile profile_;
+
+  /** Protects device_free_. */
+  std::mutex device_latch_;
+  /** The point at which the emulated device finishes its queued transfers. */
+  std::chrono::steady_clock::time_point device_free_;
+
+  std::atomic<uint64_t> injected_ns_{0};
+};
+
+}  // namespace bustub
@@ -0,0 +1,100 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// memory_disk_manager.h
+//
+// Identification: src/include/storage/disk/memory_disk_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <mutex>         // NOLINT
+#include <shared_mutex>  // NOLINT
+#include <vector>
+
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * MemoryDiskManager keeps the pages and the log in memory instead of files. Its contents disappear with the object,
+ * which makes it a deterministic, filesystem-independent backing store for tests and benchmarks.
+ */
+class MemoryDiskManager : public DiskManager {
+ public:
+  MemoryDiskManager() = default;
+
+  ~MemoryDiskManager() override = default;
+
+  /**
+   * Nothing to close; the contents stay readable until the disk manager is destroyed.
+   */
+  void ShutDown() override {}
+
+  int64_t GetLogSize() override;
+  void WriteMasterRecord(const char *data, int size) override;
+  bool ReadMasterRecord(char *data, int size) override;
+  void WriteWarmupList(const std::vector<page_id_t> &page_ids) override;
+  bool ReadWarmupList(std::vector<page_id_t> *page_ids) override;
+
+ protected:
+  /**
+   * Write a page to memory.
+   * @param page_id id of the page
+   * @param page_data raw page data
+   */
+  void WritePgImp(page_id_t page_id, const char *page_data) override;
+
+  /**
+   * Read a page from memory. Pages that were never written read as zeroes.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer
+   */
+  void ReadPgImp(page_id_t page_id, char *page_data) override;
+
+  /**
+   * Read consecutive pages from memory.
+   * @param first_page_id id of the first page
+   * @param num_pages the number of pages
+   * @param[out] page_data output buffer
+   */
+  void ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data) override;
+
+  /**
+   * Append the log buffer to the in-memory log.
+   * @param log_data raw log data
+   * @param size size of log entry
+   */
+  void WriteLogImp(char *log_data, int size) override;
+
+  /**
+   * Read a log entry from the in-memory log.
+   * @param[out] log_data output buffer
+   * @param size size of the log entry
+   * @param offset offset of the log entry in the log
+   * @return true if the read was successful, false otherwise
+   */
+  bool ReadLogImp(char *log_data, int size, int64_t offset) override;
+
+ private:
+  using PageFrame = std::array<char, PAGE_SIZE>;
+
+  /** Protects the page table; page contents are copied under it as well. */
+  std::shared_mutex pages_latch_;
+  std::vector<std::unique_ptr<PageFrame>> pages_;
+
+  /** Protects the log, the master record and the warm-up list. */
+  std::mutex log_latch_;
+  std::vector<char> log_;
+  std::vector<char> master_record_;
+  std::vector<page_id_t> warmup_list_;
+  bool has_warmup_list_{false};
+};
+
+}  // namespace bustub
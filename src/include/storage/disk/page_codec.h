@@ -0,0 +1,63 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_codec.h
+//
+// Identification: src/include/storage/disk/page_codec.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <cstddef>
+
+namespace bustub {
+
+/**
+ * PageCodec is a small dependency-free LZ77 compressor for page images.
+ *
+ * The compressed stream is a sequence of blocks, each encoding a run of literals followed by a back-reference:
+ *  -----------------------------------------------------------------------------------
+ *  | token (1) | [literal length ext] | literals | offset (2) | [match length ext] |
+ *  -----------------------------------------------------------------------------------
+ * The high nibble of the token is the literal length and the low nibble is the match length minus MIN_MATCH. A
+ * nibble value of 15 means that the length continues in the following extension bytes, each adding up to 255. The
+ * last block only carries literals. Slotted pages are mostly a long run of zeroes between the header and the tuple
+ * area, which compresses to a handful of bytes.
+ */
+class PageCodec {
+ public:
+  /** Shortest back-reference the encoder emits. */
+  static constexpr size_t MIN_MATCH = 4;
+
+  /**
+   * @param src_size the size of the input
+   * @return an upper bound of the compressed size of an input of src_size bytes
+   */
+  static constexpr size_t MaxCompressedSize(size_t src_size) { return src_size + src_size / 255 + 16; }
+
+  /**
+   * Compress a buffer.
+   * @param src the input
+   * @param src_size the size of the input, at most 64KB
+   * @param[out] dst the output buffer
+   * @param dst_capacity the size of the output buffer
+   * @return the compressed size, or 0 if the output does not fit into dst_capacity
+   */
+  static size_t Compress(const char *src, size_t src_size, char *dst, size_t dst_capacity);
+
+  /**
+   * Decompress a buffer.
+   * @param src the compressed input
+   * @param src_size the size of the compressed input
+   * @param[out] dst the output buffer
+   * @param dst_capacity the size of the output buffer
+   * @return the decompressed size, or 0 if the input is corrupted or does not fit into dst_capacity
+   */
+  static size_t Decompress(const char *src, size_t src_size, char *dst, size_t dst_capacity);
+};
+
+}  // namespace bustub
@@ -0,0 +1,106 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// striped_disk_manager.h
+//
+// Identification: src/include/storage/disk/striped_disk_manager.h
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "storage/disk/disk_manager.h"
+
+namespace bustub {
+
+/**
+ * StripedDiskManager spreads the pages of a database over several files, typically one per local volume.
+ *
+ * Pages are grouped into stripe units of stripe_pages consecutive page ids, and stripe units are assigned to the
+ * files round-robin. For stripe_pages = 2 and three files, the layout is:
+ *
+ *   file 0: | 0 1 | 6 7 | ...
+ *   file 1: | 2 3 | 8 9 | ...
+ *   file 2: | 4 5 | 10 11 | ...
+ *
+ * page_id_t values are unchanged, so callers do not need to know that the database is striped. Every stripe file is
+ * accessed with positional I/O (pread/pwrite), so reads and writes that land on different files -- or even on the
+ * same file -- proceed in parallel without a shared latch. The log is still written through the base DiskManager.
+ */
+class StripedDiskManager : public DiskManager {
+ public:
+  /** Default number of consecutive pages that are stored together in one stripe file. */
+  static constexpr uint32_t DEFAULT_STRIPE_PAGES = 16;
+
+  /**
+   * Creates a new striped disk manager.
+   * @param db_file the database file name, used for the log file and to name the stripe files
+   * @param stripe_dirs the directories to stripe pages across, one stripe file is created per entry
+   * @param stripe_pages the number of consecutive pages per stripe unit
+   */
+  StripedDiskManager(const std::string &db_file, const std::vector<std::string> &stripe_dirs,
+                     uint32_t stripe_pages = DEFAULT_STRIPE_PAGES);
+
+  ~StripedDiskManager() override;
+
+  /**
+   * Shut down the disk manager and close all the stripe files.
+   */
+  void ShutDown() override;
+
+  /** @return the number of stripe files */
+  size_t GetNumStripeFiles() const { return stripe_fds_.size(); }
+
+  /** @return the name of the stripe file at the given index */
+  const std::string &GetStripeFileName(size_t index) const { return stripe_names_[index]; }
+
+  /**
+   * Locate a page within the stripe set.
+   * @param page_id id of the page
+   * @return the index of the stripe file holding the page and the byte offset of the page inside that file
+   */
+  std::pair<size_t, size_t> Locate(page_id_t page_id) const;
+
+  /** Read a byte range of a stripe file, zero-filling whatever lies past its end. */
+  void ReadRange(size_t file_index, size_t offset, char *data, size_t size);
+
+ protected:
+  /**
+   * Write a page to the stripe file that owns it.
+   * @param page_id id of the page
+   * @param page_data raw page data
+   */
+  void WritePgImp(page_id_t page_id, const char *page_data) override;
+
+  /**
+   * Read a page from the stripe file that owns it.
+   * @param page_id id of the page
+   * @param[out] page_data output buffer
+   */
+  void ReadPgImp(page_id_t page_id, char *page_data) override;
+
+  /**
+   * Read consecutive pages, one stripe unit at a time.
+   * @param first_page_id id of the first page
+   * @param num_pages the number of pages
+   * @param[out] page_data output buffer
+   */
+  void ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data) override;
+
+ private:
+  /** Number of consecutive pages per stripe unit. */
+  const uint32_t stripe_pages_;
+  /** File names of the stripe files. */
+  std::vector<std::string> stripe_names_;
+  /** Open file descriptors of the stripe files, -1 once closed. */
+  std::vector<int> stripe_fds_;
+};
+
+}  // namespace bustub
@@ -12,6 +12,7 @@
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
@@ -20,6 +21,8 @@
 
 namespace bustub {
 
+class PrivateLogBuffer;
+
 /**
  * Page is the basic unit of storage within the database system. Page provides a wrapper for actual data pages being
  * held in main memory. Page also contains book-keeping information that is used by the buffer pool manager, e.g.
@@ -28,6 +31,7 @@ namespace bustub {
 class Page {
   // There is book-keeping information inside the page that should only be relevant to the buffer pool manager.
   friend class BufferPoolManagerInstance;
+  friend class LogManager;
 
  public:
   /** Constructor. Zeros out the page data. */
@@ -66,6 +70,15 @@ class Page {
   /** Sets the page LSN. */
   inline void SetLSN(lsn_t lsn) { memcpy(GetData() + OFFSET_LSN, &lsn, sizeof(lsn_t)); }
 
+  /** Raise the page LSN to at least lsn, which is safe without the page latch. */
+  inline void RaiseLSN(lsn_t lsn) {
+    auto *page_lsn = reinterpret_cast<lsn_t *>(GetData() + OFFSET_LSN);
+    lsn_t current = __atomic_load_n(page_lsn, __ATOMIC_RELAXED);
+    while (current < lsn &&
+           !__atomic_compare_exchange_n(page_lsn, &current, lsn, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+  }
+
  protected:
   static_assert(sizeof(page_id_t) == 4);
   static_assert(sizeof(lsn_t) == 4);
@@ -86,6 +99,10 @@ class Page {
   int pin_count_ = 0;
   /** True if the page is dirty, i.e. it is different from its corresponding page on disk. */
   bool is_dirty_ = false;
+  /** The LSN of the first log record that may have changed the page since it was last written back. */
+  lsn_t rec_lsn_ = INVALID_LSN;
+  /** The private log buffer holding records that changed the page but have no LSN yet, if any. */
+  std::atomic<PrivateLogBuffer *> log_owner_{nullptr};
   /** Page latch. */
   ReaderWriterLatch rwlatch_;
 };
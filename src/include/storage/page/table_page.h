@@ -79,9 +79,11 @@ class TablePage : public Page {
    * @param txn transaction performing the insert
    * @param lock_manager the lock manager
    * @param log_manager the log manager
+   * @param oid the table of the page, an exclusive lock on which covers the tuple, INVALID_TABLE_OID if unknown
    * @return true if the insert is successful (i.e. there is enough space)
    */
-  bool InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager);
+  bool InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager,
+                   table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Mark a tuple as deleted. This does not actually delete the tuple.
@@ -89,9 +91,11 @@ class TablePage : public Page {
    * @param txn transaction performing the delete
    * @param lock_manager the lock manager
    * @param log_manager the log manager
+   * @param oid the table of the page, an exclusive lock on which covers the tuple, INVALID_TABLE_OID if unknown
    * @return true if marking the tuple as deleted is successful (i.e the tuple exists)
    */
-  bool MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager);
+  bool MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager,
+                  table_oid_t oid = INVALID_TABLE_OID);
 
   /**
    * Update a tuple.
@@ -101,26 +105,41 @@ class TablePage : public Page {
    * @param txn transaction performing the update
    * @param lock_manager the lock manager
    * @param log_manager the log manager
+   * @param oid the table of the page, an exclusive lock on which covers the tuple, INVALID_TABLE_OID if unknown
    * @return true if updating the tuple succeeded
    */
   bool UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID &rid, Transaction *txn,
-                   LockManager *lock_manager, LogManager *log_manager);
+                   LockManager *lock_manager, LogManager *log_manager, table_oid_t oid = INVALID_TABLE_OID);
 
-  /** To be called on commit or abort. Actually perform the delete or rollback an insert. */
-  void ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
+  /**
+   * To be called on commit or abort. Actually perform the delete or rollback an insert. The transaction must hold an
+   * exclusive lock on the tuple, or on the table oid.
+   */
+  void ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager, table_oid_t oid = INVALID_TABLE_OID);
 
-  /** To be called on abort. Rollback a delete, i.e. this reverses a MarkDelete. */
-  void RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager);
+  /** To be called on abort. Rollback a delete, i.e. this reverses a MarkDelete. Needs the locks ApplyDelete does. */
+  void RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager, table_oid_t oid = INVALID_TABLE_OID);
+
+  /**
+   * Put a tuple back into a given slot, without logging. Recovery uses this to replay an insert and to undo a delete,
+   * which must both land in the slot that was logged rather than in the first free one.
+   * @param tuple tuple to insert
+   * @param rid rid of the tuple, whose slot must be free or past the last slot
+   * @return true if the insert is successful (i.e. the slot is free and there is enough space)
+   */
+  bool InsertTupleAt(const Tuple &tuple, const RID &rid);
 
   /**
    * Read a tuple from a table.
    * @param rid rid of the tuple to read
    * @param[out] tuple the tuple that was read
    * @param txn transaction performing the read
-   * @param lock_manager the lock manager
+   * @param lock_manager the lock manager, nullptr to read without locking
+   * @param oid the table of the page, a shared lock on which covers the tuple, INVALID_TABLE_OID if unknown
    * @return true if the read is successful (i.e. the tuple exists)
    */
-  bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager);
+  bool GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager,
+                table_oid_t oid = INVALID_TABLE_OID);
 
   /** @return the rid of the first tuple in this page */
 
@@ -138,6 +157,10 @@ class TablePage : public Page {
   bool GetNextTupleRid(const RID &cur_rid, RID *next_rid);
 
  private:
+  /** A standby and snapshot scans also read the deleted slots, whose tuples may still be visible. */
+  friend class LogStandby;
+  friend class TableIterator;
+
   static_assert(sizeof(page_id_t) == 4);
 
   static constexpr size_t SIZE_TABLE_PAGE_HEADER = 24;
@@ -12,6 +12,12 @@
 
 #pragma once
 
+#include <array>
+#include <deque>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
 #include "buffer/buffer_pool_manager.h"
 #include "recovery/log_manager.h"
 #include "storage/page/table_page.h"
@@ -23,6 +29,19 @@ namespace bustub {
 /**
  * TableHeap represents a physical table on disk.
  * This is just a doubly-linked list of pages.
+ *
+ * The pages always hold the newest version of every tuple, committed or not. For the tuples that SNAPSHOT_ISOLATION
+ * transactions wrote, the heap also keeps a version chain in memory: the transaction writing the page version if it
+ * has not committed yet, the commit timestamp of the page version otherwise, and the older versions, newest first,
+ * each with the commit timestamp it became visible at. A snapshot read walks the chain to the newest version committed
+ * at or before its read timestamp, without taking any locks. The TransactionManager commits, drops and garbage
+ * collects the versions.
+ *
+ * For OPTIMISTIC transactions the heap keeps a version stamp of every tuple they wrote, which their commits bump, and
+ * records the stamp of every tuple they read. Their updates and deletes are held back in the transaction until its
+ * commit has locked the stamps of the tuples to write and validated the stamps it read. The tuples they insert go to
+ * the pages right away, but with their stamps locked until the inserting transaction finishes. Stamps are kept for
+ * the life of the heap, so that a tuple changing and changing back is still noticed.
  */
 class TableHeap {
   friend class TableIterator;
@@ -90,6 +109,19 @@ class TableHeap {
    */
   void RollbackDelete(const RID &rid, Transaction *txn);
 
+  /**
+   * Called on Commit/Abort to finish the writes of a transaction to this table page by page: every page is fetched and
+   * latched once for all its records. On commit the deletes are applied like ApplyDelete does, on abort the records
+   * are undone, inserts with ApplyDelete, deletes with RollbackDelete and updates by writing the old tuple back.
+   * @param first the first write record, the records have to be sorted by page and, on abort, be newest first within
+   * a page
+   * @param last the end of the write records
+   * @param txn the committed or aborted transaction
+   * @param is_commit true to apply the deletes, false to undo all the records
+   */
+  void FinishWrites(std::vector<const TableWriteRecord *>::const_iterator first,
+                    std::vector<const TableWriteRecord *>::const_iterator last, Transaction *txn, bool is_commit);
+
   /**
    * Read a tuple from the table.
    * @param rid rid of the tuple to read
@@ -108,11 +140,126 @@ class TableHeap {
   /** @return the id of the first page of this table */
   inline page_id_t GetFirstPageId() const { return first_page_id_; }
 
+  /**
+   * Set the oid of this table in its catalog, so that the table lock an escalation took covers the rows on its pages.
+   * @param oid the oid of the table
+   */
+  inline void SetTableOid(table_oid_t oid) { oid_ = oid; }
+
+  /**
+   * Make the version a snapshot transaction wrote the committed page version. Called on commit, before ApplyDelete.
+   * @param rid the tuple the transaction wrote
+   * @param txn the committing transaction
+   * @param commit_ts the commit timestamp of the transaction
+   */
+  void CommitVersion(const RID &rid, Transaction *txn, timestamp_t commit_ts);
+
+  /**
+   * Drop the version a snapshot transaction wrote. Called on abort, once all of its writes are rolled back.
+   * @param rid the tuple the transaction wrote
+   * @param txn the aborting transaction
+   */
+  void AbortVersion(const RID &rid, Transaction *txn);
+
+  /**
+   * Drop the old versions of a tuple that no snapshot can read any more, and the whole chain once the page version is
+   * visible to every snapshot.
+   * @param rid the tuple
+   * @param watermark the oldest read timestamp of any running snapshot transaction, or of any future one
+   */
+  void CollectVersions(const RID &rid, timestamp_t watermark);
+
+  /** @return the number of tuples with a version chain */
+  size_t GetNumVersionedTuples();
+
+  /**
+   * Lock the stamp of a tuple for an optimistic transaction, which is about to write it.
+   * @return false if another transaction holds the stamp
+   */
+  bool LockStamp(const RID &rid, Transaction *txn);
+
+  /**
+   * Unlock the stamp of a tuple, if an optimistic transaction holds it.
+   * @param changed whether the transaction changed the tuple, which bumps its version
+   */
+  void UnlockStamp(const RID &rid, Transaction *txn, bool changed);
+
+  /**
+   * Validate a read of an optimistic transaction, whose stamps of the tuples to write must be locked.
+   * @param rid the tuple read
+   * @param txn the validating transaction
+   * @param stamp the stamp the tuple had when it was read
+   * @return true if the tuple has not changed since, and no other transaction is about to change it
+   */
+  bool ValidateStamp(const RID &rid, Transaction *txn, const TupleStamp &stamp);
+
  private:
+  /** A version of a tuple older than the one on its page. */
+  struct UndoVersion {
+    /** The transaction whose write replaced this version. */
+    txn_id_t replaced_by_;
+    /** The commit timestamp this version became visible at. */
+    timestamp_t ts_;
+    /** False if the tuple did not exist, i.e. before it was inserted or after it was deleted. */
+    bool exists_;
+    Tuple tuple_;
+  };
+
+  struct VersionChain {
+    /** The snapshot transaction that wrote the page version and has not committed yet, if any. */
+    txn_id_t writer_{INVALID_TXN_ID};
+    /** The commit timestamp of the page version once it is committed. */
+    timestamp_t ts_{0};
+    std::deque<UndoVersion> undo_;
+  };
+
+  /** log2 of the number of version chain shards. */
+  static constexpr size_t VERSION_SHARD_BITS = 4;
+
+  /** A part of the version chains and stamps, on its own cache line like the shards of the lock table. */
+  struct alignas(64) VersionShard {
+    std::mutex latch_;
+    std::unordered_map<RID, VersionChain> chains_;
+    std::unordered_map<RID, TupleStamp> stamps_;
+  };
+
+  /** @return the shard holding the version chain and stamp of a tuple */
+  VersionShard &GetVersionShard(const RID &rid);
+
+  /**
+   * Check whether a snapshot transaction may write a tuple: not if another transaction wrote it and has not committed
+   * yet, nor if a transaction committed a write to it after the snapshot was taken. The caller holds the page latch.
+   * @return true if the write may go ahead
+   */
+  bool CanWriteVersion(const RID &rid, Transaction *txn);
+
+  /**
+   * Keep the version of a tuple a snapshot transaction is replacing, on its first write to the tuple. The caller holds
+   * the page latch from before the write until after this call, so reads see the chain and the page change together.
+   * @param rid the tuple
+   * @param txn the writing transaction
+   * @param exists false if the tuple did not exist before, i.e. for an insert
+   * @param tuple the replaced version
+   */
+  void SaveVersion(const RID &rid, Transaction *txn, bool exists, const Tuple &tuple);
+
+  /** Read the version of a tuple a snapshot transaction sees. The caller holds the page latch. */
+  bool GetVisibleTuple(TablePage *page, const RID &rid, Tuple *tuple, Transaction *txn);
+
+  /**
+   * Read a tuple from its page for an optimistic transaction and record the read. The caller holds the page latch, so
+   * the tuple and its stamp are read together.
+   */
+  bool GetTupleAndStamp(TablePage *page, const RID &rid, Tuple *tuple, Transaction *txn);
+
   BufferPoolManager *buffer_pool_manager_;
   LockManager *lock_manager_;
   LogManager *log_manager_;
   page_id_t first_page_id_{};
+  /** The oid of this table, or INVALID_TABLE_OID if it is not in a catalog. */
+  table_oid_t oid_{INVALID_TABLE_OID};
+
+  std::array<VersionShard, 1 << VERSION_SHARD_BITS> version_shards_;
 };
 
 }  // namespace bustub
@@ -27,6 +27,7 @@ class TableHeap;
  */
 class TableIterator {
   friend class Cursor;
+  friend class TableHeap;
 
  public:
   TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
@@ -56,6 +57,14 @@ class TableIterator {
   }
 
  private:
+  /**
+   * Move to the first tuple at or after a slot that a snapshot or optimistic transaction sees, or to the end. Unlike
+   * the tuples other transactions see, these may be deleted on the page, or deleted only by the transaction itself, so
+   * every slot is looked at.
+   * @param rid the slot to start at
+   */
+  void SeekVisible(RID rid);
+
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
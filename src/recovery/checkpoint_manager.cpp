@@ -12,16 +12,92 @@
 
 #include "recovery/checkpoint_manager.h"
 
+#include <algorithm>
+#include <utility>
+
+#include "common/exception.h"
+
 namespace bustub {
 
 void CheckpointManager::BeginCheckpoint() {
   // Block all the transactions and ensure that both the WAL and all dirty buffer pool pages are persisted to disk,
   // creating a consistent checkpoint. Do NOT allow transactions to resume at the end of this method, resume them
   // in CheckpointManager::EndCheckpoint() instead. This is for grading purposes.
+  transaction_manager_->BlockAllTransactions();
+  buffer_pool_manager_->FlushAllPages();
+  if (warmup_ != nullptr) {
+    warmup_->SaveResidentPages();
+  }
+  if (!enable_logging || log_manager_ == nullptr) {
+    return;
+  }
+  // Nothing is running and nothing is dirty, so the checkpoint needs neither table.
+  LogRecord begin_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::CHECKPOINT_BEGIN);
+  lsn_t begin_lsn = log_manager_->AppendLogRecord(&begin_record);
+  CompleteCheckpoint(begin_lsn, {}, {});
 }
 
 void CheckpointManager::EndCheckpoint() {
   // Allow transactions to resume, completing the checkpoint.
+  transaction_manager_->ResumeTransactions();
+}
+
+lsn_t CheckpointManager::FuzzyCheckpoint() {
+  if (!enable_logging || log_manager_ == nullptr) {
+    throw Exception("fuzzy checkpoints need logging enabled");
+  }
+  LogRecord begin_record(INVALID_TXN_ID, INVALID_LSN, LogRecordType::CHECKPOINT_BEGIN);
+  std::vector<ActiveTxnEntry> active_txns;
+  lsn_t begin_lsn = transaction_manager_->AppendLogRecordWithActiveTxns(&begin_record, &active_txns);
+  // Every page dirtied before begin_lsn is either written back by now or still in the buffer pool.
+  CompleteCheckpoint(begin_lsn, std::move(active_txns), buffer_pool_manager_->GetDirtyPageTable());
+  if (warmup_ != nullptr) {
+    warmup_->SaveResidentPages();
+  }
+  return begin_lsn;
+}
+
+void CheckpointManager::CompleteCheckpoint(lsn_t begin_lsn, std::vector<ActiveTxnEntry> active_txns,
+                                           std::vector<DirtyPageEntry> dirty_pages) {
+  // Recovery has to read back to the oldest change that may be missing from the disk, and to the BEGIN record of
+  // every transaction it may have to undo.
+  lsn_t scan_lsn = begin_lsn;
+  for (const auto &txn : active_txns) {
+    scan_lsn = std::min(scan_lsn, txn.first_lsn_);
+  }
+  for (const auto &page : dirty_pages) {
+    scan_lsn = std::min(scan_lsn, page.rec_lsn_);
+  }
+
+  // A record has to fit into a log buffer.
+  size_t max_size = log_manager_->GetBufferSize();
+  size_t entry_size = std::max(sizeof(ActiveTxnEntry), sizeof(DirtyPageEntry));
+  if (max_size < LogRecord::CheckpointEndSize(0, 0) + entry_size) {
+    throw Exception("the log buffer is too small for a checkpoint");
+  }
+  size_t max_entries = (max_size - LogRecord::CheckpointEndSize(0, 0)) / entry_size;
+  // Split the tables across as many CHECKPOINT_END records as they need, recovery merges them.
+  size_t next_txn = 0;
+  size_t next_page = 0;
+  lsn_t end_lsn;
+  do {
+    size_t num_txns = std::min(active_txns.size() - next_txn, max_entries);
+    size_t num_pages = std::min(dirty_pages.size() - next_page, max_entries - num_txns);
+    std::vector<ActiveTxnEntry> txns(active_txns.begin() + next_txn, active_txns.begin() + next_txn + num_txns);
+    std::vector<DirtyPageEntry> pages(dirty_pages.begin() + next_page,
+                                      dirty_pages.begin() + next_page + num_pages);
+    next_txn += num_txns;
+    next_page += num_pages;
+    bool is_last = next_txn == active_txns.size() && next_page == dirty_pages.size();
+    LogRecord end_record(begin_lsn, std::move(txns), std::move(pages), is_last);
+    end_lsn = log_manager_->AppendLogRecord(&end_record);
+  } while (next_txn < active_txns.size() || next_page < dirty_pages.size());
+  log_manager_->Flush(end_lsn);
+  int64_t scan_offset = log_manager_->GetLogOffset(scan_lsn);
+  log_manager_->WriteMasterRecord(
+      MasterRecord{begin_lsn, scan_lsn, log_manager_->GetLogOffset(begin_lsn), scan_offset});
+  // Once the master record points past it, recovery never reads the log before the scan offset again.
+  log_manager_->TruncateLog(scan_offset);
 }
 
 }  // namespace bustub
@@ -12,7 +12,49 @@
 
 #include "recovery/log_manager.h"
 
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "common/exception.h"
+#include "concurrency/transaction.h"
+#include "recovery/log_shipper.h"
+#include "storage/page/page.h"
+
 namespace bustub {
+
+namespace {
+
+/** Offsets of the header fields of a serialized record, | size | LSN | transID | prevLSN | LogType |. */
+constexpr int OFFSET_SIZE = 0;
+constexpr int OFFSET_LSN = 4;
+constexpr int OFFSET_PREV_LSN = 12;
+constexpr int OFFSET_TYPE = 16;
+
+}  // namespace
+
+LogManager::LogManager(DiskManager *disk_manager, size_t buffer_size, size_t num_buffers)
+    : reserve_state_(PackState(0, 0)),
+      persistent_lsn_(INVALID_LSN),
+      buffer_size_(buffer_size),
+      max_commits_per_buffer_(buffer_size / LogRecord::HEADER_SIZE),
+      buffers_(num_buffers),
+      disk_manager_(disk_manager) {
+  if (num_buffers < 2 || buffer_size < static_cast<size_t>(LogRecord::HEADER_SIZE) || buffer_size >= SEALED) {
+    throw Exception("the log needs at least two buffers of a valid size");
+  }
+  for (auto &buffer : buffers_) {
+    buffer.data_ = std::make_unique<char[]>(buffer_size_);
+    buffer.commit_times_ = std::make_unique<int64_t[]>(max_commits_per_buffer_);
+  }
+  log_buffer_ = buffers_[active_].data_.get();
+  log_commit_times_ = buffers_[active_].commit_times_.get();
+  active_offset_ = disk_manager_->GetLogSize();
+  flushed_offset_ = active_offset_;
+}
+
+LogManager::~LogManager() { StopFlushThread(); }
+
 /*
  * set enable_logging = true
  * Start a separate thread to execute flush to disk operation periodically
@@ -22,33 +64,434 @@ namespace bustub {
  *
  * This thread runs forever until system shutdown/StopFlushThread
  */
-void LogManager::RunFlushThread() {}
+void LogManager::RunFlushThread() {
+  std::scoped_lock latch(latch_);
+  if (flush_thread_ != nullptr) {
+    return;
+  }
+  enable_logging = true;
+  stop_flush_thread_ = false;
+  flush_thread_ = new std::thread([this] {
+    std::unique_lock lock(latch_);
+    while (!stop_flush_thread_) {
+      auto timeout = std::chrono::steady_clock::now() + log_timeout;
+      while (!flush_requested_ && num_full_ == 0 && !stop_flush_thread_ &&
+             std::chrono::steady_clock::now() < std::min(timeout, flush_deadline_)) {
+        cv_.wait_until(lock, std::min(timeout, flush_deadline_));
+      }
+      // On a timeout, a deadline, a request or shutdown, also write out what is in the log buffer.
+      FlushInline(&lock);
+    }
+    while (num_full_ != 0 || StateOffset(reserve_state_) != 0) {
+      FlushInline(&lock);
+    }
+  });
+}
 
 /*
  * Stop and join the flush thread, set enable_logging = false
  */
-void LogManager::StopFlushThread() {}
+void LogManager::StopFlushThread() {
+  std::thread *flush_thread;
+  {
+    std::scoped_lock latch(latch_);
+    if (flush_thread_ == nullptr) {
+      return;
+    }
+    enable_logging = false;
+    stop_flush_thread_ = true;
+    flush_thread = flush_thread_;
+  }
+  cv_.notify_one();
+  flush_thread->join();
+  delete flush_thread;
+  std::scoped_lock latch(latch_);
+  flush_thread_ = nullptr;
+}
 
 /*
  * append a log record into log buffer
  * you MUST set the log record's lsn within this method
  * @return: lsn that is assigned to this log record
- *
- *
- * example below
- * // First, serialize the must have fields(20 bytes in total)
- * log_record.lsn_ = next_lsn_++;
- * memcpy(log_buffer_ + offset_, &log_record, 20);
- * int pos = offset_ + 20;
- *
- * if (log_record.log_record_type_ == LogRecordType::INSERT) {
- *    memcpy(log_buffer_ + pos, &log_record.insert_rid_, sizeof(RID));
- *    pos += sizeof(RID);
- *    // we have provided serialize function for tuple class
- *    log_record.insert_tuple_.SerializeTo(log_buffer_ + pos);
- *  }
- *
  */
-lsn_t LogManager::AppendLogRecord(LogRecord *log_record) { return INVALID_LSN; }
+lsn_t LogManager::AppendLogRecord(LogRecord *log_record) {
+  int size = log_record->size_;
+  if (static_cast<size_t>(size) > buffer_size_) {
+    throw Exception("log record does not fit into the log buffer");
+  }
+  uint64_t state = Reserve(size, 1);
+  log_record->lsn_ = StateLSN(state);
+  // The flush thread cannot swap the buffers until this record is published below.
+  SerializeLogRecord(log_record, log_buffer_ + StateOffset(state));
+  if (log_record->log_record_type_ == LogRecordType::COMMIT) {
+    log_commit_times_[log_num_commits_++] = std::chrono::steady_clock::now().time_since_epoch().count();
+  }
+  completed_bytes_ += size;
+  return log_record->lsn_;
+}
+
+uint64_t LogManager::Reserve(int size, int num_records) {
+  // Reserve the LSNs and the byte range together, so that LSN order matches the order in the log.
+  uint64_t state = reserve_state_.load();
+  while (true) {
+    if ((state & SEALED) != 0 || static_cast<size_t>(StateOffset(state) + size) > buffer_size_) {
+      WaitForSpace(size);
+      state = reserve_state_.load();
+      continue;
+    }
+    if (reserve_state_.compare_exchange_weak(
+            state, PackState(StateLSN(state) + num_records, StateOffset(state) + size))) {
+      return state;
+    }
+  }
+}
+
+void LogManager::AppendTxnLogRecord(LogRecord *log_record, Transaction *txn, Page *page) {
+  // The records about a page must reach the log in the order of the changes, so publish the other transaction's.
+  if (page != nullptr) {
+    PrivateLogBuffer *owner = page->log_owner_.load();
+    if (owner != nullptr && owner != txn->GetPrivateLog()) {
+      PublishPrivateLog(owner);
+    }
+  }
+  size_t private_size = private_buffer_size_;
+  PrivateLogBuffer *buffer = txn->GetPrivateLog();
+  if (buffer == nullptr && private_size != 0) {
+    std::scoped_lock latch(private_buffers_latch_);
+    if (!free_private_buffers_.empty() && free_private_buffers_.back()->capacity_ == private_size) {
+      buffer = free_private_buffers_.back();
+      free_private_buffers_.pop_back();
+    } else {
+      buffer = private_buffers_.emplace_back(std::make_unique<PrivateLogBuffer>(private_size)).get();
+    }
+    buffer->txn_ = txn;
+    txn->SetPrivateLog(buffer);
+  }
+
+  int size = log_record->size_;
+  std::unique_lock<std::mutex> latch;
+  if (buffer != nullptr) {
+    latch = std::unique_lock(buffer->latch_);
+    if (static_cast<size_t>(buffer->size_ + size) > buffer->capacity_) {
+      PublishLocked(buffer);
+    }
+  }
+  if (buffer == nullptr || static_cast<size_t>(size) > buffer->capacity_) {
+    if (latch.owns_lock()) {
+      latch.unlock();
+    }
+    log_record->prev_lsn_ = txn->GetPrevLSN();
+    lsn_t lsn = AppendLogRecord(log_record);
+    if (page != nullptr) {
+      page->SetLSN(lsn);
+    }
+    txn->SetPrevLSN(lsn);
+    return;
+  }
+
+  SerializeLogRecord(log_record, buffer->data_.get() + buffer->size_);
+  buffer->size_ += size;
+  if (page != nullptr) {
+    buffer->pages_.emplace_back(page, buffer->num_records_);
+    page->log_owner_ = buffer;
+  }
+  buffer->num_records_++;
+}
+
+lsn_t LogManager::PublishTxnLog(Transaction *txn) {
+  PrivateLogBuffer *buffer = txn->GetPrivateLog();
+  if (buffer == nullptr) {
+    return txn->GetPrevLSN();
+  }
+  PublishPrivateLog(buffer);
+  txn->SetPrivateLog(nullptr);
+  {
+    std::scoped_lock latch(buffer->latch_);
+    buffer->txn_ = nullptr;
+  }
+  std::scoped_lock latch(private_buffers_latch_);
+  free_private_buffers_.push_back(buffer);
+  return txn->GetPrevLSN();
+}
+
+void LogManager::PublishPageLog(Page *page) {
+  PrivateLogBuffer *owner = page->log_owner_.load();
+  if (owner != nullptr) {
+    PublishPrivateLog(owner);
+  }
+}
+
+void LogManager::PublishPrivateLog(PrivateLogBuffer *buffer) {
+  std::scoped_lock latch(buffer->latch_);
+  PublishLocked(buffer);
+}
+
+void LogManager::PublishLocked(PrivateLogBuffer *buffer) {
+  if (buffer->size_ == 0) {
+    return;
+  }
+  uint64_t state = Reserve(buffer->size_, buffer->num_records_);
+  lsn_t first_lsn = StateLSN(state);
+  // Chain the records to the transaction's earlier ones, now that their LSNs are known.
+  lsn_t lsn = first_lsn;
+  lsn_t prev_lsn = buffer->txn_->GetPrevLSN();
+  char *data = buffer->data_.get();
+  for (int pos = 0; pos < buffer->size_; lsn++) {
+    memcpy(data + pos + OFFSET_LSN, &lsn, sizeof(lsn_t));
+    memcpy(data + pos + OFFSET_PREV_LSN, &prev_lsn, sizeof(lsn_t));
+    LogRecordType type;
+    memcpy(&type, data + pos + OFFSET_TYPE, sizeof(LogRecordType));
+    if (type == LogRecordType::COMMIT) {
+      log_commit_times_[log_num_commits_++] = std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+    int32_t size;
+    memcpy(&size, data + pos + OFFSET_SIZE, sizeof(int32_t));
+    prev_lsn = lsn;
+    pos += size;
+  }
+  memcpy(log_buffer_ + StateOffset(state), data, buffer->size_);
+  completed_bytes_ += buffer->size_;
+  buffer->txn_->SetPrevLSN(prev_lsn);
+
+  for (const auto &[page, record] : buffer->pages_) {
+    page->RaiseLSN(first_lsn + record);
+    PrivateLogBuffer *owner = buffer;
+    page->log_owner_.compare_exchange_strong(owner, nullptr);
+  }
+  buffer->pages_.clear();
+  buffer->size_ = 0;
+  buffer->num_records_ = 0;
+}
+
+void LogManager::SetPrivateBufferSize(size_t size) {
+  if (size > buffer_size_) {
+    throw Exception("private log buffers must fit into the log buffer");
+  }
+  private_buffer_size_ = size;
+}
+
+void LogManager::WaitForSpace(int size) {
+  auto start = std::chrono::steady_clock::now();
+  std::unique_lock lock(latch_);
+  // Buffers are only sealed under latch_, so holding it the log buffer is open and only its fill level matters.
+  while (static_cast<size_t>(StateOffset(reserve_state_) + size) > buffer_size_) {
+    if (num_full_ + 1 < buffers_.size()) {
+      // Rotating is cheap; leave the write to the flush thread.
+      RotateBuffers();
+    } else if (flush_thread_ == nullptr) {
+      FlushInline(&lock);
+    } else {
+      append_cv_.wait(lock);
+    }
+  }
+  num_append_stalls_++;
+  append_stall_ns_ +=
+      std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LogManager::Flush(lsn_t lsn) {
+  std::unique_lock lock(latch_);
+  // Nothing past the last appended record can ever become persistent.
+  lsn = std::min<lsn_t>(lsn, GetNextLSN() - 1);
+  while (persistent_lsn_ < lsn) {
+    if (flush_thread_ == nullptr) {
+      FlushInline(&lock);
+      continue;
+    }
+    flush_requested_ = true;
+    cv_.notify_one();
+    flushed_cv_.wait(lock);
+  }
+}
+
+void LogManager::SetNextLSN(lsn_t next_lsn) {
+  std::scoped_lock latch(latch_);
+  if (flush_thread_ != nullptr || StateOffset(reserve_state_) != 0 || num_full_ != 0 || next_lsn < GetNextLSN()) {
+    throw Exception("the LSNs can only be moved forward before logging starts");
+  }
+  reserve_state_ = PackState(next_lsn, 0);
+  persistent_lsn_ = next_lsn - 1;
+  active_first_lsn_ = next_lsn;
+}
+
+void LogManager::FlushWithin(lsn_t lsn, std::chrono::milliseconds max_delay) {
+  auto deadline = std::chrono::steady_clock::now() + max_delay;
+  std::unique_lock lock(latch_);
+  if (persistent_lsn_ >= lsn) {
+    return;
+  }
+  if (flush_thread_ == nullptr) {
+    // Nobody would write the log later, so write it now.
+    lock.unlock();
+    Flush(lsn);
+    return;
+  }
+  deadline_lsn_ = std::max(deadline_lsn_, lsn);
+  if (deadline < flush_deadline_) {
+    flush_deadline_ = deadline;
+    cv_.notify_one();
+  }
+}
+
+void LogManager::RotateBuffers() {
+  if (StateOffset(reserve_state_) == 0) {
+    return;
+  }
+  // Seal the buffer, then wait for the appenders that reserved space before the seal.
+  uint64_t state = reserve_state_.fetch_or(SEALED);
+  int size = StateOffset(state);
+  while (completed_bytes_ != size) {
+    std::this_thread::yield();
+  }
+  auto &full = buffers_[active_];
+  full.size_ = size;
+  full.last_lsn_ = StateLSN(state) - 1;
+  full.num_commits_ = log_num_commits_.exchange(0);
+  num_full_++;
+  // Buffers are written in ring order, so the next one starts where this one ends.
+  lsn_offsets_[active_first_lsn_] = active_offset_;
+  active_first_lsn_ = StateLSN(state);
+  active_offset_ += size;
+
+  active_ = (active_ + 1) % buffers_.size();
+  log_buffer_ = buffers_[active_].data_.get();
+  log_commit_times_ = buffers_[active_].commit_times_.get();
+  completed_bytes_ = 0;
+  reserve_state_ = PackState(StateLSN(state), 0);
+  append_cv_.notify_all();
+  cv_.notify_one();
+}
+
+void LogManager::FlushInline(std::unique_lock<std::mutex> *lock) {
+  if (writing_) {
+    flushed_cv_.wait(*lock);
+    return;
+  }
+  flush_requested_ = false;
+  if (num_full_ == 0) {
+    RotateBuffers();
+    if (num_full_ == 0) {
+      return;
+    }
+  }
+
+  // The full buffers precede the active one in the ring; write the oldest.
+  auto &full = buffers_[(active_ + buffers_.size() - num_full_) % buffers_.size()];
+  writing_ = true;
+  LogShipper *log_shipper = log_shipper_;
+  int64_t offset = flushed_offset_;
+  lock->unlock();
+  disk_manager_->WriteLog(full.data_.get(), full.size_);
+  if (log_shipper != nullptr) {
+    log_shipper->Ship(full.data_.get(), full.size_, offset, full.last_lsn_);
+  }
+  int64_t now = std::chrono::steady_clock::now().time_since_epoch().count();
+  for (int i = 0; i < full.num_commits_; i++) {
+    commit_latency_.Record(now - full.commit_times_[i]);
+  }
+  num_commits_ += full.num_commits_;
+  num_flushes_++;
+  lock->lock();
+
+  persistent_lsn_ = full.last_lsn_;
+  flushed_offset_ += full.size_;
+  if (persistent_lsn_ >= deadline_lsn_) {
+    flush_deadline_ = std::chrono::steady_clock::time_point::max();
+  }
+  writing_ = false;
+  num_full_--;
+  append_cv_.notify_all();
+  flushed_cv_.notify_all();
+}
+
+int64_t LogManager::GetLogOffset(lsn_t lsn) {
+  std::scoped_lock latch(latch_);
+  if (lsn >= active_first_lsn_) {
+    return active_offset_;
+  }
+  auto it = lsn_offsets_.upper_bound(lsn);
+  return it == lsn_offsets_.begin() ? 0 : std::prev(it)->second;
+}
+
+void LogManager::SetLogShipper(LogShipper *log_shipper) {
+  std::unique_lock lock(latch_);
+  // A write in progress may still be handing its buffer to the previous shipper.
+  while (writing_) {
+    flushed_cv_.wait(lock);
+  }
+  log_shipper_ = log_shipper;
+}
+
+void LogManager::WriteMasterRecord(const MasterRecord &master_record) {
+  disk_manager_->WriteMasterRecord(reinterpret_cast<const char *>(&master_record), sizeof(MasterRecord));
+}
+
+void LogManager::TruncateLog(int64_t offset) {
+  disk_manager_->TruncateLog(offset);
+  std::scoped_lock latch(latch_);
+  // Keep the entry covering offset, so that the offsets of the retained records can still be found.
+  auto it = lsn_offsets_.begin();
+  while (it != lsn_offsets_.end() && std::next(it) != lsn_offsets_.end() && std::next(it)->second <= offset) {
+    it = lsn_offsets_.erase(it);
+  }
+}
+
+/*
+ * The header is the first HEADER_SIZE bytes of LogRecord, the body depends on the record type (see log_record.h).
+ */
+void LogManager::SerializeLogRecord(LogRecord *log_record, char *dst) {
+  memcpy(dst, log_record, LogRecord::HEADER_SIZE);
+  int pos = LogRecord::HEADER_SIZE;
+  switch (log_record->log_record_type_) {
+    case LogRecordType::INSERT:
+      memcpy(dst + pos, &log_record->insert_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->insert_tuple_.SerializeTo(dst + pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(dst + pos, &log_record->delete_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->delete_tuple_.SerializeTo(dst + pos);
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(dst + pos, &log_record->update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->old_tuple_.SerializeTo(dst + pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      log_record->new_tuple_.SerializeTo(dst + pos);
+      break;
+    case LogRecordType::UPDATE_DELTA:
+      memcpy(dst + pos, &log_record->update_rid_, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->delta_.SerializeTo(dst + pos);
+      break;
+    case LogRecordType::NEWPAGE:
+      memcpy(dst + pos, &log_record->prev_page_id_, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(dst + pos, &log_record->page_id_, sizeof(page_id_t));
+      break;
+    case LogRecordType::CHECKPOINT_END: {
+      memcpy(dst + pos, &log_record->checkpoint_begin_lsn_, sizeof(lsn_t));
+      pos += sizeof(lsn_t);
+      auto is_last = static_cast<int32_t>(log_record->checkpoint_is_last_);
+      memcpy(dst + pos, &is_last, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      auto num_txns = static_cast<int32_t>(log_record->active_txns_.size());
+      memcpy(dst + pos, &num_txns, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      memcpy(dst + pos, log_record->active_txns_.data(), num_txns * sizeof(ActiveTxnEntry));
+      pos += num_txns * sizeof(ActiveTxnEntry);
+      auto num_pages = static_cast<int32_t>(log_record->dirty_pages_.size());
+      memcpy(dst + pos, &num_pages, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      memcpy(dst + pos, log_record->dirty_pages_.data(), num_pages * sizeof(DirtyPageEntry));
+      break;
+    }
+    default:
+      break;
+  }
+}
 
 }  // namespace bustub
@@ -12,15 +12,111 @@
 
 #include "recovery/log_recovery.h"
 
-#include "storage/page/table_page.h"
+#include <cstring>
+#include <functional>
+#include <utility>
+
+#include "common/exception.h"
 
 namespace bustub {
+
+LogRecovery::LogRecovery(DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager, size_t num_workers)
+    : disk_manager_(disk_manager),
+      buffer_pool_manager_(buffer_pool_manager),
+      num_workers_(std::max<size_t>(1, std::min(num_workers, buffer_pool_manager->GetPoolSize() / 2))),
+      offset_(0) {
+  log_buffer_ = new char[log_buffer_size_];
+}
+
 /*
  * deserialize a log record from log buffer
  * @return: true means deserialize succeed, otherwise can't deserialize cause
  * incomplete log record
  */
-bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record) { return false; }
+bool LogRecovery::DeserializeLogRecord(const char *data, int size, LogRecord *log_record) {
+  if (size < LogRecord::HEADER_SIZE) {
+    return false;
+  }
+  int32_t record_size;
+  LogRecordType type;
+  memcpy(&record_size, data, sizeof(int32_t));
+  memcpy(&type, data + 4 * sizeof(int32_t), sizeof(LogRecordType));
+  // A zeroed or torn tail marks the end of the log.
+  if (record_size < LogRecord::HEADER_SIZE || record_size > size || type <= LogRecordType::INVALID ||
+      type > LogRecordType::UPDATE_DELTA) {
+    return false;
+  }
+  log_record->size_ = record_size;
+  memcpy(&log_record->lsn_, data + sizeof(int32_t), sizeof(lsn_t));
+  memcpy(&log_record->txn_id_, data + 2 * sizeof(int32_t), sizeof(txn_id_t));
+  memcpy(&log_record->prev_lsn_, data + 3 * sizeof(int32_t), sizeof(lsn_t));
+  log_record->log_record_type_ = type;
+
+  int pos = LogRecord::HEADER_SIZE;
+  switch (type) {
+    case LogRecordType::INSERT:
+      memcpy(&log_record->insert_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->insert_tuple_.DeserializeFrom(data + pos);
+      break;
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+      memcpy(&log_record->delete_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->delete_tuple_.DeserializeFrom(data + pos);
+      break;
+    case LogRecordType::UPDATE:
+      memcpy(&log_record->update_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      log_record->old_tuple_.DeserializeFrom(data + pos);
+      pos += sizeof(int32_t) + log_record->old_tuple_.GetLength();
+      log_record->new_tuple_.DeserializeFrom(data + pos);
+      break;
+    case LogRecordType::UPDATE_DELTA:
+      memcpy(&log_record->update_rid_, data + pos, sizeof(RID));
+      pos += sizeof(RID);
+      if (!log_record->delta_.DeserializeFrom(data + pos, record_size - pos)) {
+        return false;
+      }
+      break;
+    case LogRecordType::NEWPAGE:
+      memcpy(&log_record->prev_page_id_, data + pos, sizeof(page_id_t));
+      pos += sizeof(page_id_t);
+      memcpy(&log_record->page_id_, data + pos, sizeof(page_id_t));
+      break;
+    case LogRecordType::CHECKPOINT_END: {
+      int32_t is_last;
+      int32_t num_txns;
+      int32_t num_pages;
+      memcpy(&log_record->checkpoint_begin_lsn_, data + pos, sizeof(lsn_t));
+      pos += sizeof(lsn_t);
+      memcpy(&is_last, data + pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      log_record->checkpoint_is_last_ = is_last != 0;
+      memcpy(&num_txns, data + pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      size_t txns_end = pos + num_txns * sizeof(ActiveTxnEntry);
+      if (num_txns < 0 || txns_end + sizeof(int32_t) > static_cast<size_t>(record_size)) {
+        return false;
+      }
+      log_record->active_txns_.resize(num_txns);
+      memcpy(log_record->active_txns_.data(), data + pos, num_txns * sizeof(ActiveTxnEntry));
+      pos += num_txns * sizeof(ActiveTxnEntry);
+      memcpy(&num_pages, data + pos, sizeof(int32_t));
+      pos += sizeof(int32_t);
+      if (num_pages < 0 || pos + num_pages * sizeof(DirtyPageEntry) > static_cast<size_t>(record_size)) {
+        return false;
+      }
+      log_record->dirty_pages_.resize(num_pages);
+      memcpy(log_record->dirty_pages_.data(), data + pos, num_pages * sizeof(DirtyPageEntry));
+      break;
+    }
+    default:
+      break;
+  }
+  return true;
+}
 
 /*
  *redo phase on TABLE PAGE level(table/table_page.h)
@@ -29,12 +125,467 @@ bool LogRecovery::DeserializeLogRecord(const char *data, LogRecord *log_record)
  *LSN with log_record's sequence number, and also build active_txn_ table &
  *lsn_mapping_ table
  */
-void LogRecovery::Redo() {}
+void LogRecovery::Redo() {
+  if (enable_logging) {
+    throw Exception("recovery must run before logging is enabled");
+  }
+  WorkerPool pool(num_workers_);
+  StartWorkers(&pool, false);
+  std::exception_ptr error;
+  try {
+    ScanLog(&pool);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  FinishWorkers(&pool, error);
+}
+
+void LogRecovery::ScanLog(WorkerPool *pool) {
+  if (!LoadCheckpoint()) {
+    checkpoint_lsn_ = INVALID_LSN;
+    scan_lsn_ = INVALID_LSN;
+    // Without a checkpoint nothing was truncated, so this is where the log was first written.
+    scan_offset_ = disk_manager_->GetLogStart();
+    checkpoint_txns_.clear();
+    dirty_pages_.clear();
+  }
+  offset_ = scan_offset_;
+  while (ReadLogBuffer(offset_)) {
+    int pos = 0;
+    while (true) {
+      auto log_record = std::make_unique<LogRecord>();
+      if (!DeserializeLogRecord(log_buffer_ + pos, log_buffer_size_ - pos, log_record.get())) {
+        break;
+      }
+      lsn_t lsn = log_record->lsn_;
+      txn_id_t txn_id = log_record->txn_id_;
+      int64_t record_offset = offset_ + pos;
+      pos += log_record->size_;
+      max_lsn_ = std::max(max_lsn_, lsn);
+      max_txn_id_ = std::max(max_txn_id_, txn_id);
+      if (lsn < scan_lsn_ || log_record->log_record_type_ == LogRecordType::CHECKPOINT_BEGIN ||
+          log_record->log_record_type_ == LogRecordType::CHECKPOINT_END) {
+        continue;
+      }
+      // Before the checkpoint, only the transactions it found active may still be losers.
+      if (lsn < checkpoint_lsn_ && checkpoint_txns_.count(txn_id) == 0) {
+        // The transaction finished before the checkpoint, so only its changes matter.
+      } else if (log_record->log_record_type_ == LogRecordType::COMMIT ||
+                 log_record->log_record_type_ == LogRecordType::ABORT) {
+        // The transaction needs no undo, so forget where its records are.
+        auto it = active_txn_.find(txn_id);
+        for (lsn_t prev = it == active_txn_.end() ? INVALID_LSN : it->second; prev != INVALID_LSN;) {
+          auto location = lsn_mapping_.find(prev);
+          if (location == lsn_mapping_.end()) {
+            break;
+          }
+          prev = location->second.prev_lsn_;
+          lsn_mapping_.erase(location);
+        }
+        active_txn_.erase(txn_id);
+      } else {
+        active_txn_[txn_id] = lsn;
+        lsn_mapping_[lsn] = LogLocation{record_offset, log_record->prev_lsn_};
+      }
+
+      switch (log_record->log_record_type_) {
+        case LogRecordType::INSERT:
+        case LogRecordType::MARKDELETE:
+        case LogRecordType::APPLYDELETE:
+        case LogRecordType::ROLLBACKDELETE:
+        case LogRecordType::UPDATE:
+        case LogRecordType::UPDATE_DELTA: {
+          page_id_t page_id = GetRID(*log_record).GetPageId();
+          if (NeedsRedo(page_id, lsn)) {
+            Dispatch(pool, PartitionOf(page_id), std::move(log_record));
+          }
+          break;
+        }
+        case LogRecordType::NEWPAGE: {
+          if (!NeedsRedo(log_record->page_id_, lsn) && !NeedsRedo(log_record->prev_page_id_, lsn)) {
+            break;
+          }
+          // The new page is initialized and the previous page linked to it, possibly by two different workers.
+          size_t partition = PartitionOf(log_record->page_id_);
+          if (log_record->prev_page_id_ != INVALID_PAGE_ID && PartitionOf(log_record->prev_page_id_) != partition) {
+            Dispatch(pool, PartitionOf(log_record->prev_page_id_), std::make_unique<LogRecord>(*log_record));
+          }
+          Dispatch(pool, partition, std::move(log_record));
+          break;
+        }
+        default:
+          break;
+      }
+    }
+    if (pos == 0) {
+      // Either the end of the log, or a torn record at its end.
+      break;
+    }
+    offset_ += pos;
+  }
+}
 
 /*
  *undo phase on TABLE PAGE level(table/table_page.h)
  *iterate through active txn map and undo each operation
  */
-void LogRecovery::Undo() {}
+void LogRecovery::Undo() {
+  // Redo left the records of the losers in lsn_mapping_. Rolling them back newest first gives every page its old
+  // tuples back in the reverse order they gave up their space.
+  std::vector<std::pair<lsn_t, int64_t>> records;
+  records.reserve(lsn_mapping_.size());
+  for (const auto &[lsn, location] : lsn_mapping_) {
+    records.emplace_back(lsn, location.offset_);
+  }
+  std::sort(records.begin(), records.end(), std::greater<>());
+
+  WorkerPool pool(num_workers_);
+  StartWorkers(&pool, true);
+  std::exception_ptr error;
+  try {
+    for (const auto &[lsn, offset] : records) {
+      auto log_record = std::make_unique<LogRecord>();
+      ReadLogRecord(offset, log_record.get());
+      switch (log_record->log_record_type_) {
+        case LogRecordType::INSERT:
+        case LogRecordType::MARKDELETE:
+        case LogRecordType::APPLYDELETE:
+        case LogRecordType::ROLLBACKDELETE:
+        case LogRecordType::UPDATE:
+        case LogRecordType::UPDATE_DELTA:
+          if (active_txn_.count(log_record->txn_id_) != 0) {
+            size_t partition = PartitionOf(GetRID(*log_record).GetPageId());
+            Dispatch(&pool, partition, std::move(log_record));
+          }
+          break;
+        default:
+          // A new page is left in the table, empty.
+          break;
+      }
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+  FinishWorkers(&pool, error);
+  undone_txns_.insert(active_txn_.begin(), active_txn_.end());
+  active_txn_.clear();
+  lsn_mapping_.clear();
+}
+
+void LogRecovery::Restart(LogManager *log_manager, TransactionManager *txn_manager) {
+  if (enable_logging) {
+    throw Exception("recovery must run before logging is enabled");
+  }
+  log_manager->SetNextLSN(max_lsn_ + 1);
+  txn_manager->SetNextTxnId(max_txn_id_ + 1);
+  if (undone_txns_.empty()) {
+    return;
+  }
+  // FlushAllPages only covers the pages this buffer pool allocated, not the ones recovery fetched.
+  for (const auto &entry : buffer_pool_manager_->GetDirtyPageTable()) {
+    buffer_pool_manager_->FlushPage(entry.page_id_);
+  }
+  lsn_t lsn = INVALID_LSN;
+  for (const auto &[txn_id, prev_lsn] : undone_txns_) {
+    LogRecord log_record(txn_id, prev_lsn, LogRecordType::ABORT);
+    lsn = log_manager->AppendLogRecord(&log_record);
+  }
+  log_manager->Flush(lsn);
+  undone_txns_.clear();
+}
+
+bool LogRecovery::LoadCheckpoint() {
+  MasterRecord master_record;
+  if (!disk_manager_->ReadMasterRecord(reinterpret_cast<char *>(&master_record), sizeof(MasterRecord))) {
+    return false;
+  }
+  // The master record is only written once the checkpoint is durable, but the log may have been lost since.
+  // Large tables are split across several CHECKPOINT_END records, which only count once the last one is found.
+  checkpoint_txns_.clear();
+  dirty_pages_.clear();
+  int64_t offset = master_record.checkpoint_offset_;
+  while (ReadLogBuffer(offset)) {
+    int pos = 0;
+    LogRecord log_record;
+    while (DeserializeLogRecord(log_buffer_ + pos, log_buffer_size_ - pos, &log_record)) {
+      pos += log_record.size_;
+      if (log_record.log_record_type_ != LogRecordType::CHECKPOINT_END ||
+          log_record.checkpoint_begin_lsn_ != master_record.checkpoint_lsn_) {
+        continue;
+      }
+      for (const auto &txn : log_record.active_txns_) {
+        checkpoint_txns_.insert(txn.txn_id_);
+        max_txn_id_ = std::max(max_txn_id_, txn.txn_id_);
+      }
+      for (const auto &page : log_record.dirty_pages_) {
+        dirty_pages_[page.page_id_] = page.rec_lsn_;
+      }
+      if (!log_record.checkpoint_is_last_) {
+        continue;
+      }
+      checkpoint_lsn_ = master_record.checkpoint_lsn_;
+      scan_lsn_ = master_record.scan_lsn_;
+      scan_offset_ = master_record.scan_offset_;
+      return true;
+    }
+    if (pos == 0) {
+      break;
+    }
+    offset += pos;
+  }
+  return false;
+}
+
+void LogRecovery::StartWorkers(WorkerPool *pool, bool undo) {
+  for (size_t i = 0; i < pool->queues_.size(); i++) {
+    pool->threads_.emplace_back([this, pool, i, undo] { RunWorker(&pool->queues_[i], i, undo); });
+  }
+}
+
+void LogRecovery::Dispatch(WorkerPool *pool, size_t partition, std::unique_ptr<LogRecord> log_record) {
+  auto &batch = pool->batches_[partition];
+  batch.push_back(std::move(log_record));
+  if (batch.size() == BATCH_SIZE) {
+    PushBatch(&pool->queues_[partition], &batch);
+  }
+}
+
+void LogRecovery::FinishWorkers(WorkerPool *pool, std::exception_ptr error) {
+  for (size_t i = 0; i < pool->queues_.size(); i++) {
+    auto &queue = pool->queues_[i];
+    if (error == nullptr && !pool->batches_[i].empty()) {
+      PushBatch(&queue, &pool->batches_[i]);
+    }
+    {
+      std::scoped_lock latch(queue.latch_);
+      queue.done_ = true;
+    }
+    queue.cv_.notify_all();
+  }
+  for (auto &thread : pool->threads_) {
+    thread.join();
+  }
+  for (const auto &queue : pool->queues_) {
+    if (error == nullptr) {
+      error = queue.error_;
+    }
+  }
+  if (error != nullptr) {
+    std::rethrow_exception(error);
+  }
+}
+
+void LogRecovery::PushBatch(RecordQueue *queue, RecordBatch *batch) {
+  {
+    std::unique_lock lock(queue->latch_);
+    queue->cv_.wait(lock, [queue] { return queue->batches_.size() < MAX_QUEUED_BATCHES; });
+    queue->batches_.push_back(std::move(*batch));
+  }
+  queue->cv_.notify_all();
+  batch->clear();
+}
+
+void LogRecovery::RunWorker(RecordQueue *queue, size_t partition, bool undo) {
+  while (true) {
+    RecordBatch batch;
+    {
+      std::unique_lock lock(queue->latch_);
+      queue->cv_.wait(lock, [queue] { return !queue->batches_.empty() || queue->done_; });
+      if (queue->batches_.empty()) {
+        return;
+      }
+      batch = std::move(queue->batches_.front());
+      queue->batches_.pop_front();
+    }
+    queue->cv_.notify_all();
+    // A worker that failed keeps taking batches, so that the scan never waits for it.
+    for (auto &log_record : batch) {
+      if (queue->error_ != nullptr) {
+        break;
+      }
+      try {
+        if (undo) {
+          UndoLogRecord(*log_record);
+        } else {
+          RedoLogRecord(log_record.get(), partition);
+        }
+      } catch (...) {
+        queue->error_ = std::current_exception();
+      }
+    }
+  }
+}
+
+void LogRecovery::RedoLogRecord(LogRecord *log_record, size_t partition) {
+  lsn_t lsn = log_record->lsn_;
+  if (log_record->log_record_type_ == LogRecordType::NEWPAGE) {
+    if (PartitionOf(log_record->page_id_) == partition) {
+      TablePage *page = FetchTablePage(log_record->page_id_);
+      bool redo = page->GetLSN() < lsn;
+      if (redo) {
+        page->Init(log_record->page_id_, PAGE_SIZE, log_record->prev_page_id_, nullptr, nullptr);
+        page->SetLSN(lsn);
+      }
+      ReleaseTablePage(page, redo);
+    }
+    if (log_record->prev_page_id_ != INVALID_PAGE_ID && PartitionOf(log_record->prev_page_id_) == partition) {
+      // Linking the previous page is not logged on that page, but it is idempotent.
+      TablePage *page = FetchTablePage(log_record->prev_page_id_);
+      bool redo = page->GetNextPageId() != log_record->page_id_;
+      if (redo) {
+        page->SetNextPageId(log_record->page_id_);
+      }
+      ReleaseTablePage(page, redo);
+    }
+    return;
+  }
+
+  RID rid = GetRID(*log_record);
+  TablePage *page = FetchTablePage(rid.GetPageId());
+  bool redo = page->GetLSN() < lsn;
+  bool is_applied = true;
+  if (redo) {
+    switch (log_record->log_record_type_) {
+      case LogRecordType::INSERT:
+        is_applied = page->InsertTupleAt(log_record->insert_tuple_, rid);
+        break;
+      case LogRecordType::MARKDELETE:
+        is_applied = page->MarkDelete(rid, nullptr, nullptr, nullptr);
+        break;
+      case LogRecordType::APPLYDELETE:
+        page->ApplyDelete(rid, nullptr, nullptr);
+        break;
+      case LogRecordType::ROLLBACKDELETE:
+        page->RollbackDelete(rid, nullptr, nullptr);
+        break;
+      case LogRecordType::UPDATE: {
+        Tuple old_tuple;
+        is_applied = page->UpdateTuple(log_record->new_tuple_, &old_tuple, rid, nullptr, nullptr, nullptr);
+        break;
+      }
+      case LogRecordType::UPDATE_DELTA:
+        is_applied = ApplyUpdateDelta(page, rid, log_record->delta_, true);
+        break;
+      default:
+        break;
+    }
+    page->SetLSN(lsn);
+  }
+  ReleaseTablePage(page, redo);
+  if (!is_applied) {
+    throw Exception("log record can't be replayed on its page");
+  }
+}
+
+void LogRecovery::ReplayLogRecord(LogRecord *log_record) {
+  switch (log_record->log_record_type_) {
+    case LogRecordType::NEWPAGE:
+      RedoLogRecord(log_record, PartitionOf(log_record->page_id_));
+      if (log_record->prev_page_id_ != INVALID_PAGE_ID &&
+          PartitionOf(log_record->prev_page_id_) != PartitionOf(log_record->page_id_)) {
+        RedoLogRecord(log_record, PartitionOf(log_record->prev_page_id_));
+      }
+      break;
+    case LogRecordType::INSERT:
+    case LogRecordType::MARKDELETE:
+    case LogRecordType::APPLYDELETE:
+    case LogRecordType::ROLLBACKDELETE:
+    case LogRecordType::UPDATE:
+    case LogRecordType::UPDATE_DELTA:
+      RedoLogRecord(log_record, PartitionOf(GetRID(*log_record).GetPageId()));
+      break;
+    default:
+      break;
+  }
+}
+
+void LogRecovery::UndoLogRecord(const LogRecord &log_record) {
+  const RID &rid = GetRID(log_record);
+  TablePage *page = FetchTablePage(rid.GetPageId());
+  bool is_undone = true;
+  switch (log_record.log_record_type_) {
+    case LogRecordType::INSERT:
+      page->ApplyDelete(rid, nullptr, nullptr);
+      break;
+    case LogRecordType::MARKDELETE:
+      page->RollbackDelete(rid, nullptr, nullptr);
+      break;
+    case LogRecordType::APPLYDELETE:
+      is_undone = page->InsertTupleAt(log_record.delete_tuple_, rid);
+      break;
+    case LogRecordType::ROLLBACKDELETE:
+      is_undone = page->MarkDelete(rid, nullptr, nullptr, nullptr);
+      break;
+    case LogRecordType::UPDATE: {
+      Tuple new_tuple;
+      is_undone = page->UpdateTuple(log_record.old_tuple_, &new_tuple, rid, nullptr, nullptr, nullptr);
+      break;
+    }
+    case LogRecordType::UPDATE_DELTA:
+      is_undone = ApplyUpdateDelta(page, rid, log_record.delta_, false);
+      break;
+    default:
+      break;
+  }
+  ReleaseTablePage(page, true);
+  if (!is_undone) {
+    throw Exception("log record of a loser can't be rolled back on its page");
+  }
+}
+
+bool LogRecovery::ApplyUpdateDelta(TablePage *page, const RID &rid, const TupleDelta &delta, bool redo) {
+  Tuple current;
+  Tuple image;
+  return page->GetTuple(rid, &current, nullptr, nullptr) &&
+         (redo ? delta.Redo(current, &image) : delta.Undo(current, &image)) &&
+         page->UpdateTuple(image, &current, rid, nullptr, nullptr, nullptr);
+}
+
+bool LogRecovery::ReadLogBuffer(int64_t offset) {
+  if (!disk_manager_->ReadLog(log_buffer_, log_buffer_size_, offset)) {
+    return false;
+  }
+  // A log manager with larger log buffers writes larger records. The size of a torn one may be garbage, so the
+  // record has to end within the log to count.
+  int32_t size;
+  memcpy(&size, log_buffer_, sizeof(int32_t));
+  if (size > log_buffer_size_ && offset + size <= disk_manager_->GetLogSize()) {
+    delete[] log_buffer_;
+    log_buffer_size_ = size;
+    log_buffer_ = new char[log_buffer_size_];
+    return disk_manager_->ReadLog(log_buffer_, log_buffer_size_, offset);
+  }
+  return true;
+}
+
+void LogRecovery::ReadLogRecord(int64_t offset, LogRecord *log_record) {
+  std::vector<char> buffer(LogRecord::HEADER_SIZE);
+  int32_t size = 0;
+  if (disk_manager_->ReadLog(buffer.data(), LogRecord::HEADER_SIZE, offset)) {
+    memcpy(&size, buffer.data(), sizeof(int32_t));
+  }
+  if (size >= LogRecord::HEADER_SIZE) {
+    buffer.resize(size);
+    disk_manager_->ReadLog(buffer.data(), size, offset);
+  }
+  if (!DeserializeLogRecord(buffer.data(), static_cast<int>(buffer.size()), log_record)) {
+    throw Exception("log record of an active transaction can't be read back");
+  }
+}
+
+TablePage *LogRecovery::FetchTablePage(page_id_t page_id) {
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "no free frame in the buffer pool for recovery");
+  }
+  page->WLatch();
+  return page;
+}
+
+void LogRecovery::ReleaseTablePage(TablePage *page, bool is_dirty) {
+  page_id_t page_id = page->GetPageId();
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, is_dirty);
+}
 
 }  // namespace bustub
@@ -0,0 +1,160 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_shipper.cpp
+//
+// Identification: src/recovery/log_shipper.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_shipper.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <array>
+#include <cerrno>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <utility>
+
+#include "common/exception.h"
+#include "common/logger.h"
+
+namespace bustub {
+
+LogShipper::LogShipper(int fd, size_t max_queued_bytes) : fd_(fd), max_queued_bytes_(max_queued_bytes) {
+  if (pipe(wake_fds_) != 0) {
+    throw Exception("could not create the wake-up pipe of the log shipper");
+  }
+  int flags = fcntl(fd_, F_GETFL);
+  if (flags < 0 || fcntl(fd_, F_SETFL, flags | O_NONBLOCK) != 0) {
+    close(wake_fds_[0]);
+    close(wake_fds_[1]);
+    throw Exception("could not make the connection to the standby non-blocking");
+  }
+  sender_ = std::thread([this] { RunSender(); });
+}
+
+LogShipper::~LogShipper() {
+  {
+    std::scoped_lock latch(latch_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  WakeSender();
+  sender_.join();
+  close(fd_);
+  close(wake_fds_[0]);
+  close(wake_fds_[1]);
+}
+
+void LogShipper::Ship(const char *data, int size, int64_t offset, lsn_t last_lsn) {
+  if (size == 0 || !connected_) {
+    return;
+  }
+  ShippedLogHeader header{offset, std::chrono::steady_clock::now().time_since_epoch().count(), size, last_lsn};
+  std::vector<char> chunk(sizeof(ShippedLogHeader) + size);
+  memcpy(chunk.data(), &header, sizeof(ShippedLogHeader));
+  memcpy(chunk.data() + sizeof(ShippedLogHeader), data, size);
+  {
+    std::scoped_lock latch(latch_);
+    if (!connected_) {
+      return;
+    }
+    if (queued_bytes_ + chunk.size() > max_queued_bytes_) {
+      LOG_WARN("standby fell more than %zu bytes behind, disconnecting it", max_queued_bytes_);
+      Disconnect();
+      return;
+    }
+    queued_bytes_ += chunk.size();
+    queue_.push_back(std::move(chunk));
+  }
+  cv_.notify_one();
+}
+
+void LogShipper::RunSender() {
+  std::unique_lock lock(latch_);
+  while (true) {
+    cv_.wait(lock, [this] { return !queue_.empty() || stop_ || !connected_; });
+    if (queue_.empty() || !connected_) {
+      return;
+    }
+    std::vector<char> chunk = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+    bool sent = SendAll(chunk.data(), chunk.size());
+    lock.lock();
+    if (!connected_) {
+      return;
+    }
+    queued_bytes_ -= chunk.size();
+    if (!sent) {
+      LOG_WARN("lost the connection to the standby");
+      Disconnect();
+      return;
+    }
+    ShippedLogHeader header;
+    memcpy(&header, chunk.data(), sizeof(ShippedLogHeader));
+    shipped_lsn_ = header.last_lsn_;
+    shipped_bytes_ += header.size_;
+  }
+}
+
+bool LogShipper::SendAll(const char *data, size_t size) {
+  size_t sent = 0;
+  while (sent < size) {
+    // MSG_NOSIGNAL keeps a socket whose peer is gone from raising SIGPIPE.
+    ssize_t ret = send(fd_, data + sent, size - sent, MSG_NOSIGNAL);
+    if (ret < 0 && errno == ENOTSOCK) {
+      ret = write(fd_, data + sent, size - sent);
+    }
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // Once the shipper is stopping, the wake-up pipe stays readable, so only the connection is polled, with a limit.
+      bool stopping = stop_;
+      std::array<pollfd, 2> fds{pollfd{fd_, POLLOUT, 0}, pollfd{wake_fds_[0], POLLIN, 0}};
+      int ready = poll(fds.data(), stopping ? 1 : fds.size(), stopping ? STOP_TIMEOUT.count() : -1);
+      if (ready < 0 && errno != EINTR) {
+        return false;
+      }
+      if (ready == 0) {
+        LOG_WARN("the standby took nothing for %d ms, giving up on it", static_cast<int>(STOP_TIMEOUT.count()));
+        return false;
+      }
+      // Woken up to disconnect. Woken up to stop, the sender still sends what is queued.
+      if (!connected_) {
+        return false;
+      }
+      continue;
+    }
+    if (ret <= 0) {
+      return false;
+    }
+    sent += ret;
+  }
+  return true;
+}
+
+void LogShipper::Disconnect() {
+  connected_ = false;
+  queue_.clear();
+  queued_bytes_ = 0;
+  // The descriptor itself is closed with the shipper.
+  WakeSender();
+  cv_.notify_all();
+}
+
+void LogShipper::WakeSender() {
+  char wake = 0;
+  while (write(wake_fds_[1], &wake, 1) < 0 && errno == EINTR) {
+  }
+}
+
+}  // namespace bustub
@@ -0,0 +1,242 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_standby.cpp
+//
+// Identification: src/recovery/log_standby.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/log_standby.h"
+
+#include <poll.h>
+#include <unistd.h>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include "common/exception.h"
+#include "common/logger.h"
+
+namespace bustub {
+
+LogStandby::LogStandby(int fd, DiskManager *disk_manager, BufferPoolManager *buffer_pool_manager)
+    : fd_(fd),
+      disk_manager_(disk_manager),
+      buffer_pool_manager_(buffer_pool_manager),
+      log_recovery_(disk_manager, buffer_pool_manager, 1) {
+  if (pipe(wake_fds_) != 0) {
+    throw Exception("could not create the wake-up pipe of the standby");
+  }
+}
+
+LogStandby::~LogStandby() {
+  Stop();
+  close(fd_);
+  close(wake_fds_[0]);
+  close(wake_fds_[1]);
+}
+
+void LogStandby::Start() {
+  if (enable_logging) {
+    throw Exception("a standby must run where logging is disabled");
+  }
+  if (applier_.joinable()) {
+    return;
+  }
+  applier_ = std::thread([this] { RunApplier(); });
+}
+
+void LogStandby::Stop() {
+  if (!applier_.joinable()) {
+    return;
+  }
+  // Wake up the applier if it is waiting for the primary. This works for a pipe as well, which can't be shut down.
+  char wake = 0;
+  while (write(wake_fds_[1], &wake, 1) < 0 && errno == EINTR) {
+  }
+  applier_.join();
+  // The applier only polls the wake-up pipe, take the byte back for the next Start.
+  while (read(wake_fds_[0], &wake, 1) < 0 && errno == EINTR) {
+  }
+}
+
+bool LogStandby::WaitForLSN(lsn_t lsn, std::chrono::milliseconds timeout) {
+  std::unique_lock lock(applied_latch_);
+  return applied_cv_.wait_for(lock, timeout, [this, lsn] { return applied_lsn_ >= lsn || !connected_; }) &&
+         applied_lsn_ >= lsn;
+}
+
+bool LogStandby::GetTuple(const RID &rid, Tuple *tuple, lsn_t *read_lsn) {
+  read_latch_.RLock();
+  if (read_lsn != nullptr) {
+    *read_lsn = applied_lsn_;
+  }
+  TablePage *page = FetchTablePage(rid.GetPageId());
+  page->RLatch();
+  bool found = ReadTuple(page, rid, tuple);
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  read_latch_.RUnlock();
+  return found;
+}
+
+lsn_t LogStandby::ScanTable(page_id_t first_page_id, const std::function<void(const RID &, const Tuple &)> &visitor) {
+  read_latch_.RLock();
+  lsn_t read_lsn = applied_lsn_;
+  for (page_id_t page_id = first_page_id; page_id != INVALID_PAGE_ID;) {
+    TablePage *page = FetchTablePage(page_id);
+    page->RLatch();
+    for (uint32_t slot = 0; slot < page->GetTupleCount(); slot++) {
+      RID rid(page_id, slot);
+      Tuple tuple;
+      if (ReadTuple(page, rid, &tuple)) {
+        visitor(rid, tuple);
+      }
+    }
+    page_id_t next_page_id = page->GetNextPageId();
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, false);
+    page_id = next_page_id;
+  }
+  read_latch_.RUnlock();
+  return read_lsn;
+}
+
+void LogStandby::RunApplier() {
+  while (true) {
+    ShippedLogHeader header;
+    auto &chunk = chunks_[active_chunk_];
+    if (!ReceiveAll(reinterpret_cast<char *>(&header), sizeof(ShippedLogHeader)) || header.size_ <= 0) {
+      break;
+    }
+    chunk.resize(header.size_);
+    if (!ReceiveAll(chunk.data(), chunk.size())) {
+      break;
+    }
+    if (next_offset_ != -1 && header.offset_ != next_offset_) {
+      LOG_WARN("the shipped log skips from offset %ld to %ld", next_offset_, header.offset_);
+      break;
+    }
+    next_offset_ = header.offset_ + header.size_;
+    disk_manager_->WriteLog(chunk.data(), header.size_);
+    active_chunk_ ^= 1;
+
+    read_latch_.WLock();
+    ApplyChunk(chunk.data(), header.size_);
+    {
+      std::scoped_lock latch(applied_latch_);
+      applied_lsn_ = header.last_lsn_;
+    }
+    read_latch_.WUnlock();
+    apply_lag_.Record(std::chrono::steady_clock::now().time_since_epoch().count() - header.flush_time_);
+    applied_bytes_ += header.size_;
+    applied_cv_.notify_all();
+  }
+  {
+    std::scoped_lock latch(applied_latch_);
+    connected_ = false;
+  }
+  applied_cv_.notify_all();
+}
+
+bool LogStandby::ReceiveAll(char *data, size_t size) {
+  size_t received = 0;
+  while (received < size) {
+    std::array<pollfd, 2> fds{pollfd{fd_, POLLIN, 0}, pollfd{wake_fds_[0], POLLIN, 0}};
+    if (poll(fds.data(), fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    if (fds[1].revents != 0) {
+      return false;
+    }
+    ssize_t ret = read(fd_, data + received, size - received);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ret <= 0) {
+      return false;
+    }
+    received += ret;
+  }
+  return true;
+}
+
+void LogStandby::ApplyChunk(const char *data, int size) {
+  LogRecord log_record;
+  for (int pos = 0; log_recovery_.DeserializeLogRecord(data + pos, size - pos, &log_record);
+       pos += log_record.size_) {
+    switch (log_record.log_record_type_) {
+      case LogRecordType::INSERT:
+        SaveBeforeImage(log_record.txn_id_, log_record.insert_rid_);
+        break;
+      case LogRecordType::MARKDELETE:
+      case LogRecordType::APPLYDELETE:
+      case LogRecordType::ROLLBACKDELETE:
+        SaveBeforeImage(log_record.txn_id_, log_record.delete_rid_);
+        break;
+      case LogRecordType::UPDATE:
+      case LogRecordType::UPDATE_DELTA:
+        SaveBeforeImage(log_record.txn_id_, log_record.update_rid_);
+        break;
+      case LogRecordType::COMMIT:
+      case LogRecordType::ABORT: {
+        // The changes of the transaction are now final, or rolled back by the records before.
+        auto it = txn_tuples_.find(log_record.txn_id_);
+        if (it != txn_tuples_.end()) {
+          for (const auto &rid : it->second) {
+            before_images_.erase(rid);
+          }
+          txn_tuples_.erase(it);
+        }
+        break;
+      }
+      default:
+        break;
+    }
+    log_recovery_.ReplayLogRecord(&log_record);
+    applied_records_++;
+  }
+}
+
+void LogStandby::SaveBeforeImage(txn_id_t txn_id, const RID &rid) {
+  if (before_images_.count(rid) != 0) {
+    return;
+  }
+  BeforeImage image{txn_id, false, Tuple()};
+  TablePage *page = FetchTablePage(rid.GetPageId());
+  page->RLatch();
+  image.exists_ = page->GetTuple(rid, &image.tuple_, nullptr, nullptr);
+  page->RUnlatch();
+  buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
+  before_images_.emplace(rid, std::move(image));
+  txn_tuples_[txn_id].push_back(rid);
+}
+
+bool LogStandby::ReadTuple(TablePage *page, const RID &rid, Tuple *tuple) {
+  auto it = before_images_.find(rid);
+  if (it != before_images_.end()) {
+    if (it->second.exists_) {
+      *tuple = it->second.tuple_;
+    }
+    return it->second.exists_;
+  }
+  return page->GetTuple(rid, tuple, nullptr, nullptr);
+}
+
+TablePage *LogStandby::FetchTablePage(page_id_t page_id) {
+  auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+  if (page == nullptr) {
+    throw Exception(ExceptionType::OUT_OF_MEMORY, "no free frame in the buffer pool of the standby");
+  }
+  return page;
+}
+
+}  // namespace bustub
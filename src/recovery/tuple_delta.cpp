@@ -0,0 +1,156 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// tuple_delta.cpp
+//
+// Identification: src/recovery/tuple_delta.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "recovery/tuple_delta.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace bustub {
+
+TupleDelta::TupleDelta(const Tuple &old_tuple, const Tuple &new_tuple)
+    : old_size_(old_tuple.GetLength()), new_size_(new_tuple.GetLength()) {
+  const char *old_data = old_tuple.GetData();
+  const char *new_data = new_tuple.GetData();
+  uint32_t common = std::min(old_size_, new_size_);
+  uint32_t prefix = 0;
+  while (prefix < common && old_data[prefix] == new_data[prefix]) {
+    prefix++;
+  }
+  uint32_t suffix = 0;
+  while (suffix < common - prefix && old_data[old_size_ - suffix - 1] == new_data[new_size_ - suffix - 1]) {
+    suffix++;
+  }
+
+  auto add_range = [this, old_data, new_data](uint32_t old_begin, uint32_t old_end, uint32_t new_begin,
+                                             uint32_t new_end) {
+    ranges_.push_back(Range{static_cast<uint16_t>(old_begin), static_cast<uint16_t>(old_end - old_begin),
+                            static_cast<uint16_t>(new_end - new_begin)});
+    old_bytes_.insert(old_bytes_.end(), old_data + old_begin, old_data + old_end);
+    new_bytes_.insert(new_bytes_.end(), new_data + new_begin, new_data + new_end);
+  };
+  if (old_size_ != new_size_) {
+    add_range(prefix, old_size_ - suffix, prefix, new_size_ - suffix);
+    return;
+  }
+  // Unchanged bytes are logged twice when two ranges are merged across them, a range header once.
+  const uint32_t max_gap = sizeof(Range) / 2;
+  uint32_t end = old_size_ - suffix;
+  uint32_t begin = prefix;
+  while (begin < end) {
+    uint32_t range_end = begin + 1;
+    uint32_t gap = 0;
+    for (uint32_t i = range_end; i < end && gap <= max_gap; i++) {
+      if (old_data[i] == new_data[i]) {
+        gap++;
+      } else {
+        range_end = i + 1;
+        gap = 0;
+      }
+    }
+    add_range(begin, range_end, begin, range_end);
+    begin = range_end;
+    while (begin < end && old_data[begin] == new_data[begin]) {
+      begin++;
+    }
+  }
+}
+
+void TupleDelta::SerializeTo(char *storage) const {
+  auto num_ranges = static_cast<uint16_t>(ranges_.size());
+  memcpy(storage, &old_size_, sizeof(uint16_t));
+  memcpy(storage + sizeof(uint16_t), &new_size_, sizeof(uint16_t));
+  memcpy(storage + 2 * sizeof(uint16_t), &num_ranges, sizeof(uint16_t));
+  char *pos = storage + 3 * sizeof(uint16_t);
+  memcpy(pos, ranges_.data(), ranges_.size() * sizeof(Range));
+  pos += ranges_.size() * sizeof(Range);
+  memcpy(pos, old_bytes_.data(), old_bytes_.size());
+  memcpy(pos + old_bytes_.size(), new_bytes_.data(), new_bytes_.size());
+}
+
+bool TupleDelta::DeserializeFrom(const char *storage, uint32_t size) {
+  uint16_t num_ranges;
+  if (size < 3 * sizeof(uint16_t)) {
+    return false;
+  }
+  memcpy(&old_size_, storage, sizeof(uint16_t));
+  memcpy(&new_size_, storage + sizeof(uint16_t), sizeof(uint16_t));
+  memcpy(&num_ranges, storage + 2 * sizeof(uint16_t), sizeof(uint16_t));
+  uint32_t pos = 3 * sizeof(uint16_t);
+  if (pos + num_ranges * sizeof(Range) > size) {
+    return false;
+  }
+  ranges_.resize(num_ranges);
+  memcpy(ranges_.data(), storage + pos, num_ranges * sizeof(Range));
+  pos += num_ranges * sizeof(Range);
+
+  uint32_t old_length = 0;
+  uint32_t new_length = 0;
+  uint32_t old_end = 0;
+  for (const auto &range : ranges_) {
+    if (range.offset_ < old_end || range.offset_ + range.old_length_ > old_size_) {
+      return false;
+    }
+    old_end = range.offset_ + range.old_length_;
+    old_length += range.old_length_;
+    new_length += range.new_length_;
+  }
+  if (old_size_ - old_length + new_length != new_size_ || pos + old_length + new_length > size) {
+    return false;
+  }
+  old_bytes_.assign(storage + pos, storage + pos + old_length);
+  new_bytes_.assign(storage + pos + old_length, storage + pos + old_length + new_length);
+  return true;
+}
+
+bool TupleDelta::Redo(const Tuple &old_tuple, Tuple *new_tuple) const { return Apply(old_tuple, new_tuple, true); }
+
+bool TupleDelta::Undo(const Tuple &new_tuple, Tuple *old_tuple) const { return Apply(new_tuple, old_tuple, false); }
+
+bool TupleDelta::Apply(const Tuple &src, Tuple *dst, bool forward) const {
+  uint32_t src_size = forward ? old_size_ : new_size_;
+  uint32_t dst_size = forward ? new_size_ : old_size_;
+  const char *src_data = src.GetData();
+  if (src.GetLength() != src_size) {
+    return false;
+  }
+  // Tuple has no constructor from raw bytes, so the image is built in its length-prefixed serialized format.
+  std::vector<char> serialized(sizeof(uint32_t) + dst_size);
+  memcpy(serialized.data(), &dst_size, sizeof(uint32_t));
+  char *dst_data = serialized.data() + sizeof(uint32_t);
+  const char *replacement = forward ? new_bytes_.data() : old_bytes_.data();
+  const char *expected = forward ? old_bytes_.data() : new_bytes_.data();
+  uint32_t src_pos = 0;
+  uint32_t dst_pos = 0;
+  for (const auto &range : ranges_) {
+    uint32_t src_length = forward ? range.old_length_ : range.new_length_;
+    uint32_t dst_length = forward ? range.new_length_ : range.old_length_;
+    // Range offsets are in the old image.
+    uint32_t unchanged = range.offset_ - (forward ? src_pos : dst_pos);
+    memcpy(dst_data + dst_pos, src_data + src_pos, unchanged);
+    src_pos += unchanged;
+    dst_pos += unchanged;
+    if (memcmp(src_data + src_pos, expected, src_length) != 0) {
+      return false;
+    }
+    memcpy(dst_data + dst_pos, replacement, dst_length);
+    src_pos += src_length;
+    dst_pos += dst_length;
+    expected += src_length;
+    replacement += dst_length;
+  }
+  memcpy(dst_data + dst_pos, src_data + src_pos, src_size - src_pos);
+  dst->DeserializeFrom(serialized.data());
+  return true;
+}
+
+}  // namespace bustub
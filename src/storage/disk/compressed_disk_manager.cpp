@@ -0,0 +1,248 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// compressed_disk_manager.cpp
+//
+// Identification: src/storage/disk/compressed_disk_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/compressed_disk_manager.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <string>
+
+#include "common/exception.h"
+#include "common/logger.h"
+#include "storage/disk/page_codec.h"
+
+namespace bustub {
+
+static_assert(sizeof(CompressedDiskManager::MapEntry) == 8, "page-mapping entries are stored as 8 bytes");
+static_assert(PAGE_SIZE <= UINT16_MAX, "image lengths are stored as 16 bits");
+
+namespace {
+
+uint64_t ElapsedNs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool PWriteAll(int fd, const char *data, size_t size, size_t offset) {
+  size_t written = 0;
+  while (written < size) {
+    ssize_t ret = pwrite(fd, data + written, size - written, offset + written);
+    if (ret < 0) {
+      return false;
+    }
+    written += ret;
+  }
+  return true;
+}
+
+size_t PReadAll(int fd, char *data, size_t size, size_t offset) {
+  size_t read_count = 0;
+  while (read_count < size) {
+    ssize_t ret = pread(fd, data + read_count, size - read_count, offset + read_count);
+    if (ret <= 0) {
+      break;
+    }
+    read_count += ret;
+  }
+  return read_count;
+}
+
+}  // namespace
+
+CompressedDiskManager::CompressedDiskManager(const std::string &db_file) : DiskManager(db_file) {
+  std::string::size_type n = db_file.rfind('.');
+  map_name_ = (n == std::string::npos ? db_file : db_file.substr(0, n)) + ".map";
+
+  data_fd_ = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  if (data_fd_ < 0) {
+    throw Exception("can't open db file");
+  }
+  map_fd_ = open(map_name_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (map_fd_ < 0) {
+    close(data_fd_);
+    throw Exception("can't open page map file");
+  }
+
+  // Load the page map, and rebuild the free extents from the holes between live extents.
+  int64_t map_size = GetFileSize(map_name_);
+  if (map_size > 0) {
+    page_map_.resize(map_size / sizeof(MapEntry));
+    PReadAll(map_fd_, reinterpret_cast<char *>(page_map_.data()), page_map_.size() * sizeof(MapEntry), 0);
+  }
+  std::vector<MapEntry> live;
+  for (const auto &entry : page_map_) {
+    if (entry.capacity_ != 0) {
+      live.push_back(entry);
+    }
+  }
+  std::sort(live.begin(), live.end(), [](const MapEntry &a, const MapEntry &b) { return a.sector_ < b.sector_; });
+  for (const auto &entry : live) {
+    while (next_sector_ < entry.sector_) {
+      auto hole = static_cast<uint16_t>(std::min<uint32_t>(entry.sector_ - next_sector_, UINT16_MAX));
+      free_extents_.emplace(hole, next_sector_);
+      next_sector_ += hole;
+    }
+    next_sector_ = std::max(next_sector_, entry.sector_ + entry.capacity_);
+  }
+}
+
+CompressedDiskManager::~CompressedDiskManager() {
+  if (data_fd_ >= 0) {
+    close(data_fd_);
+  }
+  if (map_fd_ >= 0) {
+    close(map_fd_);
+  }
+}
+
+void CompressedDiskManager::ShutDown() {
+  {
+    std::scoped_lock latch(latch_);
+    if (data_fd_ >= 0) {
+      close(data_fd_);
+      data_fd_ = -1;
+    }
+    if (map_fd_ >= 0) {
+      close(map_fd_);
+      map_fd_ = -1;
+    }
+  }
+  DiskManager::ShutDown();
+}
+
+uint32_t CompressedDiskManager::AllocateExtent(uint16_t sectors) {
+  // Best fit among the free extents, splitting off the unused tail.
+  auto it = free_extents_.lower_bound(sectors);
+  if (it != free_extents_.end()) {
+    uint16_t capacity = it->first;
+    uint32_t sector = it->second;
+    free_extents_.erase(it);
+    if (capacity > sectors) {
+      free_extents_.emplace(capacity - sectors, sector + sectors);
+    }
+    return sector;
+  }
+  uint32_t sector = next_sector_;
+  next_sector_ += sectors;
+  return sector;
+}
+
+/**
+ * Compress the specified page and write it into its extent, moving it to a new extent if it has outgrown its old one
+ */
+void CompressedDiskManager::WritePgImp(page_id_t page_id, const char *page_data) {
+  char buffer[PageCodec::MaxCompressedSize(PAGE_SIZE)];
+  auto start = std::chrono::steady_clock::now();
+  size_t length = PageCodec::Compress(page_data, PAGE_SIZE, buffer, PAGE_SIZE - 1);
+  compress_ns_ += ElapsedNs(start);
+  const char *image = buffer;
+  if (length == 0) {
+    // Incompressible, store the page as is.
+    length = PAGE_SIZE;
+    image = page_data;
+  }
+  auto sectors = static_cast<uint16_t>((length + SECTOR_SIZE - 1) / SECTOR_SIZE);
+
+  MapEntry entry;
+  MapEntry old_entry{0, 0, 0};
+  {
+    std::scoped_lock latch(latch_);
+    if (static_cast<size_t>(page_id) >= page_map_.size()) {
+      page_map_.resize(page_id + 1, MapEntry{0, 0, 0});
+    }
+    entry = page_map_[page_id];
+    if (entry.capacity_ < sectors) {
+      // The old extent is only freed below, once nothing on disk points to it any more.
+      old_entry = entry;
+      entry.sector_ = AllocateExtent(sectors);
+      entry.capacity_ = sectors;
+    }
+    entry.length_ = static_cast<uint16_t>(length);
+    page_map_[page_id] = entry;
+  }
+
+  num_writes_ += 1;
+  logical_bytes_written_ += PAGE_SIZE;
+  physical_bytes_written_ += length;
+  bool moved = old_entry.capacity_ != 0;
+  // A moved page is written to its new extent and synced before the mapping entry points there, and the entry is
+  // synced before the old extent can be reused, so a crash leaves the page with its old or its new image.
+  if (!PWriteAll(data_fd_, image, length, static_cast<size_t>(entry.sector_) * SECTOR_SIZE) ||
+      (moved && fdatasync(data_fd_) != 0) ||
+      !PWriteAll(map_fd_, reinterpret_cast<const char *>(&entry), sizeof(entry), page_id * sizeof(MapEntry)) ||
+      (moved && fdatasync(map_fd_) != 0)) {
+    LOG_DEBUG("I/O error while writing");
+    // Leave the old extent allocated, the entry on disk may still point to it.
+    return;
+  }
+  if (moved) {
+    std::scoped_lock latch(latch_);
+    free_extents_.emplace(old_entry.capacity_, old_entry.sector_);
+  }
+}
+
+/**
+ * Read the compressed image of the specified page and decompress it into the given memory area
+ */
+void CompressedDiskManager::ReadPgImp(page_id_t page_id, char *page_data) {
+  MapEntry entry{0, 0, 0};
+  {
+    std::scoped_lock latch(latch_);
+    if (static_cast<size_t>(page_id) < page_map_.size()) {
+      entry = page_map_[page_id];
+    }
+  }
+  logical_bytes_read_ += PAGE_SIZE;
+  if (entry.length_ == 0) {
+    LOG_DEBUG("I/O error reading past end of file");
+    memset(page_data, 0, PAGE_SIZE);
+    return;
+  }
+
+  size_t offset = static_cast<size_t>(entry.sector_) * SECTOR_SIZE;
+  physical_bytes_read_ += entry.length_;
+  if (entry.length_ == PAGE_SIZE) {
+    if (PReadAll(data_fd_, page_data, PAGE_SIZE, offset) < static_cast<size_t>(PAGE_SIZE)) {
+      LOG_DEBUG("Read less than a page");
+    }
+    return;
+  }
+  char buffer[PAGE_SIZE];
+  size_t read_count = PReadAll(data_fd_, buffer, entry.length_, offset);
+  auto start = std::chrono::steady_clock::now();
+  size_t decompressed = PageCodec::Decompress(buffer, read_count, page_data, PAGE_SIZE);
+  decompress_ns_ += ElapsedNs(start);
+  if (decompressed != static_cast<size_t>(PAGE_SIZE)) {
+    LOG_DEBUG("I/O error while reading, corrupted page image");
+    memset(page_data, 0, PAGE_SIZE);
+  }
+}
+
+void CompressedDiskManager::ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data) {
+  for (int i = 0; i < num_pages; i++) {
+    ReadPgImp(first_page_id + i, page_data + static_cast<size_t>(i) * PAGE_SIZE);
+  }
+}
+
+CompressedDiskManager::CompressionStats CompressedDiskManager::GetCompressionStats() const {
+  return CompressionStats{logical_bytes_written_, physical_bytes_written_, logical_bytes_read_,
+                          physical_bytes_read_,   compress_ns_,           decompress_ns_};
+}
+
+size_t CompressedDiskManager::GetAllocatedSectors() {
+  std::scoped_lock latch(latch_);
+  return next_sector_;
+}
+
+}  // namespace bustub
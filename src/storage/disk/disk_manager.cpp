@@ -10,9 +10,14 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
 #include <cassert>
+#include <chrono>  // NOLINT
 #include <cstring>
+#include <filesystem>
 #include <iostream>
 #include <mutex>  // NOLINT
 #include <string>
@@ -30,27 +35,35 @@ static char *buffer_used;
  * Constructor: open/create a single database file & log file
  * @input db_file: database file name
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), num_flushes_(0), num_writes_(0), flush_log_(false), flush_log_f_(nullptr) {
+DiskManager::DiskManager(const std::string &db_file) : file_name_(db_file) {
   std::string::size_type n = file_name_.rfind('.');
   if (n == std::string::npos) {
     LOG_DEBUG("wrong file format");
     return;
   }
   log_name_ = file_name_.substr(0, n) + ".log";
+  master_name_ = file_name_.substr(0, n) + ".master";
+  warmup_name_ = file_name_.substr(0, n) + ".warmup";
 
-  log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
-  // directory or file does not exist
-  if (!log_io_.is_open()) {
-    log_io_.clear();
-    // create a new file
-    log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app | std::ios::out);
-    log_io_.close();
-    // reopen with original mode
+  log_segment_size_ = log_segment_size;
+  if (log_segment_size_ > 0) {
+    OpenLogSegments();
+  } else {
     log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
+    // directory or file does not exist
     if (!log_io_.is_open()) {
-      throw Exception("can't open dblog file");
+      log_io_.clear();
+      // create a new file
+      log_io_.open(log_name_, std::ios::binary | std::ios::trunc | std::ios::app | std::ios::out);
+      log_io_.close();
+      // reopen with original mode
+      log_io_.open(log_name_, std::ios::binary | std::ios::in | std::ios::app | std::ios::out);
+      if (!log_io_.is_open()) {
+        throw Exception("can't open dblog file");
+      }
     }
+    // The stream has no way to sync, so keep a descriptor of the log file for fdatasync.
+    log_fd_ = open(log_name_.c_str(), O_RDONLY);
   }
 
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
@@ -70,6 +83,16 @@ DiskManager::DiskManager(const std::string &db_file)
   buffer_used = nullptr;
 }
 
+DiskManager::~DiskManager() {
+  StopStatsDump();
+  if (log_fd_ >= 0) {
+    close(log_fd_);
+  }
+  for (const auto &[segment, fd] : log_segments_) {
+    close(fd);
+  }
+}
+
 /**
  * Close all file streams
  */
@@ -79,12 +102,111 @@ void DiskManager::ShutDown() {
     db_io_.close();
   }
   log_io_.close();
+  if (log_fd_ >= 0) {
+    close(log_fd_);
+    log_fd_ = -1;
+  }
+  std::scoped_lock latch(log_segment_latch_);
+  for (const auto &[segment, fd] : log_segments_) {
+    close(fd);
+  }
+  log_segments_.clear();
+}
+
+namespace {
+
+uint64_t ElapsedNs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool PWriteAll(int fd, const char *data, size_t size, size_t offset) {
+  size_t written = 0;
+  while (written < size) {
+    ssize_t ret = pwrite(fd, data + written, size - written, offset + written);
+    if (ret < 0) {
+      return false;
+    }
+    written += ret;
+  }
+  return true;
+}
+
+size_t PReadAll(int fd, char *data, size_t size, size_t offset) {
+  size_t read_count = 0;
+  while (read_count < size) {
+    ssize_t ret = pread(fd, data + read_count, size - read_count, offset + read_count);
+    if (ret <= 0) {
+      break;
+    }
+    read_count += ret;
+  }
+  return read_count;
+}
+
+}  // namespace
+
+void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
+  auto start = std::chrono::steady_clock::now();
+  WritePgImp(page_id, page_data);
+  stats_.Record(DiskOp::PAGE_WRITE, page_id, PAGE_SIZE, ElapsedNs(start));
+}
+
+void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
+  auto start = std::chrono::steady_clock::now();
+  ReadPgImp(page_id, page_data);
+  stats_.Record(DiskOp::PAGE_READ, page_id, PAGE_SIZE, ElapsedNs(start));
+}
+
+void DiskManager::ReadPages(page_id_t first_page_id, int num_pages, char *page_data) {
+  auto start = std::chrono::steady_clock::now();
+  ReadPagesImp(first_page_id, num_pages, page_data);
+  stats_.Record(DiskOp::PAGE_READ, first_page_id, static_cast<size_t>(num_pages) * PAGE_SIZE, ElapsedNs(start));
+}
+
+void DiskManager::WriteLog(char *log_data, int size) {
+  // The log is append-only, so every flush starts where the previous one ended.
+  auto offset = static_cast<int64_t>(stats_.GetBytes(DiskOp::LOG_WRITE));
+  auto start = std::chrono::steady_clock::now();
+  WriteLogImp(log_data, size);
+  if (size != 0) {
+    stats_.Record(DiskOp::LOG_WRITE, offset, size, ElapsedNs(start));
+  }
+}
+
+bool DiskManager::ReadLog(char *log_data, int size, int64_t offset) {
+  auto start = std::chrono::steady_clock::now();
+  bool success = ReadLogImp(log_data, size, offset);
+  stats_.Record(DiskOp::LOG_READ, offset, size, ElapsedNs(start));
+  return success;
+}
+
+void DiskManager::StartStatsDump(std::chrono::milliseconds interval) {
+  StopStatsDump();
+  stats_dump_interval_ = interval;
+  stats_dump_enabled_ = true;
+  stats_dump_thread_ = std::thread([this] {
+    std::unique_lock lock(stats_dump_latch_);
+    while (!stats_dump_cv_.wait_for(lock, stats_dump_interval_, [this] { return !stats_dump_enabled_; })) {
+      LOG_INFO("disk I/O statistics:\n%s", stats_.ToString().c_str());
+    }
+  });
+}
+
+void DiskManager::StopStatsDump() {
+  {
+    std::scoped_lock lock(stats_dump_latch_);
+    stats_dump_enabled_ = false;
+  }
+  stats_dump_cv_.notify_all();
+  if (stats_dump_thread_.joinable()) {
+    stats_dump_thread_.join();
+  }
 }
 
 /**
  * Write the contents of the specified page into disk file
  */
-void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
+void DiskManager::WritePgImp(page_id_t page_id, const char *page_data) {
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
   size_t offset = static_cast<size_t>(page_id) * PAGE_SIZE;
   // set write cursor to offset
@@ -103,7 +225,7 @@ void DiskManager::WritePage(page_id_t page_id, const char *page_data) {
 /**
  * Read the contents of the specified page into the given memory area
  */
-void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
+void DiskManager::ReadPgImp(page_id_t page_id, char *page_data) {
   std::scoped_lock scoped_db_io_latch(db_io_latch_);
   int offset = page_id * PAGE_SIZE;
   // check if read beyond file length
@@ -129,11 +251,31 @@ void DiskManager::ReadPage(page_id_t page_id, char *page_data) {
   }
 }
 
+/**
+ * Read the contents of consecutive pages into the given memory area with one read
+ */
+void DiskManager::ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data) {
+  std::scoped_lock scoped_db_io_latch(db_io_latch_);
+  size_t size = static_cast<size_t>(num_pages) * PAGE_SIZE;
+  db_io_.seekg(static_cast<size_t>(first_page_id) * PAGE_SIZE);
+  db_io_.read(page_data, size);
+  if (db_io_.bad()) {
+    LOG_DEBUG("I/O error while reading");
+    return;
+  }
+  // Pages past the end of the file read as zeroes.
+  size_t read_count = db_io_.gcount();
+  if (read_count < size) {
+    db_io_.clear();
+    memset(page_data + read_count, 0, size - read_count);
+  }
+}
+
 /**
  * Write the contents of the log into disk file
  * Only return when sync is done, and only perform sequence write
  */
-void DiskManager::WriteLog(char *log_data, int size) {
+void DiskManager::WriteLogImp(char *log_data, int size) {
   // enforce swap log buffer
   assert(log_data != buffer_used);
   buffer_used = log_data;
@@ -150,6 +292,11 @@ void DiskManager::WriteLog(char *log_data, int size) {
   }
 
   num_flushes_ += 1;
+  if (log_segment_size_ > 0) {
+    WriteLogSegments(log_data, size);
+    flush_log_ = false;
+    return;
+  }
   // sequence write
   log_io_.write(log_data, size);
 
@@ -158,8 +305,11 @@ void DiskManager::WriteLog(char *log_data, int size) {
     LOG_DEBUG("I/O error while writing log");
     return;
   }
-  // needs to flush to keep disk file in sync
+  // needs to flush to keep disk file in sync, and to sync to make the log records durable
   log_io_.flush();
+  if (log_fd_ >= 0 && fdatasync(log_fd_) != 0) {
+    LOG_DEBUG("I/O error while syncing log");
+  }
   flush_log_ = false;
 }
 
@@ -168,7 +318,10 @@ void DiskManager::WriteLog(char *log_data, int size) {
  * Always read from the beginning and perform sequence read
  * @return: false means already reach the end
  */
-bool DiskManager::ReadLog(char *log_data, int size, int offset) {
+bool DiskManager::ReadLogImp(char *log_data, int size, int64_t offset) {
+  if (log_segment_size_ > 0) {
+    return ReadLogSegments(log_data, size, offset);
+  }
   if (offset >= GetFileSize(log_name_)) {
     // LOG_DEBUG("end of log file");
     // LOG_DEBUG("file size is %d", GetFileSize(log_name_));
@@ -191,6 +344,208 @@ bool DiskManager::ReadLog(char *log_data, int size, int offset) {
   return true;
 }
 
+int64_t DiskManager::GetLogSize() {
+  if (log_segment_size_ > 0) {
+    std::scoped_lock latch(log_segment_latch_);
+    return log_end_;
+  }
+  return std::max<int64_t>(GetFileSize(log_name_), 0);
+}
+
+int64_t DiskManager::GetLogStart() {
+  std::scoped_lock latch(log_segment_latch_);
+  return log_start_;
+}
+
+size_t DiskManager::GetNumLogSegments() {
+  std::scoped_lock latch(log_segment_latch_);
+  return log_segments_.size();
+}
+
+void DiskManager::OpenLogSegments() {
+  namespace fs = std::filesystem;
+  fs::path log_path(log_name_);
+  fs::path directory = log_path.has_parent_path() ? log_path.parent_path() : fs::path(".");
+  std::string segment_prefix = log_path.filename().string() + ".";
+  std::string spare_prefix = segment_prefix + "spare.";
+  std::error_code ec;
+  for (const auto &entry : fs::directory_iterator(directory, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.compare(0, spare_prefix.size(), spare_prefix) == 0) {
+      spare_log_segments_.push_back(entry.path().string());
+      continue;
+    }
+    if (name.size() == segment_prefix.size() || name.compare(0, segment_prefix.size(), segment_prefix) != 0 ||
+        name.find_first_not_of("0123456789", segment_prefix.size()) != std::string::npos) {
+      continue;
+    }
+    int fd = open(entry.path().c_str(), O_RDWR);
+    if (fd < 0) {
+      throw Exception("can't open log segment");
+    }
+    // Recovery reads the retained segments front to back.
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    log_segments_[std::stoll(name.substr(segment_prefix.size()))] = fd;
+  }
+  // Every segment but the last one is full, and a segment file is exactly as long as the log bytes it holds.
+  if (!log_segments_.empty()) {
+    int64_t last = log_segments_.rbegin()->first;
+    log_end_ = last * log_segment_size_ + std::max<int64_t>(GetFileSize(SegmentName(last)), 0);
+    log_start_ = log_segments_.begin()->first * log_segment_size_;
+  }
+}
+
+int DiskManager::CreateLogSegment(int64_t segment) {
+  std::string name = SegmentName(segment);
+  // Recycling a spare saves creating a file. Its blocks are freed all the same: the file size marks the end of the
+  // log, so the old records have to go.
+  while (!spare_log_segments_.empty()) {
+    std::string spare = spare_log_segments_.back();
+    spare_log_segments_.pop_back();
+    if (rename(spare.c_str(), name.c_str()) == 0) {
+      break;
+    }
+  }
+  int fd = open(name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw Exception("can't create log segment");
+  }
+  // Allocate the whole segment up front so that appends do not have to, without changing the file size, which is
+  // how the end of the log is found again. Failing to preallocate only costs performance.
+  if (fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, log_segment_size_) != 0) {
+    LOG_DEBUG("I/O error while preallocating log segment");
+  }
+  // Make the new name durable before any log record relies on it.
+  std::string directory = std::filesystem::path(name).parent_path().string();
+  int dir_fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY);
+  if (dir_fd >= 0) {
+    fsync(dir_fd);
+    close(dir_fd);
+  }
+  log_segments_[segment] = fd;
+  return fd;
+}
+
+void DiskManager::WriteLogSegments(const char *log_data, int size) {
+  std::scoped_lock latch(log_segment_latch_);
+  while (size > 0) {
+    int64_t segment = log_end_ / log_segment_size_;
+    int64_t position = log_end_ % log_segment_size_;
+    auto it = log_segments_.find(segment);
+    int fd = it == log_segments_.end() ? CreateLogSegment(segment) : it->second;
+    auto length = static_cast<int>(std::min<int64_t>(size, log_segment_size_ - position));
+    if (!PWriteAll(fd, log_data, length, position)) {
+      LOG_DEBUG("I/O error while writing log");
+      return;
+    }
+    if (fdatasync(fd) != 0) {
+      LOG_DEBUG("I/O error while syncing log");
+    }
+    log_data += length;
+    size -= length;
+    log_end_ += length;
+  }
+}
+
+bool DiskManager::ReadLogSegments(char *log_data, int size, int64_t offset) {
+  std::scoped_lock latch(log_segment_latch_);
+  if (offset >= log_end_) {
+    return false;
+  }
+  if (offset < log_start_) {
+    LOG_DEBUG("reading truncated log");
+    return false;
+  }
+  int read_count = 0;
+  while (read_count < size && offset < log_end_) {
+    auto it = log_segments_.find(offset / log_segment_size_);
+    if (it == log_segments_.end()) {
+      break;
+    }
+    int64_t position = offset % log_segment_size_;
+    auto length = static_cast<size_t>(
+        std::min<int64_t>({static_cast<int64_t>(size - read_count), log_segment_size_ - position, log_end_ - offset}));
+    size_t count = PReadAll(it->second, log_data + read_count, length, position);
+    read_count += count;
+    offset += count;
+    if (count < length) {
+      break;
+    }
+  }
+  // if the log ends before reading "size"
+  memset(log_data + read_count, 0, size - read_count);
+  return true;
+}
+
+void DiskManager::TruncateLog(int64_t offset) {
+  std::scoped_lock latch(log_segment_latch_);
+  while (log_segments_.size() > 1 && (log_segments_.begin()->first + 1) * log_segment_size_ <= offset) {
+    auto oldest = log_segments_.begin();
+    close(oldest->second);
+    std::string name = SegmentName(oldest->first);
+    std::string spare = log_name_ + ".spare." + std::to_string(oldest->first);
+    if (spare_log_segments_.size() < MAX_SPARE_LOG_SEGMENTS && rename(name.c_str(), spare.c_str()) == 0) {
+      spare_log_segments_.push_back(spare);
+    } else {
+      unlink(name.c_str());
+    }
+    log_segments_.erase(oldest);
+  }
+  if (!log_segments_.empty()) {
+    log_start_ = log_segments_.begin()->first * log_segment_size_;
+  }
+}
+
+/**
+ * The master record is far smaller than a sector, so overwriting it in place is atomic.
+ */
+void DiskManager::WriteMasterRecord(const char *data, int size) {
+  int fd = open(master_name_.c_str(), O_WRONLY | O_CREAT, 0644);
+  if (fd < 0 || pwrite(fd, data, size, 0) != size || fdatasync(fd) != 0) {
+    LOG_DEBUG("I/O error while writing master record");
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+bool DiskManager::ReadMasterRecord(char *data, int size) {
+  int fd = open(master_name_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool success = pread(fd, data, size, 0) == size;
+  close(fd);
+  return success;
+}
+
+void DiskManager::WriteWarmupList(const std::vector<page_id_t> &page_ids) {
+  // Write a new file and rename it over the old one, so that a crash leaves either list intact.
+  std::string tmp_name = warmup_name_ + ".tmp";
+  int fd = open(tmp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  size_t size = page_ids.size() * sizeof(page_id_t);
+  if (fd < 0 || !PWriteAll(fd, reinterpret_cast<const char *>(page_ids.data()), size, 0) || fdatasync(fd) != 0 ||
+      rename(tmp_name.c_str(), warmup_name_.c_str()) != 0) {
+    LOG_DEBUG("I/O error while writing warm-up list");
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+}
+
+bool DiskManager::ReadWarmupList(std::vector<page_id_t> *page_ids) {
+  int64_t size = GetFileSize(warmup_name_);
+  int fd = open(warmup_name_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  page_ids->resize(std::max<int64_t>(size, 0) / sizeof(page_id_t));
+  size_t expected = page_ids->size() * sizeof(page_id_t);
+  bool success = PReadAll(fd, reinterpret_cast<char *>(page_ids->data()), expected, 0) == expected;
+  close(fd);
+  return success;
+}
+
 /**
  * Returns number of flushes made so far
  */
@@ -209,10 +564,10 @@ bool DiskManager::GetFlushState() const { return flush_log_; }
 /**
  * Private helper function to get disk file size
  */
-int DiskManager::GetFileSize(const std::string &file_name) {
+int64_t DiskManager::GetFileSize(const std::string &file_name) {
   struct stat stat_buf;
   int rc = stat(file_name.c_str(), &stat_buf);
-  return rc == 0 ? static_cast<int>(stat_buf.st_size) : -1;
+  return rc == 0 ? static_cast<int64_t>(stat_buf.st_size) : -1;
 }
 
 }  // namespace bustub
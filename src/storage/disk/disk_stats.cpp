@@ -0,0 +1,106 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// disk_stats.cpp
+//
+// Identification: src/storage/disk/disk_stats.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/disk_stats.h"
+
+#include <sstream>
+
+namespace bustub {
+
+void LatencyHistogram::Record(uint64_t latency_ns) {
+  uint64_t latency_us = latency_ns / 1000;
+  size_t bucket = 0;
+  while (latency_us != 0 && bucket < NUM_BUCKETS - 1) {
+    latency_us >>= 1;
+    bucket++;
+  }
+  buckets_[bucket]++;
+  total_ns_ += latency_ns;
+}
+
+uint64_t LatencyHistogram::GetCount() const {
+  uint64_t count = 0;
+  for (const auto &bucket : buckets_) {
+    count += bucket.load();
+  }
+  return count;
+}
+
+uint64_t LatencyHistogram::GetPercentile(double percentile) const {
+  uint64_t count = GetCount();
+  if (count == 0) {
+    return 0;
+  }
+  auto rank = static_cast<uint64_t>(percentile / 100 * count);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < NUM_BUCKETS; i++) {
+    seen += buckets_[i].load();
+    if (seen >= rank && seen > 0) {
+      return GetBucketBound(i);
+    }
+  }
+  return GetBucketBound(NUM_BUCKETS - 1);
+}
+
+double LatencyHistogram::GetMean() const {
+  uint64_t count = GetCount();
+  return count == 0 ? 0 : static_cast<double>(total_ns_.load()) / 1000 / count;
+}
+
+void LatencyHistogram::Reset() {
+  for (auto &bucket : buckets_) {
+    bucket = 0;
+  }
+  total_ns_ = 0;
+}
+
+void DiskStats::Record(DiskOp op, int64_t position, size_t bytes, uint64_t latency_ns) {
+  auto &stats = ops_[static_cast<size_t>(op)];
+  int64_t next = (op == DiskOp::PAGE_READ || op == DiskOp::PAGE_WRITE) ? position + 1 : position + bytes;
+  if (stats.next_position_.exchange(next) == position) {
+    stats.sequential_++;
+  }
+  stats.count_++;
+  stats.bytes_ += bytes;
+  stats.latency_.Record(latency_ns);
+}
+
+void DiskStats::Reset() {
+  for (auto &stats : ops_) {
+    stats.count_ = 0;
+    stats.bytes_ = 0;
+    stats.sequential_ = 0;
+    stats.next_position_ = -1;
+    stats.latency_.Reset();
+  }
+}
+
+std::string DiskStats::ToString() const {
+  static const char *names[] = {"page read", "page write", "log read", "log write"};
+  std::ostringstream os;
+  for (size_t i = 0; i < ops_.size(); i++) {
+    const auto &stats = ops_[i];
+    uint64_t count = stats.count_.load();
+    if (i != 0) {
+      os << "\n";
+    }
+    os << names[i] << ": " << count << " ops, " << stats.bytes_.load() << " bytes, " << stats.sequential_.load()
+       << " sequential";
+    if (count != 0) {
+      os << ", avg " << stats.latency_.GetMean() << "us, p50 <" << stats.latency_.GetPercentile(50) << "us, p99 <"
+         << stats.latency_.GetPercentile(99) << "us, max <" << stats.latency_.GetPercentile(100) << "us";
+    }
+  }
+  return os.str();
+}
+
+}  // namespace bustub
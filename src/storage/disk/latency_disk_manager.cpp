@@ -0,0 +1,98 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// latency_disk_manager.cpp
+//
+// Identification: src/storage/disk/latency_disk_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/latency_disk_manager.h"
+
+#include <algorithm>
+#include <thread>  // NOLINT
+
+namespace bustub {
+
+LatencyDiskManager::LatencyDiskManager(DiskManager *disk_manager, const DiskProfile &profile)
+    : disk_manager_(disk_manager), profile_(profile), device_free_(std::chrono::steady_clock::now()) {}
+
+void LatencyDiskManager::ShutDown() { disk_manager_->ShutDown(); }
+
+int64_t LatencyDiskManager::GetLogSize() { return disk_manager_->GetLogSize(); }
+
+int64_t LatencyDiskManager::GetLogStart() { return disk_manager_->GetLogStart(); }
+
+void LatencyDiskManager::TruncateLog(int64_t offset) { disk_manager_->TruncateLog(offset); }
+
+void LatencyDiskManager::WriteMasterRecord(const char *data, int size) {
+  disk_manager_->WriteMasterRecord(data, size);
+  Delay(size, profile_.log_latency_);
+}
+
+bool LatencyDiskManager::ReadMasterRecord(char *data, int size) {
+  Delay(size, profile_.read_latency_);
+  return disk_manager_->ReadMasterRecord(data, size);
+}
+
+void LatencyDiskManager::WriteWarmupList(const std::vector<page_id_t> &page_ids) {
+  disk_manager_->WriteWarmupList(page_ids);
+  Delay(page_ids.size() * sizeof(page_id_t), profile_.log_latency_);
+}
+
+bool LatencyDiskManager::ReadWarmupList(std::vector<page_id_t> *page_ids) {
+  bool success = disk_manager_->ReadWarmupList(page_ids);
+  Delay(page_ids->size() * sizeof(page_id_t), profile_.read_latency_);
+  return success;
+}
+
+void LatencyDiskManager::Delay(size_t bytes, std::chrono::microseconds latency) {
+  auto start = std::chrono::steady_clock::now();
+  auto done = start;
+  {
+    std::scoped_lock latch(device_latch_);
+    done = std::max(start, device_free_);
+    if (profile_.bandwidth_ != 0) {
+      done += std::chrono::nanoseconds(bytes * 1000000000ULL / profile_.bandwidth_);
+    }
+    device_free_ = done;
+  }
+  done += latency;
+  std::this_thread::sleep_until(done);
+  injected_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void LatencyDiskManager::WritePgImp(page_id_t page_id, const char *page_data) {
+  disk_manager_->WritePage(page_id, page_data);
+  num_writes_ += 1;
+  Delay(PAGE_SIZE, profile_.write_latency_);
+}
+
+void LatencyDiskManager::ReadPgImp(page_id_t page_id, char *page_data) {
+  Delay(PAGE_SIZE, profile_.read_latency_);
+  disk_manager_->ReadPage(page_id, page_data);
+}
+
+void LatencyDiskManager::ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data) {
+  Delay(static_cast<size_t>(num_pages) * PAGE_SIZE, profile_.read_latency_);
+  disk_manager_->ReadPages(first_page_id, num_pages, page_data);
+}
+
+void LatencyDiskManager::WriteLogImp(char *log_data, int size) {
+  if (size == 0) {
+    return;
+  }
+  disk_manager_->WriteLog(log_data, size);
+  num_flushes_ += 1;
+  Delay(size, profile_.log_latency_);
+}
+
+bool LatencyDiskManager::ReadLogImp(char *log_data, int size, int64_t offset) {
+  Delay(size, profile_.read_latency_);
+  return disk_manager_->ReadLog(log_data, size, offset);
+}
+
+}  // namespace bustub
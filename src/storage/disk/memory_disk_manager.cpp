@@ -0,0 +1,102 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// memory_disk_manager.cpp
+//
+// Identification: src/storage/disk/memory_disk_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/memory_disk_manager.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "common/logger.h"
+
+namespace bustub {
+
+void MemoryDiskManager::WritePgImp(page_id_t page_id, const char *page_data) {
+  std::unique_lock latch(pages_latch_);
+  if (static_cast<size_t>(page_id) >= pages_.size()) {
+    pages_.resize(page_id + 1);
+  }
+  if (pages_[page_id] == nullptr) {
+    pages_[page_id] = std::make_unique<PageFrame>();
+  }
+  memcpy(pages_[page_id]->data(), page_data, PAGE_SIZE);
+  num_writes_ += 1;
+}
+
+void MemoryDiskManager::ReadPgImp(page_id_t page_id, char *page_data) {
+  std::shared_lock latch(pages_latch_);
+  if (static_cast<size_t>(page_id) >= pages_.size() || pages_[page_id] == nullptr) {
+    LOG_DEBUG("I/O error reading past end of file");
+    memset(page_data, 0, PAGE_SIZE);
+    return;
+  }
+  memcpy(page_data, pages_[page_id]->data(), PAGE_SIZE);
+}
+
+void MemoryDiskManager::ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data) {
+  for (int i = 0; i < num_pages; i++) {
+    ReadPgImp(first_page_id + i, page_data + static_cast<size_t>(i) * PAGE_SIZE);
+  }
+}
+
+void MemoryDiskManager::WriteLogImp(char *log_data, int size) {
+  if (size == 0) {
+    return;
+  }
+  std::scoped_lock latch(log_latch_);
+  log_.insert(log_.end(), log_data, log_data + size);
+  num_flushes_ += 1;
+}
+
+bool MemoryDiskManager::ReadLogImp(char *log_data, int size, int64_t offset) {
+  std::scoped_lock latch(log_latch_);
+  if (offset < 0 || static_cast<size_t>(offset) >= log_.size()) {
+    return false;
+  }
+  size_t read_count = std::min(log_.size() - offset, static_cast<size_t>(size));
+  memcpy(log_data, log_.data() + offset, read_count);
+  // if log ends before reading "size"
+  memset(log_data + read_count, 0, size - read_count);
+  return true;
+}
+
+int64_t MemoryDiskManager::GetLogSize() {
+  std::scoped_lock latch(log_latch_);
+  return log_.size();
+}
+
+void MemoryDiskManager::WriteMasterRecord(const char *data, int size) {
+  std::scoped_lock latch(log_latch_);
+  master_record_.assign(data, data + size);
+}
+
+bool MemoryDiskManager::ReadMasterRecord(char *data, int size) {
+  std::scoped_lock latch(log_latch_);
+  if (master_record_.size() != static_cast<size_t>(size)) {
+    return false;
+  }
+  memcpy(data, master_record_.data(), size);
+  return true;
+}
+
+void MemoryDiskManager::WriteWarmupList(const std::vector<page_id_t> &page_ids) {
+  std::scoped_lock latch(log_latch_);
+  warmup_list_ = page_ids;
+  has_warmup_list_ = true;
+}
+
+bool MemoryDiskManager::ReadWarmupList(std::vector<page_id_t> *page_ids) {
+  std::scoped_lock latch(log_latch_);
+  *page_ids = warmup_list_;
+  return has_warmup_list_;
+}
+
+}  // namespace bustub
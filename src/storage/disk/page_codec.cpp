@@ -0,0 +1,182 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// page_codec.cpp
+//
+// Identification: src/storage/disk/page_codec.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/page_codec.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace bustub {
+
+namespace {
+
+constexpr size_t HASH_BITS = 12;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr uint8_t NIBBLE_MAX = 15;
+
+inline uint32_t Load32(const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint32_t Hash(uint32_t v) { return (v * 2654435761U) >> (32 - HASH_BITS); }
+
+/** Appends the extension bytes of a length whose nibble saturated. Returns false if dst overflows. */
+inline bool WriteLengthExt(size_t len, uint8_t **op, const uint8_t *op_end) {
+  while (len >= 255) {
+    if (*op >= op_end) {
+      return false;
+    }
+    *(*op)++ = 255;
+    len -= 255;
+  }
+  if (*op >= op_end) {
+    return false;
+  }
+  *(*op)++ = static_cast<uint8_t>(len);
+  return true;
+}
+
+/** Reads the extension bytes of a saturated length. Returns false if src is exhausted. */
+inline bool ReadLengthExt(size_t *len, const uint8_t **ip, const uint8_t *ip_end) {
+  uint8_t b;
+  do {
+    if (*ip >= ip_end) {
+      return false;
+    }
+    b = *(*ip)++;
+    *len += b;
+  } while (b == 255);
+  return true;
+}
+
+/** Emits one block. match_len == 0 marks the final, literal-only block. */
+bool EmitBlock(const uint8_t *literals, size_t literal_len, size_t offset, size_t match_len, uint8_t **op,
+               const uint8_t *op_end) {
+  if (*op >= op_end) {
+    return false;
+  }
+  uint8_t *token = (*op)++;
+  size_t match_code = match_len == 0 ? 0 : match_len - PageCodec::MIN_MATCH;
+  *token = static_cast<uint8_t>((literal_len < NIBBLE_MAX ? literal_len : NIBBLE_MAX) << 4);
+  if (literal_len >= NIBBLE_MAX && !WriteLengthExt(literal_len - NIBBLE_MAX, op, op_end)) {
+    return false;
+  }
+  if (static_cast<size_t>(op_end - *op) < literal_len) {
+    return false;
+  }
+  memcpy(*op, literals, literal_len);
+  *op += literal_len;
+  if (match_len == 0) {
+    return true;
+  }
+  *token |= static_cast<uint8_t>(match_code < NIBBLE_MAX ? match_code : NIBBLE_MAX);
+  if (op_end - *op < 2) {
+    return false;
+  }
+  *(*op)++ = static_cast<uint8_t>(offset & 0xff);
+  *(*op)++ = static_cast<uint8_t>(offset >> 8);
+  return match_code < NIBBLE_MAX || WriteLengthExt(match_code - NIBBLE_MAX, op, op_end);
+}
+
+}  // namespace
+
+size_t PageCodec::Compress(const char *src, size_t src_size, char *dst, size_t dst_capacity) {
+  const auto *base = reinterpret_cast<const uint8_t *>(src);
+  const uint8_t *ip = base;
+  const uint8_t *anchor = base;
+  const uint8_t *ip_end = base + src_size;
+  auto *op = reinterpret_cast<uint8_t *>(dst);
+  const uint8_t *op_end = op + dst_capacity;
+
+  // Positions of the most recent occurrence of each 4-byte sequence, relative to base.
+  uint16_t table[1 << HASH_BITS];
+  memset(table, 0, sizeof(table));
+
+  if (src_size > MIN_MATCH) {
+    const uint8_t *match_limit = ip_end - MIN_MATCH;
+    ip++;
+    while (ip <= match_limit) {
+      uint32_t seq = Load32(ip);
+      uint32_t h = Hash(seq);
+      const uint8_t *ref = base + table[h];
+      table[h] = static_cast<uint16_t>(ip - base);
+      if (ref >= ip || static_cast<size_t>(ip - ref) > MAX_OFFSET || Load32(ref) != seq) {
+        ip++;
+        continue;
+      }
+      // Extend the match as far as possible.
+      size_t match_len = MIN_MATCH;
+      while (ip + match_len < ip_end && ref[match_len] == ip[match_len]) {
+        match_len++;
+      }
+      if (!EmitBlock(anchor, ip - anchor, ip - ref, match_len, &op, op_end)) {
+        return 0;
+      }
+      ip += match_len;
+      anchor = ip;
+    }
+  }
+  if (!EmitBlock(anchor, ip_end - anchor, 0, 0, &op, op_end)) {
+    return 0;
+  }
+  return op - reinterpret_cast<uint8_t *>(dst);
+}
+
+size_t PageCodec::Decompress(const char *src, size_t src_size, char *dst, size_t dst_capacity) {
+  const auto *ip = reinterpret_cast<const uint8_t *>(src);
+  const uint8_t *ip_end = ip + src_size;
+  auto *base = reinterpret_cast<uint8_t *>(dst);
+  uint8_t *op = base;
+  const uint8_t *op_end = base + dst_capacity;
+
+  while (ip < ip_end) {
+    uint8_t token = *ip++;
+    size_t literal_len = token >> 4;
+    if (literal_len == NIBBLE_MAX && !ReadLengthExt(&literal_len, &ip, ip_end)) {
+      return 0;
+    }
+    if (static_cast<size_t>(ip_end - ip) < literal_len || static_cast<size_t>(op_end - op) < literal_len) {
+      return 0;
+    }
+    memcpy(op, ip, literal_len);
+    ip += literal_len;
+    op += literal_len;
+    if (ip == ip_end) {
+      // The final block carries no match.
+      break;
+    }
+    if (ip_end - ip < 2) {
+      return 0;
+    }
+    size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+    size_t match_len = token & NIBBLE_MAX;
+    if (match_len == NIBBLE_MAX && !ReadLengthExt(&match_len, &ip, ip_end)) {
+      return 0;
+    }
+    match_len += MIN_MATCH;
+    if (offset == 0 || offset > static_cast<size_t>(op - base) || static_cast<size_t>(op_end - op) < match_len) {
+      return 0;
+    }
+    // Byte-wise copy: the source may overlap the destination for runs.
+    const uint8_t *ref = op - offset;
+    for (size_t i = 0; i < match_len; i++) {
+      op[i] = ref[i];
+    }
+    op += match_len;
+  }
+  return op - base;
+}
+
+}  // namespace bustub
@@ -0,0 +1,133 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// striped_disk_manager.cpp
+//
+// Identification: src/storage/disk/striped_disk_manager.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include "storage/disk/striped_disk_manager.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include "common/exception.h"
+#include "common/logger.h"
+
+namespace bustub {
+
+StripedDiskManager::StripedDiskManager(const std::string &db_file, const std::vector<std::string> &stripe_dirs,
+                                       uint32_t stripe_pages)
+    : DiskManager(db_file), stripe_pages_(stripe_pages) {
+  if (stripe_dirs.empty() || stripe_pages_ == 0) {
+    throw Exception("striping needs at least one directory and a non-empty stripe unit");
+  }
+  // Stripe files are named after the database file so that several databases can share the same volumes.
+  std::string base_name = db_file.substr(db_file.rfind('/') == std::string::npos ? 0 : db_file.rfind('/') + 1);
+  for (size_t i = 0; i < stripe_dirs.size(); i++) {
+    std::string dir = stripe_dirs[i].empty() ? "." : stripe_dirs[i];
+    std::string name = dir + "/" + base_name + "." + std::to_string(i);
+    int fd = open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+      for (int opened : stripe_fds_) {
+        close(opened);
+      }
+      throw Exception("can't open stripe file " + name);
+    }
+    stripe_names_.push_back(name);
+    stripe_fds_.push_back(fd);
+  }
+}
+
+StripedDiskManager::~StripedDiskManager() {
+  for (int fd : stripe_fds_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+void StripedDiskManager::ShutDown() {
+  for (int &fd : stripe_fds_) {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  DiskManager::ShutDown();
+}
+
+std::pair<size_t, size_t> StripedDiskManager::Locate(page_id_t page_id) const {
+  size_t num_files = stripe_fds_.size();
+  size_t stripe = static_cast<size_t>(page_id) / stripe_pages_;
+  size_t page_in_file = (stripe / num_files) * stripe_pages_ + static_cast<size_t>(page_id) % stripe_pages_;
+  return {stripe % num_files, page_in_file * PAGE_SIZE};
+}
+
+/**
+ * Write the contents of the specified page into the stripe file that owns it
+ */
+void StripedDiskManager::WritePgImp(page_id_t page_id, const char *page_data) {
+  auto [file_index, offset] = Locate(page_id);
+  num_writes_ += 1;
+  size_t written = 0;
+  while (written < static_cast<size_t>(PAGE_SIZE)) {
+    ssize_t ret = pwrite(stripe_fds_[file_index], page_data + written, PAGE_SIZE - written, offset + written);
+    if (ret < 0) {
+      LOG_DEBUG("I/O error while writing");
+      return;
+    }
+    written += ret;
+  }
+}
+
+/**
+ * Read the contents of the specified page from the stripe file that owns it
+ */
+void StripedDiskManager::ReadPgImp(page_id_t page_id, char *page_data) {
+  auto [file_index, offset] = Locate(page_id);
+  ReadRange(file_index, offset, page_data, PAGE_SIZE);
+}
+
+/**
+ * Read consecutive pages, with one read per stripe unit they span
+ */
+void StripedDiskManager::ReadPagesImp(page_id_t first_page_id, int num_pages, char *page_data) {
+  for (int i = 0; i < num_pages;) {
+    page_id_t page_id = first_page_id + i;
+    // The pages of a stripe unit are contiguous in its file.
+    int run = std::min<int>(num_pages - i, stripe_pages_ - static_cast<uint32_t>(page_id) % stripe_pages_);
+    auto [file_index, offset] = Locate(page_id);
+    ReadRange(file_index, offset, page_data + static_cast<size_t>(i) * PAGE_SIZE, static_cast<size_t>(run) * PAGE_SIZE);
+    i += run;
+  }
+}
+
+void StripedDiskManager::ReadRange(size_t file_index, size_t offset, char *data, size_t size) {
+  size_t read_count = 0;
+  while (read_count < size) {
+    ssize_t ret = pread(stripe_fds_[file_index], data + read_count, size - read_count, offset + read_count);
+    if (ret < 0) {
+      LOG_DEBUG("I/O error while reading");
+      return;
+    }
+    if (ret == 0) {
+      break;
+    }
+    read_count += ret;
+  }
+  // if file ends before reading everything
+  if (read_count < size) {
+    LOG_DEBUG("Read less than a page");
+    memset(data + read_count, 0, size - read_count);
+  }
+}
+
+}  // namespace bustub
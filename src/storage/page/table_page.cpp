@@ -13,9 +13,22 @@
 #include "storage/page/table_page.h"
 
 #include <cassert>
+#include <utility>
 
 namespace bustub {
 
+namespace {
+
+/** @return true if the transaction holds a lock in the mode on the row, or on the whole table after an escalation */
+bool HoldsRowLock(Transaction *txn, table_oid_t oid, const RID &rid, TableLockMode mode) {
+  if (txn->IsExclusiveLocked(rid) || (mode == TableLockMode::SHARED && txn->IsSharedLocked(rid))) {
+    return true;
+  }
+  return oid != INVALID_TABLE_OID && LockManager::IsTableLocked(txn, oid, mode);
+}
+
+}  // namespace
+
 void TablePage::Init(page_id_t page_id, uint32_t page_size, page_id_t prev_page_id, LogManager *log_manager,
                      Transaction *txn) {
   // Set the page ID.
@@ -24,9 +37,7 @@ void TablePage::Init(page_id_t page_id, uint32_t page_size, page_id_t prev_page_
   if (enable_logging) {
     LogRecord log_record =
         LogRecord(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::NEWPAGE, prev_page_id, page_id);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    log_manager->AppendTxnLogRecord(&log_record, txn, this);
   }
   // Set the previous and next page IDs.
   SetPrevPageId(prev_page_id);
@@ -36,7 +47,7 @@ void TablePage::Init(page_id_t page_id, uint32_t page_size, page_id_t prev_page_
 }
 
 bool TablePage::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, LockManager *lock_manager,
-                            LogManager *log_manager) {
+                            LogManager *log_manager, table_oid_t oid) {
   BUSTUB_ASSERT(tuple.size_ > 0, "Cannot have empty tuples.");
   // If there is not enough space, then return false.
   if (GetFreeSpaceRemaining() < tuple.size_ + SIZE_TUPLE) {
@@ -74,18 +85,19 @@ bool TablePage::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn, Lock
   // Write the log record.
   if (enable_logging) {
     BUSTUB_ASSERT(!txn->IsSharedLocked(*rid) && !txn->IsExclusiveLocked(*rid), "A new tuple should not be locked.");
-    // Acquire an exclusive lock on the new tuple.
-    bool locked = lock_manager->LockExclusive(txn, *rid);
-    BUSTUB_ASSERT(locked, "Locking a new tuple should always work.");
+    // Acquire an exclusive lock on the new tuple, unless the table lock covers it.
+    if (!HoldsRowLock(txn, oid, *rid, TableLockMode::EXCLUSIVE)) {
+      bool locked = lock_manager->LockExclusive(txn, *rid);
+      BUSTUB_ASSERT(locked, "Locking a new tuple should always work.");
+    }
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::INSERT, *rid, tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    log_manager->AppendTxnLogRecord(&log_record, txn, this);
   }
   return true;
 }
 
-bool TablePage::MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager) {
+bool TablePage::MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_manager, LogManager *log_manager,
+                           table_oid_t oid) {
   uint32_t slot_num = rid.GetSlotNum();
   // If the slot number is invalid, abort the transaction.
   if (slot_num >= GetTupleCount()) {
@@ -106,18 +118,18 @@ bool TablePage::MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_m
 
   if (enable_logging) {
     // Acquire an exclusive lock, upgrading from a shared lock if necessary.
-    if (txn->IsSharedLocked(rid)) {
+    if (HoldsRowLock(txn, oid, rid, TableLockMode::EXCLUSIVE)) {
+      // Already locked, possibly by the table lock an escalation took.
+    } else if (txn->IsSharedLocked(rid)) {
       if (!lock_manager->LockUpgrade(txn, rid)) {
         return false;
       }
-    } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
+    } else if (!lock_manager->LockExclusive(txn, rid)) {
       return false;
     }
     Tuple dummy_tuple;
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::MARKDELETE, rid, dummy_tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    log_manager->AppendTxnLogRecord(&log_record, txn, this);
   }
 
   // Mark the tuple as deleted.
@@ -128,7 +140,7 @@ bool TablePage::MarkDelete(const RID &rid, Transaction *txn, LockManager *lock_m
 }
 
 bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID &rid, Transaction *txn,
-                            LockManager *lock_manager, LogManager *log_manager) {
+                            LockManager *lock_manager, LogManager *log_manager, table_oid_t oid) {
   BUSTUB_ASSERT(new_tuple.size_ > 0, "Cannot have empty tuples.");
   uint32_t slot_num = rid.GetSlotNum();
   // If the slot number is invalid, abort the transaction.
@@ -164,17 +176,29 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
 
   if (enable_logging) {
     // Acquire an exclusive lock, upgrading from shared if necessary.
-    if (txn->IsSharedLocked(rid)) {
+    if (HoldsRowLock(txn, oid, rid, TableLockMode::EXCLUSIVE)) {
+      // Already locked, possibly by the table lock an escalation took.
+    } else if (txn->IsSharedLocked(rid)) {
       if (!lock_manager->LockUpgrade(txn, rid)) {
         return false;
       }
-    } else if (!txn->IsExclusiveLocked(rid) && !lock_manager->LockExclusive(txn, rid)) {
+    } else if (!lock_manager->LockExclusive(txn, rid)) {
       return false;
     }
-    LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::UPDATE, rid, *old_tuple, new_tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    // Updates usually change a few columns, so log only the bytes that differ unless that is no smaller.
+    TupleDelta delta;
+    if (log_manager->UsesUpdateDeltas()) {
+      delta = TupleDelta(*old_tuple, new_tuple);
+    }
+    if (log_manager->UsesUpdateDeltas() &&
+        delta.GetSerializedSize() < old_tuple->GetLength() + new_tuple.GetLength() + 2 * sizeof(int32_t)) {
+      LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), rid, std::move(delta));
+      log_manager->AppendTxnLogRecord(&log_record, txn, this);
+    } else {
+      LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::UPDATE, rid, *old_tuple,
+                           new_tuple);
+      log_manager->AppendTxnLogRecord(&log_record, txn, this);
+    }
   }
 
   // Perform the update.
@@ -197,7 +221,7 @@ bool TablePage::UpdateTuple(const Tuple &new_tuple, Tuple *old_tuple, const RID
   return true;
 }
 
-void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager) {
+void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_manager, table_oid_t oid) {
   uint32_t slot_num = rid.GetSlotNum();
   BUSTUB_ASSERT(slot_num < GetTupleCount(), "Cannot have more slots than tuples.");
 
@@ -218,12 +242,10 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
   delete_tuple.allocated_ = true;
 
   if (enable_logging) {
-    BUSTUB_ASSERT(txn->IsExclusiveLocked(rid), "We must own the exclusive lock!");
+    BUSTUB_ASSERT(HoldsRowLock(txn, oid, rid, TableLockMode::EXCLUSIVE), "We must own the exclusive lock!");
 
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::APPLYDELETE, rid, delete_tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    log_manager->AppendTxnLogRecord(&log_record, txn, this);
   }
 
   uint32_t free_space_pointer = GetFreeSpacePointer();
@@ -244,15 +266,13 @@ void TablePage::ApplyDelete(const RID &rid, Transaction *txn, LogManager *log_ma
   }
 }
 
-void TablePage::RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager) {
+void TablePage::RollbackDelete(const RID &rid, Transaction *txn, LogManager *log_manager, table_oid_t oid) {
   // Log the rollback.
   if (enable_logging) {
-    BUSTUB_ASSERT(txn->IsExclusiveLocked(rid), "We must own an exclusive lock on the RID.");
+    BUSTUB_ASSERT(HoldsRowLock(txn, oid, rid, TableLockMode::EXCLUSIVE), "We must own an exclusive lock on the RID.");
     Tuple dummy_tuple;
     LogRecord log_record(txn->GetTransactionId(), txn->GetPrevLSN(), LogRecordType::ROLLBACKDELETE, rid, dummy_tuple);
-    lsn_t lsn = log_manager->AppendLogRecord(&log_record);
-    SetLSN(lsn);
-    txn->SetPrevLSN(lsn);
+    log_manager->AppendTxnLogRecord(&log_record, txn, this);
   }
 
   uint32_t slot_num = rid.GetSlotNum();
@@ -265,12 +285,42 @@ void TablePage::RollbackDelete(const RID &rid, Transaction *txn, LogManager *log
   }
 }
 
-bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager) {
+bool TablePage::InsertTupleAt(const Tuple &tuple, const RID &rid) {
+  BUSTUB_ASSERT(tuple.size_ > 0, "Cannot have empty tuples.");
+  uint32_t slot_num = rid.GetSlotNum();
+  uint32_t tuple_count = GetTupleCount();
+  if (slot_num < tuple_count && GetTupleSize(slot_num) != 0) {
+    return false;
+  }
+  // Slots past the end are created, empty, up to and including the target slot.
+  uint32_t new_slots = slot_num < tuple_count ? 0 : slot_num - tuple_count + 1;
+  if (GetFreeSpaceRemaining() < tuple.size_ + SIZE_TUPLE * new_slots) {
+    return false;
+  }
+
+  SetFreeSpacePointer(GetFreeSpacePointer() - tuple.size_);
+  memcpy(GetData() + GetFreeSpacePointer(), tuple.data_, tuple.size_);
+  for (uint32_t i = tuple_count; i < slot_num; i++) {
+    SetTupleOffsetAtSlot(i, 0);
+    SetTupleSize(i, 0);
+  }
+  SetTupleOffsetAtSlot(slot_num, GetFreeSpacePointer());
+  SetTupleSize(slot_num, tuple.size_);
+  if (new_slots != 0) {
+    SetTupleCount(slot_num + 1);
+  }
+  return true;
+}
+
+bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockManager *lock_manager,
+                         table_oid_t oid) {
   // Get the current slot number.
   uint32_t slot_num = rid.GetSlotNum();
+  // Reads without a lock manager neither lock nor abort, e.g. snapshot reads.
+  bool locking = enable_logging && lock_manager != nullptr;
   // If somehow we have more slots than tuples, abort the transaction.
   if (slot_num >= GetTupleCount()) {
-    if (enable_logging) {
+    if (locking) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
@@ -279,15 +329,15 @@ bool TablePage::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn, LockMan
   uint32_t tuple_size = GetTupleSize(slot_num);
   // If the tuple is deleted, abort the transaction.
   if (IsDeleted(tuple_size)) {
-    if (enable_logging) {
+    if (locking) {
       txn->SetState(TransactionState::ABORTED);
     }
     return false;
   }
 
   // Otherwise we have a valid tuple, try to acquire at least a shared lock.
-  if (enable_logging) {
-    if (!txn->IsSharedLocked(rid) && !txn->IsExclusiveLocked(rid) && !lock_manager->LockShared(txn, rid)) {
+  if (locking) {
+    if (!HoldsRowLock(txn, oid, rid, TableLockMode::SHARED) && !lock_manager->LockShared(txn, rid)) {
       return false;
     }
   }
@@ -10,13 +10,35 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
 
 #include "common/logger.h"
 #include "storage/table/table_heap.h"
 
 namespace bustub {
 
+namespace {
+
+/** @return true if the transaction reads a snapshot */
+bool IsSnapshot(Transaction *txn) {
+  return txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::SNAPSHOT_ISOLATION;
+}
+
+/** @return true if the writes of the transaction keep versions; rollbacks of aborted transactions don't */
+bool KeepsVersions(Transaction *txn) { return IsSnapshot(txn) && txn->GetState() != TransactionState::ABORTED; }
+
+/** @return true if the transaction uses optimistic concurrency control */
+bool IsOptimistic(Transaction *txn) {
+  return txn != nullptr && txn->GetIsolationLevel() == IsolationLevel::OPTIMISTIC;
+}
+
+/** @return true if the transaction holds its updates and deletes back, i.e. it is optimistic and not committing yet */
+bool DefersWrites(Transaction *txn) { return IsOptimistic(txn) && txn->GetState() == TransactionState::GROWING; }
+
+}  // namespace
+
 TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager, LockManager *lock_manager, LogManager *log_manager,
                      page_id_t first_page_id)
     : buffer_pool_manager_(buffer_pool_manager),
@@ -51,7 +73,7 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
   cur_page->WLatch();
   // Insert into the first page with enough space. If no such page exists, create a new page and insert into that.
   // INVARIANT: cur_page is WLatched if you leave the loop normally.
-  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_)) {
+  while (!cur_page->InsertTuple(tuple, rid, txn, lock_manager_, log_manager_, oid_)) {
     auto next_page_id = cur_page->GetNextPageId();
     // If the next page is a valid page,
     if (next_page_id != INVALID_PAGE_ID) {
@@ -81,16 +103,29 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID *rid, Transaction *txn) {
       cur_page = new_page;
     }
   }
+  if (KeepsVersions(txn)) {
+    SaveVersion(*rid, txn, false, Tuple{});
+  }
+  // The stamp stays locked until the transaction finishes, so that no optimistic transaction commits having read the
+  // tuple before. A committing transaction may still hold it if the slot was freed just now.
+  bool is_stamped = !IsOptimistic(txn) || LockStamp(*rid, txn);
   // This line has caused most of us to double-take and "whoa double unlatch".
   // We are not, in fact, double unlatching. See the invariant above.
   cur_page->WUnlatch();
   buffer_pool_manager_->UnpinPage(cur_page->GetTablePageId(), true);
   // Update the transaction's write set.
   txn->GetWriteSet()->emplace_back(*rid, WType::INSERT, Tuple{}, this);
-  return true;
+  if (!is_stamped) {
+    txn->SetState(TransactionState::ABORTED);
+  }
+  return is_stamped;
 }
 
 bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
+  if (DefersWrites(txn)) {
+    txn->GetPendingWriteSet()->insert_or_assign(rid, TableWriteRecord(rid, WType::DELETE, Tuple{}, this));
+    return true;
+  }
   // TODO(Amadou): remove empty page
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
@@ -101,7 +136,21 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
   }
   // Otherwise, mark the tuple as deleted.
   page->WLatch();
-  page->MarkDelete(rid, txn, lock_manager_, log_manager_);
+  if (KeepsVersions(txn)) {
+    if (!CanWriteVersion(rid, txn)) {
+      page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetTablePageId(), false);
+      txn->SetState(TransactionState::ABORTED);
+      return false;
+    }
+    Tuple old_tuple;
+    if (page->GetTuple(rid, &old_tuple, txn, nullptr) &&
+        page->MarkDelete(rid, txn, lock_manager_, log_manager_, oid_)) {
+      SaveVersion(rid, txn, true, old_tuple);
+    }
+  } else {
+    page->MarkDelete(rid, txn, lock_manager_, log_manager_, oid_);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
   // Update the transaction's write set.
@@ -110,6 +159,15 @@ bool TableHeap::MarkDelete(const RID &rid, Transaction *txn) {
 }
 
 bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn) {
+  if (DefersWrites(txn)) {
+    auto pending_write_set = txn->GetPendingWriteSet();
+    auto pending = pending_write_set->find(rid);
+    if (pending != pending_write_set->end() && pending->second.wtype_ == WType::DELETE) {
+      return false;
+    }
+    pending_write_set->insert_or_assign(rid, TableWriteRecord(rid, WType::UPDATE, tuple, this));
+    return true;
+  }
   // Find the page which contains the tuple.
   auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -120,7 +178,17 @@ bool TableHeap::UpdateTuple(const Tuple &tuple, const RID &rid, Transaction *txn
   // Update the tuple; but first save the old value for rollbacks.
   Tuple old_tuple;
   page->WLatch();
-  bool is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_);
+  bool is_updated = false;
+  if (!KeepsVersions(txn)) {
+    is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_, oid_);
+  } else if (CanWriteVersion(rid, txn)) {
+    is_updated = page->UpdateTuple(tuple, &old_tuple, rid, txn, lock_manager_, log_manager_, oid_);
+    if (is_updated) {
+      SaveVersion(rid, txn, true, old_tuple);
+    }
+  } else {
+    txn->SetState(TransactionState::ABORTED);
+  }
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), is_updated);
   // Update the transaction's write set.
@@ -136,7 +204,7 @@ void TableHeap::ApplyDelete(const RID &rid, Transaction *txn) {
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Delete the tuple from the page.
   page->WLatch();
-  page->ApplyDelete(rid, txn, log_manager_);
+  page->ApplyDelete(rid, txn, log_manager_, oid_);
   lock_manager_->Unlock(txn, rid);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
@@ -148,12 +216,54 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn) {
   BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
   // Rollback the delete.
   page->WLatch();
-  page->RollbackDelete(rid, txn, log_manager_);
+  page->RollbackDelete(rid, txn, log_manager_, oid_);
   page->WUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetTablePageId(), true);
 }
 
+void TableHeap::FinishWrites(std::vector<const TableWriteRecord *>::const_iterator first,
+                             std::vector<const TableWriteRecord *>::const_iterator last, Transaction *txn,
+                             bool is_commit) {
+  while (first != last) {
+    page_id_t page_id = (*first)->rid_.GetPageId();
+    auto page = reinterpret_cast<TablePage *>(buffer_pool_manager_->FetchPage(page_id));
+    BUSTUB_ASSERT(page != nullptr, "Couldn't find a page containing that RID.");
+    page->WLatch();
+    for (; first != last && (*first)->rid_.GetPageId() == page_id; ++first) {
+      const auto &item = **first;
+      if (item.wtype_ == WType::DELETE && is_commit) {
+        page->ApplyDelete(item.rid_, txn, log_manager_, oid_);
+        lock_manager_->Unlock(txn, item.rid_);
+      } else if (item.wtype_ == WType::DELETE) {
+        page->RollbackDelete(item.rid_, txn, log_manager_, oid_);
+      } else if (item.wtype_ == WType::INSERT && !is_commit) {
+        page->ApplyDelete(item.rid_, txn, log_manager_, oid_);
+        lock_manager_->Unlock(txn, item.rid_);
+      } else if (item.wtype_ == WType::UPDATE && !is_commit) {
+        // The rollback of an aborted transaction keeps no versions, so this is all UpdateTuple would do.
+        Tuple new_tuple;
+        page->UpdateTuple(item.tuple_, &new_tuple, item.rid_, txn, lock_manager_, log_manager_, oid_);
+      }
+    }
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page_id, true);
+  }
+}
+
 bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
+  if (DefersWrites(txn)) {
+    // An optimistic transaction sees its own updates and deletes before they are written.
+    auto pending_write_set = txn->GetPendingWriteSet();
+    auto pending = pending_write_set->find(rid);
+    if (pending != pending_write_set->end()) {
+      if (pending->second.wtype_ == WType::DELETE) {
+        return false;
+      }
+      *tuple = pending->second.tuple_;
+      tuple->rid_ = rid;
+      return true;
+    }
+  }
   // Find the page which contains the tuple.
   auto page = static_cast<TablePage *>(buffer_pool_manager_->FetchPage(rid.GetPageId()));
   // If the page could not be found, then abort the transaction.
@@ -163,13 +273,27 @@ bool TableHeap::GetTuple(const RID &rid, Tuple *tuple, Transaction *txn) {
   }
   // Read the tuple from the page.
   page->RLatch();
-  bool res = page->GetTuple(rid, tuple, txn, lock_manager_);
+  bool res;
+  if (IsSnapshot(txn)) {
+    res = GetVisibleTuple(page, rid, tuple, txn);
+  } else if (DefersWrites(txn)) {
+    res = GetTupleAndStamp(page, rid, tuple, txn);
+  } else {
+    res = page->GetTuple(rid, tuple, txn, lock_manager_, oid_);
+  }
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(rid.GetPageId(), false);
   return res;
 }
 
 TableIterator TableHeap::Begin(Transaction *txn) {
+  if (IsSnapshot(txn) || IsOptimistic(txn)) {
+    // A snapshot may still see tuples that are deleted on the page, and an optimistic transaction does not see the ones
+    // it deleted itself, so look at every slot.
+    TableIterator iter(this, RID(INVALID_PAGE_ID, 0), txn);
+    iter.SeekVisible(RID(first_page_id_, 0));
+    return iter;
+  }
   // Start an iterator from the first page.
   // TODO(Wuwen): Hacky fix for now. Removing empty pages is a better way to handle this.
   RID rid;
@@ -191,4 +315,176 @@ TableIterator TableHeap::Begin(Transaction *txn) {
 
 TableIterator TableHeap::End() { return TableIterator(this, RID(INVALID_PAGE_ID, 0), nullptr); }
 
+void TableHeap::CommitVersion(const RID &rid, Transaction *txn, timestamp_t commit_ts) {
+  auto &shard = GetVersionShard(rid);
+  std::scoped_lock<std::mutex> latch(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it != shard.chains_.end() && it->second.writer_ == txn->GetTransactionId()) {
+    it->second.writer_ = INVALID_TXN_ID;
+    it->second.ts_ = commit_ts;
+  }
+}
+
+void TableHeap::AbortVersion(const RID &rid, Transaction *txn) {
+  auto &shard = GetVersionShard(rid);
+  std::scoped_lock<std::mutex> latch(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it == shard.chains_.end()) {
+    return;
+  }
+  auto &chain = it->second;
+  // The version is not necessarily the newest one: a rolled back insert frees its slot, which another transaction may
+  // have taken already.
+  auto version = std::find_if(chain.undo_.begin(), chain.undo_.end(),
+                              [txn](const auto &v) { return v.replaced_by_ == txn->GetTransactionId(); });
+  if (version == chain.undo_.end()) {
+    return;
+  }
+  if (chain.writer_ == txn->GetTransactionId()) {
+    chain.writer_ = INVALID_TXN_ID;
+    chain.ts_ = version->ts_;
+  }
+  chain.undo_.erase(version);
+  if (chain.writer_ == INVALID_TXN_ID && chain.ts_ == 0 && chain.undo_.empty()) {
+    shard.chains_.erase(it);
+  }
+}
+
+void TableHeap::CollectVersions(const RID &rid, timestamp_t watermark) {
+  auto &shard = GetVersionShard(rid);
+  std::scoped_lock<std::mutex> latch(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it == shard.chains_.end()) {
+    return;
+  }
+  auto &chain = it->second;
+  // A version is needed as long as the version that replaced it is newer than some snapshot.
+  timestamp_t newer_ts = chain.writer_ == INVALID_TXN_ID ? chain.ts_ : std::numeric_limits<timestamp_t>::max();
+  auto version = chain.undo_.begin();
+  while (version != chain.undo_.end() && newer_ts > watermark) {
+    newer_ts = version->ts_;
+    ++version;
+  }
+  chain.undo_.erase(version, chain.undo_.end());
+  if (chain.writer_ == INVALID_TXN_ID && chain.ts_ <= watermark && chain.undo_.empty()) {
+    shard.chains_.erase(it);
+  }
+}
+
+size_t TableHeap::GetNumVersionedTuples() {
+  size_t num_tuples = 0;
+  for (auto &shard : version_shards_) {
+    std::scoped_lock<std::mutex> latch(shard.latch_);
+    num_tuples += shard.chains_.size();
+  }
+  return num_tuples;
+}
+
+TableHeap::VersionShard &TableHeap::GetVersionShard(const RID &rid) {
+  // Mix the RID hash like the lock table does, it is the identity on page id and slot.
+  uint64_t hash = std::hash<RID>()(rid);
+  hash = (hash ^ (hash >> 32)) * 0x9E3779B97F4A7C15ULL;
+  return version_shards_[hash >> (64 - VERSION_SHARD_BITS)];
+}
+
+bool TableHeap::CanWriteVersion(const RID &rid, Transaction *txn) {
+  auto &shard = GetVersionShard(rid);
+  std::scoped_lock<std::mutex> latch(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it == shard.chains_.end()) {
+    return true;
+  }
+  const auto &chain = it->second;
+  if (chain.writer_ != INVALID_TXN_ID) {
+    return chain.writer_ == txn->GetTransactionId();
+  }
+  return chain.ts_ <= txn->GetReadTimestamp();
+}
+
+void TableHeap::SaveVersion(const RID &rid, Transaction *txn, bool exists, const Tuple &tuple) {
+  auto &shard = GetVersionShard(rid);
+  std::scoped_lock<std::mutex> latch(shard.latch_);
+  auto &chain = shard.chains_[rid];
+  if (chain.writer_ == txn->GetTransactionId()) {
+    // The version the transaction replaced first is the one other transactions see.
+    return;
+  }
+  chain.undo_.push_front(UndoVersion{txn->GetTransactionId(), chain.ts_, exists, tuple});
+  chain.writer_ = txn->GetTransactionId();
+}
+
+bool TableHeap::GetVisibleTuple(TablePage *page, const RID &rid, Tuple *tuple, Transaction *txn) {
+  auto &shard = GetVersionShard(rid);
+  std::scoped_lock<std::mutex> latch(shard.latch_);
+  auto it = shard.chains_.find(rid);
+  if (it == shard.chains_.end()) {
+    return page->GetTuple(rid, tuple, txn, nullptr);
+  }
+  const auto &chain = it->second;
+  timestamp_t read_ts = txn->GetReadTimestamp();
+  if (chain.writer_ == txn->GetTransactionId() || (chain.writer_ == INVALID_TXN_ID && chain.ts_ <= read_ts)) {
+    return page->GetTuple(rid, tuple, txn, nullptr);
+  }
+  for (const auto &version : chain.undo_) {
+    if (version.ts_ <= read_ts) {
+      if (version.exists_) {
+        *tuple = version.tuple_;
+        tuple->rid_ = rid;
+      }
+      return version.exists_;
+    }
+  }
+  return false;
+}
+
+bool TableHeap::LockStamp(const RID &rid, Transaction *txn) {
+  auto &shard = GetVersionShard(rid);
+  std::scoped_lock<std::mutex> latch(shard.latch_);
+  auto &stamp = shard.stamps_[rid];
+  if (stamp.writer_ != INVALID_TXN_ID && stamp.writer_ != txn->GetTransactionId()) {
+    return false;
+  }
+  stamp.writer_ = txn->GetTransactionId();
+  return true;
+}
+
+void TableHeap::UnlockStamp(const RID &rid, Transaction *txn, bool changed) {
+  auto &shard = GetVersionShard(rid);
+  std::scoped_lock<std::mutex> latch(shard.latch_);
+  auto it = shard.stamps_.find(rid);
+  if (it == shard.stamps_.end() || it->second.writer_ != txn->GetTransactionId()) {
+    return;
+  }
+  it->second.writer_ = INVALID_TXN_ID;
+  if (changed) {
+    it->second.version_++;
+  }
+}
+
+bool TableHeap::ValidateStamp(const RID &rid, Transaction *txn, const TupleStamp &stamp) {
+  auto &shard = GetVersionShard(rid);
+  std::scoped_lock<std::mutex> latch(shard.latch_);
+  auto it = shard.stamps_.find(rid);
+  TupleStamp current = it == shard.stamps_.end() ? TupleStamp{} : it->second;
+  auto held_by_other = [txn](const TupleStamp &s) {
+    return s.writer_ != INVALID_TXN_ID && s.writer_ != txn->GetTransactionId();
+  };
+  return current.version_ == stamp.version_ && !held_by_other(current) && !held_by_other(stamp);
+}
+
+bool TableHeap::GetTupleAndStamp(TablePage *page, const RID &rid, Tuple *tuple, Transaction *txn) {
+  bool res = page->GetTuple(rid, tuple, txn, nullptr);
+  auto &shard = GetVersionShard(rid);
+  TupleStamp stamp;
+  {
+    std::scoped_lock<std::mutex> latch(shard.latch_);
+    auto it = shard.stamps_.find(rid);
+    if (it != shard.stamps_.end()) {
+      stamp = it->second;
+    }
+  }
+  txn->GetReadSet()->emplace_back(rid, stamp, this);
+  return res;
+}
+
 }  // namespace bustub
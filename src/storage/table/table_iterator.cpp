@@ -34,6 +34,10 @@ Tuple *TableIterator::operator->() {
 }
 
 TableIterator &TableIterator::operator++() {
+  if (txn_ != nullptr && txn_->IsLockFree()) {
+    SeekVisible(RID(tuple_->rid_.GetPageId(), tuple_->rid_.GetSlotNum() + 1));
+    return *this;
+  }
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
   auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
   cur_page->RLatch();
@@ -64,6 +68,30 @@ TableIterator &TableIterator::operator++() {
   return *this;
 }
 
+void TableIterator::SeekVisible(RID rid) {
+  BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
+  page_id_t page_id = rid.GetPageId();
+  uint32_t slot_num = rid.GetSlotNum();
+  while (page_id != INVALID_PAGE_ID) {
+    auto page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(page_id));
+    page->RLatch();
+    uint32_t tuple_count = page->GetTupleCount();
+    page_id_t next_page_id = page->GetNextPageId();
+    page->RUnlatch();
+    buffer_pool_manager->UnpinPage(page_id, false);
+    // Slots added after the count was read hold tuples newer than the snapshot.
+    for (; slot_num < tuple_count; slot_num++) {
+      if (table_heap_->GetTuple(RID(page_id, slot_num), tuple_, txn_)) {
+        tuple_->rid_ = RID(page_id, slot_num);
+        return;
+      }
+    }
+    page_id = next_page_id;
+    slot_num = 0;
+  }
+  tuple_->rid_ = RID(INVALID_PAGE_ID, 0);
+}
+
 TableIterator TableIterator::operator++(int) {
   TableIterator clone(*this);
   ++(*this);
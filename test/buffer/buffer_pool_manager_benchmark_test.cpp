@@ -0,0 +1,211 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// buffer_pool_manager_benchmark_test.cpp
+//
+// Identification: test/buffer/buffer_pool_manager_benchmark_test.cpp
+//
+// Copyright (c) 2015-2021, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "buffer/buffer_pool_warmup.h"
+#include "buffer/parallel_buffer_pool_manager.h"
+#include "common/logger.h"
+#include "gtest/gtest.h"
+#include "storage/disk/latency_disk_manager.h"
+#include "storage/disk/memory_disk_manager.h"
+
+namespace bustub {
+
+/**
+ * Buffer pool benchmarks run against MemoryDiskManager behind a LatencyDiskManager, so that the numbers depend on the
+ * emulated device rather than on the machine running them. Run them with
+ *   ./test/buffer_pool_manager_benchmark_test --gtest_also_run_disabled_tests
+ */
+class BufferPoolManagerBenchmark : public ::testing::Test {
+ protected:
+  static constexpr page_id_t NUM_PAGES = 1000;
+
+  struct Workload {
+    size_t num_threads_;
+    size_t ops_per_thread_;
+    /** Fraction of the accesses that modify the page, which then has to be written back on eviction. */
+    double write_ratio_;
+    /** Fraction of the accesses that go to the first 20% of the pages. */
+    double hot_ratio_;
+  };
+
+  void SetUp() override {
+    char data[PAGE_SIZE] = {0};
+    for (page_id_t page_id = 0; page_id < NUM_PAGES; page_id++) {
+      memory_.WritePage(page_id, data);
+    }
+  }
+
+  /** Runs the workload against the buffer pool and returns the throughput in accesses per second. */
+  static double Run(BufferPoolManager *bpm, const Workload &workload) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < workload.num_threads_; t++) {
+      threads.emplace_back([bpm, &workload, t] {
+        std::mt19937 rng(t);
+        std::uniform_real_distribution<double> coin(0, 1);
+        std::uniform_int_distribution<page_id_t> hot(0, NUM_PAGES / 5 - 1);
+        std::uniform_int_distribution<page_id_t> any(0, NUM_PAGES - 1);
+        for (size_t i = 0; i < workload.ops_per_thread_; i++) {
+          page_id_t page_id = coin(rng) < workload.hot_ratio_ ? hot(rng) : any(rng);
+          bool is_write = coin(rng) < workload.write_ratio_;
+          Page *page = bpm->FetchPage(page_id);
+          if (page == nullptr) {
+            continue;
+          }
+          if (is_write) {
+            page->WLatch();
+            page->GetData()[i % PAGE_SIZE]++;
+            page->WUnlatch();
+          }
+          bpm->UnpinPage(page_id, is_write);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return workload.num_threads_ * workload.ops_per_thread_ / elapsed.count();
+  }
+
+  /**
+   * Runs the workload against the buffer pool until num_windows windows have passed, ignoring ops_per_thread_.
+   * @return the hit ratio of the buffer pool in every window
+   */
+  static std::vector<double> RunWindows(BufferPoolManager *bpm, const Workload &workload,
+                                        std::chrono::milliseconds window, size_t num_windows) {
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < workload.num_threads_; t++) {
+      threads.emplace_back([bpm, &workload, &stop, t] {
+        std::mt19937 rng(t);
+        std::uniform_real_distribution<double> coin(0, 1);
+        std::uniform_int_distribution<page_id_t> hot(0, NUM_PAGES / 5 - 1);
+        std::uniform_int_distribution<page_id_t> any(0, NUM_PAGES - 1);
+        while (!stop) {
+          page_id_t page_id = coin(rng) < workload.hot_ratio_ ? hot(rng) : any(rng);
+          if (bpm->FetchPage(page_id) != nullptr) {
+            bpm->UnpinPage(page_id, false);
+          }
+        }
+      });
+    }
+    std::vector<double> hit_ratios;
+    uint64_t hits = bpm->GetNumHits();
+    uint64_t misses = bpm->GetNumMisses();
+    for (size_t i = 0; i < num_windows; i++) {
+      std::this_thread::sleep_for(window);
+      uint64_t window_hits = bpm->GetNumHits() - hits;
+      uint64_t window_misses = bpm->GetNumMisses() - misses;
+      hits += window_hits;
+      misses += window_misses;
+      hit_ratios.push_back(window_hits + window_misses == 0 ? 0 : 1.0 * window_hits / (window_hits + window_misses));
+    }
+    stop = true;
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    return hit_ratios;
+  }
+
+  MemoryDiskManager memory_;
+};
+
+// NOLINTNEXTLINE
+TEST_F(BufferPoolManagerBenchmark, DISABLED_DeviceProfileBenchmark) {
+  const std::vector<std::pair<std::string, DiskProfile>> profiles = {{"hdd", DiskProfile::Hdd()},
+                                                                     {"ssd", DiskProfile::Ssd()}};
+  const std::vector<Workload> workloads = {{4, 500, 0.0, 0.8}, {4, 500, 0.3, 0.8}};
+
+  for (const auto &[name, profile] : profiles) {
+    for (const auto &workload : workloads) {
+      for (size_t pool_size : {64, 256}) {
+        for (size_t num_instances : {1, 4}) {
+          LatencyDiskManager dm(&memory_, profile);
+          double ops_per_sec;
+          if (num_instances == 1) {
+            BufferPoolManagerInstance bpm(pool_size, &dm);
+            ops_per_sec = Run(&bpm, workload);
+          } else {
+            ParallelBufferPoolManager bpm(num_instances, pool_size / num_instances, &dm);
+            ops_per_sec = Run(&bpm, workload);
+          }
+          LOG_INFO("%s, %.0f%% writes, pool %zu x %zu: %.0f accesses/s, %d write-backs, %.1f ms waiting on the device",
+                   name.c_str(), workload.write_ratio_ * 100, num_instances, pool_size / num_instances, ops_per_sec,
+                   dm.GetNumWrites(), dm.GetInjectedDelay().count() / 1e6);
+        }
+      }
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(BufferPoolManagerBenchmark, DISABLED_WarmupBenchmark) {
+  const size_t pool_size = 256;
+  const Workload workload{4, 0, 0.0, 0.9};
+  const auto window = std::chrono::milliseconds(100);
+  const size_t num_windows = 30;
+
+  // Before the restart: run until the hit ratio is steady, then save the warm-up list as a checkpoint would.
+  double steady_hit_ratio;
+  {
+    BufferPoolManagerInstance bpm(pool_size, &memory_);
+    Run(&bpm, {4, 20000, 0.0, workload.hot_ratio_});
+    auto hit_ratios = RunWindows(&bpm, workload, window, 5);
+    steady_hit_ratio = hit_ratios.back();
+    BufferPoolWarmup warmup(&bpm, &memory_);
+    warmup.SaveResidentPages();
+  }
+  LOG_INFO("steady-state hit ratio %.3f", steady_hit_ratio);
+
+  const std::vector<std::pair<std::string, DiskProfile>> profiles = {{"hdd", DiskProfile::Hdd()},
+                                                                     {"ssd", DiskProfile::Ssd()}};
+  for (const auto &[name, profile] : profiles) {
+    for (bool warm : {false, true}) {
+      LatencyDiskManager dm(&memory_, profile);
+      BufferPoolManagerInstance bpm(pool_size, &dm);
+      BufferPoolWarmup warmup(&bpm, &dm);
+      if (warm) {
+        ASSERT_TRUE(warmup.Start());
+      }
+      auto hit_ratios = RunWindows(&bpm, workload, window, num_windows);
+      warmup.Stop();
+      // The restart is over once a window comes within 5% of the steady-state hit ratio.
+      size_t steady_window = num_windows;
+      for (size_t i = 0; i < num_windows; i++) {
+        if (hit_ratios[i] >= 0.95 * steady_hit_ratio) {
+          steady_window = i;
+          break;
+        }
+      }
+      std::string trace;
+      for (size_t i = 0; i < 10; i++) {
+        trace += std::to_string(static_cast<int>(hit_ratios[i] * 100)) + "% ";
+      }
+      LOG_INFO("%s, %s restart: steady after %s%zu ms, %zu pages prefetched in %.1f ms, first second: %s", name.c_str(),
+               warm ? "warm" : "cold", steady_window == num_windows ? "more than " : "",
+               (steady_window + 1) * window.count(), warmup.GetNumPrefetched(), warmup.GetWarmupTime().count() / 1e6,
+               trace.c_str());
+    }
+  }
+}
+
+}  // namespace bustub
@@ -14,7 +14,9 @@
 #include <cstdio>
 #include <random>
 #include <string>
+#include <vector>
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/buffer_pool_warmup.h"
 #include "gtest/gtest.h"
 
 namespace bustub {
@@ -141,4 +143,79 @@ TEST(BufferPoolManagerInstanceTest, SampleTest) {
   delete disk_manager;
 }
 
+// NOLINTNEXTLINE
+TEST(BufferPoolManagerInstanceTest, WarmupTest) {
+  const std::string db_name = "test.db";
+  const size_t buffer_pool_size = 10;
+
+  auto *disk_manager = new DiskManager(db_name);
+  auto *bpm = new BufferPoolManagerInstance(buffer_pool_size, disk_manager);
+  page_id_t page_id_temp;
+  for (int i = 0; i < 20; ++i) {
+    auto *page = bpm->NewPage(&page_id_temp);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", i);
+    EXPECT_EQ(true, bpm->UnpinPage(page_id_temp, true));
+  }
+  bpm->FlushAllPages();
+
+  // Scenario: The resident pages are listed hottest first, the pinned ones before the others.
+  ASSERT_NE(nullptr, bpm->FetchPage(8));
+  for (page_id_t page_id : {15, 3, 4, 5, 17}) {
+    ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+  std::vector<page_id_t> resident = bpm->GetResidentPages();
+  ASSERT_EQ(buffer_pool_size, resident.size());
+  resident.resize(6);
+  EXPECT_EQ((std::vector<page_id_t>{8, 17, 5, 4, 3, 15}), resident);
+
+  BufferPoolWarmup warmup(bpm, disk_manager);
+  warmup.SaveResidentPages();
+  EXPECT_EQ(true, bpm->UnpinPage(8, false));
+  disk_manager->ShutDown();
+  delete bpm;
+  delete disk_manager;
+
+  // Scenario: After a restart, a smaller buffer pool is warmed up with the hottest pages of the list.
+  disk_manager = new DiskManager(db_name);
+  bpm = new BufferPoolManagerInstance(4, disk_manager);
+  BufferPoolWarmup restart_warmup(bpm, disk_manager);
+  ASSERT_EQ(true, restart_warmup.Start());
+  restart_warmup.Wait();
+  EXPECT_EQ(true, restart_warmup.IsDone());
+  EXPECT_EQ(4, restart_warmup.GetNumPrefetched());
+  for (page_id_t page_id : {8, 17, 5, 4}) {
+    auto *page = bpm->FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ("page " + std::to_string(page_id), std::string(page->GetData()));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+  EXPECT_EQ(4, bpm->GetNumHits());
+  EXPECT_EQ(0, bpm->GetNumMisses());
+
+  // Scenario: Prefetching never evicts, and the prefetched pages keep their rank: fetching one more page evicts the
+  // coldest of them that has not been touched since.
+  EXPECT_EQ(0, bpm->Prefetch({0, 1}));
+  delete bpm;
+  bpm = new BufferPoolManagerInstance(4, disk_manager);
+  EXPECT_EQ(4, bpm->Prefetch({8, 17, 5, 4}));
+  ASSERT_NE(nullptr, bpm->FetchPage(0));
+  EXPECT_EQ(true, bpm->UnpinPage(0, false));
+  for (page_id_t page_id : {8, 17, 5}) {
+    ASSERT_NE(nullptr, bpm->FetchPage(page_id));
+    EXPECT_EQ(true, bpm->UnpinPage(page_id, false));
+  }
+  EXPECT_EQ(3, bpm->GetNumHits());
+  EXPECT_EQ(1, bpm->GetNumMisses());
+
+  disk_manager->ShutDown();
+  remove("test.db");
+  remove("test.log");
+  remove("test.warmup");
+
+  delete bpm;
+  delete disk_manager;
+}
+
 }  // namespace bustub
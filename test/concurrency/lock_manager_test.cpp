@@ -3,13 +3,20 @@
  */
 
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <random>
 
+#include "buffer/buffer_pool_manager_instance.h"
+#include "catalog/catalog.h"
 #include "common/exception.h"
 #include "common/logger.h"
 #include "concurrency/transaction.h"
 #include "concurrency/transaction_manager.h"
 #include "gtest/gtest.h"
+#include "recovery/log_manager.h"
+#include "storage/disk/disk_stats.h"
+#include "storage/disk/memory_disk_manager.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 
@@ -535,6 +542,267 @@ void FairnessTest2() {
   mutex.unlock();
 }
 
+void TableLockTest() {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  const table_oid_t oid = 0;
+
+  Transaction txn0(0);
+  Transaction txn1(1);
+  txn_mgr.Begin(&txn0);
+  txn_mgr.Begin(&txn1);
+  EXPECT_TRUE(lock_mgr.LockTable(&txn0, oid, TableLockMode::INTENTION_SHARED));
+  EXPECT_TRUE(lock_mgr.LockTable(&txn1, oid, TableLockMode::INTENTION_EXCLUSIVE));
+  CheckGrowing(&txn1);
+
+  // Reading the whole table conflicts with the rows txn1 means to write, and txn1 is younger.
+  EXPECT_TRUE(lock_mgr.LockTable(&txn0, oid, TableLockMode::SHARED));
+  CheckAborted(&txn1);
+  txn_mgr.Abort(&txn1);
+  EXPECT_TRUE(txn1.GetTableLockSet()->empty());
+
+  // Upgrading a shared table lock to write some rows ends up with SHARED_INTENTION_EXCLUSIVE.
+  EXPECT_TRUE(lock_mgr.LockTable(&txn0, oid, TableLockMode::INTENTION_EXCLUSIVE));
+  EXPECT_EQ(txn0.GetTableLockSet()->at(oid), TableLockMode::SHARED_INTENTION_EXCLUSIVE);
+  EXPECT_TRUE(LockManager::IsTableLocked(&txn0, oid, TableLockMode::SHARED));
+  EXPECT_TRUE(LockManager::IsTableLocked(&txn0, oid, TableLockMode::INTENTION_EXCLUSIVE));
+  EXPECT_FALSE(LockManager::IsTableLocked(&txn0, oid, TableLockMode::EXCLUSIVE));
+
+  // A younger reader of some rows gets in, a younger reader of the whole table waits for txn0.
+  Transaction txn2(2);
+  txn_mgr.Begin(&txn2);
+  EXPECT_TRUE(lock_mgr.LockTable(&txn2, oid, TableLockMode::INTENTION_SHARED));
+  std::atomic<bool> granted{false};
+  std::thread reader([&] {
+    Transaction txn3(3);
+    txn_mgr.Begin(&txn3);
+    EXPECT_TRUE(lock_mgr.LockTable(&txn3, oid, TableLockMode::SHARED));
+    granted = true;
+    txn_mgr.Commit(&txn3);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  txn_mgr.Commit(&txn0);
+  reader.join();
+  EXPECT_TRUE(granted);
+  CheckGrowing(&txn2);
+  txn_mgr.Commit(&txn2);
+
+  // READ_UNCOMMITTED takes no shared locks, so it may not announce any either.
+  Transaction txn4(4, IsolationLevel::READ_UNCOMMITTED);
+  txn_mgr.Begin(&txn4);
+  EXPECT_FALSE(lock_mgr.LockTable(&txn4, oid, TableLockMode::INTENTION_SHARED));
+  CheckAborted(&txn4);
+  txn_mgr.Abort(&txn4);
+}
+
+void EscalationTest() {
+  LockManager lock_mgr{4};
+  TransactionManager txn_mgr{&lock_mgr};
+  const table_oid_t oid = 0;
+
+  Transaction txn0(0, IsolationLevel::READ_COMMITTED);
+  txn_mgr.Begin(&txn0);
+  EXPECT_TRUE(lock_mgr.LockTable(&txn0, oid, TableLockMode::INTENTION_EXCLUSIVE));
+  for (int slot = 0; slot < 4; slot++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, oid, RID(0, slot)));
+  }
+  CheckTxnLockSize(&txn0, 0, 4);
+  EXPECT_EQ(lock_mgr.GetNumEscalations(), 0);
+
+  // One row lock too many trades them all for a table lock.
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, oid, RID(0, 4)));
+  CheckGrowing(&txn0);
+  CheckTxnLockSize(&txn0, 0, 0);
+  EXPECT_TRUE(LockManager::IsTableLocked(&txn0, oid, TableLockMode::EXCLUSIVE));
+  EXPECT_EQ(lock_mgr.GetNumEscalations(), 1);
+  EXPECT_EQ(lock_mgr.GetNumEscalatedRowLocks(), 5);
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, oid, RID(0, 5)));
+  CheckTxnLockSize(&txn0, 0, 0);
+
+  // Writers of other rows of the table now wait for the table lock.
+  Transaction txn1(1);
+  txn_mgr.Begin(&txn1);
+  std::atomic<bool> granted{false};
+  std::thread writer([&] {
+    EXPECT_TRUE(lock_mgr.LockTable(&txn1, oid, TableLockMode::INTENTION_EXCLUSIVE));
+    granted = true;
+    txn_mgr.Commit(&txn1);
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(granted);
+  txn_mgr.Commit(&txn0);
+  writer.join();
+  EXPECT_TRUE(granted);
+  EXPECT_TRUE(txn0.GetTableRowLocks()->empty());
+}
+
+void EscalationLoggingTest() {
+  MemoryDiskManager disk_manager;
+  LogManager log_manager(&disk_manager);
+  BufferPoolManagerInstance bpm(16, &disk_manager, &log_manager);
+  LockManager lock_mgr{4};
+  TransactionManager txn_mgr{&lock_mgr, &log_manager};
+  Catalog catalog(&bpm, &lock_mgr, &log_manager);
+  log_manager.RunFlushThread();
+  Schema schema{std::vector<Column>{Column{"a", TypeId::INTEGER}}};
+  auto make_tuple = [&](int32_t a) { return Tuple{std::vector<Value>{ValueFactory::GetIntegerValue(a)}, &schema}; };
+
+  Transaction loader(0);
+  txn_mgr.Begin(&loader);
+  auto info = catalog.CreateTable(&loader, "t", schema);
+  std::vector<RID> rids(12);
+  for (size_t i = 0; i < rids.size(); i++) {
+    ASSERT_TRUE(info->table_->InsertTuple(make_tuple(i), &rids[i], &loader));
+  }
+  txn_mgr.Commit(&loader);
+
+  // The rows deleted before the escalation are covered by the table lock on abort, and the ones deleted or inserted
+  // after it take no row locks.
+  Transaction txn1(1);
+  txn_mgr.Begin(&txn1);
+  EXPECT_TRUE(lock_mgr.LockTable(&txn1, info->oid_, TableLockMode::INTENTION_EXCLUSIVE));
+  for (size_t i = 0; i < 6; i++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, info->oid_, rids[i]));
+    EXPECT_TRUE(info->table_->MarkDelete(rids[i], &txn1));
+  }
+  RID inserted;
+  EXPECT_TRUE(info->table_->InsertTuple(make_tuple(-1), &inserted, &txn1));
+  EXPECT_EQ(lock_mgr.GetNumEscalations(), 1);
+  CheckTxnLockSize(&txn1, 0, 0);
+  txn_mgr.Abort(&txn1);
+
+  // The same on commit.
+  Transaction txn2(2);
+  txn_mgr.Begin(&txn2);
+  EXPECT_TRUE(lock_mgr.LockTable(&txn2, info->oid_, TableLockMode::INTENTION_EXCLUSIVE));
+  for (size_t i = 6; i < rids.size(); i++) {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn2, info->oid_, rids[i]));
+    EXPECT_TRUE(info->table_->MarkDelete(rids[i], &txn2));
+  }
+  EXPECT_EQ(lock_mgr.GetNumEscalations(), 2);
+  CheckTxnLockSize(&txn2, 0, 0);
+  txn_mgr.Commit(&txn2);
+
+  Transaction reader(3);
+  txn_mgr.Begin(&reader);
+  Tuple tuple;
+  for (size_t i = 0; i < rids.size(); i++) {
+    EXPECT_EQ(info->table_->GetTuple(rids[i], &tuple, &reader), i < 6);
+  }
+  EXPECT_FALSE(info->table_->GetTuple(inserted, &tuple, &reader));
+  txn_mgr.Commit(&reader);
+  log_manager.StopFlushThread();
+}
+
+void GraphTest() {
+  LockManager lock_mgr{};
+  txn_id_t victim = INVALID_TXN_ID;
+  lock_mgr.AddEdge(0, 1);
+  lock_mgr.AddEdge(1, 2);
+  lock_mgr.AddEdge(3, 1);
+  EXPECT_FALSE(lock_mgr.HasCycle(&victim));
+  lock_mgr.AddEdge(2, 3);
+  EXPECT_EQ(lock_mgr.GetEdgeList().size(), 4);
+  // The cycle is 1 -> 2 -> 3 -> 1, which 0 only leads to.
+  EXPECT_TRUE(lock_mgr.HasCycle(&victim));
+  EXPECT_EQ(victim, 3);
+  lock_mgr.RemoveEdge(3, 1);
+  EXPECT_FALSE(lock_mgr.HasCycle(&victim));
+  EXPECT_EQ(lock_mgr.GetEdgeList().size(), 3);
+}
+
+void DeadlockDetectionTest() {
+  LockManager lock_mgr{LOCK_ESCALATION_THRESHOLD, DeadlockPolicy::DETECTION};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID rid0(0, 0);
+  RID rid1(0, 1);
+  Transaction txn0(0);
+  Transaction txn1(1);
+  txn_mgr.Begin(&txn0);
+  txn_mgr.Begin(&txn1);
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, rid0));
+  EXPECT_TRUE(lock_mgr.LockExclusive(&txn1, rid1));
+
+  // The older transaction waits for the younger one, which wound-wait would have aborted.
+  std::atomic<bool> granted{false};
+  std::thread older([&] {
+    EXPECT_TRUE(lock_mgr.LockExclusive(&txn0, rid1));
+    granted = true;
+    txn_mgr.Commit(&txn0);
+  });
+  std::this_thread::sleep_for(cycle_detection_interval * 3);
+  EXPECT_FALSE(granted);
+  CheckGrowing(&txn0);
+  CheckGrowing(&txn1);
+  EXPECT_EQ(lock_mgr.GetNumDeadlocks(), 0);
+
+  // Closing the cycle aborts its youngest transaction.
+  EXPECT_FALSE(lock_mgr.LockExclusive(&txn1, rid0));
+  CheckAborted(&txn1);
+  txn_mgr.Abort(&txn1);
+  older.join();
+  EXPECT_TRUE(granted);
+  EXPECT_EQ(lock_mgr.GetNumDeadlocks(), 1);
+}
+
+void ContentionProfileTest() {
+  LockManager lock_mgr{};
+  TransactionManager txn_mgr{&lock_mgr};
+  RID hot_rid(0, 0);
+  RID cold_rid(0, 1);
+
+  // Nothing is recorded while profiling is off.
+  auto txn0 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn0, hot_rid));
+  txn_mgr.Commit(txn0);
+  delete txn0;
+  EXPECT_TRUE(lock_mgr.GetHottestLocks(10).empty());
+  EXPECT_EQ(lock_mgr.GetRowQueueLengths().GetCount(), 0U);
+
+  lock_mgr.SetProfiling(true);
+  auto txn1 = txn_mgr.Begin();
+  auto txn2 = txn_mgr.Begin();
+  auto txn3 = txn_mgr.Begin();
+  EXPECT_TRUE(lock_mgr.LockShared(txn3, cold_rid));
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn2, hot_rid));
+  std::thread waiter([&] { EXPECT_FALSE(lock_mgr.LockExclusive(txn3, hot_rid)); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  // The oldest transaction wounds the one holding the lock and the one waiting for it.
+  EXPECT_TRUE(lock_mgr.LockExclusive(txn1, hot_rid));
+  waiter.join();
+  CheckAborted(txn2);
+  CheckAborted(txn3);
+  EXPECT_TRUE(lock_mgr.LockTable(txn1, 0, TableLockMode::INTENTION_SHARED));
+
+  auto hottest = lock_mgr.GetHottestLocks(10);
+  ASSERT_EQ(hottest.size(), 1U);
+  EXPECT_FALSE(hottest[0].is_table_);
+  EXPECT_EQ(hottest[0].rid_, hot_rid);
+  const auto &contention = hottest[0].contention_;
+  EXPECT_EQ(contention.requests_, 3U);
+  EXPECT_EQ(contention.waits_, 1U);
+  EXPECT_GE(contention.wait_ns_, 40000000U);
+  EXPECT_EQ(contention.wounds_, 2U);
+  EXPECT_EQ(contention.aborts_, 1U);
+  EXPECT_EQ(contention.max_queue_length_, 2U);
+  // Only the waiter joined a queue that was not empty.
+  EXPECT_EQ(lock_mgr.GetRowQueueLengths().GetBucketCount(0), 3U);
+  EXPECT_EQ(lock_mgr.GetRowQueueLengths().GetBucketCount(1), 1U);
+  EXPECT_EQ(lock_mgr.GetTableQueueLengths().GetCount(), 1U);
+  EXPECT_NE(lock_mgr.GetContentionReport(10).find("row (0, 0): 3 requests, 1 waits"), std::string::npos);
+
+  txn_mgr.Abort(txn2);
+  txn_mgr.Abort(txn3);
+  txn_mgr.Commit(txn1);
+  delete txn1;
+  delete txn2;
+  delete txn3;
+  lock_mgr.ResetProfile();
+  EXPECT_TRUE(lock_mgr.GetHottestLocks(10).empty());
+  EXPECT_EQ(lock_mgr.GetRowQueueLengths().GetCount(), 0U);
+}
+
 /****************************
  * Prevention Tests (55 pts)
  ****************************/
@@ -594,4 +862,256 @@ TEST(LockManagerTest, WoundWaitFairnessTest) {
   }
 }
 
+/*
+ * Description: table locks of different modes conflict as the intention locking protocol says, upgrades join the modes,
+ * and younger conflicting transactions are wounded or wait like for row locks.
+ */
+TEST(LockManagerTest, TableLockTest) { TableLockTest(); }
+
+/*
+ * Description: a transaction holding more exclusive row locks on a table than the threshold escalates them to an
+ * exclusive table lock, which other transactions then wait for.
+ */
+TEST(LockManagerTest, EscalationTest) { EscalationTest(); }
+
+/*
+ * Description: with logging enabled, a transaction whose row locks were escalated commits and aborts its deletes and
+ * inserts under the table lock, without locking the rows again.
+ */
+TEST(LockManagerTest, EscalationLoggingTest) { EscalationLoggingTest(); }
+
+/*
+ * Description: the waits-for graph finds cycles and their youngest transaction, and under the detection policy only
+ * the transactions of an actual deadlock are aborted.
+ */
+TEST(LockManagerTest, DeadlockDetectionTest) {
+  GraphTest();
+  DeadlockDetectionTest();
+}
+
+/*
+ * Description: while profiling, the lock manager records the requests, waits, wounds and aborts on every lock and the
+ * queue lengths, and reports the locks waited for longest.
+ */
+TEST(LockManagerTest, ContentionProfileTest) { ContentionProfileTest(); }
+
+/*
+ * Lock manager benchmarks are not graded. Run them with
+ *   ./test/lock_manager_test --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*
+ *
+ * Every thread runs transactions that each lock 16 rows of their own exclusively and then release them, so no two
+ * threads ever want the same lock and the throughput only depends on the lock manager itself.
+ */
+TEST(LockManagerTest, DISABLED_UncontendedLockBenchmark) {
+  const size_t total_txns = 40000;
+  const int rows_per_txn = 16;
+
+  for (size_t num_threads : {1, 2, 4, 8, 16, 32, 64}) {
+    LockManager lock_mgr{};
+    std::atomic<txn_id_t> next_txn_id{0};
+    size_t txns_per_thread = total_txns / num_threads;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] {
+        for (size_t i = 0; i < txns_per_thread; i++) {
+          Transaction txn(next_txn_id++, IsolationLevel::READ_COMMITTED);
+          for (int slot = 0; slot < rows_per_txn; slot++) {
+            EXPECT_TRUE(lock_mgr.LockExclusive(&txn, RID(static_cast<page_id_t>(t), slot)));
+          }
+          txn.SetState(TransactionState::COMMITTED);
+          for (int slot = 0; slot < rows_per_txn; slot++) {
+            lock_mgr.Unlock(&txn, RID(static_cast<page_id_t>(t), slot));
+          }
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double pairs = static_cast<double>(num_threads * txns_per_thread * rows_per_txn);
+    LOG_INFO("%zu threads: %.0f lock/unlock pairs/s", num_threads, pairs / elapsed.count());
+  }
+}
+
+/*
+ * All threads run transactions that lock the same row exclusively and yield while holding it, so that at any time
+ * nearly all of them wait for it. A transaction that happens to be older than some of the waiters wounds them on
+ * arrival; those count as aborts.
+ */
+TEST(LockManagerTest, DISABLED_HotRowBenchmark) {
+  const size_t total_txns = 20000;
+  const RID hot_rid{0, 0};
+
+  for (size_t num_threads : {10, 100, 200, 400}) {
+    LockManager lock_mgr{};
+    TransactionManager txn_mgr{&lock_mgr};
+    std::atomic<txn_id_t> next_txn_id{0};
+    std::atomic<size_t> num_aborts{0};
+    LatencyHistogram wait_latency;
+    size_t txns_per_thread = total_txns / num_threads;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+      threads.emplace_back([&] {
+        for (size_t i = 0; i < txns_per_thread; i++) {
+          Transaction txn(next_txn_id++);
+          txn_mgr.Begin(&txn);
+          auto lock_start = std::chrono::steady_clock::now();
+          if (!lock_mgr.LockExclusive(&txn, hot_rid)) {
+            num_aborts++;
+            txn_mgr.Abort(&txn);
+            continue;
+          }
+          wait_latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() -
+                                                                                   lock_start)
+                                  .count());
+          // Give the other threads the chance to queue up behind the lock.
+          std::this_thread::yield();
+          txn_mgr.Commit(&txn);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG_INFO("%zu threads: %.0f grants/s, %zu aborts, wait p50 %lu us, p99 %lu us, p99.9 %lu us", num_threads,
+             wait_latency.GetCount() / elapsed.count(), num_aborts.load(), wait_latency.GetPercentile(50),
+             wait_latency.GetPercentile(99), wait_latency.GetPercentile(99.9));
+  }
+}
+
+/*
+ * Threads run transactions that each lock a few rows out of a small hot set exclusively, in random order, and yield
+ * while holding them, so transactions often conflict and sometimes deadlock. Compares wound-wait with deadlock
+ * detection at the default and at a short detection interval; aborted transactions are not retried.
+ */
+TEST(LockManagerTest, DISABLED_DeadlockPolicyBenchmark) {
+  const size_t num_threads = 8;
+  const size_t txns_per_thread = 2000;
+  const int num_hot_rows = 64;
+  const int rows_per_txn = 4;
+  const auto default_interval = cycle_detection_interval;
+
+  for (auto [policy, interval] : {std::make_pair(DeadlockPolicy::WOUND_WAIT, default_interval),
+                                  std::make_pair(DeadlockPolicy::DETECTION, default_interval),
+                                  std::make_pair(DeadlockPolicy::DETECTION, std::chrono::milliseconds(1))}) {
+    cycle_detection_interval = interval;
+    LockManager lock_mgr{LOCK_ESCALATION_THRESHOLD, policy};
+    TransactionManager txn_mgr{&lock_mgr};
+    std::atomic<size_t> num_commits{0};
+    std::atomic<size_t> num_aborts{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] {
+        std::mt19937 gen(t);
+        std::uniform_int_distribution<int> pick_row(0, num_hot_rows - 1);
+        for (size_t i = 0; i < txns_per_thread; i++) {
+          auto txn = txn_mgr.Begin();
+          bool ok = true;
+          for (int j = 0; ok && j < rows_per_txn; j++) {
+            ok = lock_mgr.LockExclusive(txn, RID(0, pick_row(gen)));
+            std::this_thread::yield();
+          }
+          if (ok && txn->GetState() != TransactionState::ABORTED) {
+            txn_mgr.Commit(txn);
+            num_commits++;
+          } else {
+            txn_mgr.Abort(txn);
+            num_aborts++;
+          }
+          delete txn;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG_INFO("%s, interval %ld ms: %.0f commits/s, %zu aborts (%.2f%%), %lu deadlocks",
+             policy == DeadlockPolicy::WOUND_WAIT ? "wound-wait" : "detection", interval.count(),
+             num_commits / elapsed.count(), num_aborts.load(), 100.0 * num_aborts / (num_commits + num_aborts),
+             lock_mgr.GetNumDeadlocks());
+  }
+  cycle_detection_interval = default_interval;
+}
+
+/*
+ * Runs the workloads of the uncontended benchmark and of a hot set of rows, where threads lock 4 out of 64 rows
+ * exclusively, with profiling off and on, and prints the contention report of the hot set.
+ */
+TEST(LockManagerTest, DISABLED_ContentionProfileBenchmark) {
+  const size_t num_threads = 8;
+  const size_t pairs_per_thread = 100000;
+  const size_t txns_per_thread = 5000;
+  const int num_hot_rows = 64;
+  const int rows_per_txn = 4;
+
+  for (bool profiling : {false, true}) {
+    LockManager lock_mgr{};
+    lock_mgr.SetProfiling(profiling);
+    std::atomic<txn_id_t> next_txn_id{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] {
+        for (size_t i = 0; i < pairs_per_thread; i++) {
+          Transaction txn(next_txn_id++, IsolationLevel::READ_COMMITTED);
+          RID rid(static_cast<page_id_t>(t), static_cast<uint32_t>(i % 16));
+          EXPECT_TRUE(lock_mgr.LockExclusive(&txn, rid));
+          txn.SetState(TransactionState::COMMITTED);
+          lock_mgr.Unlock(&txn, rid);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG_INFO("profiling %s, uncontended: %.0f lock/unlock pairs/s", profiling ? "on" : "off",
+             num_threads * pairs_per_thread / elapsed.count());
+  }
+
+  for (bool profiling : {false, true}) {
+    LockManager lock_mgr{};
+    TransactionManager txn_mgr{&lock_mgr};
+    lock_mgr.SetProfiling(profiling);
+    std::atomic<size_t> num_commits{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+      threads.emplace_back([&, t] {
+        std::mt19937 gen(t);
+        std::uniform_int_distribution<int> pick_row(0, num_hot_rows - 1);
+        for (size_t i = 0; i < txns_per_thread; i++) {
+          auto txn = txn_mgr.Begin();
+          bool ok = true;
+          for (int j = 0; ok && j < rows_per_txn; j++) {
+            ok = lock_mgr.LockExclusive(txn, RID(0, pick_row(gen)));
+            std::this_thread::yield();
+          }
+          if (ok && txn->GetState() != TransactionState::ABORTED) {
+            txn_mgr.Commit(txn);
+            num_commits++;
+          } else {
+            txn_mgr.Abort(txn);
+          }
+          delete txn;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG_INFO("profiling %s, hot set: %.0f commits/s", profiling ? "on" : "off", num_commits / elapsed.count());
+    if (profiling) {
+      LOG_INFO("contention report:\n%s", lock_mgr.GetContentionReport(5).c_str());
+    }
+  }
+}
+
 }  // namespace bustub
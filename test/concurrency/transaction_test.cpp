@@ -2,7 +2,10 @@
  * grading_transaction_test.cpp
  */
 
+#include <malloc.h>
+#include <algorithm>
 #include <atomic>
+#include <chrono>  // NOLINT
 #include <cstdio>
 #include <memory>
 #include <random>
@@ -13,6 +16,7 @@
 
 #include "buffer/buffer_pool_manager_instance.h"
 #include "catalog/table_generator.h"
+#include "common/logger.h"
 #include "concurrency/transaction.h"
 #include "concurrency/transaction_manager.h"
 #include "execution/execution_engine.h"
@@ -129,6 +133,18 @@ class GradingTransactionTest : public ::testing::Test {
     return allocated_output_schemas_.back().get();
   }
 
+  /** Create a table (a integer, b integer) with a row (i, i % 100) for every i below num_rows, for benchmarks. */
+  TableInfo *MakeLargeTable(const std::string &name, int num_rows) {
+    auto schema = ParseCreateStatement("a integer,b integer");
+    auto table_info = GetCatalog()->CreateTable(GetTxn(), name, *schema);
+    for (int i = 0; i < num_rows; i++) {
+      Tuple tuple({ValueFactory::GetIntegerValue(i), ValueFactory::GetIntegerValue(i % 100)}, schema.get());
+      RID rid;
+      table_info->table_->InsertTuple(tuple, &rid, GetTxn());
+    }
+    return table_info;
+  }
+
  private:
   std::unique_ptr<TransactionManager> txn_mgr_;
   Transaction *txn_{nullptr};
@@ -502,4 +518,621 @@ TEST_F(GradingTransactionTest, IntegratedTest) {
   delete txn3;
 }
 
+/*
+ * Snapshot transactions read the database as of their start, without locks, and the first of two concurrent writers
+ * of a tuple wins.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, SnapshotIsolationTest) {
+  auto table_info = MakeLargeTable("snapshot_table", 10);
+  auto table = table_info->table_.get();
+  const Schema *schema = &table_info->schema_;
+  TransactionManager txn_mgr(GetLockManager());
+
+  std::vector<RID> rids;
+  for (auto it = table->Begin(GetTxn()); it != table->End(); ++it) {
+    rids.push_back(it->GetRid());
+  }
+  ASSERT_EQ(rids.size(), 10U);
+  auto make_tuple = [schema](int a, int b) {
+    return Tuple({ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b)}, schema);
+  };
+  auto read_b = [table, schema](const RID &rid, Transaction *txn) {
+    Tuple tuple;
+    return table->GetTuple(rid, &tuple, txn) ? tuple.GetValue(schema, 1).GetAs<int32_t>() : -1;
+  };
+  auto count_rows = [table](Transaction *txn) {
+    size_t num_rows = 0;
+    for (auto it = table->Begin(txn); it != table->End(); ++it) {
+      num_rows++;
+    }
+    return num_rows;
+  };
+
+  auto reader = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto late_writer = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  auto writer = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  RID new_rid;
+  ASSERT_TRUE(table->UpdateTuple(make_tuple(0, 100), rids[0], writer));
+  ASSERT_TRUE(table->MarkDelete(rids[1], writer));
+  ASSERT_TRUE(table->InsertTuple(make_tuple(10, 10), &new_rid, writer));
+
+  // The writer sees its own changes, nobody else does.
+  EXPECT_EQ(read_b(rids[0], writer), 100);
+  EXPECT_EQ(read_b(rids[1], writer), -1);
+  EXPECT_EQ(count_rows(writer), 10U);
+  EXPECT_EQ(read_b(rids[0], reader), 0);
+  EXPECT_EQ(read_b(rids[1], reader), 1);
+  EXPECT_EQ(read_b(new_rid, reader), -1);
+  EXPECT_EQ(count_rows(reader), 10U);
+  EXPECT_EQ(reader->GetSharedLockSet()->size(), 0U);
+
+  // A concurrent update of the same tuple loses.
+  auto concurrent_writer = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_FALSE(table->UpdateTuple(make_tuple(0, 200), rids[0], concurrent_writer));
+  CheckAborted(concurrent_writer);
+  txn_mgr.Abort(concurrent_writer);
+  delete concurrent_writer;
+
+  txn_mgr.Commit(writer);
+  delete writer;
+
+  // Snapshots taken before the commit still see the old tuples, even the one whose delete was applied.
+  EXPECT_EQ(read_b(rids[0], reader), 0);
+  EXPECT_EQ(read_b(rids[1], reader), 1);
+  EXPECT_EQ(read_b(new_rid, reader), -1);
+  EXPECT_EQ(count_rows(reader), 10U);
+  auto new_reader = txn_mgr.Begin(nullptr, IsolationLevel::SNAPSHOT_ISOLATION);
+  EXPECT_EQ(read_b(rids[0], new_reader), 100);
+  EXPECT_EQ(read_b(rids[1], new_reader), -1);
+  EXPECT_EQ(read_b(new_rid, new_reader), 10);
+  EXPECT_EQ(count_rows(new_reader), 10U);
+
+  // An update of a tuple that changed since the snapshot was taken loses too, an unrelated one does not.
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(2, 300), rids[2], late_writer));
+  EXPECT_FALSE(table->UpdateTuple(make_tuple(0, 300), rids[0], late_writer));
+  CheckAborted(late_writer);
+  txn_mgr.Abort(late_writer);
+  delete late_writer;
+  EXPECT_EQ(read_b(rids[2], new_reader), 2);
+  EXPECT_EQ(read_b(rids[2], reader), 2);
+
+  txn_mgr.Commit(reader);
+  delete reader;
+  txn_mgr.Commit(new_reader);
+  delete new_reader;
+  // Without snapshots left, no old versions are kept.
+  EXPECT_EQ(table->GetNumVersionedTuples(), 0U);
+}
+
+/*
+ * Optimistic transactions keep their updates and deletes to themselves until they commit, and fail to commit if a
+ * tuple they read changed in the meantime.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, OptimisticTest) {
+  auto table_info = MakeLargeTable("optimistic_table", 10);
+  auto table = table_info->table_.get();
+  const Schema *schema = &table_info->schema_;
+  TransactionManager txn_mgr(GetLockManager());
+
+  std::vector<RID> rids;
+  for (auto it = table->Begin(GetTxn()); it != table->End(); ++it) {
+    rids.push_back(it->GetRid());
+  }
+  ASSERT_EQ(rids.size(), 10U);
+  auto make_tuple = [schema](int a, int b) {
+    return Tuple({ValueFactory::GetIntegerValue(a), ValueFactory::GetIntegerValue(b)}, schema);
+  };
+  auto read_b = [table, schema](const RID &rid, Transaction *txn) {
+    Tuple tuple;
+    return table->GetTuple(rid, &tuple, txn) ? tuple.GetValue(schema, 1).GetAs<int32_t>() : -1;
+  };
+  auto count_rows = [table](Transaction *txn) {
+    size_t num_rows = 0;
+    for (auto it = table->Begin(txn); it != table->End(); ++it) {
+      num_rows++;
+    }
+    return num_rows;
+  };
+
+  // Two transactions read and update the same tuple, the first to commit wins.
+  auto writer = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto other_writer = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(read_b(rids[0], writer), 0);
+  EXPECT_EQ(read_b(rids[0], other_writer), 0);
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(0, 100), rids[0], writer));
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(0, 200), rids[0], other_writer));
+  EXPECT_TRUE(table->MarkDelete(rids[1], writer));
+  EXPECT_EQ(read_b(rids[0], writer), 100);
+  EXPECT_EQ(read_b(rids[1], writer), -1);
+  EXPECT_EQ(count_rows(writer), 9U);
+  // Nothing is written before the commit.
+  EXPECT_EQ(read_b(rids[0], GetTxn()), 0);
+  EXPECT_EQ(read_b(rids[1], GetTxn()), 1);
+  EXPECT_EQ(writer->GetExclusiveLockSet()->size(), 0U);
+
+  EXPECT_TRUE(txn_mgr.Commit(writer));
+  delete writer;
+  EXPECT_FALSE(txn_mgr.Commit(other_writer));
+  CheckAborted(other_writer);
+  delete other_writer;
+  EXPECT_EQ(read_b(rids[0], GetTxn()), 100);
+  EXPECT_EQ(read_b(rids[1], GetTxn()), -1);
+
+  // A tuple inserted by a running transaction can be read, but not committed on.
+  auto inserter = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto reader = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  auto bystander = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  RID new_rid;
+  ASSERT_TRUE(table->InsertTuple(make_tuple(10, 10), &new_rid, inserter));
+  EXPECT_EQ(read_b(new_rid, reader), 10);
+  EXPECT_EQ(read_b(rids[2], bystander), 2);
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(2, 300), rids[2], bystander));
+  EXPECT_TRUE(txn_mgr.Commit(inserter));
+  delete inserter;
+  EXPECT_FALSE(txn_mgr.Commit(reader));
+  delete reader;
+  EXPECT_TRUE(txn_mgr.Commit(bystander));
+  delete bystander;
+
+  auto last_reader = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(read_b(rids[2], last_reader), 300);
+  EXPECT_EQ(read_b(new_rid, last_reader), 10);
+  EXPECT_EQ(count_rows(last_reader), 10U);
+  EXPECT_TRUE(txn_mgr.Commit(last_reader));
+  delete last_reader;
+}
+
+/*
+ * An optimistic transaction whose write fails at commit, here an update that no longer fits its page, is aborted
+ * with all of its writes rolled back, including those written before the failing one.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, OptimisticFailedWriteTest) {
+  Schema schema({Column("a", TypeId::INTEGER), Column("b", TypeId::VARCHAR, 3000)});
+  auto table_info = GetCatalog()->CreateTable(GetTxn(), "optimistic_failed_write_table", schema);
+  auto table = table_info->table_.get();
+  TransactionManager txn_mgr(GetLockManager());
+  auto make_tuple = [&schema](int a, char c, size_t length) {
+    return Tuple({ValueFactory::GetIntegerValue(a), ValueFactory::GetVarcharValue(std::string(length, c))}, &schema);
+  };
+  auto read_b = [table, &schema](const RID &rid, Transaction *txn) {
+    Tuple tuple;
+    return table->GetTuple(rid, &tuple, txn) ? tuple.GetValue(&schema, 1).ToString() : std::string();
+  };
+
+  // Three rows of 1000 bytes fill most of the first page.
+  std::vector<RID> rids(3);
+  for (int i = 0; i < 3; i++) {
+    ASSERT_TRUE(table->InsertTuple(make_tuple(i, 'a', 1000), &rids[i], GetTxn()));
+    ASSERT_EQ(rids[i].GetPageId(), rids[0].GetPageId());
+  }
+
+  auto writer = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  RID new_rid;
+  ASSERT_TRUE(table->InsertTuple(make_tuple(3, 'b', 10), &new_rid, writer));
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(0, 'b', 1000), rids[0], writer));
+  EXPECT_TRUE(table->MarkDelete(rids[1], writer));
+  // Deferred until the commit, where the row no longer fits its page.
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(2, 'b', 3000), rids[2], writer));
+  EXPECT_FALSE(txn_mgr.Commit(writer));
+  CheckAborted(writer);
+  delete writer;
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_EQ(read_b(rids[i], GetTxn()), std::string(1000, 'a')) << i;
+  }
+  EXPECT_EQ(read_b(new_rid, GetTxn()), std::string());
+
+  // The stamps of the tuples are unlocked, so they can be written again.
+  auto next_writer = txn_mgr.Begin(nullptr, IsolationLevel::OPTIMISTIC);
+  EXPECT_EQ(read_b(rids[1], next_writer), std::string(1000, 'a'));
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(1, 'c', 1000), rids[1], next_writer));
+  EXPECT_TRUE(table->UpdateTuple(make_tuple(2, 'c', 1000), rids[2], next_writer));
+  EXPECT_TRUE(txn_mgr.Commit(next_writer));
+  delete next_writer;
+  EXPECT_EQ(read_b(rids[1], GetTxn()), std::string(1000, 'c'));
+  EXPECT_EQ(read_b(rids[2], GetTxn()), std::string(1000, 'c'));
+}
+
+/*
+ * A transaction that inserts, updates and deletes rows all over a table of several pages, some rows more than once, is
+ * rolled back to exactly the table it started with; a transaction deleting rows in random order deletes just those.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, WriteSetByPageTest) {
+  const int num_rows = 1000;
+  auto table_info = MakeLargeTable("write_set_table", num_rows);
+  auto table = table_info->table_.get();
+  const Schema *schema = &table_info->schema_;
+  LockManager lock_mgr;
+  TransactionManager txn_mgr(&lock_mgr);
+
+  std::vector<RID> rids;
+  for (auto it = table->Begin(GetTxn()); it != table->End(); ++it) {
+    rids.push_back(it->GetRid());
+  }
+  ASSERT_EQ(rids.size(), static_cast<size_t>(num_rows));
+  ASSERT_NE(rids.front().GetPageId(), rids.back().GetPageId());
+  auto read_rows = [table, schema](Transaction *txn) {
+    std::vector<std::pair<int, int>> rows;
+    for (auto it = table->Begin(txn); it != table->End(); ++it) {
+      rows.emplace_back(it->GetValue(schema, 0).GetAs<int32_t>(), it->GetValue(schema, 1).GetAs<int32_t>());
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+  };
+  auto rows_before = read_rows(GetTxn());
+  std::mt19937 gen(0);
+  std::shuffle(rids.begin(), rids.end(), gen);
+
+  auto txn = txn_mgr.Begin();
+  for (int i = 0; i < num_rows; i++) {
+    ASSERT_TRUE(lock_mgr.LockExclusive(txn, rids[i]));
+    Tuple tuple({ValueFactory::GetIntegerValue(-i), ValueFactory::GetIntegerValue(i)}, schema);
+    if (i % 3 != 2) {
+      ASSERT_TRUE(table->UpdateTuple(tuple, rids[i], txn));
+    }
+    if (i % 3 != 0) {
+      ASSERT_TRUE(table->MarkDelete(rids[i], txn));
+    }
+    if (i % 10 == 0) {
+      RID rid;
+      ASSERT_TRUE(table->InsertTuple(tuple, &rid, txn));
+      ASSERT_TRUE(lock_mgr.LockExclusive(txn, rid));
+    }
+  }
+  txn_mgr.Abort(txn);
+  delete txn;
+  EXPECT_EQ(read_rows(GetTxn()), rows_before);
+
+  txn = txn_mgr.Begin();
+  for (int i = 0; i < num_rows / 2; i++) {
+    ASSERT_TRUE(lock_mgr.LockExclusive(txn, rids[i]));
+    ASSERT_TRUE(table->MarkDelete(rids[i], txn));
+  }
+  txn_mgr.Commit(txn);
+  delete txn;
+  EXPECT_EQ(read_rows(GetTxn()).size(), static_cast<size_t>(num_rows / 2));
+}
+
+/*
+ * A running transaction can be looked up by its id until it finishes, and blocking all transactions for a checkpoint
+ * waits for the running ones and holds up new ones until the transactions resume.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, BlockAllTransactionsTest) {
+  TransactionManager txn_mgr(GetLockManager());
+  auto txn = txn_mgr.Begin();
+  EXPECT_EQ(TransactionManager::GetTransaction(txn->GetTransactionId()), txn);
+
+  std::atomic<bool> blocked{false};
+  std::thread checkpoint([&] {
+    txn_mgr.BlockAllTransactions();
+    blocked = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_FALSE(blocked);
+  txn_mgr.Commit(txn);
+  checkpoint.join();
+  EXPECT_TRUE(blocked);
+  delete txn;
+
+  std::atomic<Transaction *> next_txn{nullptr};
+  std::thread begin([&] { next_txn = txn_mgr.Begin(); });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_EQ(next_txn, nullptr);
+  txn_mgr.ResumeTransactions();
+  begin.join();
+  ASSERT_NE(next_txn, nullptr);
+  txn_mgr.Abort(next_txn);
+  delete next_txn;
+}
+
+/*
+ * Not graded. Run it with
+ *   ./test/transaction_test --gtest_also_run_disabled_tests --gtest_filter=*Benchmark*
+ *
+ * Scans a large table once under each isolation level, each time with a lock manager of its own, and reports the scan
+ * throughput, the locks the scan leaves in the lock set of its transaction, and how much the heap grew by the time the
+ * scan finished, which is mostly lock requests and lock set entries.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, DISABLED_FullScanBenchmark) {
+  const int num_rows = 200000;
+
+  auto table_info = MakeLargeTable("scan_table", num_rows);
+  auto col_a = MakeColumnValueExpression(table_info->schema_, 0, "a");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+
+  for (auto isolation_level : {IsolationLevel::REPEATABLE_READ, IsolationLevel::READ_COMMITTED}) {
+    LockManager lock_mgr;
+    TransactionManager txn_mgr(&lock_mgr);
+    auto txn = txn_mgr.Begin(nullptr, isolation_level);
+    ExecutorContext exec_ctx(txn, GetCatalog(), GetBPM(), &txn_mgr, &lock_mgr);
+    size_t heap_before = mallinfo2().uordblks;
+    auto start = std::chrono::steady_clock::now();
+    GetExecutionEngine()->Execute(&scan_plan, nullptr, txn, &exec_ctx);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    size_t heap_after = mallinfo2().uordblks;
+    LOG_INFO("%s: %.0f rows/s, %zu row locks held, heap grew by %zu KB",
+             isolation_level == IsolationLevel::REPEATABLE_READ ? "REPEATABLE_READ" : "READ_COMMITTED",
+             num_rows / elapsed.count(), txn->GetSharedLockSet()->size(), (heap_after - heap_before) / 1024);
+    txn_mgr.Commit(txn);
+    delete txn;
+  }
+}
+
+/*
+ * Updates every row of a large table in one READ_COMMITTED transaction, once with lock escalation turned off and once
+ * with the default threshold, and reports how long the update took, how many row locks the transaction was left with
+ * and how much the heap grew until the update finished.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, DISABLED_LockEscalationBenchmark) {
+  const int num_rows = 200000;
+
+  auto table_info = MakeLargeTable("update_table", num_rows);
+  auto col_a = MakeColumnValueExpression(table_info->schema_, 0, "a");
+  auto out_schema = MakeOutputSchema({{"colA", col_a}});
+  SeqScanPlanNode scan_plan{out_schema, nullptr, table_info->oid_};
+  std::unordered_map<uint32_t, UpdateInfo> update_attrs;
+  update_attrs.insert(std::make_pair(1, UpdateInfo(UpdateType::Add, 1)));
+  UpdatePlanNode update_plan{&scan_plan, table_info->oid_, update_attrs};
+
+  for (size_t threshold : {static_cast<size_t>(0), static_cast<size_t>(LOCK_ESCALATION_THRESHOLD)}) {
+    LockManager lock_mgr(threshold);
+    TransactionManager txn_mgr(&lock_mgr);
+    auto txn = txn_mgr.Begin(nullptr, IsolationLevel::READ_COMMITTED);
+    ExecutorContext exec_ctx(txn, GetCatalog(), GetBPM(), &txn_mgr, &lock_mgr);
+    size_t heap_before = mallinfo2().uordblks;
+    auto start = std::chrono::steady_clock::now();
+    GetExecutionEngine()->Execute(&update_plan, nullptr, txn, &exec_ctx);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    size_t heap_after = mallinfo2().uordblks;
+    LOG_INFO("threshold %zu: %.0f rows/s, %zu row locks held, %lu escalations releasing %lu row locks, "
+             "heap grew by %zu KB",
+             threshold, num_rows / elapsed.count(), txn->GetExclusiveLockSet()->size(), lock_mgr.GetNumEscalations(),
+             lock_mgr.GetNumEscalatedRowLocks(), (heap_after - heap_before) / 1024);
+    txn_mgr.Commit(txn);
+    delete txn;
+  }
+}
+
+/*
+ * Runs a mix of short OLTP transactions on a table from a few threads, once under strict 2PL with REPEATABLE_READ and
+ * once under SNAPSHOT_ISOLATION, and reports committed transactions per second and the abort rate. Most transactions
+ * only read, the rest read and update a few rows; under 2PL their locks make them wait for and wound each other.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, DISABLED_SnapshotIsolationBenchmark) {
+  const int num_rows = 1000;
+  const int num_threads = 4;
+  const int num_txns_per_thread = 20000;
+  const int reads_per_txn = 8;
+  const int updates_per_txn = 2;
+  const int update_txn_percent = 20;
+
+  auto table_info = MakeLargeTable("oltp_table", num_rows);
+  auto table = table_info->table_.get();
+  const Schema *schema = &table_info->schema_;
+  std::vector<RID> rids;
+  for (auto it = table->Begin(GetTxn()); it != table->End(); ++it) {
+    rids.push_back(it->GetRid());
+  }
+
+  for (auto isolation_level : {IsolationLevel::REPEATABLE_READ, IsolationLevel::SNAPSHOT_ISOLATION}) {
+    bool locking = isolation_level == IsolationLevel::REPEATABLE_READ;
+    LockManager lock_mgr;
+    TransactionManager txn_mgr(&lock_mgr);
+    std::atomic<uint64_t> num_commits{0};
+    std::atomic<uint64_t> num_aborts{0};
+    auto worker = [&](int seed) {
+      std::mt19937 gen(seed);
+      std::uniform_int_distribution<size_t> pick_row(0, rids.size() - 1);
+      std::uniform_int_distribution<int> pick_percent(0, 99);
+      for (int i = 0; i < num_txns_per_thread; i++) {
+        auto txn = txn_mgr.Begin(nullptr, isolation_level);
+        bool is_update = pick_percent(gen) < update_txn_percent;
+        bool ok = true;
+        Tuple tuple;
+        for (int j = 0; ok && j < reads_per_txn; j++) {
+          RID rid = rids[pick_row(gen)];
+          ok = (!locking || txn->IsSharedLocked(rid) || txn->IsExclusiveLocked(rid) || lock_mgr.LockShared(txn, rid)) &&
+               table->GetTuple(rid, &tuple, txn);
+        }
+        for (int j = 0; ok && is_update && j < updates_per_txn; j++) {
+          RID rid = rids[pick_row(gen)];
+          if (locking && !txn->IsExclusiveLocked(rid)) {
+            ok = txn->IsSharedLocked(rid) ? lock_mgr.LockUpgrade(txn, rid) : lock_mgr.LockExclusive(txn, rid);
+          }
+          ok = ok && table->GetTuple(rid, &tuple, txn);
+          if (ok) {
+            int32_t b = tuple.GetValue(schema, 1).GetAs<int32_t>();
+            ok = table->UpdateTuple(
+                Tuple({tuple.GetValue(schema, 0), ValueFactory::GetIntegerValue(b + 1)}, schema), rid, txn);
+          }
+        }
+        // Wound-wait may have aborted the transaction while it was not waiting.
+        if (ok && txn->GetState() != TransactionState::ABORTED) {
+          txn_mgr.Commit(txn);
+          num_commits++;
+        } else {
+          txn_mgr.Abort(txn);
+          num_aborts++;
+        }
+        delete txn;
+      }
+    };
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back(worker, i);
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG_INFO("%s: %.0f commits/s, %lu commits, %lu aborts (%.2f%%), %zu versioned tuples left",
+             locking ? "REPEATABLE_READ" : "SNAPSHOT_ISOLATION", num_commits / elapsed.count(), num_commits.load(),
+             num_aborts.load(), 100.0 * num_aborts / (num_commits + num_aborts), table->GetNumVersionedTuples());
+  }
+}
+
+/*
+ * Runs short read-modify-write transactions from a few threads, each adding 1 to a few rows, under strict 2PL with
+ * REPEATABLE_READ and under OPTIMISTIC concurrency control. The rows are picked from the whole table for low
+ * contention, and from a handful of hot rows for high contention. Reports committed transactions per second and the
+ * abort rate; aborted transactions are not retried.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, DISABLED_OptimisticBenchmark) {
+  const int num_rows = 10000;
+  const int num_hot_rows = 16;
+  const int num_threads = 4;
+  const int num_txns_per_thread = 50000;
+  const int rows_per_txn = 4;
+
+  auto table_info = MakeLargeTable("rmw_table", num_rows);
+  auto table = table_info->table_.get();
+  const Schema *schema = &table_info->schema_;
+  std::vector<RID> rids;
+  for (auto it = table->Begin(GetTxn()); it != table->End(); ++it) {
+    rids.push_back(it->GetRid());
+  }
+
+  for (size_t num_keys : {rids.size(), static_cast<size_t>(num_hot_rows)}) {
+    for (auto isolation_level : {IsolationLevel::REPEATABLE_READ, IsolationLevel::OPTIMISTIC}) {
+      bool locking = isolation_level == IsolationLevel::REPEATABLE_READ;
+      LockManager lock_mgr;
+      TransactionManager txn_mgr(&lock_mgr);
+      std::atomic<uint64_t> num_commits{0};
+      std::atomic<uint64_t> num_aborts{0};
+      auto worker = [&](int seed) {
+        std::mt19937 gen(seed);
+        std::uniform_int_distribution<size_t> pick_row(0, num_keys - 1);
+        for (int i = 0; i < num_txns_per_thread; i++) {
+          auto txn = txn_mgr.Begin(nullptr, isolation_level);
+          bool ok = true;
+          Tuple tuple;
+          for (int j = 0; ok && j < rows_per_txn; j++) {
+            RID rid = rids[pick_row(gen)];
+            ok = (!locking || txn->IsExclusiveLocked(rid) || lock_mgr.LockExclusive(txn, rid)) &&
+                 table->GetTuple(rid, &tuple, txn);
+            if (ok) {
+              int32_t b = tuple.GetValue(schema, 1).GetAs<int32_t>();
+              ok = table->UpdateTuple(
+                  Tuple({tuple.GetValue(schema, 0), ValueFactory::GetIntegerValue(b + 1)}, schema), rid, txn);
+            }
+          }
+          // Wound-wait may have aborted the transaction while it was not waiting. A failed commit aborts it itself.
+          if (!ok || txn->GetState() == TransactionState::ABORTED) {
+            txn_mgr.Abort(txn);
+            num_aborts++;
+          } else if (txn_mgr.Commit(txn)) {
+            num_commits++;
+          } else {
+            num_aborts++;
+          }
+          delete txn;
+        }
+      };
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int i = 0; i < num_threads; i++) {
+        threads.emplace_back(worker, i);
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      LOG_INFO("%zu rows, %s: %.0f commits/s, %lu commits, %lu aborts (%.2f%%)", num_keys,
+               locking ? "REPEATABLE_READ" : "OPTIMISTIC", num_commits / elapsed.count(), num_commits.load(),
+               num_aborts.load(), 100.0 * num_aborts / (num_commits + num_aborts));
+    }
+  }
+}
+
+/*
+ * Transactions lock and mark deleted a few thousand rows each, in random order, and are then aborted, which rolls the
+ * deletes back; then the same transactions are run again and committed, which applies the deletes. Reports the time
+ * the aborts and the commits took per transaction and per row.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, DISABLED_BulkDeleteBenchmark) {
+  const int num_rows = 100000;
+  const size_t rows_per_txn = 5000;
+
+  auto table_info = MakeLargeTable("delete_table", num_rows);
+  auto table = table_info->table_.get();
+  std::vector<RID> rids;
+  for (auto it = table->Begin(GetTxn()); it != table->End(); ++it) {
+    rids.push_back(it->GetRid());
+  }
+  std::mt19937 gen(0);
+  std::shuffle(rids.begin(), rids.end(), gen);
+
+  LockManager lock_mgr;
+  TransactionManager txn_mgr(&lock_mgr);
+  for (bool commit : {false, true}) {
+    std::chrono::duration<double> finish_time{0};
+    size_t num_txns = 0;
+    for (size_t first = 0; first < rids.size(); first += rows_per_txn, num_txns++) {
+      auto txn = txn_mgr.Begin();
+      for (size_t i = first; i < std::min(first + rows_per_txn, rids.size()); i++) {
+        ASSERT_TRUE(lock_mgr.LockExclusive(txn, rids[i]));
+        ASSERT_TRUE(table->MarkDelete(rids[i], txn));
+      }
+      auto start = std::chrono::steady_clock::now();
+      if (commit) {
+        txn_mgr.Commit(txn);
+      } else {
+        txn_mgr.Abort(txn);
+      }
+      finish_time += std::chrono::steady_clock::now() - start;
+      delete txn;
+    }
+    LOG_INFO("%s: %.3f ms per transaction of %zu deletes, %.0f rows/s", commit ? "commit" : "abort",
+             finish_time.count() * 1000 / num_txns, rows_per_txn, rids.size() / finish_time.count());
+  }
+  size_t num_left = 0;
+  for (auto it = table->Begin(GetTxn()); it != table->End(); ++it) {
+    num_left++;
+  }
+  EXPECT_EQ(num_left, 0U);
+}
+
+/*
+ * Threads begin and commit empty transactions on one transaction manager, and the benchmark reports how many
+ * transactions per second it gets through; nothing but the transaction registry and the checkpoint latch is shared.
+ */
+// NOLINTNEXTLINE
+TEST_F(GradingTransactionTest, DISABLED_BeginCommitBenchmark) {
+  const size_t total_txns = 1000000;
+
+  for (size_t num_threads : {1, 2, 4, 8, 16}) {
+    LockManager lock_mgr;
+    TransactionManager txn_mgr(&lock_mgr);
+    size_t txns_per_thread = total_txns / num_threads;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++) {
+      threads.emplace_back([&] {
+        for (size_t i = 0; i < txns_per_thread; i++) {
+          auto txn = txn_mgr.Begin();
+          txn_mgr.Commit(txn);
+          delete txn;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG_INFO("%zu threads: %.0f transactions/s", num_threads, num_threads * txns_per_thread / elapsed.count());
+  }
+}
+
 }  // namespace bustub
@@ -0,0 +1,723 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_manager_test.cpp
+//
+// Identification: test/recovery/log_manager_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
+#include <vector>
+
+#include "catalog/schema.h"
+#include "common/config.h"
+#include "common/exception.h"
+#include "common/logger.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "buffer/buffer_pool_manager_instance.h"
+#include "gtest/gtest.h"
+#include "logging/common.h"
+#include "recovery/log_manager.h"
+#include "recovery/log_recovery.h"
+#include "recovery/tuple_delta.h"
+#include "storage/disk/latency_disk_manager.h"
+#include "storage/disk/memory_disk_manager.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+/**
+ * The append path LogManager used to have: one latch around LSN assignment, serialization and buffer swaps. It is
+ * kept here as the baseline of the append benchmark.
+ */
+class MutexLogAppender {
+ public:
+  explicit MutexLogAppender(DiskManager *disk_manager) : disk_manager_(disk_manager) {}
+
+  lsn_t AppendLogRecord(LogRecord *log_record) {
+    std::scoped_lock latch(latch_);
+    if (offset_ + log_record->GetSize() > LOG_BUFFER_SIZE) {
+      disk_manager_->WriteLog(buffers_[current_].data(), offset_);
+      current_ ^= 1;
+      offset_ = 0;
+    }
+    lsn_t lsn = next_lsn_++;
+    LogManager::SerializeLogRecord(log_record, buffers_[current_].data() + offset_);
+    offset_ += log_record->GetSize();
+    return lsn;
+  }
+
+ private:
+  DiskManager *disk_manager_;
+  std::mutex latch_;
+  std::vector<char> buffers_[2] = {std::vector<char>(LOG_BUFFER_SIZE), std::vector<char>(LOG_BUFFER_SIZE)};
+  int current_{0};
+  int offset_{0};
+  lsn_t next_lsn_{0};
+};
+
+class LogManagerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    remove("test.db");
+    remove("test.log");
+    saved_log_timeout_ = log_timeout;
+  }
+
+  // Also runs when a test fails an assertion half way, so a test may change the log timeout freely.
+  void TearDown() override {
+    remove("test.db");
+    remove("test.log");
+    log_timeout = saved_log_timeout_;
+  }
+
+  /** Commits num_threads * txns_per_thread empty transactions concurrently. */
+  static void CommitConcurrently(TransactionManager *txn_mgr, size_t num_threads, size_t txns_per_thread) {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; i++) {
+      threads.emplace_back([txn_mgr, txns_per_thread] {
+        for (size_t j = 0; j < txns_per_thread; j++) {
+          Transaction *txn = txn_mgr->Begin();
+          txn_mgr->Commit(txn);
+          delete txn;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+  }
+
+ private:
+  std::chrono::duration<int64_t> saved_log_timeout_;
+};
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, AppendAndFlushTest) {
+  DiskManager disk_manager("test.db");
+  LogManager log_manager(&disk_manager);
+  log_manager.RunFlushThread();
+  EXPECT_TRUE(enable_logging);
+
+  LogRecord begin(0, INVALID_LSN, LogRecordType::BEGIN);
+  EXPECT_EQ(log_manager.AppendLogRecord(&begin), 0);
+  LogRecord new_page(0, begin.GetLSN(), LogRecordType::NEWPAGE, INVALID_PAGE_ID, 7);
+  EXPECT_EQ(log_manager.AppendLogRecord(&new_page), 1);
+  LogRecord commit(0, new_page.GetLSN(), LogRecordType::COMMIT);
+  EXPECT_EQ(log_manager.AppendLogRecord(&commit), 2);
+
+  log_manager.Flush(commit.GetLSN());
+  EXPECT_EQ(log_manager.GetPersistentLSN(), 2);
+  EXPECT_EQ(log_manager.GetNumCommits(), 1);
+  EXPECT_GE(log_manager.GetNumFlushes(), 1);
+  // Flushing past the end of the log returns at once.
+  log_manager.Flush(100);
+
+  log_manager.StopFlushThread();
+  EXPECT_FALSE(enable_logging);
+
+  // The records are laid out back to back: | size | LSN | transID | prevLSN | LogType | body |.
+  char buf[128];
+  ASSERT_TRUE(disk_manager.ReadLog(buf, sizeof(buf), 0));
+  int32_t header[5];
+  memcpy(header, buf + begin.GetSize(), sizeof(header));
+  EXPECT_EQ(header[0], new_page.GetSize());
+  EXPECT_EQ(header[1], 1);
+  EXPECT_EQ(header[3], 0);
+  EXPECT_EQ(header[4], static_cast<int32_t>(LogRecordType::NEWPAGE));
+  page_id_t page_id;
+  memcpy(&page_id, buf + begin.GetSize() + 20 + sizeof(page_id_t), sizeof(page_id));
+  EXPECT_EQ(page_id, 7);
+  disk_manager.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, GroupCommitTest) {
+  MemoryDiskManager memory;
+  // A slow log device makes committers pile up behind each write.
+  LatencyDiskManager disk_manager(&memory, {std::chrono::microseconds(0), std::chrono::microseconds(0),
+                                            std::chrono::microseconds(2000), 0});
+  LogManager log_manager(&disk_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, &log_manager);
+  log_manager.RunFlushThread();
+
+  CommitConcurrently(&txn_mgr, 16, 10);
+  EXPECT_EQ(log_manager.GetNumCommits(), 160);
+  EXPECT_EQ(log_manager.GetCommitLatency().GetCount(), 160);
+  EXPECT_LT(log_manager.GetNumFlushes(), 160);
+  EXPECT_GT(log_manager.GetCommitsPerFlush(), 1);
+  // BEGIN and COMMIT for every transaction, and all of them are durable.
+  EXPECT_EQ(log_manager.GetNextLSN(), 320);
+  EXPECT_EQ(log_manager.GetPersistentLSN(), 319);
+
+  log_manager.StopFlushThread();
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, AsyncCommitTest) {
+  // Far beyond the delays below, so that only they can have the flush thread write the asynchronous commits.
+  log_timeout = std::chrono::seconds(3600);
+  MemoryDiskManager disk_manager;
+  LogManager log_manager(&disk_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, &log_manager);
+  log_manager.RunFlushThread();
+
+  // A synchronous commit is durable when it returns.
+  Transaction *txn = txn_mgr.Begin();
+  txn_mgr.Commit(txn);
+  EXPECT_GE(log_manager.GetPersistentLSN(), txn->GetPrevLSN());
+  delete txn;
+
+  // An asynchronous commit returns before it is durable, and becomes durable once its delay is up, long before the
+  // log timeout.
+  txn = txn_mgr.Begin();
+  txn_mgr.Commit(txn, Durability::ASYNC, std::chrono::milliseconds(100));
+  EXPECT_LT(log_manager.GetPersistentLSN(), txn->GetPrevLSN());
+  while (log_manager.GetPersistentLSN() < txn->GetPrevLSN()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  delete txn;
+
+  // A synchronous commit makes the asynchronous commits before it durable as well.
+  Transaction *async_txn = txn_mgr.Begin();
+  txn_mgr.Commit(async_txn, Durability::ASYNC, std::chrono::seconds(3600));
+  EXPECT_LT(log_manager.GetPersistentLSN(), async_txn->GetPrevLSN());
+  txn = txn_mgr.Begin();
+  txn_mgr.Commit(txn);
+  EXPECT_GE(log_manager.GetPersistentLSN(), async_txn->GetPrevLSN());
+  delete async_txn;
+  delete txn;
+
+  log_manager.StopFlushThread();
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, ConcurrentAppendTest) {
+  const int num_threads = 8;
+  const int records_per_thread = 2000;
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  // The default double buffer, and a ring of small buffers that rotates constantly.
+  for (auto [buffer_size, num_buffers] : {std::pair<size_t, size_t>{LOG_BUFFER_SIZE, 2}, {1024, 4}}) {
+    MemoryDiskManager disk_manager;
+    LogManager log_manager(&disk_manager, buffer_size, num_buffers);
+    log_manager.RunFlushThread();
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < num_threads; i++) {
+      threads.emplace_back([&log_manager, &schema, i] {
+        Tuple tuple = ConstructTuple(&schema);
+        lsn_t prev_lsn = INVALID_LSN;
+        for (int j = 0; j < records_per_thread; j++) {
+          LogRecord log_record(i, prev_lsn, LogRecordType::INSERT, RID(i, j), tuple);
+          lsn_t lsn = log_manager.AppendLogRecord(&log_record);
+          EXPECT_GT(lsn, prev_lsn);
+          prev_lsn = lsn;
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    log_manager.Flush(log_manager.GetNextLSN() - 1);
+    EXPECT_EQ(log_manager.GetPersistentLSN(), num_threads * records_per_thread - 1);
+    log_manager.StopFlushThread();
+    EXPECT_GT(log_manager.GetNumFlushes(), 1);
+    EXPECT_GT(log_manager.GetNumAppendStalls(), 0);
+
+    // Records must appear in LSN order with no gaps, each intact and chained to the previous record of its thread.
+    std::vector<lsn_t> last_lsn(num_threads, INVALID_LSN);
+    std::vector<int> next_slot(num_threads, 0);
+    int offset = 0;
+    const int header_size = 20;
+    char buf[header_size + 64];
+    for (lsn_t lsn = 0; lsn < num_threads * records_per_thread; lsn++) {
+      ASSERT_TRUE(disk_manager.ReadLog(buf, sizeof(buf), offset));
+      int32_t header[5];
+      memcpy(header, buf, sizeof(header));
+      ASSERT_EQ(header[1], lsn);
+      txn_id_t txn_id = header[2];
+      ASSERT_TRUE(txn_id >= 0 && txn_id < num_threads);
+      EXPECT_EQ(header[3], last_lsn[txn_id]);
+      RID rid;
+      memcpy(&rid, buf + header_size, sizeof(RID));
+      EXPECT_EQ(rid, RID(txn_id, next_slot[txn_id]++));
+      last_lsn[txn_id] = lsn;
+      offset += header[0];
+    }
+    EXPECT_FALSE(disk_manager.ReadLog(buf, sizeof(buf), offset));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, InvalidBufferConfigTest) {
+  MemoryDiskManager disk_manager;
+  EXPECT_THROW(LogManager(&disk_manager, LOG_BUFFER_SIZE, 1), Exception);
+  EXPECT_THROW(LogManager(&disk_manager, 4, 2), Exception);
+
+  LogManager log_manager(&disk_manager, 64, 2);
+  Column col{"a", TypeId::VARCHAR, 100};
+  Schema schema{std::vector<Column>{col}};
+  std::vector<Value> values{ValueFactory::GetVarcharValue(std::string(80, 'x'))};
+  LogRecord too_large(0, INVALID_LSN, LogRecordType::INSERT, RID(0, 0), Tuple(values, &schema));
+  EXPECT_THROW(log_manager.AppendLogRecord(&too_large), Exception);
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, UpdateDeltaTest) {
+  std::vector<Column> cols;
+  for (int i = 0; i < 16; i++) {
+    cols.emplace_back("c" + std::to_string(i), TypeId::INTEGER);
+  }
+  cols.emplace_back("v", TypeId::VARCHAR, 64);
+  Schema schema{cols};
+  auto make_tuple = [&schema](int32_t first, int32_t last, const std::string &text) {
+    std::vector<Value> values;
+    for (int i = 0; i < 16; i++) {
+      values.push_back(ValueFactory::GetIntegerValue(i == 0 ? first : i == 15 ? last : i));
+    }
+    values.push_back(ValueFactory::GetVarcharValue(text));
+    return Tuple(values, &schema);
+  };
+  auto same = [](const Tuple &a, const Tuple &b) {
+    return a.GetLength() == b.GetLength() && memcmp(a.GetData(), b.GetData(), a.GetLength()) == 0;
+  };
+  auto check_round_trip = [&same](const Tuple &old_tuple, const Tuple &new_tuple, size_t num_ranges) {
+    TupleDelta delta(old_tuple, new_tuple);
+    EXPECT_EQ(delta.GetNumRanges(), num_ranges);
+    Tuple image;
+    ASSERT_TRUE(delta.Redo(old_tuple, &image));
+    EXPECT_TRUE(same(image, new_tuple));
+    ASSERT_TRUE(delta.Undo(new_tuple, &image));
+    EXPECT_TRUE(same(image, old_tuple));
+    // The delta only applies to the images it was computed from.
+    if (num_ranges != 0) {
+      EXPECT_FALSE(delta.Redo(new_tuple, &image));
+    }
+  };
+
+  Tuple base = make_tuple(0, 15, "unchanged text");
+  check_round_trip(base, base, 0);
+  check_round_trip(base, make_tuple(1000, 15, "unchanged text"), 1);
+  check_round_trip(base, make_tuple(1000, 1000, "unchanged text"), 2);
+  check_round_trip(base, make_tuple(0, 15, "unchanged text, now longer"), 1);
+  // Changing both ends of the tuple leaves nothing to save, TablePage logs the full images then.
+  check_round_trip(base, make_tuple(7, 15, "short"), 1);
+  EXPECT_LT(TupleDelta(base, make_tuple(1000, 1000, "unchanged text")).GetSerializedSize(), 32);
+  EXPECT_GT(TupleDelta(base, make_tuple(7, 15, "short")).GetSerializedSize(), base.GetLength());
+
+  // The delta goes through the log as an UPDATE_DELTA record.
+  Tuple new_tuple = make_tuple(0, 1000, "unchanged text");
+  LogRecord update(3, 7, RID(5, 9), TupleDelta(base, new_tuple));
+  // The header, the RID and one range of at most 4 bytes.
+  EXPECT_LE(update.GetSize(), 20 + sizeof(RID) + 6 * sizeof(uint16_t) + 8);
+  std::vector<char> buf(update.GetSize());
+  LogManager::SerializeLogRecord(&update, buf.data());
+
+  MemoryDiskManager disk_manager;
+  BufferPoolManagerInstance bpm(10, &disk_manager);
+  LogRecovery log_recovery(&disk_manager, &bpm);
+  LogRecord log_record;
+  ASSERT_TRUE(log_recovery.DeserializeLogRecord(buf.data(), buf.size(), &log_record));
+  EXPECT_EQ(log_record.GetLogRecordType(), LogRecordType::UPDATE_DELTA);
+  EXPECT_EQ(log_record.GetUpdateRID(), RID(5, 9));
+  Tuple image;
+  ASSERT_TRUE(log_record.GetUpdateDelta().Redo(base, &image));
+  EXPECT_TRUE(same(image, new_tuple));
+  EXPECT_FALSE(log_recovery.DeserializeLogRecord(buf.data(), buf.size() - 1, &log_record));
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, PrivateLogBufferTest) {
+  const int num_tuples = 20;
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+  MemoryDiskManager disk_manager;
+  LogManager log_manager(&disk_manager);
+  log_manager.SetPrivateBufferSize(PAGE_SIZE);
+  EXPECT_THROW(log_manager.SetPrivateBufferSize(LOG_BUFFER_SIZE + 1), Exception);
+  BufferPoolManagerInstance bpm(16, &disk_manager, &log_manager);
+  LockManager lock_manager;
+  TransactionManager txn_mgr(&lock_manager, &log_manager);
+  log_manager.RunFlushThread();
+
+  std::vector<Tuple> tuples;
+  std::vector<RID> rids(num_tuples);
+  Transaction *txn = txn_mgr.Begin();
+  auto *table = new TableHeap(&bpm, &lock_manager, &log_manager, txn);
+  page_id_t first_page_id = table->GetFirstPageId();
+  for (int i = 0; i < num_tuples; i++) {
+    tuples.push_back(ConstructTuple(&schema));
+    ASSERT_TRUE(table->InsertTuple(tuples[i], &rids[i], txn));
+  }
+  // Only the BEGIN record is in the log; the commit publishes NEWPAGE, the inserts and COMMIT at once.
+  EXPECT_EQ(log_manager.GetNextLSN(), 1);
+  txn_mgr.Commit(txn);
+  EXPECT_EQ(log_manager.GetNextLSN(), num_tuples + 3);
+  EXPECT_EQ(txn->GetPrevLSN(), num_tuples + 2);
+  EXPECT_EQ(txn->GetPrivateLog(), nullptr);
+  delete txn;
+
+  // Writing a page back publishes the changes to it first, so that the page LSN covers them.
+  Transaction *writer = txn_mgr.Begin();
+  tuples[0] = ConstructTuple(&schema);
+  ASSERT_TRUE(table->UpdateTuple(tuples[0], rids[0], writer));
+  lsn_t update_lsn = log_manager.GetNextLSN();
+  ASSERT_TRUE(bpm.FlushPage(first_page_id));
+  EXPECT_EQ(log_manager.GetNextLSN(), update_lsn + 1);
+  EXPECT_GE(log_manager.GetPersistentLSN(), update_lsn);
+  Page *page = bpm.FetchPage(first_page_id);
+  EXPECT_EQ(page->GetLSN(), update_lsn);
+  bpm.UnpinPage(first_page_id, false);
+
+  // Changing a page that has changes in another private buffer publishes those first, keeping the page order.
+  Transaction *other = txn_mgr.Begin();
+  tuples[1] = ConstructTuple(&schema);
+  ASSERT_TRUE(table->UpdateTuple(tuples[1], rids[1], writer));
+  lsn_t next_lsn = log_manager.GetNextLSN();
+  tuples[2] = ConstructTuple(&schema);
+  ASSERT_TRUE(table->UpdateTuple(tuples[2], rids[2], other));
+  EXPECT_EQ(log_manager.GetNextLSN(), next_lsn + 1);
+  txn_mgr.Commit(other);
+  txn_mgr.Commit(writer);
+  EXPECT_EQ(writer->GetPrevLSN(), next_lsn + 3);
+  delete other;
+  delete writer;
+  delete table;
+  log_manager.StopFlushThread();
+
+  // The log holds consecutive LSNs, and every record points at the previous record of its transaction.
+  std::vector<char> log(disk_manager.GetLogSize());
+  ASSERT_TRUE(disk_manager.ReadLog(log.data(), log.size(), 0));
+  std::unordered_map<txn_id_t, lsn_t> last_lsn;
+  lsn_t expected_lsn = 0;
+  for (size_t pos = 0; pos < log.size(); expected_lsn++) {
+    int32_t header[5];
+    memcpy(header, log.data() + pos, sizeof(header));
+    EXPECT_EQ(header[1], expected_lsn);
+    auto it = last_lsn.find(header[2]);
+    EXPECT_EQ(header[3], it == last_lsn.end() ? INVALID_LSN : it->second) << expected_lsn;
+    last_lsn[header[2]] = header[1];
+    pos += header[0];
+  }
+  EXPECT_EQ(expected_lsn, log_manager.GetNextLSN());
+
+  // Recovery replays the published records.
+  BufferPoolManagerInstance recovered(16, &disk_manager);
+  LogRecovery log_recovery(&disk_manager, &recovered);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  TableHeap recovered_table(&recovered, &lock_manager, &log_manager, first_page_id);
+  Transaction reader(INVALID_TXN_ID);
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    ASSERT_TRUE(recovered_table.GetTuple(rids[i], &tuple, &reader)) << i;
+    EXPECT_EQ(memcmp(tuple.GetData(), tuples[i].GetData(), tuple.GetLength()), 0) << i;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, DISABLED_AppendBenchmark) {
+  const int records_per_thread = 50000;
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  auto run = [&schema](size_t num_threads, const std::function<lsn_t(LogRecord *)> &append) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < num_threads; i++) {
+      threads.emplace_back([&schema, &append, i] {
+        Tuple tuple = ConstructTuple(&schema);
+        for (int j = 0; j < records_per_thread; j++) {
+          LogRecord log_record(i, INVALID_LSN, LogRecordType::INSERT, RID(i, j), tuple);
+          append(&log_record);
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return num_threads * records_per_thread / elapsed.count();
+  };
+
+  for (size_t num_threads : {1, 4, 16, 64}) {
+    MemoryDiskManager mutex_disk;
+    MutexLogAppender mutex_appender(&mutex_disk);
+    double mutex_rate = run(num_threads, [&](LogRecord *r) { return mutex_appender.AppendLogRecord(r); });
+
+    MemoryDiskManager disk_manager;
+    LogManager log_manager(&disk_manager);
+    log_manager.RunFlushThread();
+    double cas_rate = run(num_threads, [&](LogRecord *r) { return log_manager.AppendLogRecord(r); });
+    log_manager.StopFlushThread();
+    LOG_INFO("%zu threads: mutex append %.2fM records/s, reserved append %.2fM records/s", num_threads,
+             mutex_rate / 1e6, cas_rate / 1e6);
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, DISABLED_BufferSizeBenchmark) {
+  const size_t num_threads = 16;
+  const int records_per_thread = 20000;
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::SMALLINT};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  for (size_t buffer_size : {16 << 10, 64 << 10, 256 << 10, 1 << 20}) {
+    for (size_t num_buffers : {2, 4}) {
+      MemoryDiskManager memory;
+      // Every log write costs 500us plus its transfer at 200MB/s.
+      LatencyDiskManager disk_manager(&memory, {std::chrono::microseconds(0), std::chrono::microseconds(0),
+                                                std::chrono::microseconds(500), 200 << 20});
+      LogManager log_manager(&disk_manager, buffer_size, num_buffers);
+      log_manager.RunFlushThread();
+
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back([&log_manager, &schema, i] {
+          Tuple tuple = ConstructTuple(&schema);
+          for (int j = 0; j < records_per_thread; j++) {
+            LogRecord log_record(i, INVALID_LSN, LogRecordType::INSERT, RID(i, j), tuple);
+            log_manager.AppendLogRecord(&log_record);
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      log_manager.StopFlushThread();
+
+      double appends = num_threads * records_per_thread;
+      LOG_INFO("%4zuKB x %zu: %.2fM records/s, %.0f flushes/s, %lu stalls (%.2f%% of appends), %.2fus stalled/append",
+               buffer_size >> 10, num_buffers, appends / elapsed.count() / 1e6,
+               log_manager.GetNumFlushes() / elapsed.count(), log_manager.GetNumAppendStalls(),
+               100.0 * log_manager.GetNumAppendStalls() / appends,
+               log_manager.GetAppendStallTime().count() / 1e3 / appends);
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, DISABLED_GroupCommitBenchmark) {
+  const size_t txns_per_thread = 200;
+  for (size_t num_threads : {1, 4, 16, 64}) {
+    remove("test.log");
+    DiskManager disk_manager("test.db");
+    LogManager log_manager(&disk_manager);
+    LockManager lock_manager;
+    TransactionManager txn_mgr(&lock_manager, &log_manager);
+    log_manager.RunFlushThread();
+
+    auto start = std::chrono::steady_clock::now();
+    CommitConcurrently(&txn_mgr, num_threads, txns_per_thread);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    log_manager.StopFlushThread();
+
+    const auto &latency = log_manager.GetCommitLatency();
+    LOG_INFO("%zu threads: %.0f commits/s, %lu fdatasyncs, %.1f commits/fdatasync, latency avg %.0fus p50 <%luus "
+             "p99 <%luus",
+             num_threads, num_threads * txns_per_thread / elapsed.count(), log_manager.GetNumFlushes(),
+             log_manager.GetCommitsPerFlush(), latency.GetMean(), latency.GetPercentile(50),
+             latency.GetPercentile(99));
+    disk_manager.ShutDown();
+  }
+}
+
+/*
+ * Commits single-update transactions against a file-backed log, synchronously and asynchronously with a 10ms
+ * delay. Commit latency is measured by the caller; the loss window is the time from appending a COMMIT record until
+ * it was durable.
+ */
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, DISABLED_AsyncCommitBenchmark) {
+  const size_t txns_per_thread = 500;
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  for (Durability durability : {Durability::SYNC, Durability::ASYNC}) {
+    for (size_t num_threads : {1, 4, 16}) {
+      remove("test.db");
+      remove("test.log");
+      DiskManager disk_manager("test.db");
+      LogManager log_manager(&disk_manager);
+      BufferPoolManagerInstance bpm(64, &disk_manager, &log_manager);
+      LockManager lock_manager;
+      TransactionManager txn_mgr(&lock_manager, &log_manager);
+      log_manager.RunFlushThread();
+      Transaction *txn = txn_mgr.Begin();
+      TableHeap table(&bpm, &lock_manager, &log_manager, txn);
+      txn_mgr.Commit(txn);
+      delete txn;
+
+      LatencyHistogram commit_latency;
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (size_t i = 0; i < num_threads; i++) {
+        threads.emplace_back([&] {
+          RID rid;
+          for (size_t j = 0; j < txns_per_thread; j++) {
+            Transaction *txn = txn_mgr.Begin();
+            table.InsertTuple(ConstructTuple(&schema), &rid, txn);
+            auto commit_start = std::chrono::steady_clock::now();
+            txn_mgr.Commit(txn, durability, std::chrono::milliseconds(10));
+            commit_latency.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      std::chrono::steady_clock::now() - commit_start)
+                                      .count());
+            delete txn;
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      log_manager.StopFlushThread();
+
+      const auto &window = log_manager.GetCommitLatency();
+      LOG_INFO("%s, %zu threads: %.0f commits/s, commit avg %.0fus p99 <%luus, durable after avg %.0fus max <%luus",
+               durability == Durability::SYNC ? "sync" : "async", num_threads,
+               num_threads * txns_per_thread / elapsed.count(), commit_latency.GetMean(),
+               commit_latency.GetPercentile(99), window.GetMean(), window.GetPercentile(100));
+      disk_manager.ShutDown();
+    }
+  }
+}
+
+/*
+ * Runs transactions of 16 updates from concurrent threads, each on its own tuples, with every record appended to the
+ * log buffer and with private log buffers. Commits are asynchronous and the log is in memory, so that the appends
+ * are what the threads contend on.
+ */
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, DISABLED_PrivateLogBufferBenchmark) {
+  const int txns_per_thread = 5000;
+  const int updates_per_txn = 16;
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  for (size_t private_size : {static_cast<size_t>(0), static_cast<size_t>(PAGE_SIZE)}) {
+    for (int num_threads : {1, 4, 16}) {
+      MemoryDiskManager disk_manager;
+      LogManager log_manager(&disk_manager);
+      log_manager.SetPrivateBufferSize(private_size);
+      BufferPoolManagerInstance bpm(256, &disk_manager, &log_manager);
+      LockManager lock_manager;
+      TransactionManager txn_mgr(&lock_manager, &log_manager);
+      log_manager.RunFlushThread();
+      Transaction *txn = txn_mgr.Begin();
+      TableHeap table(&bpm, &lock_manager, &log_manager, txn);
+      std::vector<RID> rids(num_threads * updates_per_txn);
+      for (auto &rid : rids) {
+        ASSERT_TRUE(table.InsertTuple(ConstructTuple(&schema), &rid, txn));
+      }
+      txn_mgr.Commit(txn);
+      delete txn;
+
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int t = 0; t < num_threads; t++) {
+        threads.emplace_back([&, t] {
+          Tuple tuple = ConstructTuple(&schema);
+          for (int i = 0; i < txns_per_thread; i++) {
+            Transaction *txn = txn_mgr.Begin();
+            for (int j = 0; j < updates_per_txn; j++) {
+              table.UpdateTuple(tuple, rids[t * updates_per_txn + j], txn);
+            }
+            txn_mgr.Commit(txn, Durability::ASYNC);
+            delete txn;
+          }
+        });
+      }
+      for (auto &thread : threads) {
+        thread.join();
+      }
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+      log_manager.StopFlushThread();
+      LOG_INFO("private buffers of %zu bytes, %d threads: %.0f txns/s, %lu append stalls", private_size, num_threads,
+               num_threads * txns_per_thread / elapsed.count(), log_manager.GetNumAppendStalls());
+    }
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(LogManagerTest, DISABLED_UpdateLogVolumeBenchmark) {
+  const int num_tuples = 1000;
+  const int num_txns = 2000;
+  const int updates_per_txn = 10;
+  // 500-byte rows, of which every update changes a single column.
+  std::vector<Column> cols;
+  for (int i = 0; i < 125; i++) {
+    cols.emplace_back("c" + std::to_string(i), TypeId::INTEGER);
+  }
+  Schema schema{cols};
+  auto make_tuple = [&schema](int column, int32_t value) {
+    std::vector<Value> values;
+    for (int i = 0; i < 125; i++) {
+      values.push_back(ValueFactory::GetIntegerValue(i == column ? value : i));
+    }
+    return Tuple(values, &schema);
+  };
+
+  for (bool deltas : {false, true}) {
+    MemoryDiskManager disk_manager;
+    LogManager log_manager(&disk_manager);
+    log_manager.SetUpdateDeltas(deltas);
+    BufferPoolManagerInstance bpm(256, &disk_manager, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_mgr(&lock_manager, &log_manager);
+    log_manager.RunFlushThread();
+
+    Transaction *txn = txn_mgr.Begin();
+    TableHeap table(&bpm, &lock_manager, &log_manager, txn);
+    std::vector<RID> rids(num_tuples);
+    for (auto &rid : rids) {
+      ASSERT_TRUE(table.InsertTuple(make_tuple(0, 0), &rid, txn));
+    }
+    txn_mgr.Commit(txn);
+    delete txn;
+
+    std::mt19937 generator(15445);
+    uint64_t bytes_before = disk_manager.GetStats().GetBytes(DiskOp::LOG_WRITE);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_txns; i++) {
+      txn = txn_mgr.Begin();
+      for (int j = 0; j < updates_per_txn; j++) {
+        ASSERT_TRUE(table.UpdateTuple(make_tuple(generator() % 125, generator()), rids[generator() % num_tuples], txn));
+      }
+      txn_mgr.Commit(txn);
+      delete txn;
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    log_manager.StopFlushThread();
+
+    double bytes = disk_manager.GetStats().GetBytes(DiskOp::LOG_WRITE) - bytes_before;
+    LOG_INFO("%s: %.1f MB of log, %.0f bytes per update, %.0f txn/s", deltas ? "delta records" : "full images",
+             bytes / 1e6, bytes / (num_txns * updates_per_txn), num_txns / elapsed.count());
+  }
+}
+
+}  // namespace bustub
@@ -0,0 +1,381 @@
+//===----------------------------------------------------------------------===//
+//
+//                         BusTub
+//
+// log_shipper_test.cpp
+//
+// Identification: test/recovery/log_shipper_test.cpp
+//
+// Copyright (c) 2015-2019, Carnegie Mellon University Database Group
+//
+//===----------------------------------------------------------------------===//
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "buffer/buffer_pool_manager_instance.h"
+#include "catalog/schema.h"
+#include "common/logger.h"
+#include "concurrency/lock_manager.h"
+#include "concurrency/transaction_manager.h"
+#include "gtest/gtest.h"
+#include "recovery/log_manager.h"
+#include "recovery/log_shipper.h"
+#include "recovery/log_standby.h"
+#include "storage/disk/memory_disk_manager.h"
+#include "storage/table/table_heap.h"
+#include "type/value_factory.h"
+
+namespace bustub {
+
+/**
+ * The primary and the standby run in two processes, since logging is a process-wide switch: the test forks a primary,
+ * which streams its log over a socket pair, and keeps the standby. A pair of pipes lets the two take turns.
+ */
+class LogShipperTest : public ::testing::Test {
+ protected:
+  /** What the primary tells the standby after each step. */
+  struct Step {
+    /** The log is durable up to this LSN. */
+    lsn_t lsn_;
+    page_id_t first_page_id_;
+    /** Committed transactions per second, for the benchmark. */
+    double commits_per_second_;
+  };
+
+  void SetUp() override {
+    ASSERT_EQ(socketpair(AF_UNIX, SOCK_STREAM, 0, log_fds_), 0);
+    ASSERT_EQ(pipe(to_standby_), 0);
+    ASSERT_EQ(pipe(to_primary_), 0);
+  }
+
+  /**
+   * Fork the primary.
+   * @param primary the body of the primary, returning its exit status
+   * @return the pid of the primary
+   */
+  pid_t ForkPrimary(const std::function<int()> &primary) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(log_fds_[1]);
+      close(to_standby_[0]);
+      close(to_primary_[1]);
+      _exit(primary());
+    }
+    close(log_fds_[0]);
+    close(to_standby_[1]);
+    close(to_primary_[0]);
+    return pid;
+  }
+
+  /** In the primary: report a step, then wait for the standby to check it. */
+  bool SendStep(const Step &step) {
+    char go;
+    return write(to_standby_[1], &step, sizeof(Step)) == sizeof(Step) && read(to_primary_[0], &go, 1) == 1;
+  }
+
+  /** In the standby: receive the next step of the primary. */
+  bool ReceiveStep(Step *step) { return read(to_standby_[0], step, sizeof(Step)) == sizeof(Step); }
+
+  /** In the standby: let the primary go on. */
+  void Continue() { ASSERT_EQ(write(to_primary_[1], "g", 1), 1); }
+
+  /** @return the exit status of the primary */
+  int WaitPrimary(pid_t pid) {
+    close(to_primary_[1]);
+    close(to_standby_[0]);
+    int status = -1;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+  }
+
+  Tuple MakeTuple(int32_t key, int32_t value) {
+    return Tuple{std::vector<Value>{ValueFactory::GetIntegerValue(key), ValueFactory::GetIntegerValue(value)},
+                 &schema_};
+  }
+
+  /** @return the tuples of a table on the standby, by key */
+  std::map<int32_t, int32_t> ScanStandby(LogStandby *standby, page_id_t first_page_id) {
+    std::map<int32_t, int32_t> tuples;
+    standby->ScanTable(first_page_id, [this, &tuples](const RID &rid, const Tuple &tuple) {
+      tuples[tuple.GetValue(&schema_, 0).GetAs<int32_t>()] = tuple.GetValue(&schema_, 1).GetAs<int32_t>();
+    });
+    return tuples;
+  }
+
+  Column key_{"key", TypeId::INTEGER};
+  Column value_{"value", TypeId::INTEGER};
+  Schema schema_{std::vector<Column>{key_, value_}};
+  int log_fds_[2];
+  int to_standby_[2];
+  int to_primary_[2];
+};
+
+// NOLINTNEXTLINE
+TEST_F(LogShipperTest, StandbyTest) {
+  pid_t pid = ForkPrimary([this] {
+    MemoryDiskManager disk_manager;
+    LogManager log_manager(&disk_manager);
+    LogShipper shipper(log_fds_[0]);
+    log_manager.SetLogShipper(&shipper);
+    BufferPoolManagerInstance bpm(32, &disk_manager, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_mgr(&lock_manager, &log_manager);
+    log_manager.RunFlushThread();
+
+    Transaction *loader = txn_mgr.Begin();
+    TableHeap table(&bpm, &lock_manager, &log_manager, loader);
+    std::vector<RID> rids(12);
+    for (int key = 0; key < 10; key++) {
+      if (!table.InsertTuple(MakeTuple(key, key), &rids[key], loader)) {
+        return 1;
+      }
+    }
+    txn_mgr.Commit(loader);
+    if (!SendStep(Step{loader->GetPrevLSN(), table.GetFirstPageId(), 0})) {
+      return 2;
+    }
+
+    // Durable but uncommitted changes reach the standby, which must not show them.
+    Transaction *writer = txn_mgr.Begin();
+    Transaction *loser = txn_mgr.Begin();
+    if (!table.UpdateTuple(MakeTuple(0, 100), rids[0], writer) || !table.MarkDelete(rids[1], writer) ||
+        !table.InsertTuple(MakeTuple(10, 10), &rids[10], writer) ||
+        !table.InsertTuple(MakeTuple(11, 11), &rids[11], loser)) {
+      return 3;
+    }
+    lsn_t lsn = std::max(writer->GetPrevLSN(), loser->GetPrevLSN());
+    log_manager.Flush(lsn);
+    if (!SendStep(Step{lsn, table.GetFirstPageId(), 0})) {
+      return 4;
+    }
+
+    txn_mgr.Commit(writer);
+    txn_mgr.Abort(loser);
+    lsn = std::max(writer->GetPrevLSN(), loser->GetPrevLSN());
+    log_manager.Flush(lsn);
+    if (!SendStep(Step{lsn, table.GetFirstPageId(), 0})) {
+      return 5;
+    }
+    delete loader;
+    delete writer;
+    delete loser;
+    log_manager.StopFlushThread();
+    log_manager.SetLogShipper(nullptr);
+    return 0;
+  });
+
+  MemoryDiskManager disk_manager;
+  BufferPoolManagerInstance bpm(32, &disk_manager);
+  LogStandby standby(log_fds_[1], &disk_manager, &bpm);
+  standby.Start();
+
+  Step step;
+  ASSERT_TRUE(ReceiveStep(&step));
+  ASSERT_TRUE(standby.WaitForLSN(step.lsn_, std::chrono::seconds(10)));
+  std::map<int32_t, int32_t> expected;
+  for (int key = 0; key < 10; key++) {
+    expected[key] = key;
+  }
+  EXPECT_EQ(ScanStandby(&standby, step.first_page_id_), expected);
+  Continue();
+
+  ASSERT_TRUE(ReceiveStep(&step));
+  ASSERT_TRUE(standby.WaitForLSN(step.lsn_, std::chrono::seconds(10)));
+  EXPECT_EQ(ScanStandby(&standby, step.first_page_id_), expected);
+  Tuple tuple;
+  lsn_t read_lsn;
+  ASSERT_TRUE(standby.GetTuple(RID(step.first_page_id_, 0), &tuple, &read_lsn));
+  EXPECT_EQ(tuple.GetValue(&schema_, 1).GetAs<int32_t>(), 0);
+  EXPECT_GE(read_lsn, step.lsn_);
+  EXPECT_TRUE(standby.GetTuple(RID(step.first_page_id_, 1), &tuple));
+  EXPECT_FALSE(standby.GetTuple(RID(step.first_page_id_, 10), &tuple));
+  Continue();
+
+  // The committed changes show up at once, and the aborted insert never does.
+  ASSERT_TRUE(ReceiveStep(&step));
+  ASSERT_TRUE(standby.WaitForLSN(step.lsn_, std::chrono::seconds(10)));
+  expected[0] = 100;
+  expected.erase(1);
+  expected[10] = 10;
+  EXPECT_EQ(ScanStandby(&standby, step.first_page_id_), expected);
+  EXPECT_FALSE(standby.GetTuple(RID(step.first_page_id_, 1), &tuple));
+  EXPECT_FALSE(standby.GetTuple(RID(step.first_page_id_, 11), &tuple));
+  Continue();
+
+  EXPECT_EQ(WaitPrimary(pid), 0);
+  // The primary went away, and the standby kept a copy of everything it applied.
+  EXPECT_FALSE(standby.WaitForLSN(step.lsn_ + 1, std::chrono::seconds(10)));
+  EXPECT_FALSE(standby.IsConnected());
+  EXPECT_EQ(disk_manager.GetLogSize(), static_cast<int64_t>(standby.GetAppliedBytes()));
+  EXPECT_EQ(standby.GetAppliedLSN(), step.lsn_);
+}
+
+/*
+ * A standby reading from a pipe, which can't be shut down like a socket, still stops while it waits for a primary
+ * that never sends anything.
+ */
+// NOLINTNEXTLINE
+TEST_F(LogShipperTest, StopOnPipeTest) {
+  int log_pipe[2];
+  ASSERT_EQ(pipe(log_pipe), 0);
+  MemoryDiskManager disk_manager;
+  BufferPoolManagerInstance bpm(32, &disk_manager);
+  LogStandby standby(log_pipe[0], &disk_manager, &bpm);
+  standby.Start();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  EXPECT_TRUE(standby.IsConnected());
+  standby.Stop();
+  EXPECT_FALSE(standby.IsConnected());
+  close(log_pipe[1]);
+}
+
+/*
+ * A shipper writing to a pipe that the standby stopped reading is still disconnected when it falls too far behind, and
+ * is still destroyed when it can't send the rest of its queue.
+ */
+// NOLINTNEXTLINE
+TEST_F(LogShipperTest, ShipperStopOnPipeTest) {
+  // More than the pipe holds, so that the sender blocks on it.
+  std::vector<char> chunk(256 * 1024);
+  int log_pipe[2];
+  ASSERT_EQ(pipe(log_pipe), 0);
+  {
+    LogShipper shipper(log_pipe[1], 2 * chunk.size());
+    for (int i = 0; i < 4; i++) {
+      shipper.Ship(chunk.data(), chunk.size(), i * chunk.size(), i);
+    }
+    EXPECT_FALSE(shipper.IsConnected());
+  }
+  close(log_pipe[0]);
+
+  // The destructor gives up on the rest of the queue after STOP_TIMEOUT.
+  ASSERT_EQ(pipe(log_pipe), 0);
+  {
+    LogShipper shipper(log_pipe[1]);
+    shipper.Ship(chunk.data(), chunk.size(), 0, 0);
+  }
+  close(log_pipe[0]);
+}
+
+/*
+ * Measures how far a standby on the same machine lags behind a primary under an update-heavy load, while a reader
+ * scans the standby, and what shipping costs the primary.
+ */
+// NOLINTNEXTLINE
+TEST_F(LogShipperTest, DISABLED_LogShippingBenchmark) {
+  const int num_writers = 4;
+  const int tuples_per_writer = 64;
+  const int updates_per_txn = 4;
+  const auto duration = std::chrono::seconds(3);
+
+  // Runs the load on the primary, with or without a standby, and reports its throughput as the last step. With a
+  // standby, the loaded table is reported first.
+  auto run_primary = [&](bool ship) {
+    MemoryDiskManager disk_manager;
+    LogManager log_manager(&disk_manager);
+    std::unique_ptr<LogShipper> shipper;
+    if (ship) {
+      shipper = std::make_unique<LogShipper>(log_fds_[0]);
+      log_manager.SetLogShipper(shipper.get());
+    }
+    BufferPoolManagerInstance bpm(256, &disk_manager, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_mgr(&lock_manager, &log_manager);
+    log_manager.RunFlushThread();
+
+    Transaction *loader = txn_mgr.Begin();
+    TableHeap table(&bpm, &lock_manager, &log_manager, loader);
+    std::vector<RID> rids(num_writers * tuples_per_writer);
+    for (size_t key = 0; key < rids.size(); key++) {
+      table.InsertTuple(MakeTuple(key, 0), &rids[key], loader);
+    }
+    txn_mgr.Commit(loader);
+    if (ship && !SendStep(Step{loader->GetPrevLSN(), table.GetFirstPageId(), 0})) {
+      _exit(1);
+    }
+    delete loader;
+
+    std::atomic<uint64_t> commits{0};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> writers;
+    for (int w = 0; w < num_writers; w++) {
+      writers.emplace_back([&, w] {
+        for (int32_t round = 1; std::chrono::steady_clock::now() - start < duration; round++) {
+          Transaction *txn = txn_mgr.Begin();
+          for (int i = 0; i < updates_per_txn; i++) {
+            int32_t key = w * tuples_per_writer + (round * updates_per_txn + i) % tuples_per_writer;
+            table.UpdateTuple(MakeTuple(key, round), rids[key], txn);
+          }
+          txn_mgr.Commit(txn);
+          delete txn;
+          commits++;
+        }
+      });
+    }
+    for (auto &writer : writers) {
+      writer.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    log_manager.StopFlushThread();
+    log_manager.SetLogShipper(nullptr);
+    shipper.reset();
+    return Step{log_manager.GetPersistentLSN(), table.GetFirstPageId(), commits / elapsed.count()};
+  };
+
+  pid_t pid = ForkPrimary([&] {
+    if (!SendStep(run_primary(false))) {
+      return 1;
+    }
+    return SendStep(run_primary(true)) ? 0 : 2;
+  });
+
+  MemoryDiskManager disk_manager;
+  BufferPoolManagerInstance bpm(256, &disk_manager);
+  LogStandby standby(log_fds_[1], &disk_manager, &bpm);
+  standby.Start();
+  Step baseline;
+  Step loaded;
+  Step shipped;
+  ASSERT_TRUE(ReceiveStep(&baseline));
+  Continue();
+  ASSERT_TRUE(ReceiveStep(&loaded));
+  ASSERT_TRUE(standby.WaitForLSN(loaded.lsn_, std::chrono::seconds(10)));
+  std::atomic<bool> stop{false};
+  std::atomic<uint64_t> scans{0};
+  std::thread reader([&] {
+    while (!stop) {
+      standby.ScanTable(loaded.first_page_id_, [](const RID &rid, const Tuple &tuple) {});
+      scans++;
+    }
+  });
+  Continue();
+  auto start = std::chrono::steady_clock::now();
+  ASSERT_TRUE(ReceiveStep(&shipped));
+  ASSERT_TRUE(standby.WaitForLSN(shipped.lsn_, std::chrono::seconds(10)));
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  stop = true;
+  reader.join();
+  Continue();
+  EXPECT_EQ(WaitPrimary(pid), 0);
+
+  const auto &lag = standby.GetApplyLag();
+  LOG_INFO("primary: %.0f commits/s alone, %.0f commits/s shipping", baseline.commits_per_second_,
+           shipped.commits_per_second_);
+  LOG_INFO("standby: %.1f MB/s, %.0f records/s applied, %.0f scans/s",
+           standby.GetAppliedBytes() / elapsed.count() / 1e6, standby.GetAppliedRecords() / elapsed.count(),
+           scans / elapsed.count());
+  LOG_INFO("apply lag: mean %.0fus, p50 %luus, p99 %luus, max %luus", lag.GetMean(), lag.GetPercentile(50),
+           lag.GetPercentile(99), lag.GetPercentile(100));
+}
+
+}  // namespace bustub
@@ -10,7 +10,17 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <random>
 #include <string>
+#include <thread>  // NOLINT
 #include <vector>
 
 #include "common/bustub_instance.h"
@@ -19,10 +29,14 @@
 #include "concurrency/transaction_manager.h"
 #include "gtest/gtest.h"
 #include "logging/common.h"
+#include "recovery/checkpoint_manager.h"
 #include "recovery/log_recovery.h"
+#include "storage/disk/latency_disk_manager.h"
+#include "storage/disk/memory_disk_manager.h"
 #include "storage/table/table_heap.h"
 #include "storage/table/table_iterator.h"
 #include "storage/table/tuple.h"
+#include "type/value_factory.h"
 
 namespace bustub {
 
@@ -32,6 +46,8 @@ class RecoveryTest : public ::testing::Test {
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    remove("test.master");
+    RemoveLogSegments();
   }
 
   // This function is called after every test.
@@ -39,11 +55,39 @@ class RecoveryTest : public ::testing::Test {
     LOG_INFO("Tearing down the system..");
     remove("test.db");
     remove("test.log");
+    remove("test.master");
+    RemoveLogSegments();
+    log_segment_size = 0;
   };
+
+  /** Remove the segments and spare segments of test.log. */
+  static void RemoveLogSegments() {
+    for (const auto &entry : std::filesystem::directory_iterator(".")) {
+      if (entry.path().filename().string().rfind("test.log.", 0) == 0) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+  }
+
+  /** @return the disk space allocated to test.log and its segments, including preallocated space */
+  static int64_t LogDiskUsage() {
+    int64_t usage = 0;
+    for (const auto &entry : std::filesystem::directory_iterator(".")) {
+      struct stat stat_buf;
+      if (entry.path().filename().string().rfind("test.log", 0) == 0 && stat(entry.path().c_str(), &stat_buf) == 0) {
+        usage += static_cast<int64_t>(stat_buf.st_blocks) * 512;
+      }
+    }
+    return usage;
+  }
+
+  static bool SameTuple(const Tuple &a, const Tuple &b) {
+    return a.GetLength() == b.GetLength() && memcmp(a.GetData(), b.GetData(), a.GetLength()) == 0;
+  }
 };
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_RedoTest) {
+TEST_F(RecoveryTest, RedoTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -132,7 +176,7 @@ TEST_F(RecoveryTest, DISABLED_RedoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_UndoTest) {
+TEST_F(RecoveryTest, UndoTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   ASSERT_FALSE(enable_logging);
@@ -211,7 +255,7 @@ TEST_F(RecoveryTest, DISABLED_UndoTest) {
 }
 
 // NOLINTNEXTLINE
-TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
+TEST_F(RecoveryTest, CheckpointTest) {
   BustubInstance *bustub_instance = new BustubInstance("test.db");
 
   EXPECT_FALSE(enable_logging);
@@ -314,4 +358,765 @@ TEST_F(RecoveryTest, DISABLED_CheckpointTest) {
   LOG_INFO("Shutdown System");
   delete bustub_instance;
 }
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, ParallelRecoveryTest) {
+  const int num_tuples = 1000;
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = bustub_instance->transaction_manager_;
+
+  // Fixed-size tuples, so that updates always fit into their page.
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  // The table spans more pages than the buffer pool holds, so part of it is on disk at the crash.
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(num_tuples);
+  std::vector<Tuple> tuples;
+  for (int i = 0; i < num_tuples; i++) {
+    tuples.push_back(ConstructTuple(&schema));
+    ASSERT_TRUE(test_table->InsertTuple(tuples[i], &rids[i], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // A committed transaction updates a quarter of the tuples and deletes another quarter.
+  txn = txn_manager->Begin();
+  for (int i = 0; i < num_tuples; i++) {
+    if (i % 4 == 1) {
+      tuples[i] = ConstructTuple(&schema);
+      ASSERT_TRUE(test_table->UpdateTuple(tuples[i], rids[i], txn));
+    } else if (i % 4 == 2) {
+      ASSERT_TRUE(test_table->MarkDelete(rids[i], txn));
+    }
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // Two losers: one inserts, the other updates and deletes the tuples left alone so far.
+  Transaction *loser_insert = txn_manager->Begin();
+  std::vector<RID> loser_rids(100);
+  for (auto &rid : loser_rids) {
+    ASSERT_TRUE(test_table->InsertTuple(ConstructTuple(&schema), &rid, loser_insert));
+  }
+  Transaction *loser_update = txn_manager->Begin();
+  for (int i = 0; i < num_tuples; i++) {
+    if (i % 4 == 3) {
+      ASSERT_TRUE(test_table->UpdateTuple(ConstructTuple(&schema), rids[i], loser_update));
+    } else if (i % 4 == 0) {
+      ASSERT_TRUE(test_table->MarkDelete(rids[i], loser_update));
+    }
+  }
+  delete test_table;
+
+  LOG_INFO("System crash with two transactions in flight");
+  delete bustub_instance;
+  delete loser_insert;
+  delete loser_update;
+
+  bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_, 4);
+  EXPECT_EQ(4, log_recovery.GetNumWorkers());
+  log_recovery.Redo();
+  log_recovery.Undo();
+
+  txn_manager = bustub_instance->transaction_manager_;
+  txn = txn_manager->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    if (i % 4 == 2) {
+      EXPECT_FALSE(test_table->GetTuple(rids[i], &tuple, txn));
+    } else {
+      ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn)) << i;
+      EXPECT_TRUE(SameTuple(tuples[i], tuple)) << i;
+    }
+  }
+  for (const auto &rid : loser_rids) {
+    Tuple tuple;
+    EXPECT_FALSE(test_table->GetTuple(rid, &tuple, txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, FuzzyCheckpointTest) {
+  const int num_tuples = 200;
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  TransactionManager *txn_manager = bustub_instance->transaction_manager_;
+
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(num_tuples);
+  std::vector<Tuple> tuples;
+  for (int i = 0; i < num_tuples; i++) {
+    tuples.push_back(ConstructTuple(&schema));
+    ASSERT_TRUE(test_table->InsertTuple(tuples[i], &rids[i], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  bustub_instance->buffer_pool_manager_->FlushAllPages();
+
+  // The loser is running while the checkpoint is taken, which a blocking checkpoint would wait for.
+  Transaction *loser = txn_manager->Begin();
+  for (int i = 0; i < num_tuples; i += 4) {
+    ASSERT_TRUE(test_table->UpdateTuple(ConstructTuple(&schema), rids[i], loser));
+  }
+  lsn_t checkpoint_lsn = bustub_instance->checkpoint_manager_->FuzzyCheckpoint();
+  EXPECT_LE(checkpoint_lsn, bustub_instance->log_manager_->GetPersistentLSN());
+
+  txn = txn_manager->Begin();
+  for (int i = 1; i < num_tuples; i += 4) {
+    tuples[i] = ConstructTuple(&schema);
+    ASSERT_TRUE(test_table->UpdateTuple(tuples[i], rids[i], txn));
+  }
+  for (int i = 2; i < num_tuples; i += 4) {
+    ASSERT_TRUE(test_table->MarkDelete(rids[i], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  for (int i = 3; i < num_tuples; i += 4) {
+    ASSERT_TRUE(test_table->MarkDelete(rids[i], loser));
+  }
+  delete test_table;
+
+  LOG_INFO("System crash after a fuzzy checkpoint");
+  delete bustub_instance;
+  delete loser;
+
+  bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_, 2);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  // The inserts before the checkpoint were written back, so recovery does not read them.
+  EXPECT_GT(log_recovery.GetScanStartOffset(), 0);
+
+  txn_manager = bustub_instance->transaction_manager_;
+  txn = txn_manager->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    if (i % 4 == 2) {
+      EXPECT_FALSE(test_table->GetTuple(rids[i], &tuple, txn));
+    } else {
+      ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn)) << i;
+      EXPECT_TRUE(SameTuple(tuples[i], tuple)) << i;
+    }
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, LargeCheckpointTest) {
+  const int num_tuples = 4000;
+  const size_t log_buffer_size = 1024;
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::VARCHAR, 400};
+  Schema schema{std::vector<Column>{col1, col2}};
+  auto make_tuple = [&schema](int i) {
+    return Tuple({ValueFactory::GetBigIntValue(i), ValueFactory::GetVarcharValue(std::string(400, 'a' + i % 26))},
+                 &schema);
+  };
+
+  std::vector<RID> rids(num_tuples);
+  page_id_t first_page_id;
+  {
+    DiskManager disk_manager("test.db");
+    LogManager log_manager(&disk_manager, log_buffer_size);
+    BufferPoolManagerInstance bpm(1024, &disk_manager, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_manager(&lock_manager, &log_manager);
+    CheckpointManager checkpoint_manager(&txn_manager, &log_manager, &bpm);
+    log_manager.RunFlushThread();
+
+    Transaction *txn = txn_manager.Begin();
+    TableHeap table(&bpm, &lock_manager, &log_manager, txn);
+    first_page_id = table.GetFirstPageId();
+    for (int i = 0; i < num_tuples; i++) {
+      ASSERT_TRUE(table.InsertTuple(make_tuple(i), &rids[i], txn));
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+
+    // None of the pages is written back, so the dirty page table needs several records of the small log buffer.
+    size_t num_dirty_pages = bpm.GetDirtyPageTable().size();
+    EXPECT_GT(LogRecord::CheckpointEndSize(0, num_dirty_pages), 2 * log_buffer_size);
+    checkpoint_manager.FuzzyCheckpoint();
+    log_manager.StopFlushThread();
+    LOG_INFO("System crash after a checkpoint of %zu dirty pages", num_dirty_pages);
+  }
+
+  auto *bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_, 2);
+  log_recovery.Redo();
+  log_recovery.Undo();
+
+  // Redo only replays the changes before the checkpoint to the pages in its dirty page table, so every part counts.
+  TransactionManager *txn_manager = bustub_instance->transaction_manager_;
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, first_page_id);
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn)) << i;
+    EXPECT_TRUE(SameTuple(make_tuple(i), tuple)) << i;
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, LargeLogRecordTest) {
+  const int num_tuples = 200;
+  const int num_running_txns = 12000;
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  std::vector<RID> rids(num_tuples);
+  std::vector<Tuple> tuples;
+  page_id_t first_page_id;
+  {
+    DiskManager disk_manager("test.db");
+    LogManager log_manager(&disk_manager, 4 * LOG_BUFFER_SIZE);
+    BufferPoolManagerInstance bpm(BUFFER_POOL_SIZE, &disk_manager, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_manager(&lock_manager, &log_manager);
+    CheckpointManager checkpoint_manager(&txn_manager, &log_manager, &bpm);
+    log_manager.RunFlushThread();
+
+    Transaction *txn = txn_manager.Begin();
+    TableHeap table(&bpm, &lock_manager, &log_manager, txn);
+    first_page_id = table.GetFirstPageId();
+    for (int i = 0; i < num_tuples; i++) {
+      tuples.push_back(ConstructTuple(&schema));
+      ASSERT_TRUE(table.InsertTuple(tuples[i], &rids[i], txn));
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+    bpm.FlushAllPages();
+
+    // The active transaction table of the checkpoint makes its CHECKPOINT_END record larger than LOG_BUFFER_SIZE.
+    std::vector<std::unique_ptr<Transaction>> running;
+    for (int i = 0; i < num_running_txns; i++) {
+      running.emplace_back(txn_manager.Begin());
+    }
+    ASSERT_GT(LogRecord::CheckpointEndSize(num_running_txns, 0), static_cast<size_t>(LOG_BUFFER_SIZE));
+    checkpoint_manager.FuzzyCheckpoint();
+
+    // Redo has to read past the large record to find these.
+    txn = txn_manager.Begin();
+    for (int i = 0; i < num_tuples; i++) {
+      tuples[i] = ConstructTuple(&schema);
+      ASSERT_TRUE(table.UpdateTuple(tuples[i], rids[i], txn));
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+    log_manager.StopFlushThread();
+    LOG_INFO("System crash after a checkpoint of %d running transactions", num_running_txns);
+  }
+
+  auto *bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_, 2);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  // Redo started from the checkpoint, which it could only find by reading the large record.
+  EXPECT_GT(log_recovery.GetScanStartOffset(), 0);
+
+  TransactionManager *txn_manager = bustub_instance->transaction_manager_;
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, first_page_id);
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn)) << i;
+    EXPECT_TRUE(SameTuple(tuples[i], tuple)) << i;
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, SegmentedLogRecoveryTest) {
+  const int num_tuples = 200;
+  const int num_rounds = 20;
+  log_segment_size = 16 * 1024;
+  auto *bustub_instance = new BustubInstance("test.db");
+  bustub_instance->log_manager_->RunFlushThread();
+  DiskManager *disk_manager = bustub_instance->disk_manager_;
+  TransactionManager *txn_manager = bustub_instance->transaction_manager_;
+
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, txn);
+  page_id_t first_page_id = test_table->GetFirstPageId();
+  std::vector<RID> rids(num_tuples);
+  std::vector<Tuple> tuples;
+  for (int i = 0; i < num_tuples; i++) {
+    tuples.push_back(ConstructTuple(&schema));
+    ASSERT_TRUE(test_table->InsertTuple(tuples[i], &rids[i], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+
+  // Every round writes the pages back before its checkpoint, so each checkpoint makes the previous rounds obsolete.
+  for (int round = 0; round < num_rounds; round++) {
+    txn = txn_manager->Begin();
+    for (int i = 0; i < num_tuples; i++) {
+      tuples[i] = ConstructTuple(&schema);
+      ASSERT_TRUE(test_table->UpdateTuple(tuples[i], rids[i], txn));
+    }
+    txn_manager->Commit(txn);
+    delete txn;
+    bustub_instance->buffer_pool_manager_->FlushAllPages();
+    bustub_instance->checkpoint_manager_->FuzzyCheckpoint();
+    EXPECT_LE(disk_manager->GetNumLogSegments(), 2) << round;
+  }
+  EXPECT_GT(disk_manager->GetLogSize(), 4 * log_segment_size);
+  EXPECT_GT(disk_manager->GetLogStart(), 0);
+
+  Transaction *loser = txn_manager->Begin();
+  for (int i = 0; i < num_tuples; i += 2) {
+    ASSERT_TRUE(test_table->UpdateTuple(ConstructTuple(&schema), rids[i], loser));
+  }
+  txn = txn_manager->Begin();
+  for (int i = 1; i < num_tuples; i += 2) {
+    tuples[i] = ConstructTuple(&schema);
+    ASSERT_TRUE(test_table->UpdateTuple(tuples[i], rids[i], txn));
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  delete test_table;
+
+  LOG_INFO("System crash with a truncated log");
+  delete bustub_instance;
+  delete loser;
+
+  bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_, 2);
+  log_recovery.Redo();
+  log_recovery.Undo();
+  EXPECT_GE(log_recovery.GetScanStartOffset(), bustub_instance->disk_manager_->GetLogStart());
+
+  txn_manager = bustub_instance->transaction_manager_;
+  txn = txn_manager->Begin();
+  test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                             bustub_instance->log_manager_, first_page_id);
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn)) << i;
+    EXPECT_TRUE(SameTuple(tuples[i], tuple)) << i;
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+/*
+ * Compares the throughput of a transactional workload while checkpoints are taken every 250ms, blocking and fuzzy.
+ * Commits are counted in 50ms windows; the slowest window shows the dip a checkpoint causes. The database lives in
+ * memory behind an emulated SSD, so that flushing the buffer pool takes as long as it would on a device.
+ */
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, RestartTest) {
+  const int num_tuples = 50;
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  std::vector<RID> rids(num_tuples);
+  std::vector<Tuple> tuples;
+  page_id_t first_page_id;
+  txn_id_t loser_id;
+  {
+    DiskManager disk_manager("test.db");
+    LogManager log_manager(&disk_manager);
+    BufferPoolManagerInstance bpm(BUFFER_POOL_SIZE, &disk_manager, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_manager(&lock_manager, &log_manager);
+    log_manager.RunFlushThread();
+
+    Transaction *txn = txn_manager.Begin();
+    TableHeap table(&bpm, &lock_manager, &log_manager, txn);
+    first_page_id = table.GetFirstPageId();
+    for (int i = 0; i < num_tuples; i++) {
+      tuples.push_back(ConstructTuple(&schema));
+      ASSERT_TRUE(table.InsertTuple(tuples[i], &rids[i], txn));
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+
+    // The pages are written back with the updates of the loser, and so with its LSNs.
+    std::unique_ptr<Transaction> loser(txn_manager.Begin());
+    loser_id = loser->GetTransactionId();
+    for (int i = 0; i < num_tuples; i++) {
+      ASSERT_TRUE(table.UpdateTuple(ConstructTuple(&schema), rids[i], loser.get()));
+    }
+    bpm.FlushAllPages();
+    log_manager.StopFlushThread();
+    LOG_INFO("System crash with a loser on disk");
+  }
+
+  {
+    DiskManager disk_manager("test.db");
+    LogManager log_manager(&disk_manager);
+    BufferPoolManagerInstance bpm(BUFFER_POOL_SIZE, &disk_manager, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_manager(&lock_manager, &log_manager);
+    LogRecovery log_recovery(&disk_manager, &bpm, 2);
+    log_recovery.Redo();
+    log_recovery.Undo();
+    EXPECT_EQ(log_recovery.GetMaxTxnId(), loser_id);
+    log_recovery.Restart(&log_manager, &txn_manager);
+    EXPECT_GT(log_manager.GetNextLSN(), log_recovery.GetMaxLSN());
+    log_manager.RunFlushThread();
+
+    // Half of the tuples the loser updated are updated again, and the pages are not written back this time.
+    Transaction *txn = txn_manager.Begin();
+    EXPECT_GT(txn->GetTransactionId(), loser_id);
+    TableHeap table(&bpm, &lock_manager, &log_manager, first_page_id);
+    for (int i = 0; i < num_tuples; i += 2) {
+      tuples[i] = ConstructTuple(&schema);
+      ASSERT_TRUE(table.UpdateTuple(tuples[i], rids[i], txn));
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+    log_manager.StopFlushThread();
+    LOG_INFO("System crash after a restart");
+  }
+
+  // The new updates are newer than the pages, and the loser is not rolled back over them again.
+  auto *bustub_instance = new BustubInstance("test.db");
+  LogRecovery log_recovery(bustub_instance->disk_manager_, bustub_instance->buffer_pool_manager_, 2);
+  log_recovery.Redo();
+  log_recovery.Undo();
+
+  TransactionManager *txn_manager = bustub_instance->transaction_manager_;
+  Transaction *txn = txn_manager->Begin();
+  auto *test_table = new TableHeap(bustub_instance->buffer_pool_manager_, bustub_instance->lock_manager_,
+                                   bustub_instance->log_manager_, first_page_id);
+  for (int i = 0; i < num_tuples; i++) {
+    Tuple tuple;
+    ASSERT_TRUE(test_table->GetTuple(rids[i], &tuple, txn)) << i;
+    EXPECT_TRUE(SameTuple(tuples[i], tuple)) << i;
+  }
+  txn_manager->Commit(txn);
+  delete txn;
+  delete test_table;
+  delete bustub_instance;
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, UndoFailureTest) {
+  Column col{"a", TypeId::VARCHAR, 4000};
+  Schema schema{std::vector<Column>{col}};
+  auto make_tuple = [&schema](size_t length) {
+    return Tuple({ValueFactory::GetVarcharValue(std::string(length, 'a'))}, &schema);
+  };
+
+  MemoryDiskManager disk_manager;
+  {
+    LogManager log_manager(&disk_manager);
+    BufferPoolManagerInstance bpm(BUFFER_POOL_SIZE, &disk_manager, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_manager(&lock_manager, &log_manager);
+    log_manager.RunFlushThread();
+
+    RID rid;
+    RID rid1;
+    Transaction *txn = txn_manager.Begin();
+    TableHeap table(&bpm, &lock_manager, &log_manager, txn);
+    ASSERT_TRUE(table.InsertTuple(make_tuple(1500), &rid, txn));
+    ASSERT_TRUE(table.InsertTuple(make_tuple(1000), &rid1, txn));
+    ASSERT_EQ(rid.GetPageId(), rid1.GetPageId());
+    txn_manager.Commit(txn);
+    delete txn;
+
+    // The loser shrinks a tuple, and a transaction that commits takes the space it gave up.
+    std::unique_ptr<Transaction> loser(txn_manager.Begin());
+    ASSERT_TRUE(table.UpdateTuple(make_tuple(10), rid, loser.get()));
+    txn = txn_manager.Begin();
+    ASSERT_TRUE(table.UpdateTuple(make_tuple(3500), rid1, txn));
+    txn_manager.Commit(txn);
+    delete txn;
+    log_manager.StopFlushThread();
+  }
+
+  // The old tuple of the loser no longer fits on its page, which the undo worker reports to the caller.
+  BufferPoolManagerInstance bpm(BUFFER_POOL_SIZE, &disk_manager);
+  LogRecovery log_recovery(&disk_manager, &bpm, 2);
+  log_recovery.Redo();
+  EXPECT_THROW(log_recovery.Undo(), Exception);
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_CheckpointThroughputBenchmark) {
+  const int num_threads = 4;
+  const int tuples_per_thread = 50000;
+  const int updates_per_txn = 8;
+  const auto window = std::chrono::milliseconds(50);
+  const auto checkpoint_interval = std::chrono::milliseconds(250);
+  const auto duration = std::chrono::seconds(3);
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  for (bool fuzzy : {false, true}) {
+    MemoryDiskManager memory;
+    LatencyDiskManager disk_manager(&memory, DiskProfile::Ssd());
+    LogManager log_manager(&disk_manager);
+    BufferPoolManagerInstance bpm(1024, &disk_manager, &log_manager);
+    LockManager lock_manager;
+    TransactionManager txn_manager(&lock_manager, &log_manager);
+    CheckpointManager checkpoint_manager(&txn_manager, &log_manager, &bpm);
+    log_manager.RunFlushThread();
+
+    Transaction *txn = txn_manager.Begin();
+    TableHeap table(&bpm, &lock_manager, &log_manager, txn);
+    std::vector<RID> rids(num_threads * tuples_per_thread);
+    for (auto &rid : rids) {
+      ASSERT_TRUE(table.InsertTuple(ConstructTuple(&schema), &rid, txn));
+    }
+    txn_manager.Commit(txn);
+    delete txn;
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> commits{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < num_threads; t++) {
+      // Every worker updates its own tuples, so that the workers never wait for each other's locks.
+      workers.emplace_back([&, t] {
+        std::mt19937 generator(t);
+        Tuple tuple = ConstructTuple(&schema);
+        while (!stop) {
+          Transaction *txn = txn_manager.Begin();
+          for (int i = 0; i < updates_per_txn; i++) {
+            table.UpdateTuple(tuple, rids[t * tuples_per_thread + generator() % tuples_per_thread], txn);
+          }
+          txn_manager.Commit(txn);
+          delete txn;
+          commits++;
+        }
+      });
+    }
+    std::thread checkpointer([&] {
+      while (!stop) {
+        std::this_thread::sleep_for(checkpoint_interval);
+        if (fuzzy) {
+          checkpoint_manager.FuzzyCheckpoint();
+        } else {
+          checkpoint_manager.BeginCheckpoint();
+          checkpoint_manager.EndCheckpoint();
+        }
+      }
+    });
+
+    std::vector<uint64_t> windows;
+    auto start = std::chrono::steady_clock::now();
+    for (auto next = start + window; next <= start + duration; next += window) {
+      uint64_t before = commits;
+      std::this_thread::sleep_until(next);
+      windows.push_back(commits - before);
+    }
+    stop = true;
+    checkpointer.join();
+    for (auto &worker : workers) {
+      worker.join();
+    }
+    log_manager.StopFlushThread();
+
+    double seconds = std::chrono::duration<double>(window).count();
+    uint64_t total = 0;
+    for (auto count : windows) {
+      total += count;
+    }
+    LOG_INFO("%s checkpoints: %.0f txn/s on average, %.0f txn/s in the slowest %dms window",
+             fuzzy ? "fuzzy" : "blocking", total / seconds / windows.size(),
+             *std::min_element(windows.begin(), windows.end()) / seconds, static_cast<int>(window.count()));
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_ParallelRecoveryBenchmark) {
+  const int64_t log_bytes = static_cast<int64_t>(2) << 30;
+  const int num_pages = 2048;
+  const int tuples_per_page = 32;
+  const int num_losers = 8;
+  const int records_per_txn = 16;
+  std::vector<Column> cols;
+  for (int i = 0; i < 16; i++) {
+    cols.emplace_back("c" + std::to_string(i), TypeId::INTEGER);
+  }
+  Schema schema{cols};
+  auto make_tuple = [&schema](int32_t v) {
+    return Tuple(std::vector<Value>(schema.GetColumnCount(), ValueFactory::GetIntegerValue(v)), &schema);
+  };
+  Tuple old_tuple = make_tuple(1);
+  Tuple new_tuple = make_tuple(2);
+
+  // Build the log directly: a table of num_pages pages, then transactions of updates until the log is large enough,
+  // then a few transactions that never commit.
+  {
+    DiskManager disk_manager("test.db");
+    LogManager log_manager(&disk_manager, 1 << 20, 4);
+    std::mt19937 generator(15445);
+    txn_id_t txn_id = 0;
+    auto run_txn = [&](bool commit, const std::function<lsn_t(lsn_t)> &body) {
+      LogRecord begin(txn_id, INVALID_LSN, LogRecordType::BEGIN);
+      lsn_t prev_lsn = body(log_manager.AppendLogRecord(&begin));
+      if (commit) {
+        LogRecord commit_record(txn_id, prev_lsn, LogRecordType::COMMIT);
+        log_manager.AppendLogRecord(&commit_record);
+      }
+      txn_id++;
+    };
+    auto random_updates = [&](lsn_t prev_lsn) {
+      for (int i = 0; i < records_per_txn; i++) {
+        RID rid(generator() % num_pages, generator() % tuples_per_page);
+        LogRecord update(txn_id, prev_lsn, LogRecordType::UPDATE, rid, old_tuple, new_tuple);
+        prev_lsn = log_manager.AppendLogRecord(&update);
+      }
+      return prev_lsn;
+    };
+    run_txn(true, [&](lsn_t prev_lsn) {
+      for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+        LogRecord new_page(txn_id, prev_lsn, LogRecordType::NEWPAGE, page_id - 1, page_id);
+        prev_lsn = log_manager.AppendLogRecord(&new_page);
+        for (int slot = 0; slot < tuples_per_page; slot++) {
+          LogRecord insert(txn_id, prev_lsn, LogRecordType::INSERT, RID(page_id, slot), old_tuple);
+          prev_lsn = log_manager.AppendLogRecord(&insert);
+        }
+      }
+      return prev_lsn;
+    });
+    while (disk_manager.GetStats().GetBytes(DiskOp::LOG_WRITE) < static_cast<uint64_t>(log_bytes)) {
+      run_txn(true, random_updates);
+    }
+    for (int i = 0; i < num_losers; i++) {
+      run_txn(false, random_updates);
+    }
+    log_manager.Flush(log_manager.GetNextLSN() - 1);
+    LOG_INFO("log of %.2f GB, %d transactions", disk_manager.GetStats().GetBytes(DiskOp::LOG_WRITE) / 1e9, txn_id);
+    disk_manager.ShutDown();
+  }
+
+  for (size_t num_workers : {1, 2, 4, 8}) {
+    // Start every run from an empty database, so that the whole log is replayed.
+    remove("test.db");
+    DiskManager disk_manager("test.db");
+    BufferPoolManagerInstance bpm(2 * num_pages, &disk_manager);
+    LogRecovery log_recovery(&disk_manager, &bpm, num_workers);
+    auto start = std::chrono::steady_clock::now();
+    log_recovery.Redo();
+    std::chrono::duration<double> redo = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    log_recovery.Undo();
+    std::chrono::duration<double> undo = std::chrono::steady_clock::now() - start;
+    LOG_INFO("%zu workers: redo %.2f s (%.0f MB/s), undo %.3f s", log_recovery.GetNumWorkers(), redo.count(),
+             log_bytes / 1e6 / redo.count(), undo.count());
+    disk_manager.ShutDown();
+  }
+}
+
+/*
+ * Runs update transactions against a file-backed log with a fuzzy checkpoint after every round, once with the log in
+ * a single file and once in 4 MB segments, and reports the disk space of the log as it grows, then the time to
+ * recover from a crash after the last round.
+ */
+// NOLINTNEXTLINE
+TEST_F(RecoveryTest, DISABLED_LogTruncationBenchmark) {
+  const int num_tuples = 10000;
+  const int updates_per_txn = 100;
+  const int txns_per_round = 100;
+  const int num_rounds = 40;
+  Column col1{"a", TypeId::BIGINT};
+  Column col2{"b", TypeId::INTEGER};
+  Schema schema{std::vector<Column>{col1, col2}};
+
+  for (int64_t segment_size : {static_cast<int64_t>(0), static_cast<int64_t>(4) << 20}) {
+    remove("test.db");
+    remove("test.log");
+    remove("test.master");
+    RemoveLogSegments();
+    log_segment_size = segment_size;
+    {
+      DiskManager disk_manager("test.db");
+      LogManager log_manager(&disk_manager);
+      BufferPoolManagerInstance bpm(256, &disk_manager, &log_manager);
+      LockManager lock_manager;
+      TransactionManager txn_manager(&lock_manager, &log_manager);
+      CheckpointManager checkpoint_manager(&txn_manager, &log_manager, &bpm);
+      log_manager.RunFlushThread();
+
+      Transaction *txn = txn_manager.Begin();
+      TableHeap table(&bpm, &lock_manager, &log_manager, txn);
+      std::vector<RID> rids(num_tuples);
+      for (auto &rid : rids) {
+        ASSERT_TRUE(table.InsertTuple(ConstructTuple(&schema), &rid, txn));
+      }
+      txn_manager.Commit(txn);
+      delete txn;
+
+      std::mt19937 generator(15445);
+      for (int round = 1; round <= num_rounds; round++) {
+        for (int i = 0; i < txns_per_round; i++) {
+          txn = txn_manager.Begin();
+          for (int j = 0; j < updates_per_txn; j++) {
+            ASSERT_TRUE(table.UpdateTuple(ConstructTuple(&schema), rids[generator() % num_tuples], txn));
+          }
+          txn_manager.Commit(txn);
+          delete txn;
+        }
+        bpm.FlushAllPages();
+        checkpoint_manager.FuzzyCheckpoint();
+        if (round % 10 == 0) {
+          LOG_INFO("segment size %ld, round %d: %.1f MB logged, %.1f MB on disk", segment_size, round,
+                   disk_manager.GetLogSize() / 1e6, LogDiskUsage() / 1e6);
+        }
+      }
+      log_manager.StopFlushThread();
+      disk_manager.ShutDown();
+    }
+
+    DiskManager disk_manager("test.db");
+    BufferPoolManagerInstance bpm(256, &disk_manager);
+    LogRecovery log_recovery(&disk_manager, &bpm, 1);
+    auto start = std::chrono::steady_clock::now();
+    log_recovery.Redo();
+    log_recovery.Undo();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOG_INFO("segment size %ld: recovery read from offset %ld of %ld in %.3f s", segment_size,
+             log_recovery.GetScanStartOffset(), disk_manager.GetLogSize(), elapsed.count());
+    disk_manager.ShutDown();
+  }
+}
 }  // namespace bustub
@@ -10,11 +10,26 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include <chrono>  // NOLINT
 #include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
 
+#include "catalog/schema.h"
 #include "common/exception.h"
+#include "common/logger.h"
 #include "gtest/gtest.h"
+#include "logging/common.h"
+#include "storage/disk/compressed_disk_manager.h"
 #include "storage/disk/disk_manager.h"
+#include "storage/disk/latency_disk_manager.h"
+#include "storage/disk/memory_disk_manager.h"
+#include "storage/disk/page_codec.h"
+#include "storage/disk/striped_disk_manager.h"
+#include "storage/page/table_page.h"
 
 namespace bustub {
 
@@ -24,13 +39,29 @@ class DiskManagerTest : public ::testing::Test {
   void SetUp() override {
     remove("test.db");
     remove("test.log");
+    RemoveLogSegments();
   }
 
   // This function is called after every test.
   void TearDown() override {
     remove("test.db");
     remove("test.log");
+    remove("test.map");
+    for (int i = 0; i < 8; i++) {
+      remove(("test.db." + std::to_string(i)).c_str());
+    }
+    RemoveLogSegments();
+    log_segment_size = 0;
   };
+
+  /** Remove the segments and spare segments of test.log. */
+  static void RemoveLogSegments() {
+    for (const auto &entry : std::filesystem::directory_iterator(".")) {
+      if (entry.path().filename().string().rfind("test.log.", 0) == 0) {
+        std::filesystem::remove(entry.path());
+      }
+    }
+  }
 };
 
 // NOLINTNEXTLINE
@@ -72,6 +103,412 @@ TEST_F(DiskManagerTest, ReadWriteLogTest) {
   dm.ShutDown();
 }
 
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, StripedReadWritePageTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  std::string db_file("test.db");
+  StripedDiskManager dm(db_file, {".", ".", "."}, 2);
+  EXPECT_EQ(dm.GetNumStripeFiles(), 3);
+
+  // Stripe units of two pages are dealt round-robin over the three files.
+  EXPECT_EQ(dm.Locate(0).first, 0);
+  EXPECT_EQ(dm.Locate(1).first, 0);
+  EXPECT_EQ(dm.Locate(2).first, 1);
+  EXPECT_EQ(dm.Locate(5).first, 2);
+  EXPECT_EQ(dm.Locate(6).first, 0);
+  EXPECT_EQ(dm.Locate(7).second, 3 * static_cast<size_t>(PAGE_SIZE));
+
+  dm.ReadPage(0, buf);  // tolerate empty read
+
+  for (page_id_t page_id = 0; page_id < 20; page_id++) {
+    snprintf(data, sizeof(data), "page %d", page_id);
+    dm.WritePage(page_id, data);
+  }
+  for (page_id_t page_id = 0; page_id < 20; page_id++) {
+    snprintf(data, sizeof(data), "page %d", page_id);
+    dm.ReadPage(page_id, buf);
+    EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  }
+  EXPECT_EQ(dm.GetNumWrites(), 20);
+
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, DISABLED_StripedParallelIOBenchmark) {
+  const size_t num_threads = 8;
+  const page_id_t num_pages = 4096;
+  const size_t ops_per_thread = 4096;
+
+  // Each thread writes then reads back random pages; reports the aggregate page operations per second.
+  auto run = [&](DiskManager *dm) {
+    char zero_page[PAGE_SIZE] = {0};
+    for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+      dm->WritePage(page_id, zero_page);
+    }
+    std::vector<std::thread> threads;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t tid = 0; tid < num_threads; tid++) {
+      threads.emplace_back([&, tid]() {
+        std::mt19937 generator(tid);
+        char page[PAGE_SIZE] = {0};
+        for (size_t i = 0; i < ops_per_thread; i++) {
+          page_id_t page_id = generator() % num_pages;
+          if (i % 2 == 0) {
+            dm->WritePage(page_id, page);
+          } else {
+            dm->ReadPage(page_id, page);
+          }
+        }
+      });
+    }
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return num_threads * ops_per_thread / elapsed.count();
+  };
+
+  std::string db_file("test.db");
+  {
+    DiskManager dm(db_file);
+    LOG_INFO("single file: %.0f page ops/s", run(&dm));
+    dm.ShutDown();
+  }
+  for (size_t num_files : {2, 4, 8}) {
+    std::vector<std::string> dirs(num_files, ".");
+    StripedDiskManager dm(db_file, dirs);
+    LOG_INFO("%zu stripe files: %.0f page ops/s", num_files, run(&dm));
+    dm.ShutDown();
+  }
+}
+
+/** Fill a table page with random tuples until fill_ratio of the page is used. */
+void FillTablePage(Page *page, page_id_t page_id, double fill_ratio) {
+  Column col1{"a", TypeId::VARCHAR, 20};
+  Column col2{"b", TypeId::INTEGER};
+  Column col3{"c", TypeId::BIGINT};
+  Schema schema{{col1, col2, col3}};
+  auto *table_page = reinterpret_cast<TablePage *>(page);
+  memset(page->GetData(), 0, PAGE_SIZE);
+  table_page->Init(page_id, PAGE_SIZE, INVALID_PAGE_ID, nullptr, nullptr);
+  RID rid;
+  size_t used = 0;
+  while (used < fill_ratio * PAGE_SIZE) {
+    Tuple tuple = ConstructTuple(&schema);
+    if (!table_page->InsertTuple(tuple, &rid, nullptr, nullptr, nullptr)) {
+      break;
+    }
+    used += tuple.GetLength() + 8;
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, PageCodecRoundTripTest) {
+  char page[PAGE_SIZE];
+  char compressed[PageCodec::MaxCompressedSize(PAGE_SIZE)];
+  char decompressed[PAGE_SIZE];
+  std::mt19937 generator(0);
+
+  // Zero page, sparse table page and random noise.
+  memset(page, 0, PAGE_SIZE);
+  size_t size = PageCodec::Compress(page, PAGE_SIZE, compressed, sizeof(compressed));
+  EXPECT_LT(size, 64);
+  EXPECT_EQ(PageCodec::Decompress(compressed, size, decompressed, PAGE_SIZE), PAGE_SIZE);
+  EXPECT_EQ(std::memcmp(page, decompressed, PAGE_SIZE), 0);
+
+  Page table_page;
+  FillTablePage(&table_page, 1, 0.2);
+  size = PageCodec::Compress(table_page.GetData(), PAGE_SIZE, compressed, sizeof(compressed));
+  EXPECT_LT(size, PAGE_SIZE / 2);
+  EXPECT_EQ(PageCodec::Decompress(compressed, size, decompressed, PAGE_SIZE), PAGE_SIZE);
+  EXPECT_EQ(std::memcmp(table_page.GetData(), decompressed, PAGE_SIZE), 0);
+
+  for (char &c : page) {
+    c = static_cast<char>(generator());
+  }
+  size = PageCodec::Compress(page, PAGE_SIZE, compressed, sizeof(compressed));
+  ASSERT_GT(size, 0);
+  EXPECT_EQ(PageCodec::Decompress(compressed, size, decompressed, PAGE_SIZE), PAGE_SIZE);
+  EXPECT_EQ(std::memcmp(page, decompressed, PAGE_SIZE), 0);
+  // Noise does not fit into less than a page.
+  EXPECT_EQ(PageCodec::Compress(page, PAGE_SIZE, compressed, PAGE_SIZE - 1), 0);
+
+  // Truncated input is rejected rather than overrunning the output.
+  size = PageCodec::Compress(table_page.GetData(), PAGE_SIZE, compressed, sizeof(compressed));
+  EXPECT_NE(PageCodec::Decompress(compressed, size / 2, decompressed, PAGE_SIZE), PAGE_SIZE);
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, CompressedReadWritePageTest) {
+  char buf[PAGE_SIZE] = {0};
+  char noise[PAGE_SIZE] = {0};
+  std::mt19937 generator(0);
+  for (char &c : noise) {
+    c = static_cast<char>(generator());
+  }
+  std::vector<Page> pages(8);
+  std::string db_file("test.db");
+  {
+    CompressedDiskManager dm(db_file);
+    dm.ReadPage(0, buf);  // tolerate empty read
+
+    for (page_id_t page_id = 0; page_id < 8; page_id++) {
+      FillTablePage(&pages[page_id], page_id, 0.1);
+      dm.WritePage(page_id, pages[page_id].GetData());
+    }
+    // Grow page 3 so that it has to move to a bigger extent, and store an incompressible page.
+    FillTablePage(&pages[3], 3, 0.9);
+    dm.WritePage(3, pages[3].GetData());
+    dm.WritePage(8, noise);
+
+    for (page_id_t page_id = 0; page_id < 8; page_id++) {
+      dm.ReadPage(page_id, buf);
+      EXPECT_EQ(std::memcmp(buf, pages[page_id].GetData(), PAGE_SIZE), 0);
+    }
+    auto stats = dm.GetCompressionStats();
+    EXPECT_EQ(stats.logical_bytes_written_, 10 * PAGE_SIZE);
+    EXPECT_LT(stats.physical_bytes_written_, stats.logical_bytes_written_);
+    dm.ShutDown();
+  }
+
+  // The page map is persistent.
+  CompressedDiskManager dm(db_file);
+  for (page_id_t page_id = 0; page_id < 8; page_id++) {
+    dm.ReadPage(page_id, buf);
+    EXPECT_EQ(std::memcmp(buf, pages[page_id].GetData(), PAGE_SIZE), 0);
+  }
+  dm.ReadPage(8, buf);
+  EXPECT_EQ(std::memcmp(buf, noise, PAGE_SIZE), 0);
+  // The extent page 3 moved out of is reused for a new page rather than growing the file. An empty page compresses
+  // to a single sector, which fits.
+  size_t allocated = dm.GetAllocatedSectors();
+  char empty[PAGE_SIZE] = {0};
+  dm.WritePage(9, empty);
+  EXPECT_EQ(dm.GetAllocatedSectors(), allocated);
+  dm.ReadPage(9, buf);
+  EXPECT_EQ(std::memcmp(buf, empty, PAGE_SIZE), 0);
+  for (page_id_t page_id = 0; page_id < 8; page_id++) {
+    dm.ReadPage(page_id, buf);
+    EXPECT_EQ(std::memcmp(buf, pages[page_id].GetData(), PAGE_SIZE), 0);
+  }
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, DISABLED_CompressionBenchmark) {
+  const page_id_t num_pages = 2048;
+  std::string db_file("test.db");
+  Page page;
+  char buf[PAGE_SIZE];
+
+  for (double fill_ratio : {0.1, 0.3, 0.6, 0.9}) {
+    remove("test.db");
+    remove("test.map");
+    CompressedDiskManager dm(db_file);
+    for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+      FillTablePage(&page, page_id, fill_ratio);
+      dm.WritePage(page_id, page.GetData());
+    }
+    for (page_id_t page_id = 0; page_id < num_pages; page_id++) {
+      dm.ReadPage(page_id, buf);
+    }
+    auto stats = dm.GetCompressionStats();
+    LOG_INFO("fill %.0f%%: wrote %lu of %lu bytes (%.2fx), read %lu of %lu bytes, %.2f us/compress, %.2f us/decompress",
+             fill_ratio * 100, stats.physical_bytes_written_, stats.logical_bytes_written_,
+             static_cast<double>(stats.logical_bytes_written_) / stats.physical_bytes_written_,
+             stats.physical_bytes_read_, stats.logical_bytes_read_, stats.compress_ns_ / 1000.0 / num_pages,
+             stats.decompress_ns_ / 1000.0 / num_pages);
+    dm.ShutDown();
+  }
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, MemoryReadWriteTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  MemoryDiskManager dm;
+  std::strncpy(data, "A test string.", sizeof(data));
+
+  dm.ReadPage(3, buf);  // tolerate empty read
+  char zeroes[PAGE_SIZE] = {0};
+  EXPECT_EQ(std::memcmp(buf, zeroes, sizeof(buf)), 0);
+
+  dm.WritePage(0, data);
+  dm.WritePage(5, data);
+  dm.ReadPage(5, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  EXPECT_EQ(dm.GetNumWrites(), 2);
+
+  char log_buf[16] = {0};
+  EXPECT_FALSE(dm.ReadLog(log_buf, sizeof(log_buf), 0));
+  dm.WriteLog(data, 8);
+  dm.WriteLog(data + 8, 8);
+  EXPECT_TRUE(dm.ReadLog(log_buf, sizeof(log_buf), 0));
+  EXPECT_EQ(std::memcmp(log_buf, data, sizeof(log_buf)), 0);
+  EXPECT_EQ(dm.GetNumFlushes(), 2);
+
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, LatencyInjectionTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  MemoryDiskManager memory;
+  // 4 pages per millisecond, on top of a 1ms access latency.
+  DiskProfile profile{std::chrono::microseconds(1000), std::chrono::microseconds(1000), std::chrono::microseconds(0),
+                      4000ULL * PAGE_SIZE};
+  LatencyDiskManager dm(&memory, profile);
+  std::strncpy(data, "A test string.", sizeof(data));
+
+  auto start = std::chrono::steady_clock::now();
+  dm.WritePage(0, data);
+  dm.ReadPage(0, buf);
+  EXPECT_EQ(std::memcmp(buf, data, sizeof(buf)), 0);
+  EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::microseconds(2500));
+
+  // Concurrent requests overlap their latencies but share the bandwidth: 16 reads take at least 4ms of transfer.
+  start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 16; i++) {
+    threads.emplace_back([&dm] {
+      char page[PAGE_SIZE];
+      dm.ReadPage(0, page);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  EXPECT_GE(elapsed, std::chrono::microseconds(4000));
+  EXPECT_EQ(dm.GetNumWrites(), 1);
+  EXPECT_EQ(memory.GetNumWrites(), 1);
+  EXPECT_GT(dm.GetInjectedDelay().count(), 0);
+
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, IOStatsTest) {
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  MemoryDiskManager memory;
+  DiskProfile profile{std::chrono::microseconds(100), std::chrono::microseconds(0), std::chrono::microseconds(0), 0};
+  LatencyDiskManager dm(&memory, profile);
+  auto &stats = dm.GetStats();
+
+  // Pages 0-3 are written in order, then 10 and 2 break the pattern.
+  for (page_id_t page_id : {0, 1, 2, 3, 10, 2}) {
+    dm.WritePage(page_id, data);
+  }
+  dm.ReadPage(10, buf);
+  dm.ReadPage(11, buf);
+  dm.WriteLog(data, 100);
+  dm.WriteLog(data, 50);
+  dm.ReadLog(buf, 100, 0);
+
+  EXPECT_EQ(stats.GetCount(DiskOp::PAGE_WRITE), 6);
+  EXPECT_EQ(stats.GetBytes(DiskOp::PAGE_WRITE), 6 * PAGE_SIZE);
+  EXPECT_EQ(stats.GetSequentialCount(DiskOp::PAGE_WRITE), 3);
+  EXPECT_EQ(stats.GetCount(DiskOp::PAGE_READ), 2);
+  EXPECT_EQ(stats.GetSequentialCount(DiskOp::PAGE_READ), 1);
+  EXPECT_EQ(stats.GetCount(DiskOp::LOG_WRITE), 2);
+  EXPECT_EQ(stats.GetBytes(DiskOp::LOG_WRITE), 150);
+  EXPECT_EQ(stats.GetSequentialCount(DiskOp::LOG_WRITE), 1);
+  EXPECT_EQ(stats.GetCount(DiskOp::LOG_READ), 1);
+
+  // Reads carry the injected 100us; the wrapped in-memory manager sees the same requests too.
+  EXPECT_GE(stats.GetLatency(DiskOp::PAGE_READ).GetPercentile(50), 128);
+  EXPECT_EQ(memory.GetStats().GetCount(DiskOp::PAGE_READ), 2);
+  EXPECT_EQ(stats.GetLatency(DiskOp::PAGE_WRITE).GetCount(), 6);
+  EXPECT_NE(stats.ToString().find("page write: 6 ops"), std::string::npos);
+
+  dm.StartStatsDump(std::chrono::milliseconds(10));
+  std::this_thread::sleep_for(std::chrono::milliseconds(25));
+  dm.StopStatsDump();
+
+  stats.Reset();
+  EXPECT_EQ(stats.GetCount(DiskOp::PAGE_WRITE), 0);
+  EXPECT_EQ(stats.GetLatency(DiskOp::PAGE_READ).GetPercentile(50), 0);
+  dm.ShutDown();
+}
+
+// NOLINTNEXTLINE
+TEST_F(DiskManagerTest, SegmentedLogTest) {
+  // The log buffers alternate, as the log manager's do.
+  char buffers[2][300];
+  for (int i = 0; i < 2; i++) {
+    for (int j = 0; j < 300; j++) {
+      buffers[i][j] = static_cast<char>(i * 300 + j);
+    }
+  }
+  char buf[700];
+  log_segment_size = 1000;
+  auto *dm = new DiskManager("test.db");
+  EXPECT_FALSE(dm->ReadLog(buf, sizeof(buf), 0));
+  for (int i = 0; i < 10; i++) {
+    dm->WriteLog(buffers[i % 2], 300);
+  }
+  EXPECT_EQ(dm->GetLogSize(), 3000);
+  EXPECT_EQ(dm->GetNumLogSegments(), 3);
+  EXPECT_FALSE(std::filesystem::exists("test.log"));
+  EXPECT_EQ(std::filesystem::file_size("test.log.0"), 1000);
+  EXPECT_EQ(std::filesystem::file_size("test.log.2"), 1000);
+
+  // A read is stitched together across segments, and zero-filled past the end of the log.
+  ASSERT_TRUE(dm->ReadLog(buf, sizeof(buf), 900));
+  for (int k = 0; k < 700; k++) {
+    EXPECT_EQ(buf[k], buffers[(900 + k) / 300 % 2][(900 + k) % 300]) << k;
+  }
+  ASSERT_TRUE(dm->ReadLog(buf, sizeof(buf), 2800));
+  EXPECT_EQ(buf[199], buffers[1][299]);
+  EXPECT_EQ(buf[200], 0);
+
+  // Only the segments wholly before the offset go, and they are kept as spares.
+  dm->TruncateLog(2500);
+  EXPECT_EQ(dm->GetLogStart(), 2000);
+  EXPECT_EQ(dm->GetNumLogSegments(), 1);
+  EXPECT_FALSE(std::filesystem::exists("test.log.0"));
+  EXPECT_TRUE(std::filesystem::exists("test.log.spare.0"));
+  EXPECT_TRUE(std::filesystem::exists("test.log.spare.1"));
+  EXPECT_FALSE(dm->ReadLog(buf, sizeof(buf), 1500));
+  ASSERT_TRUE(dm->ReadLog(buf, 300, 2100));
+  EXPECT_EQ(memcmp(buf, buffers[1], 300), 0);
+  // The last segment is kept even if all of it is obsolete, so that the end of the log is not lost.
+  dm->TruncateLog(3000);
+  EXPECT_EQ(dm->GetNumLogSegments(), 1);
+  dm->ShutDown();
+  delete dm;
+
+  // Reopening finds both ends of the log, and the next segment recycles a spare.
+  dm = new DiskManager("test.db");
+  EXPECT_EQ(dm->GetLogStart(), 2000);
+  EXPECT_EQ(dm->GetLogSize(), 3000);
+  dm->WriteLog(buffers[0], 300);
+  EXPECT_EQ(dm->GetNumLogSegments(), 2);
+  EXPECT_EQ(std::filesystem::file_size("test.log.3"), 300);
+  EXPECT_EQ(std::filesystem::exists("test.log.spare.0") + std::filesystem::exists("test.log.spare.1"), 1);
+  ASSERT_TRUE(dm->ReadLog(buf, 600, 2700));
+  EXPECT_EQ(memcmp(buf, buffers[1], 300), 0);
+  EXPECT_EQ(memcmp(buf + 300, buffers[0], 300), 0);
+
+  // Spares beyond the limit are deleted.
+  for (int i = 0; i < 20; i++) {
+    dm->WriteLog(buffers[(i + 1) % 2], 300);
+  }
+  dm->TruncateLog(dm->GetLogSize());
+  EXPECT_EQ(dm->GetNumLogSegments(), 1);
+  size_t num_files = 0;
+  for (const auto &entry : std::filesystem::directory_iterator(".")) {
+    num_files += entry.path().filename().string().rfind("test.log.", 0) == 0 ? 1 : 0;
+  }
+  EXPECT_EQ(num_files, 1 + DiskManager::MAX_SPARE_LOG_SEGMENTS);
+  dm->ShutDown();
+  delete dm;
+}
+
 // NOLINTNEXTLINE
 TEST_F(DiskManagerTest, ThrowBadFileTest) { EXPECT_THROW(DiskManager("dev/null\\/foo/bar/baz/test.db"), Exception); }
 